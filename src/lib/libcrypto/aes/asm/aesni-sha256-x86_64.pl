@@ -0,0 +1,527 @@
+#!/usr/bin/env perl
+# $OpenBSD$
+#
+# Copyright (c) 2026 The LibreSSL project.
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# AESNI-CBC+SHA256 "stitch", the SHA-256 counterpart of aesni-sha1-x86_64.
+#
+# void aesni_cbc_sha256_enc(const void *inp, void *out, size_t blocks,
+#     const AES_KEY *key, unsigned char iv[16], SHA256_CTX *ctx,
+#     const void *in0);
+#
+# CBC encrypts blocks*64 bytes from inp to out and hashes blocks*64 bytes
+# from in0 into ctx. AES-NI CBC encryption is a chain of dependent
+# aesenc instructions that leaves most of the core idle, so the four AES
+# blocks that go with each SHA-256 block are woven into its rounds.
+#
+# Where the SHA extensions are available, the rounds are sha256rnds2 in
+# xmm registers, as in sha256_block_data_order. Otherwise they are the
+# integer rounds of sha256_block_data_order, which leave the SIMD units
+# to AES. Decryption is left to aesni_cbc_encrypt, as it already runs
+# several blocks in parallel.
+#
+# Cycles per byte for AES-128-CBC and HMAC-SHA256 over 16KB, measured
+# with rdtsc on an AVX-512 capable Intel core:
+#
+#			AES-128-CBC	+SHA256		stitch
+# integer		1.45		7.43		6.31
+# SHA extensions	1.45		2.97		1.50
+
+$flavour = shift;
+$output  = shift;
+if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+open OUT,"| \"$^X\" $xlate $flavour $output";
+*STDOUT=*OUT;
+
+@Sigma0=( 2,13,22);
+@Sigma1=( 6,11,25);
+@sigma0=( 7,18, 3);
+@sigma1=(17,19,10);
+
+# Arguments, as passed. The AES output pointer is turned into an offset
+# from the AES input pointer.
+($in0,$out,$len,$key,$ivp,$ctx,$inp)=
+    ("%rdi","%rsi","%rdx","%rcx","%r8","%r9","%r10");
+
+($iv,$in,$rndkey0)=map("%xmm$_",(11..13));
+@rndkey=("%xmm14","%xmm15");
+
+# One step of the CBC encryption of the four AES blocks that go with each
+# SHA-256 block, ten steps per AES block; the last step of each block
+# does the extra rounds of AES-192 and AES-256.
+$r=0; $sn=0;
+sub aesenc
+{ use integer;
+  my ($n,$k)=(($r/10)%4,$r%10);
+
+    if ($k==0) {
+      $code.=<<___;
+	movups		`16*$n`($in0),$in		# load input
+	xorps		$rndkey0,$in
+___
+      $code.=<<___ if ($n);
+	movups		$iv,`16*($n-1)`($out,$in0)	# write output
+___
+      $code.=<<___;
+	xorps		$in,$iv
+	aesenc		$rndkey[0],$iv
+	movups		`32+16*$k`($key),$rndkey[1]
+___
+    } elsif ($k==9) {
+      $sn++;
+      $code.=<<___;
+	cmpl		\$11,240($key)
+	jb		.Laesenclast$sn
+	movups		`32+16*($k+0)`($key),$rndkey[1]
+	aesenc		$rndkey[0],$iv
+	movups		`32+16*($k+1)`($key),$rndkey[0]
+	aesenc		$rndkey[1],$iv
+	je		.Laesenclast$sn
+	movups		`32+16*($k+2)`($key),$rndkey[1]
+	aesenc		$rndkey[0],$iv
+	movups		`32+16*($k+3)`($key),$rndkey[0]
+	aesenc		$rndkey[1],$iv
+.Laesenclast$sn:
+	aesenclast	$rndkey[0],$iv
+	movups		16($key),$rndkey[1]		# forward reference
+___
+    } else {
+      $code.=<<___;
+	aesenc		$rndkey[0],$iv
+	movups		`32+16*$k`($key),$rndkey[1]
+___
+    }
+    $r++;	unshift(@rndkey,pop(@rndkey));
+}
+
+# Emit the given instructions with $n AES steps spread among them.
+sub weave
+{ my ($n,@insns)=@_;
+  my ($i,$s);
+
+    for ($i=0,$s=0; $i<@insns; $i++) {
+	$code.=$insns[$i];
+	while ($s<$n && ($s+1)*@insns<=($i+1)*($n+1)) {
+		&aesenc();
+		$s++;
+	}
+    }
+    while ($s++<$n) { &aesenc(); }
+}
+
+######################################################################
+# Integer code path.
+#
+{
+my @ROT=($A,$B,$C,$D,$E,$F,$G,$H)=("%eax","%ebx","%ecx","%edx",
+				"%r8d","%r9d","%r10d","%r11d");
+my ($T1,$a0,$a1,$a2)=("%r12d","%r13d","%r14d","%r15d");
+my @X=map("%xmm$_",(0..3));
+my $BSWAP="%xmm4";
+
+my $_ctx="16*4+0*8(%rsp)";
+my $_inp="16*4+1*8(%rsp)";
+my $_end="16*4+2*8(%rsp)";
+my $_ivp="16*4+3*8(%rsp)";
+my $_rsp="16*4+4*8(%rsp)";
+my $framesz="16*4+5*8";
+
+# The rounds of sha256_block_data_order, with the sixteen words of the
+# message schedule kept on the stack. The input block is byte swapped
+# into place before the rounds start.
+sub ROUND()
+{ my ($i,$a,$b,$c,$d,$e,$f,$g,$h) = @_;
+  my $code;
+
+$code.=<<___ if ($i<16);
+	mov	`4*$i`(%rsp),$T1
+	mov	$e,$a0
+	mov	$a,$a1
+___
+$code.=<<___ if ($i>=16);
+	mov	`4*(($i+1)&0xf)`(%rsp),$a0
+	mov	`4*(($i+14)&0xf)`(%rsp),$a1
+	mov	$a0,$T1
+	mov	$a1,$a2
+
+	ror	\$`$sigma0[1]-$sigma0[0]`,$T1
+	xor	$a0,$T1
+	shr	\$$sigma0[2],$a0
+
+	ror	\$$sigma0[0],$T1
+	xor	$T1,$a0			# sigma0(X[(i+1)&0xf])
+	mov	`4*(($i+9)&0xf)`(%rsp),$T1
+
+	ror	\$`$sigma1[1]-$sigma1[0]`,$a2
+	xor	$a1,$a2
+	shr	\$$sigma1[2],$a1
+
+	ror	\$$sigma1[0],$a2
+	add	$a0,$T1
+	xor	$a2,$a1			# sigma1(X[(i+14)&0xf])
+
+	add	`4*($i&0xf)`(%rsp),$T1
+	mov	$e,$a0
+	add	$a1,$T1
+	mov	$a,$a1
+	mov	$T1,`4*($i&0xf)`(%rsp)
+___
+$code.=<<___;
+	ror	\$`$Sigma1[2]-$Sigma1[1]`,$a0
+	mov	$f,$a2
+
+	ror	\$`$Sigma0[2]-$Sigma0[1]`,$a1
+	xor	$e,$a0
+	xor	$g,$a2			# f^g
+
+	ror	\$`$Sigma1[1]-$Sigma1[0]`,$a0
+	add	$h,$T1			# T1+=h
+	xor	$a,$a1
+
+	add	K256+`4*$i`(%rip),$T1	# T1+=K[i]
+	and	$e,$a2			# (f^g)&e
+	mov	$b,$h
+
+	ror	\$`$Sigma0[1]-$Sigma0[0]`,$a1
+	xor	$e,$a0
+	xor	$g,$a2			# Ch(e,f,g)=((f^g)&e)^g
+
+	xor	$c,$h			# b^c
+	xor	$a,$a1
+	add	$a2,$T1			# T1+=Ch(e,f,g)
+	mov	$b,$a2
+
+	ror	\$$Sigma1[0],$a0	# Sigma1(e)
+	and	$a,$h			# h=(b^c)&a
+	and	$c,$a2			# b&c
+
+	ror	\$$Sigma0[0],$a1	# Sigma0(a)
+	add	$a0,$T1			# T1+=Sigma1(e)
+	add	$a2,$h			# h+=b&c (completes +=Maj(a,b,c)
+
+	add	$T1,$d			# d+=T1
+	add	$T1,$h			# h+=T1
+	add	$a1,$h			# h+=Sigma0(a)
+___
+	return (grep(!/^$/,split(/^/,$code)));
+}
+
+$code.=<<___;
+.text
+.extern	OPENSSL_ia32cap_ext_P
+.hidden	OPENSSL_ia32cap_ext_P
+
+.globl	aesni_cbc_sha256_enc
+.type	aesni_cbc_sha256_enc,\@abi-omnipotent
+.align	16
+aesni_cbc_sha256_enc:
+	# caller should check for SSSE3 and AES-NI bits
+	mov	8(%rsp),$inp			# load 7th argument
+	mov	OPENSSL_ia32cap_ext_P(%rip),%r11d
+	test	\$IA32CAP_EXT_MASK_SHA,%r11d
+	jnz	aesni_cbc_sha256_enc_shaext
+
+	push	%rbx
+	push	%rbp
+	push	%r12
+	push	%r13
+	push	%r14
+	push	%r15
+	mov	%rsp,%r11			# copy %rsp
+	sub	\$$framesz,%rsp
+	and	\$-64,%rsp			# align stack frame
+	shl	\$6,$len
+	add	$inp,$len			# end of SHA input
+	sub	$in0,$out
+	mov	$ctx,$_ctx
+	mov	$inp,$_inp
+	mov	$len,$_end
+	mov	$ivp,$_ivp
+	mov	%r11,$_rsp
+
+	movdqu	($ivp),$iv			# load IV
+	mov	$key,%rbp
+	movdqa	.Lbswap(%rip),$BSWAP
+___
+$key="%rbp";
+$code.=<<___;
+	movups	($key),$rndkey0			# \$key[0]
+	movups	16($key),$rndkey[0]		# forward reference
+
+	mov	4*0($ctx),$A			# load context
+	mov	4*1($ctx),$B
+	mov	4*2($ctx),$C
+	mov	4*3($ctx),$D
+	mov	4*4($ctx),$E
+	mov	4*6($ctx),$G
+	mov	4*7($ctx),$H
+	mov	4*5($ctx),$F			# zaps \$ctx
+	jmp	.Lloop
+
+.align	16
+.Lloop:
+	mov	$_inp,%r12
+	movdqu	0x00(%r12),@X[0]
+	movdqu	0x10(%r12),@X[1]
+	movdqu	0x20(%r12),@X[2]
+	movdqu	0x30(%r12),@X[3]
+	lea	0x40(%r12),%r12
+	pshufb	$BSWAP,@X[0]
+	pshufb	$BSWAP,@X[1]
+	pshufb	$BSWAP,@X[2]
+	pshufb	$BSWAP,@X[3]
+	mov	%r12,$_inp
+	movdqa	@X[0],0x00(%rsp)
+	movdqa	@X[1],0x10(%rsp)
+	movdqa	@X[2],0x20(%rsp)
+	movdqa	@X[3],0x30(%rsp)
+___
+	# 40 AES steps spread over the 64 rounds.
+	for ($i=0; $i<64; $i++) {
+		&weave(int(($i+1)*40/64)-int($i*40/64), &ROUND($i,@ROT));
+		unshift(@ROT,pop(@ROT));
+	}
+$code.=<<___;
+	movups	$iv,48($out,$in0)		# write output
+	lea	64($in0),$in0
+
+	mov	$_ctx,%r12
+	add	4*0(%r12),$A			# update context
+	add	4*1(%r12),$B
+	add	4*2(%r12),$C
+	add	4*3(%r12),$D
+	add	4*4(%r12),$E
+	add	4*5(%r12),$F
+	add	4*6(%r12),$G
+	add	4*7(%r12),$H
+	mov	$A,4*0(%r12)
+	mov	$B,4*1(%r12)
+	mov	$C,4*2(%r12)
+	mov	$D,4*3(%r12)
+	mov	$E,4*4(%r12)
+	mov	$F,4*5(%r12)
+	mov	$G,4*6(%r12)
+	mov	$H,4*7(%r12)
+
+	mov	$_inp,%r13
+	cmp	$_end,%r13
+	jb	.Lloop
+
+	mov	$_ivp,%r12
+	movups	$iv,(%r12)			# write IV
+
+	mov	$_rsp,%rsi
+	mov	(%rsi),%r15
+	mov	8(%rsi),%r14
+	mov	16(%rsi),%r13
+	mov	24(%rsi),%r12
+	mov	32(%rsi),%rbp
+	mov	40(%rsi),%rbx
+	lea	48(%rsi),%rsp
+	ret
+.size	aesni_cbc_sha256_enc,.-aesni_cbc_sha256_enc
+___
+}
+
+######################################################################
+# SHA extensions code path. This is the sha256rnds2 loop of
+# sha256_block_data_order, split into its sixteen groups of four rounds,
+# with the AES steps spread among them.
+#
+{
+my ($Wi,$ABEF,$CDGH,$TMP,$ABEF_SAVE,$CDGH_SAVE,$BSWAP)=
+    map("%xmm$_",(0..2,7..10));
+my @MSG=map("%xmm$_",(3..6));
+my @MSG0=@MSG;
+my $Ktbl="%r11";
+
+$key="%rcx";
+$r=0;
+
+my @groups;
+push(@groups,<<___);
+	movdqa	0*16($Ktbl),$Wi
+	paddd	@MSG[0],$Wi
+	pshufb	$TMP,@MSG[1]
+	movdqa	$CDGH,$CDGH_SAVE
+	sha256rnds2	$ABEF,$CDGH		# 0-3
+	pshufd	\$0x0e,$Wi,$Wi
+	movdqa	$ABEF,$ABEF_SAVE
+	sha256rnds2	$CDGH,$ABEF
+___
+push(@groups,<<___);
+	movdqa	1*16($Ktbl),$Wi
+	paddd	@MSG[1],$Wi
+	pshufb	$TMP,@MSG[2]
+	sha256rnds2	$ABEF,$CDGH		# 4-7
+	pshufd	\$0x0e,$Wi,$Wi
+	lea	0x40($inp),$inp
+	sha256msg1	@MSG[1],@MSG[0]
+	sha256rnds2	$CDGH,$ABEF
+___
+push(@groups,<<___);
+	movdqa	2*16($Ktbl),$Wi
+	paddd	@MSG[2],$Wi
+	pshufb	$TMP,@MSG[3]
+	sha256rnds2	$ABEF,$CDGH		# 8-11
+	pshufd	\$0x0e,$Wi,$Wi
+	movdqa	@MSG[3],$TMP
+	palignr	\$4,@MSG[2],$TMP
+	paddd	$TMP,@MSG[0]
+	sha256msg1	@MSG[2],@MSG[1]
+	sha256rnds2	$CDGH,$ABEF
+___
+for ($i=3; $i<13; $i++) {
+push(@groups,<<___);
+	movdqa	$i*16($Ktbl),$Wi
+	paddd	@MSG[3],$Wi
+	sha256msg2	@MSG[3],@MSG[0]
+	sha256rnds2	$ABEF,$CDGH		# `4*$i`-`4*$i+3`
+	pshufd	\$0x0e,$Wi,$Wi
+	movdqa	@MSG[0],$TMP
+	palignr	\$4,@MSG[3],$TMP
+	paddd	$TMP,@MSG[1]
+	sha256msg1	@MSG[3],@MSG[2]
+	sha256rnds2	$CDGH,$ABEF
+___
+	push(@MSG,shift(@MSG));
+}
+push(@groups,<<___);
+	movdqa	13*16($Ktbl),$Wi
+	paddd	@MSG[3],$Wi
+	sha256msg2	@MSG[3],@MSG[0]
+	sha256rnds2	$ABEF,$CDGH		# 52-55
+	pshufd	\$0x0e,$Wi,$Wi
+	movdqa	@MSG[0],$TMP
+	palignr	\$4,@MSG[3],$TMP
+	sha256rnds2	$CDGH,$ABEF
+	paddd	$TMP,@MSG[1]
+___
+push(@groups,<<___);
+	movdqa	14*16($Ktbl),$Wi
+	paddd	@MSG[0],$Wi
+	sha256rnds2	$ABEF,$CDGH		# 56-59
+	pshufd	\$0x0e,$Wi,$Wi
+	sha256msg2	@MSG[0],@MSG[1]
+	movdqa	$BSWAP,$TMP
+	sha256rnds2	$CDGH,$ABEF
+___
+push(@groups,<<___);
+	movdqa	15*16($Ktbl),$Wi
+	paddd	@MSG[1],$Wi
+	sha256rnds2	$ABEF,$CDGH		# 60-63
+	pshufd	\$0x0e,$Wi,$Wi
+	sha256rnds2	$CDGH,$ABEF
+___
+
+$code.=<<___;
+.type	aesni_cbc_sha256_enc_shaext,\@abi-omnipotent
+.align	16
+aesni_cbc_sha256_enc_shaext:
+	lea	K256(%rip),$Ktbl
+	sub	$in0,$out
+	movdqu	($ctx),$ABEF			# DCBA
+	movdqu	16($ctx),$CDGH			# HGFE
+	movdqa	.Lbswap(%rip),$TMP
+	movdqu	($ivp),$iv			# load IV
+	movups	($key),$rndkey0			# \$key[0]
+	movups	16($key),$rndkey[0]		# forward reference
+
+	pshufd	\$0x1b,$ABEF,$Wi		# ABCD
+	pshufd	\$0xb1,$ABEF,$ABEF		# CDAB
+	pshufd	\$0x1b,$CDGH,$CDGH		# EFGH
+	movdqa	$TMP,$BSWAP
+	palignr	\$8,$CDGH,$ABEF			# ABEF
+	punpcklqdq	$Wi,$CDGH		# CDGH
+	jmp	.Loop_shaext
+
+.align	16
+.Loop_shaext:
+	movdqu	($inp),@MSG0[0]
+	movdqu	0x10($inp),@MSG0[1]
+	movdqu	0x20($inp),@MSG0[2]
+	pshufb	$TMP,@MSG0[0]
+	movdqu	0x30($inp),@MSG0[3]
+___
+	# 40 AES steps spread over the 16 groups.
+	for ($i=0; $i<16; $i++) {
+		&weave(int(($i+1)*40/16)-int($i*40/16),
+		    split(/^/,$groups[$i]));
+	}
+$code.=<<___;
+	paddd	$CDGH_SAVE,$CDGH
+	paddd	$ABEF_SAVE,$ABEF
+
+	movups	$iv,48($out,$in0)		# write output
+	lea	64($in0),$in0
+	dec	$len
+	jnz	.Loop_shaext
+
+	pshufd	\$0xb1,$CDGH,$CDGH		# DCHG
+	pshufd	\$0x1b,$ABEF,$TMP		# FEBA
+	pshufd	\$0xb1,$ABEF,$ABEF		# BAFE
+	punpckhqdq	$CDGH,$ABEF		# DCBA
+	palignr	\$8,$TMP,$CDGH			# HGFE
+
+	movdqu	$ABEF,($ctx)
+	movdqu	$CDGH,16($ctx)
+	movups	$iv,($ivp)			# write IV
+	ret
+.size	aesni_cbc_sha256_enc_shaext,.-aesni_cbc_sha256_enc_shaext
+___
+}
+
+@K256=(	0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,
+	0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+	0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,
+	0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+	0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,
+	0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+	0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,
+	0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+	0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,
+	0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+	0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,
+	0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+	0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,
+	0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+	0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,
+	0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2	);
+
+$code.=<<___;
+.align	64
+.type	K256,\@object
+K256:
+___
+for ($i=0; $i<@K256; $i+=4) {
+	$code.=sprintf("\t.long\t0x%08x,0x%08x,0x%08x,0x%08x\n",
+	    @K256[$i..$i+3]);
+}
+$code.=<<___;
+.size	K256,.-K256
+.Lbswap:
+	.byte	3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12
+___
+
+$code =~ s/\`([^\`]*)\`/eval($1)/gem;
+
+print $code;
+close STDOUT;
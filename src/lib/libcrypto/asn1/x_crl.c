@@ -58,6 +58,9 @@
 
 #include <stdio.h>
 
+#include <stdint.h>
+#include <stdlib.h>
+
 #include <openssl/opensslconf.h>
 
 #include <openssl/asn1t.h>
@@ -67,9 +70,35 @@
 
 #include "asn1_locl.h"
 
+/*
+ * The revoked entries of a decoded CRL sorted by serial number. The index
+ * is built once when the CRL is decoded and is read-only afterwards, so
+ * lookups take no lock. Each entry carries a key made of the serial
+ * length and its first bytes, which orders like ASN1_STRING_cmp(): a
+ * search compares keys within the array and only looks at the serials
+ * themselves when the keys are equal.
+ *
+ * The revoked stack is public and may be changed without the index being
+ * told, so each entry also records where its X509_REVOKED was on the
+ * stack. An entry is only followed while the stack still holds the same
+ * pointer there.
+ */
+struct x509_crl_index_entry {
+	uint64_t key;
+	X509_REVOKED *rev;
+	int pos;
+};
+
+struct x509_crl_index_st {
+	struct x509_crl_index_entry *entries;
+	int count;
+};
+
 static int X509_REVOKED_cmp(const X509_REVOKED * const *a,
     const X509_REVOKED * const *b);
 static void setup_idp(X509_CRL *crl, ISSUING_DIST_POINT *idp);
+static int crl_index_build(X509_CRL *crl);
+static void crl_index_free(X509_CRL *crl);
 
 static const ASN1_TEMPLATE X509_REVOKED_seq_tt[] = {
 	{
@@ -284,6 +313,7 @@ crl_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it, void *exarg)
 		crl->issuers = NULL;
 		crl->crl_number = NULL;
 		crl->base_crl_number = NULL;
+		crl->revoked_index = NULL;
 		break;
 
 	case ASN1_OP_D2I_POST:
@@ -337,6 +367,9 @@ crl_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it, void *exarg)
 		if (!crl_set_issuers(crl))
 			return 0;
 
+		if (!crl_index_build(crl))
+			return 0;
+
 		if (crl->meth->crl_init) {
 			if (crl->meth->crl_init(crl) == 0)
 				return 0;
@@ -355,11 +388,151 @@ crl_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it, void *exarg)
 		ASN1_INTEGER_free(crl->crl_number);
 		ASN1_INTEGER_free(crl->base_crl_number);
 		sk_GENERAL_NAMES_pop_free(crl->issuers, GENERAL_NAMES_free);
+		crl_index_free(crl);
 		break;
 	}
 	return rc;
 }
 
+/*
+ * Serials of 255 bytes or more all get the same key, which keeps the keys
+ * in order; RFC 5280 limits serials to 20 bytes anyway.
+ */
+static uint64_t
+crl_serial_key(const ASN1_INTEGER *serial)
+{
+	uint64_t key;
+	int i;
+
+	if (serial->length >= 0xff)
+		return (uint64_t)0xff << 56;
+
+	key = serial->length;
+	for (i = 0; i < 7; i++) {
+		key <<= 8;
+		if (i < serial->length)
+			key |= serial->data[i];
+	}
+	return key;
+}
+
+static int
+crl_index_cmp(const void *a, const void *b)
+{
+	const struct x509_crl_index_entry *ea = a, *eb = b;
+	int ret;
+
+	if (ea->key != eb->key)
+		return ea->key < eb->key ? -1 : 1;
+	ret = ASN1_STRING_cmp(ea->rev->serialNumber, eb->rev->serialNumber);
+	if (ret != 0)
+		return ret;
+	return ea->rev->sequence - eb->rev->sequence;
+}
+
+static void
+crl_index_free(X509_CRL *crl)
+{
+	if (crl->revoked_index == NULL)
+		return;
+	free(crl->revoked_index->entries);
+	free(crl->revoked_index);
+	crl->revoked_index = NULL;
+}
+
+static int
+crl_index_build(X509_CRL *crl)
+{
+	STACK_OF(X509_REVOKED) *revoked = crl->crl->revoked;
+	struct x509_crl_index_st *index;
+	X509_REVOKED *rev;
+	int i, n;
+
+	crl_index_free(crl);
+
+	if ((n = sk_X509_REVOKED_num(revoked)) <= 0)
+		return 1;
+
+	if ((index = malloc(sizeof(*index))) == NULL)
+		return 0;
+	if ((index->entries = reallocarray(NULL, n,
+	    sizeof(*index->entries))) == NULL) {
+		free(index);
+		return 0;
+	}
+	index->count = n;
+
+	for (i = 0; i < n; i++) {
+		rev = sk_X509_REVOKED_value(revoked, i);
+		rev->sequence = i;
+		index->entries[i].key = crl_serial_key(rev->serialNumber);
+		index->entries[i].rev = rev;
+		index->entries[i].pos = i;
+	}
+	qsort(index->entries, n, sizeof(*index->entries), crl_index_cmp);
+
+	crl->revoked_index = index;
+	return 1;
+}
+
+/*
+ * Return the revoked entry of index entry e, or NULL if the revoked stack
+ * no longer holds it where it was when the index was built.
+ */
+static X509_REVOKED *
+crl_index_rev(const X509_CRL *crl, const struct x509_crl_index_entry *e)
+{
+	X509_REVOKED *rev;
+
+	rev = sk_X509_REVOKED_value(crl->crl->revoked, e->pos);
+	if (rev != e->rev || rev->serialNumber == NULL ||
+	    crl_serial_key(rev->serialNumber) != e->key)
+		return NULL;
+	return rev;
+}
+
+/*
+ * Return the position of the first entry not below serial, or -1 if the
+ * index is out of date.
+ */
+static int
+crl_index_find(const X509_CRL *crl, const ASN1_INTEGER *serial)
+{
+	const struct x509_crl_index_st *index = crl->revoked_index;
+	const struct x509_crl_index_entry *e;
+	X509_REVOKED *rev;
+	uint64_t key;
+	int lo, hi, mid, cmp;
+
+	key = crl_serial_key(serial);
+	lo = 0;
+	hi = index->count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		e = &index->entries[mid];
+		if (e->key != key)
+			cmp = e->key < key ? -1 : 1;
+		else if ((rev = crl_index_rev(crl, e)) == NULL)
+			return -1;
+		else
+			cmp = ASN1_STRING_cmp(rev->serialNumber, serial);
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+size_t
+X509_CRL_revoked_index_size(const X509_CRL *crl)
+{
+	if (crl->revoked_index == NULL)
+		return 0;
+	return sizeof(*crl->revoked_index) + crl->revoked_index->count *
+	    sizeof(*crl->revoked_index->entries);
+}
+
 /* Convert IDP into a more convenient form */
 
 static void
@@ -539,6 +712,7 @@ X509_CRL_add0_revoked(X509_CRL *crl, X509_REVOKED *rev)
 		return 0;
 	}
 	inf->enc.modified = 1;
+	crl_index_free(crl);
 	return 1;
 }
 
@@ -602,13 +776,47 @@ crl_revoked_issuer_match(X509_CRL *crl, X509_NAME *nm, X509_REVOKED *rev)
 
 }
 
+static int
+crl_revoked_found(X509_REVOKED *rev, X509_REVOKED **ret)
+{
+	if (ret)
+		*ret = rev;
+	if (rev->reason == CRL_REASON_REMOVE_FROM_CRL)
+		return 2;
+	return 1;
+}
+
 static int
 def_crl_lookup(X509_CRL *crl, X509_REVOKED **ret, ASN1_INTEGER *serial,
     X509_NAME *issuer)
 {
+	struct x509_crl_index_st *index = crl->revoked_index;
 	X509_REVOKED rtmp, *rev;
 	int idx;
 
+	/*
+	 * Use the index unless the revoked entries were changed behind its
+	 * back since the CRL was decoded. Entries are checked against the
+	 * stack before they are used, and the search starts over on the
+	 * stack if one was replaced or moved.
+	 */
+	if (index != NULL &&
+	    index->count == sk_X509_REVOKED_num(crl->crl->revoked) &&
+	    (idx = crl_index_find(crl, serial)) >= 0) {
+		for (; idx < index->count; idx++) {
+			if ((rev = crl_index_rev(crl,
+			    &index->entries[idx])) == NULL)
+				goto stale;
+			if (ASN1_STRING_cmp(rev->serialNumber, serial))
+				return 0;
+			if (crl_revoked_issuer_match(crl, issuer, rev))
+				return crl_revoked_found(rev, ret);
+		}
+		return 0;
+	}
+
+ stale:
+
 	rtmp.serialNumber = serial;
 	/* Sort revoked into serial number order if not already sorted.
 	 * Do this under a lock to avoid race condition.
@@ -626,13 +834,8 @@ def_crl_lookup(X509_CRL *crl, X509_REVOKED **ret, ASN1_INTEGER *serial,
 		rev = sk_X509_REVOKED_value(crl->crl->revoked, idx);
 		if (ASN1_INTEGER_cmp(rev->serialNumber, serial))
 			return 0;
-		if (crl_revoked_issuer_match(crl, issuer, rev)) {
-			if (ret)
-				*ret = rev;
-			if (rev->reason == CRL_REASON_REMOVE_FROM_CRL)
-				return 2;
-			return 1;
-		}
+		if (crl_revoked_issuer_match(crl, issuer, rev))
+			return crl_revoked_found(rev, ret);
 	}
 	return 0;
 }
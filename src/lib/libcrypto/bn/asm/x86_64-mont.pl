@@ -29,6 +29,12 @@
 # to *initial* version of this module from 2005 is ~0%/30%/40%/45%
 # for 512-/1024-/2048-/4096-bit RSA *sign* benchmarks respectively.
 
+# October 2026.
+#
+# Add bn_mulx4x_mont, which interleaves two carry chains with the
+# BMI2 mulx and ADX adcx/adox instructions. It is used for both
+# multiplication and squaring on processors that have them.
+
 $flavour = shift;
 $output  = shift;
 if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
@@ -56,9 +62,14 @@ $j="%r15";
 $m0="%rbx";
 $m1="%rbp";
 
+$bmi2adx="(IA32CAP_EXT_MASK_BMI2|IA32CAP_EXT_MASK_ADX)";
+
 $code=<<___;
 .text
 
+.extern	OPENSSL_ia32cap_ext_P
+.hidden	OPENSSL_ia32cap_ext_P
+
 .globl	bn_mul_mont
 .type	bn_mul_mont,\@function,6
 .align	16
@@ -67,6 +78,10 @@ bn_mul_mont:
 	jnz	.Lmul_enter
 	cmp	\$8,${num}d
 	jb	.Lmul_enter
+	mov	OPENSSL_ia32cap_ext_P(%rip),%r11d
+	and	\$$bmi2adx,%r11d
+	cmp	\$$bmi2adx,%r11d
+	je	.Lmulx4x_enter
 	cmp	$ap,$bp
 	jne	.Lmul4x_enter
 	jmp	.Lsqr4x_enter
@@ -1495,6 +1510,184 @@ $code.=<<___;
 .size	bn_sqr4x_mont,.-bn_sqr4x_mont
 ___
 }}}
+{{{
+######################################################################
+# int bn_mulx4x_mont(
+#
+# Same arguments and constraints as bn_mul4x_mont. Each iteration of
+# the outer loop adds ap[]*bp[i] and then m*np[] to tp[]. Low halves
+# of the products are accumulated on the CF chain with adcx and high
+# halves on the OF chain with adox, so that both carry chains run
+# in parallel. Neither chain may be disturbed inside the inner loops,
+# hence lea for pointer updates and jrcxz for loop control.
+my ($aptr,$nptr,$tptr)=("%r15","%rbp","%r14");
+my ($bptr,$bend)=("%r12","%r13");
+
+$code.=<<___;
+.type	bn_mulx4x_mont,\@function,6
+.align	32
+bn_mulx4x_mont:
+.Lmulx4x_enter:
+	push	%rbx
+	push	%rbp
+	push	%r12
+	push	%r13
+	push	%r14
+	push	%r15
+
+	mov	${num}d,${num}d
+	lea	4($num),%r10
+	mov	%rsp,%r11
+	neg	%r10
+	lea	(%rsp,%r10,8),%rsp	# tp=alloca(8*(num+4))
+	and	\$-1024,%rsp		# minimize TLB usage
+
+	mov	%r11,24(%rsp,$num,8)	# tp[num+2]=%rsp
+.Lmulx4x_body:
+	mov	%rdx,$bptr		# reassign $bp
+	lea	($bptr,$num,8),$bend	# end of bp[]
+	mov	$np,$nptr		# reassign $np
+	mov	($n0),$n0		# pull n0[0] value
+
+	lea	8(%rsp),$tptr		# tp[-1] is at (%rsp)
+	lea	2($num),%rcx
+	xor	%eax,%eax
+.Lmulx4x_zero:
+	mov	%rax,($tptr)		# tp[0..num+1]=0
+	lea	8($tptr),$tptr
+	dec	%rcx
+	jnz	.Lmulx4x_zero
+
+.align	16
+.Lmulx4x_outer:
+	mov	($bptr),%rdx		# bp[i]
+	lea	8($bptr),$bptr
+	lea	8(%rsp),$tptr
+	mov	$ap,$aptr
+	mov	$num,%rcx
+	shr	\$2,%rcx
+	neg	%rcx
+	xor	%r10d,%r10d		# clear CF and OF
+
+.align	16
+.Lmulx4x_mul:				# tp[]+=ap[]*bp[i]
+	mulx	0($aptr),%rax,%r11
+	adcx	0($tptr),%rax
+	adox	%r10,%rax
+	mov	%rax,0($tptr)
+	mulx	8($aptr),%rax,%r10
+	adcx	8($tptr),%rax
+	adox	%r11,%rax
+	mov	%rax,8($tptr)
+	mulx	16($aptr),%rax,%r11
+	adcx	16($tptr),%rax
+	adox	%r10,%rax
+	mov	%rax,16($tptr)
+	mulx	24($aptr),%rax,%r10
+	adcx	24($tptr),%rax
+	adox	%r11,%rax
+	mov	%rax,24($tptr)
+	lea	32($aptr),$aptr
+	lea	32($tptr),$tptr
+	lea	1(%rcx),%rcx
+	jrcxz	.Lmulx4x_mul_done
+	jmp	.Lmulx4x_mul
+.Lmulx4x_mul_done:
+	mov	\$0,%eax		# leaves flags alone
+	adcx	%rax,%r10
+	adox	($tptr),%r10
+	mov	%r10,($tptr)		# tp[num]
+	adox	%rax,%rax
+	mov	%rax,8($tptr)		# tp[num+1]
+
+	mov	8(%rsp),%rdx
+	imul	$n0,%rdx		# m=tp[0]*n0
+	mov	%rsp,$tptr		# results land one word lower
+	mov	$nptr,$aptr
+	mov	$num,%rcx
+	shr	\$2,%rcx
+	neg	%rcx
+	xor	%r10d,%r10d		# clear CF and OF
+
+.align	16
+.Lmulx4x_red:				# tp[]=(tp[]+np[]*m)/2^64
+	mulx	0($aptr),%rax,%r11
+	adcx	8($tptr),%rax
+	adox	%r10,%rax
+	mov	%rax,0($tptr)
+	mulx	8($aptr),%rax,%r10
+	adcx	16($tptr),%rax
+	adox	%r11,%rax
+	mov	%rax,8($tptr)
+	mulx	16($aptr),%rax,%r11
+	adcx	24($tptr),%rax
+	adox	%r10,%rax
+	mov	%rax,16($tptr)
+	mulx	24($aptr),%rax,%r10
+	adcx	32($tptr),%rax
+	adox	%r11,%rax
+	mov	%rax,24($tptr)
+	lea	32($aptr),$aptr
+	lea	32($tptr),$tptr
+	lea	1(%rcx),%rcx
+	jrcxz	.Lmulx4x_red_done
+	jmp	.Lmulx4x_red
+.Lmulx4x_red_done:
+	mov	\$0,%eax
+	adcx	%rax,%r10
+	adox	8($tptr),%r10
+	mov	%r10,($tptr)		# tp[num-1]
+	mov	16($tptr),%r11
+	adox	%rax,%r11
+	mov	%r11,8($tptr)		# tp[num]
+
+	cmp	$bend,$bptr
+	jb	.Lmulx4x_outer
+
+	lea	8(%rsp),$tptr
+	xor	%r11,%r11		# i=0 and clear CF
+	mov	$num,%rcx
+.align	16
+.Lmulx4x_sub:
+	mov	($tptr,%r11,8),%rax
+	sbb	($nptr,%r11,8),%rax
+	mov	%rax,($rp,%r11,8)	# rp[i]=tp[i]-np[i]
+	lea	1(%r11),%r11
+	dec	%rcx			# doesn't affect CF!
+	jnz	.Lmulx4x_sub
+
+	mov	($tptr,$num,8),%rax	# tp[num]
+	sbb	\$0,%rax		# handle upmost overflow bit
+	and	%rax,$tptr
+	not	%rax
+	mov	$rp,%rbx
+	and	%rax,%rbx
+	or	%rbx,$tptr		# tp=borrow?tp:rp
+
+	xor	%r11,%r11
+	mov	$num,%rcx
+.Lmulx4x_copy:				# copy or in-place refresh
+	mov	($tptr,%r11,8),%rax
+	mov	%r11,8(%rsp,%r11,8)	# zap temporary vector
+	mov	%rax,($rp,%r11,8)	# rp[i]=tp[i]
+	lea	1(%r11),%r11
+	dec	%rcx
+	jnz	.Lmulx4x_copy
+
+	mov	24(%rsp,$num,8),%rsi	# restore %rsp
+	mov	\$1,%rax
+	mov	(%rsi),%r15
+	mov	8(%rsi),%r14
+	mov	16(%rsi),%r13
+	mov	24(%rsi),%r12
+	mov	32(%rsi),%rbp
+	mov	40(%rsi),%rbx
+	lea	48(%rsi),%rsp
+.Lmulx4x_epilogue:
+	ret
+.size	bn_mulx4x_mont,.-bn_mulx4x_mont
+___
+}}}
 $code.=<<___;
 .asciz	"Montgomery Multiplication for x86_64, CRYPTOGAMS by <appro\@openssl.org>"
 .align	16
@@ -355,6 +355,10 @@ void	BN_CTX_free(BN_CTX *c);
 void	BN_CTX_start(BN_CTX *ctx);
 BIGNUM *BN_CTX_get(BN_CTX *ctx);
 void	BN_CTX_end(BN_CTX *ctx);
+void	BN_CTX_cache_cleanup(void);
+unsigned long BN_CTX_cache_hits(void);
+unsigned long BN_CTX_cache_misses(void);
+unsigned long BN_CTX_pool_grows(void);
 int     BN_rand(BIGNUM *rnd, int bits, int top, int bottom);
 int     BN_pseudo_rand(BIGNUM *rnd, int bits, int top, int bottom);
 int	BN_rand_range(BIGNUM *rnd, const BIGNUM *range);
@@ -65,6 +65,7 @@
 
 #include <openssl/opensslconf.h>
 
+#include <openssl/crypto.h>
 #include <openssl/err.h>
 
 #include "bn_lcl.h"
@@ -85,6 +86,9 @@
 #define BN_CTX_POOL_SIZE	16
 /* The stack frame info is resizing, set a first-time expansion size; */
 #define BN_CTX_START_FRAMES	32
+/* How many released contexts are kept for reuse, and how big they may be */
+#define BN_CTX_CACHE_MAX	16
+#define BN_CTX_CACHE_MAX_POOL	(4 * BN_CTX_POOL_SIZE)
 
 /***********/
 /* BN_POOL */
@@ -104,6 +108,8 @@ typedef struct bignum_pool {
 	BN_POOL_ITEM *head, *current, *tail;
 	/* Stack depth and allocation size */
 	unsigned used, size;
+	/* Bundles allocated since the last bn_ctx_cache_put() */
+	unsigned grows;
 } BN_POOL;
 
 static void		BN_POOL_init(BN_POOL *);
@@ -138,6 +144,15 @@ static unsigned int	BN_STACK_pop(BN_STACK *);
 /* BN_CTX */
 /**********/
 
+/*
+ * Contexts released by the public key operations, kept with their pool
+ * bignums still expanded so the next operation does not allocate.
+ */
+static BN_CTX *bn_ctx_cache[BN_CTX_CACHE_MAX];
+static int bn_ctx_cache_num;
+static unsigned long bn_ctx_cache_hit, bn_ctx_cache_miss;
+static unsigned long bn_ctx_pool_grow;
+
 /* The opaque BN_CTX type */
 struct bignum_ctx {
 	/* The bignum bundles */
@@ -264,6 +279,134 @@ BN_CTX_free(BN_CTX *ctx)
 	free(ctx);
 }
 
+/*
+ * Hand out a context from the cache, or a new one when it is empty. The
+ * context must be given back with bn_ctx_cache_put().
+ */
+BN_CTX *
+bn_ctx_cache_get(void)
+{
+	BN_CTX *ctx = NULL;
+
+	CRYPTO_w_lock(CRYPTO_LOCK_BN);
+	if (bn_ctx_cache_num > 0) {
+		ctx = bn_ctx_cache[--bn_ctx_cache_num];
+		bn_ctx_cache[bn_ctx_cache_num] = NULL;
+		bn_ctx_cache_hit++;
+	} else
+		bn_ctx_cache_miss++;
+	CRYPTO_w_unlock(CRYPTO_LOCK_BN);
+
+	if (ctx == NULL)
+		ctx = BN_CTX_new();
+	return ctx;
+}
+
+/*
+ * Give a context back. Its bignums are zeroed but keep their storage. A
+ * context that is still in use, has grown too big or does not fit in the
+ * cache is freed instead. Either way, its pool growth is added to the
+ * count that BN_CTX_pool_grows() returns.
+ */
+void
+bn_ctx_cache_put(BN_CTX *ctx)
+{
+	BN_POOL_ITEM *item;
+	BIGNUM *bn;
+	unsigned int loop;
+	int cacheable = 0;
+
+	if (ctx == NULL)
+		return;
+	if (ctx->used != 0 || ctx->stack.depth != 0 || ctx->err_stack ||
+	    ctx->too_many || ctx->pool.size > BN_CTX_CACHE_MAX_POOL)
+		goto done;
+
+	for (item = ctx->pool.head; item != NULL; item = item->next) {
+		bn = item->vals;
+		for (loop = 0; loop < BN_CTX_POOL_SIZE; loop++, bn++) {
+			if (BN_get_flags(bn, BN_FLG_STATIC_DATA))
+				goto done;
+			if (bn->d != NULL)
+				explicit_bzero(bn->d,
+				    bn->dmax * sizeof(bn->d[0]));
+			bn->top = 0;
+			bn->neg = 0;
+			bn->flags = 0;
+		}
+	}
+	ctx->pool.current = ctx->pool.head;
+	cacheable = 1;
+
+ done:
+	CRYPTO_w_lock(CRYPTO_LOCK_BN);
+	bn_ctx_pool_grow += ctx->pool.grows;
+	ctx->pool.grows = 0;
+	if (cacheable && bn_ctx_cache_num < BN_CTX_CACHE_MAX) {
+		bn_ctx_cache[bn_ctx_cache_num++] = ctx;
+		ctx = NULL;
+	}
+	CRYPTO_w_unlock(CRYPTO_LOCK_BN);
+
+	BN_CTX_free(ctx);
+}
+
+/*
+ * Free the contexts held by the cache. Contexts that are in use at the time
+ * are given back as usual.
+ */
+void
+BN_CTX_cache_cleanup(void)
+{
+	BN_CTX *cache[BN_CTX_CACHE_MAX];
+	int i, num;
+
+	CRYPTO_w_lock(CRYPTO_LOCK_BN);
+	num = bn_ctx_cache_num;
+	for (i = 0; i < num; i++) {
+		cache[i] = bn_ctx_cache[i];
+		bn_ctx_cache[i] = NULL;
+	}
+	bn_ctx_cache_num = 0;
+	CRYPTO_w_unlock(CRYPTO_LOCK_BN);
+
+	for (i = 0; i < num; i++)
+		BN_CTX_free(cache[i]);
+}
+
+unsigned long
+BN_CTX_cache_hits(void)
+{
+	unsigned long ret;
+
+	CRYPTO_r_lock(CRYPTO_LOCK_BN);
+	ret = bn_ctx_cache_hit;
+	CRYPTO_r_unlock(CRYPTO_LOCK_BN);
+	return ret;
+}
+
+unsigned long
+BN_CTX_cache_misses(void)
+{
+	unsigned long ret;
+
+	CRYPTO_r_lock(CRYPTO_LOCK_BN);
+	ret = bn_ctx_cache_miss;
+	CRYPTO_r_unlock(CRYPTO_LOCK_BN);
+	return ret;
+}
+
+unsigned long
+BN_CTX_pool_grows(void)
+{
+	unsigned long ret;
+
+	CRYPTO_r_lock(CRYPTO_LOCK_BN);
+	ret = bn_ctx_pool_grow;
+	CRYPTO_r_unlock(CRYPTO_LOCK_BN);
+	return ret;
+}
+
 void
 BN_CTX_start(BN_CTX *ctx)
 {
@@ -386,7 +529,7 @@ static void
 BN_POOL_init(BN_POOL *p)
 {
 	p->head = p->current = p->tail = NULL;
-	p->used = p->size = 0;
+	p->used = p->size = p->grows = 0;
 }
 
 static void
@@ -435,6 +578,7 @@ BN_POOL_get(BN_POOL *p)
 		BN_POOL_ITEM *item = malloc(sizeof(BN_POOL_ITEM));
 		if (!item)
 			return NULL;
+		p->grows++;
 		/* Initialise the structure */
 		bn = item->vals;
 		while (loop++ < BN_CTX_POOL_SIZE)
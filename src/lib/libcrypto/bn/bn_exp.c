@@ -117,6 +117,11 @@
 #include "bn_lcl.h"
 #include "constant_time_locl.h"
 
+#if defined(OPENSSL_BN_ASM_MONT5)
+#include "cryptlib.h"
+#include "x86_arch.h"
+#endif
+
 /* maximum precomputation table size for *variable* sliding windows */
 #define TABLE_SIZE	32
 
@@ -756,6 +761,17 @@ BN_mod_exp_mont_consttime(BIGNUM *rr, const BIGNUM *a, const BIGNUM *p,
 		    void *table, size_t power);
 
 		BN_ULONG *np = mont->N.d, *n0 = mont->n0;
+		int mulx;
+
+		/*
+		 * bn_mul_mont_gather5 has no mulx code path, while bn_mul_mont
+		 * does. Where it is available, gathering the power into am
+		 * and multiplying with bn_mul_mont is faster.
+		 */
+		mulx = (OPENSSL_cpu_caps_ext() &
+		    (IA32CAP_EXT_MASK_BMI2 | IA32CAP_EXT_MASK_ADX)) ==
+		    (IA32CAP_EXT_MASK_BMI2 | IA32CAP_EXT_MASK_ADX) &&
+		    top % 4 == 0 && top >= 8;
 
 		/* BN_to_montgomery can contaminate words above .top
 		 * [in BN_DEBUG[_DEBUG] build]... */
@@ -822,7 +838,12 @@ BN_mod_exp_mont_consttime(BIGNUM *rr, const BIGNUM *a, const BIGNUM *p,
 			bn_mul_mont(tmp.d, tmp.d, tmp.d, np, n0, top);
 			bn_mul_mont(tmp.d, tmp.d, tmp.d, np, n0, top);
 			bn_mul_mont(tmp.d, tmp.d, tmp.d, np, n0, top);
-			bn_mul_mont_gather5(tmp.d, tmp.d, powerbuf, np, n0, top, wvalue);
+			if (mulx) {
+				bn_gather5(am.d, top, powerbuf, wvalue);
+				bn_mul_mont(tmp.d, tmp.d, am.d, np, n0, top);
+			} else
+				bn_mul_mont_gather5(tmp.d, tmp.d, powerbuf,
+				    np, n0, top, wvalue);
 		}
 
 		tmp.top = top;
@@ -0,0 +1,455 @@
+#!/usr/bin/env perl
+# $OpenBSD$
+#
+# Copyright (c) 2026 The LibreSSL project.
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# Multi-block ChaCha20 for x86_64.
+#
+# The state is kept "vertically": register n holds word n of 4 (SSE) or
+# 8 (AVX2) consecutive blocks, so that every quarter-round operates on
+# all blocks at once without any shuffling. With 16 state words and a
+# couple of temporaries not fitting in the register file, words 8-11 live
+# on the stack and are loaded two at a time; the order in which the
+# quarter-rounds are executed is chosen so that this only costs two
+# loads and two stores per double round.
+#
+# void chacha20_blocks_sse2(unsigned char *out, const unsigned char *in,
+#     size_t blocks, const unsigned int input[16]);
+# void chacha20_blocks_ssse3(...);
+# void chacha20_blocks_avx2(...);
+#
+# blocks must be a multiple of 4 (SSE2, SSSE3) or 8 (AVX2). The block
+# counter in input[12] is incremented for each block without carrying
+# into input[13]; the caller must guarantee that it does not wrap. The
+# caller is responsible for advancing the counter in input afterwards.
+#
+# The SSSE3 version differs from the SSE2 one only in the use of pshufb
+# for the 16 and 8 bit rotations.
+
+$flavour = shift;
+$output  = shift;
+if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+open OUT,"| \"$^X\" $xlate $flavour $output";
+*STDOUT=*OUT;
+
+($out,$inp,$blocks,$key)=("%rdi","%rsi","%rdx","%rcx");
+$rounds="%eax";
+$frame="%r9";
+
+$code=<<___;
+.text
+___
+
+# Quarter-round step sequence, shared by all implementations. Each step
+# is [op, dst, src] on the abstract words a, b, c, d; rotations are
+# expanded by the per-ISA emitters.
+@qr=(	["add","a","b"], ["xor","d","a"], ["rot16","d"],
+	["add","c","d"], ["xor","b","c"], ["rot","b",12],
+	["add","a","b"], ["xor","d","a"], ["rot8","d"],
+	["add","c","d"], ["xor","b","c"], ["rot","b",7] );
+
+# Emit two interleaved quarter-rounds, each given as a hash mapping the
+# abstract words to registers, with one temporary per quarter-round.
+sub qr2 {
+	my ($emit,@q)=@_;
+	my $s="";
+	foreach my $step (@qr) {
+		foreach my $q (@q) {
+			$s.=&$emit($step,$q);
+		}
+	}
+	return $s;
+}
+
+# Emit a full double round. $reg maps state word numbers to registers
+# for words that stay in registers; $c0 and $c1 are the two registers
+# holding the currently loaded words 8-11, $ws(n) is the stack slot for
+# word 8+n and $mov is the aligned load/store instruction.
+sub double_round {
+	my ($emit,$reg,$c0,$c1,$t0,$t1,$ws,$mov)=@_;
+	my $s="";
+	my $q=sub {
+		my ($a,$b,$c,$d,$t)=@_;
+		return { a=>$reg->[$a], b=>$reg->[$b], c=>$c, d=>$reg->[$d], t=>$t };
+	};
+
+	# columns 0 and 1 use words 8 and 9, which are loaded on entry
+	$s.=qr2($emit, &$q(0,4,$c0,12,$t0), &$q(1,5,$c1,13,$t1));
+	$s.="\t$mov\t$c0,".&$ws(0)."\n\t$mov\t$c1,".&$ws(1)."\n";
+	$s.="\t$mov\t".&$ws(2).",$c0\n\t$mov\t".&$ws(3).",$c1\n";
+	# columns 2 and 3 use words 10 and 11
+	$s.=qr2($emit, &$q(2,6,$c0,14,$t0), &$q(3,7,$c1,15,$t1));
+	# diagonals 0 and 1 use words 10 and 11 as well
+	$s.=qr2($emit, &$q(0,5,$c0,15,$t0), &$q(1,6,$c1,12,$t1));
+	$s.="\t$mov\t$c0,".&$ws(2)."\n\t$mov\t$c1,".&$ws(3)."\n";
+	$s.="\t$mov\t".&$ws(0).",$c0\n\t$mov\t".&$ws(1).",$c1\n";
+	# diagonals 2 and 3 use words 8 and 9, ready for the next round
+	$s.=qr2($emit, &$q(2,7,$c0,13,$t0), &$q(3,4,$c1,14,$t1));
+	return $s;
+}
+
+######################################################################
+# SSE2 and SSSE3, four blocks at a time.
+#
+# Stack frame layout:
+#	0-255		input words 0-15, broadcast to all lanes
+#	256-319		working copies of words 8-11
+{
+my @x=map("%xmm$_",(0..15));
+my ($c0,$c1,$t0,$t1)=@x[12..15];
+# words 0-7 in xmm0-7, words 12-15 in xmm8-11
+my @reg=(@x[0..7],undef,undef,undef,undef,@x[8..11]);
+my $in_slot=sub { my $n=shift; return 16*$n."(%rsp)"; };
+my $ws=sub { my $n=shift; return 256+16*$n."(%rsp)"; };
+
+sub sse_emitter {
+	my $ssse3=shift;
+	return sub {
+		my ($step,$q)=@_;
+		my ($op,$x,$y)=@$step;
+		my $r=$q->{$x};
+		my $t=$q->{t};
+		if ($op eq "add") {
+			return "\tpaddd\t$q->{$y},$r\n";
+		} elsif ($op eq "xor") {
+			return "\tpxor\t$q->{$y},$r\n";
+		} elsif ($op eq "rot16" && $ssse3) {
+			return "\tpshufb\t.Lrot16(%rip),$r\n";
+		} elsif ($op eq "rot8" && $ssse3) {
+			return "\tpshufb\t.Lrot8(%rip),$r\n";
+		} elsif ($op eq "rot16") {
+			return "\tpshuflw\t\$0xb1,$r,$r\n".
+			    "\tpshufhw\t\$0xb1,$r,$r\n";
+		}
+		my $n=($op eq "rot8") ? 8 : $y;
+		return "\tmovdqa\t$r,$t\n".
+		    "\tpslld\t\$$n,$r\n".
+		    "\tpsrld\t\$".(32-$n).",$t\n".
+		    "\tpor\t$t,$r\n";
+	};
+}
+
+# Transpose four registers holding the same four words of four blocks;
+# returns the registers holding blocks 0-3 in order, along with the two
+# registers left free.
+sub transpose4 {
+	my ($r0,$r1,$r2,$r3,$t0,$t1)=@_;
+	my $s="";
+	$s.="\tmovdqa\t$r0,$t0\n";
+	$s.="\tpunpckldq\t$r1,$t0\n";
+	$s.="\tpunpckhdq\t$r1,$r0\n";
+	$s.="\tmovdqa\t$r2,$t1\n";
+	$s.="\tpunpckldq\t$r3,$t1\n";
+	$s.="\tpunpckhdq\t$r3,$r2\n";
+	$s.="\tmovdqa\t$t0,$r1\n";
+	$s.="\tpunpcklqdq\t$t1,$t0\n";
+	$s.="\tpunpckhqdq\t$t1,$r1\n";
+	$s.="\tmovdqa\t$r0,$r3\n";
+	$s.="\tpunpcklqdq\t$r2,$r0\n";
+	$s.="\tpunpckhqdq\t$r2,$r3\n";
+	return ($s,[$t0,$r1,$r0,$r3],[$r2,$t1]);
+}
+
+# Add the input to four words, transpose them and xor the key stream
+# with the input at byte offset $off within each block.
+sub output4 {
+	my ($regs,$first,$off,$t0,$t1)=@_;
+	my $s="";
+	for (my $i=0; $i<4; $i++) {
+		$s.="\tpaddd\t".&$in_slot($first+$i).",$regs->[$i]\n";
+	}
+	my ($ts,$blk,$free)=transpose4(@$regs,$t0,$t1);
+	$s.=$ts;
+	my $tmp=$free->[0];
+	for (my $i=0; $i<4; $i++) {
+		my $o=64*$i+$off;
+		$s.="\tmovdqu\t$o($inp),$tmp\n";
+		$s.="\tpxor\t$tmp,$blk->[$i]\n";
+		$s.="\tmovdqu\t$blk->[$i],$o($out)\n";
+	}
+	return $s;
+}
+
+foreach my $ssse3 (0,1) {
+my $name=$ssse3 ? "chacha20_blocks_ssse3" : "chacha20_blocks_sse2";
+my $emit=sse_emitter($ssse3);
+
+$code.=<<___;
+.globl	$name
+.type	$name,\@function,4
+.align	32
+$name:
+	test	$blocks,$blocks
+	jz	.L${name}_done
+	mov	%rsp,$frame
+	sub	\$320+16,%rsp
+	and	\$-16,%rsp
+
+	movdqu	0($key),$x[0]
+	movdqu	16($key),$x[1]
+	movdqu	32($key),$x[2]
+	movdqu	48($key),$x[3]
+___
+for (my $i=0; $i<16; $i++) {
+	my $src=$x[$i>>2];
+	my $imm=(0x00,0x55,0xaa,0xff)[$i&3];
+	$code.="\tpshufd\t\$$imm,$src,$x[4+($i&3)]\n";
+	$code.="\tpaddd\t.Linc(%rip),$x[4+($i&3)]\n"	if ($i==12);
+	$code.="\tmovdqa\t$x[4+($i&3)],".&$in_slot($i)."\n";
+}
+$code.=<<___;
+	jmp	.L${name}_loop
+
+.align	32
+.L${name}_loop:
+___
+for (my $i=0; $i<16; $i++) {
+	next if ($i>=8 && $i<12);
+	$code.="\tmovdqa\t".&$in_slot($i).",$reg[$i]\n";
+}
+$code.="\tmovdqa\t".&$in_slot(8).",$c0\n";
+$code.="\tmovdqa\t".&$in_slot(9).",$c1\n";
+$code.="\tmovdqa\t".&$in_slot(10).",$t0\n";
+$code.="\tmovdqa\t".&$in_slot(11).",$t1\n";
+$code.="\tmovdqa\t$t0,".&$ws(2)."\n";
+$code.="\tmovdqa\t$t1,".&$ws(3)."\n";
+$code.=<<___;
+	mov	\$10,$rounds
+	jmp	.L${name}_rounds
+
+.align	32
+.L${name}_rounds:
+___
+$code.=double_round($emit,\@reg,$c0,$c1,$t0,$t1,$ws,"movdqa");
+$code.=<<___;
+	dec	$rounds
+	jnz	.L${name}_rounds
+
+	movdqa	$c0,${\&$ws(0)}
+	movdqa	$c1,${\&$ws(1)}
+___
+$code.=output4([@reg[0..3]],0,0,$t0,$t1);
+$code.=output4([@reg[4..7]],4,16,$t0,$t1);
+$code.=output4([@reg[12..15]],12,48,$t0,$t1);
+for (my $i=0; $i<4; $i++) {
+	$code.="\tmovdqa\t".&$ws($i).",$reg[$i]\n";
+}
+$code.=output4([@reg[0..3]],8,32,$t0,$t1);
+$code.=<<___;
+
+	movdqa	${\&$in_slot(12)},$t0
+	paddd	.Lfour(%rip),$t0
+	movdqa	$t0,${\&$in_slot(12)}
+
+	lea	256($inp),$inp
+	lea	256($out),$out
+	sub	\$4,$blocks
+	jnz	.L${name}_loop
+
+	mov	$frame,%rsp
+.L${name}_done:
+	ret
+.size	$name,.-$name
+___
+}
+}
+
+######################################################################
+# AVX2, eight blocks at a time.
+#
+# Stack frame layout:
+#	0-511		input words 0-15, broadcast to all lanes
+#	512-639		working copies of words 8-11
+{
+my @y=map("%ymm$_",(0..15));
+my ($c0,$c1,$t0,$t1)=@y[12..15];
+my @reg=(@y[0..7],undef,undef,undef,undef,@y[8..11]);
+my $in_slot=sub { my $n=shift; return 32*$n."(%rsp)"; };
+my $ws=sub { my $n=shift; return 512+32*$n."(%rsp)"; };
+
+my $emit=sub {
+	my ($step,$q)=@_;
+	my ($op,$x,$y)=@$step;
+	my $r=$q->{$x};
+	my $t=$q->{t};
+	if ($op eq "add") {
+		return "\tvpaddd\t$q->{$y},$r,$r\n";
+	} elsif ($op eq "xor") {
+		return "\tvpxor\t$q->{$y},$r,$r\n";
+	} elsif ($op eq "rot16") {
+		return "\tvpshufb\t.Lrot16(%rip),$r,$r\n";
+	} elsif ($op eq "rot8") {
+		return "\tvpshufb\t.Lrot8(%rip),$r,$r\n";
+	}
+	return "\tvpslld\t\$$y,$r,$t\n".
+	    "\tvpsrld\t\$".(32-$y).",$r,$r\n".
+	    "\tvpor\t$t,$r,$r\n";
+};
+
+# 4x4 transpose within each 128-bit lane; returns the registers holding
+# blocks 0-3 (low lane) and 4-7 (high lane), and the two free registers.
+sub vtranspose4 {
+	my ($r0,$r1,$r2,$r3,$t0,$t1)=@_;
+	my $s="";
+	$s.="\tvpunpckldq\t$r1,$r0,$t0\n";
+	$s.="\tvpunpckhdq\t$r1,$r0,$r0\n";
+	$s.="\tvpunpckldq\t$r3,$r2,$t1\n";
+	$s.="\tvpunpckhdq\t$r3,$r2,$r2\n";
+	$s.="\tvpunpckhqdq\t$t1,$t0,$r1\n";
+	$s.="\tvpunpcklqdq\t$t1,$t0,$t0\n";
+	$s.="\tvpunpckhqdq\t$r2,$r0,$r3\n";
+	$s.="\tvpunpcklqdq\t$r2,$r0,$r0\n";
+	return ($s,[$t0,$r1,$r0,$r3],[$r2,$t1]);
+}
+
+sub vadd4 {
+	my ($regs,$first)=@_;
+	my $s="";
+	for (my $i=0; $i<4; $i++) {
+		$s.="\tvpaddd\t".&$in_slot($first+$i).",$regs->[$i],$regs->[$i]\n";
+	}
+	return $s;
+}
+
+# Combine two transposed word groups into 32 bytes of key stream for
+# each of the eight blocks and xor it with the input at byte $off.
+sub voutput8 {
+	my ($lo,$hi,$off,$tmp)=@_;
+	my $s="";
+	for (my $i=0; $i<4; $i++) {
+		my $o=64*$i+$off;
+		$s.="\tvperm2i128\t\$0x20,$hi->[$i],$lo->[$i],$tmp\n";
+		$s.="\tvpxor\t$o($inp),$tmp,$tmp\n";
+		$s.="\tvmovdqu\t$tmp,$o($out)\n";
+		$o+=256;
+		$s.="\tvperm2i128\t\$0x31,$hi->[$i],$lo->[$i],$tmp\n";
+		$s.="\tvpxor\t$o($inp),$tmp,$tmp\n";
+		$s.="\tvmovdqu\t$tmp,$o($out)\n";
+	}
+	return $s;
+}
+
+$code.=<<___;
+.globl	chacha20_blocks_avx2
+.type	chacha20_blocks_avx2,\@function,4
+.align	32
+chacha20_blocks_avx2:
+	test	$blocks,$blocks
+	jz	.Lavx2_done
+	mov	%rsp,$frame
+	sub	\$640+32,%rsp
+	and	\$-32,%rsp
+	vzeroupper
+___
+for (my $i=0; $i<16; $i++) {
+	$code.="\tvpbroadcastd\t".(4*$i)."($key),$t0\n";
+	$code.="\tvpaddd\t.Linc(%rip),$t0,$t0\n"	if ($i==12);
+	$code.="\tvmovdqa\t$t0,".&$in_slot($i)."\n";
+}
+$code.=<<___;
+	jmp	.Lavx2_loop
+
+.align	32
+.Lavx2_loop:
+___
+for (my $i=0; $i<16; $i++) {
+	next if ($i>=8 && $i<12);
+	$code.="\tvmovdqa\t".&$in_slot($i).",$reg[$i]\n";
+}
+$code.="\tvmovdqa\t".&$in_slot(8).",$c0\n";
+$code.="\tvmovdqa\t".&$in_slot(9).",$c1\n";
+$code.="\tvmovdqa\t".&$in_slot(10).",$t0\n";
+$code.="\tvmovdqa\t".&$in_slot(11).",$t1\n";
+$code.="\tvmovdqa\t$t0,".&$ws(2)."\n";
+$code.="\tvmovdqa\t$t1,".&$ws(3)."\n";
+$code.=<<___;
+	mov	\$10,$rounds
+	jmp	.Lavx2_rounds
+
+.align	32
+.Lavx2_rounds:
+___
+$code.=double_round($emit,\@reg,$c0,$c1,$t0,$t1,$ws,"vmovdqa");
+$code.=<<___;
+	dec	$rounds
+	jnz	.Lavx2_rounds
+
+	vmovdqa	$c0,${\&$ws(0)}
+	vmovdqa	$c1,${\&$ws(1)}
+___
+{
+	# words 0-7: transpose both groups, then emit bytes 0-31
+	$code.=vadd4([@reg[0..3]],0);
+	$code.=vadd4([@reg[4..7]],4);
+	my ($s0,$a,$fa)=vtranspose4(@reg[0..3],$t0,$t1);
+	my ($s1,$b,$fb)=vtranspose4(@reg[4..7],$fa->[0],$fa->[1]);
+	$code.=$s0.$s1;
+	$code.=voutput8($a,$b,0,$fb->[0]);
+
+	# words 8-15: load 8-11 into the registers just freed
+	my @c=(@reg[0..3]);
+	for (my $i=0; $i<4; $i++) {
+		$code.="\tvmovdqa\t".&$ws($i).",$c[$i]\n";
+	}
+	$code.=vadd4(\@c,8);
+	$code.=vadd4([@reg[12..15]],12);
+	my ($s2,$c,$fc)=vtranspose4(@c,$t0,$t1);
+	my ($s3,$d,$fd)=vtranspose4(@reg[12..15],$fc->[0],$fc->[1]);
+	$code.=$s2.$s3;
+	$code.=voutput8($c,$d,32,$fd->[0]);
+}
+$code.=<<___;
+
+	vmovdqa	${\&$in_slot(12)},$t0
+	vpaddd	.Leight(%rip),$t0,$t0
+	vmovdqa	$t0,${\&$in_slot(12)}
+
+	lea	512($inp),$inp
+	lea	512($out),$out
+	sub	\$8,$blocks
+	jnz	.Lavx2_loop
+
+	vzeroupper
+	mov	$frame,%rsp
+.Lavx2_done:
+	ret
+.size	chacha20_blocks_avx2,.-chacha20_blocks_avx2
+___
+}
+
+$code.=<<___;
+.align	64
+.Lrot16:
+	.byte	2,3,0,1, 6,7,4,5, 10,11,8,9, 14,15,12,13
+	.byte	2,3,0,1, 6,7,4,5, 10,11,8,9, 14,15,12,13
+.Lrot8:
+	.byte	3,0,1,2, 7,4,5,6, 11,8,9,10, 15,12,13,14
+	.byte	3,0,1,2, 7,4,5,6, 11,8,9,10, 15,12,13,14
+.Linc:
+	.long	0,1,2,3,4,5,6,7
+.Lfour:
+	.long	4,4,4,4
+.Leight:
+	.long	8,8,8,8,8,8,8,8
+___
+
+print $code;
+close STDOUT;
@@ -21,6 +21,62 @@
 
 #include "chacha-merged.c"
 
+#ifdef CHACHA_ASM
+#include <openssl/crypto.h>
+
+#include "cryptlib.h"
+#include "x86_arch.h"
+
+void chacha20_blocks_sse2(unsigned char *out, const unsigned char *in,
+    size_t blocks, const unsigned int input[16]);
+void chacha20_blocks_ssse3(unsigned char *out, const unsigned char *in,
+    size_t blocks, const unsigned int input[16]);
+void chacha20_blocks_avx2(unsigned char *out, const unsigned char *in,
+    size_t blocks, const unsigned int input[16]);
+
+/*
+ * Encrypt as many whole blocks as possible using the multi-block
+ * implementations, advancing the block counter accordingly, and return
+ * the number of bytes processed. The remainder, if any, is left to
+ * chacha_encrypt_bytes().
+ */
+static size_t
+chacha_encrypt_blocks(chacha_ctx *x, const u8 *m, u8 *c, size_t bytes)
+{
+	uint64_t counter;
+	size_t blocks;
+
+	blocks = bytes / CHACHA_BLOCKLEN;
+
+	/*
+	 * The multi-block code does not carry from the low counter word
+	 * into the high one, so stop short of a wrap around and let the
+	 * generic code deal with it.
+	 */
+	if (blocks > 0x100000000ULL - x->input[12])
+		blocks = 0x100000000ULL - x->input[12];
+
+	if (blocks >= 8 &&
+	    (OPENSSL_cpu_caps_ext() & IA32CAP_EXT_MASK_AVX2) != 0) {
+		blocks &= ~7;
+		chacha20_blocks_avx2(c, m, blocks, x->input);
+	} else if (blocks >= 4) {
+		blocks &= ~3;
+		if ((OPENSSL_cpu_caps() & CPUCAP_MASK_SSSE3) != 0)
+			chacha20_blocks_ssse3(c, m, blocks, x->input);
+		else
+			chacha20_blocks_sse2(c, m, blocks, x->input);
+	} else
+		return 0;
+
+	counter = ((uint64_t)x->input[13] << 32 | x->input[12]) + blocks;
+	x->input[12] = (uint32_t)counter;
+	x->input[13] = (uint32_t)(counter >> 32);
+
+	return blocks * CHACHA_BLOCKLEN;
+}
+#endif
+
 void
 ChaCha_set_key(ChaCha_ctx *ctx, const unsigned char *key, uint32_t keybits)
 {
@@ -41,6 +97,9 @@ ChaCha(ChaCha_ctx *ctx, unsigned char *out, const unsigned char *in, size_t len)
 {
 	unsigned char *k;
 	int i, l;
+#ifdef CHACHA_ASM
+	size_t n;
+#endif
 
 	/* Consume remaining keystream, if any exists. */
 	if (ctx->unused > 0) {
@@ -52,6 +111,13 @@ ChaCha(ChaCha_ctx *ctx, unsigned char *out, const unsigned char *in, size_t len)
 		len -= l;
 	}
 
+#ifdef CHACHA_ASM
+	n = chacha_encrypt_blocks((chacha_ctx *)ctx, in, out, len);
+	in += n;
+	out += n;
+	len -= n;
+#endif
+
 	chacha_encrypt_bytes((chacha_ctx *)ctx, in, out, (uint32_t)len);
 }
 
@@ -60,6 +126,9 @@ CRYPTO_chacha_20(unsigned char *out, const unsigned char *in, size_t len,
     const unsigned char key[32], const unsigned char iv[8], uint64_t counter)
 {
 	struct chacha_ctx ctx;
+#ifdef CHACHA_ASM
+	size_t n;
+#endif
 
 	/*
 	 * chacha_ivsetup expects the counter to be in u8. Rather than
@@ -73,5 +142,12 @@ CRYPTO_chacha_20(unsigned char *out, const unsigned char *in, size_t len,
 		ctx.input[13] = (uint32_t)(counter >> 32);
 	}
 
+#ifdef CHACHA_ASM
+	n = chacha_encrypt_blocks(&ctx, in, out, len);
+	in += n;
+	out += n;
+	len -= n;
+#endif
+
 	chacha_encrypt_bytes(&ctx, in, out, (uint32_t)len);
 }
@@ -623,6 +623,7 @@ CRYPTO_get_lock_name(int type)
 	defined(__x86_64) || defined(__x86_64__) || defined(_M_AMD64) || defined(_M_X64)
 
 uint64_t OPENSSL_ia32cap_P;
+uint32_t OPENSSL_ia32cap_ext_P;
 
 uint64_t
 OPENSSL_cpu_caps(void)
@@ -630,6 +631,12 @@ OPENSSL_cpu_caps(void)
 	return OPENSSL_ia32cap_P;
 }
 
+uint32_t
+OPENSSL_cpu_caps_ext(void)
+{
+	return OPENSSL_ia32cap_ext_P;
+}
+
 #if defined(OPENSSL_CPUID_OBJ) && !defined(OPENSSL_NO_ASM)
 #define OPENSSL_CPUID_SETUP
 void
@@ -651,6 +658,12 @@ OPENSSL_cpu_caps(void)
 {
 	return 0;
 }
+
+uint32_t
+OPENSSL_cpu_caps_ext(void)
+{
+	return 0;
+}
 #endif
 
 #if !defined(OPENSSL_CPUID_SETUP) && !defined(OPENSSL_CPUID_OBJ)
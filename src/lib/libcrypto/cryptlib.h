@@ -59,6 +59,8 @@
 #ifndef HEADER_CRYPTLIB_H
 #define HEADER_CRYPTLIB_H
 
+#include <stdint.h>
+
 #include <openssl/opensslconf.h>
 
 #ifdef  __cplusplus
@@ -73,6 +75,7 @@ extern "C" {
 #define X509_CERT_FILE_EVP       "SSL_CERT_FILE"
 
 void OPENSSL_cpuid_setup(void);
+uint32_t OPENSSL_cpu_caps_ext(void);
 
 #ifdef  __cplusplus
 }
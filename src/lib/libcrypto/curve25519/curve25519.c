@@ -34,10 +34,16 @@
 
 #include "curve25519_internal.h"
 
+#ifdef CURVE25519_64BIT
+typedef unsigned __int128 uint128_t;
+
+static const uint64_t kBottom51Bits = 0x7ffffffffffffULL;
+#else
 static const int64_t kBottom25Bits = 0x1ffffffLL;
 static const int64_t kBottom26Bits = 0x3ffffffLL;
 static const int64_t kTop39Bits = 0xfffffffffe000000LL;
 static const int64_t kTop38Bits = 0xfffffffffc000000LL;
+#endif
 
 static uint64_t load_3(const uint8_t *in) {
   uint64_t result;
@@ -56,6 +62,98 @@ static uint64_t load_4(const uint8_t *in) {
   return result;
 }
 
+#ifdef CURVE25519_64BIT
+static uint64_t load_8(const uint8_t *in) {
+  uint64_t result;
+  result = (uint64_t)in[0];
+  result |= ((uint64_t)in[1]) << 8;
+  result |= ((uint64_t)in[2]) << 16;
+  result |= ((uint64_t)in[3]) << 24;
+  result |= ((uint64_t)in[4]) << 32;
+  result |= ((uint64_t)in[5]) << 40;
+  result |= ((uint64_t)in[6]) << 48;
+  result |= ((uint64_t)in[7]) << 56;
+  return result;
+}
+
+static void store_8(uint8_t *out, uint64_t v) {
+  unsigned i;
+  for (i = 0; i < 8; i++) {
+    out[i] = v >> (8 * i);
+  }
+}
+
+static void fe_frombytes(fe h, const uint8_t *s) {
+  /* Ignores top bit of h. */
+  h[0] = load_8(s) & kBottom51Bits;
+  h[1] = (load_8(s + 6) >> 3) & kBottom51Bits;
+  h[2] = (load_8(s + 12) >> 6) & kBottom51Bits;
+  h[3] = (load_8(s + 19) >> 1) & kBottom51Bits;
+  h[4] = (load_8(s + 24) >> 12) & kBottom51Bits;
+}
+
+/* h = f, with each limb of h brought down to 51 bits plus a small carry.
+ * Can overlap h with f.
+ *
+ * Preconditions:
+ *    |f| bounded by 2^63,2^63,2^63,2^63,2^63.
+ *
+ * Postconditions:
+ *    |h| bounded by 2^51,2^51+2^13,2^51,2^51,2^51. */
+static void fe_carry(fe h, const fe f) {
+  uint64_t h0 = f[0];
+  uint64_t h1 = f[1];
+  uint64_t h2 = f[2];
+  uint64_t h3 = f[3];
+  uint64_t h4 = f[4];
+
+  h1 += h0 >> 51; h0 &= kBottom51Bits;
+  h2 += h1 >> 51; h1 &= kBottom51Bits;
+  h3 += h2 >> 51; h2 &= kBottom51Bits;
+  h4 += h3 >> 51; h3 &= kBottom51Bits;
+  h0 += (h4 >> 51) * 19; h4 &= kBottom51Bits;
+  h1 += h0 >> 51; h0 &= kBottom51Bits;
+
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+  h[3] = h3;
+  h[4] = h4;
+}
+
+/* Preconditions:
+ *  |h| bounded by 2^63,2^63,2^63,2^63,2^63.
+ *
+ * After fe_carry, h < 2p, so q = floor((h + 19) / 2^255) is 1 exactly when
+ * h >= p and h - pq is the canonical value. */
+static void fe_tobytes(uint8_t *s, const fe h) {
+  fe t;
+  uint64_t q;
+
+  fe_carry(t, h);
+
+  q = (t[0] + 19) >> 51;
+  q = (t[1] + q) >> 51;
+  q = (t[2] + q) >> 51;
+  q = (t[3] + q) >> 51;
+  q = (t[4] + q) >> 51;
+
+  /* Goal: Output h-(2^255-19)q, which is between 0 and 2^255-20. */
+  t[0] += 19 * q;
+  /* Goal: Output h-2^255 q, which is between 0 and 2^255-20. */
+
+  t[1] += t[0] >> 51; t[0] &= kBottom51Bits;
+  t[2] += t[1] >> 51; t[1] &= kBottom51Bits;
+  t[3] += t[2] >> 51; t[2] &= kBottom51Bits;
+  t[4] += t[3] >> 51; t[3] &= kBottom51Bits;
+                      t[4] &= kBottom51Bits;
+
+  store_8(s, t[0] | (t[1] << 51));
+  store_8(s + 8, (t[1] >> 13) | (t[2] << 38));
+  store_8(s + 16, (t[2] >> 26) | (t[3] << 25));
+  store_8(s + 24, (t[3] >> 39) | (t[4] << 12));
+}
+#else
 static void fe_frombytes(fe h, const uint8_t *s) {
   /* Ignores top bit of h. */
   int64_t h0 = load_4(s);
@@ -204,21 +302,165 @@ static void fe_tobytes(uint8_t *s, const fe h) {
   s[30] = h9 >> 10;
   s[31] = h9 >> 18;
 }
+#endif
 
 /* h = f */
 static void fe_copy(fe h, const fe f) {
-  memmove(h, f, sizeof(int32_t) * 10);
+  memmove(h, f, sizeof(fe));
 }
 
 /* h = 0 */
-static void fe_0(fe h) { memset(h, 0, sizeof(int32_t) * 10); }
+static void fe_0(fe h) { memset(h, 0, sizeof(fe)); }
 
 /* h = 1 */
 static void fe_1(fe h) {
-  memset(h, 0, sizeof(int32_t) * 10);
+  memset(h, 0, sizeof(fe));
   h[0] = 1;
 }
 
+#ifdef CURVE25519_64BIT
+/* h = f + g
+ * Can overlap h with f or g.
+ *
+ * Preconditions:
+ *    |f| bounded by 1.01*2^52,1.01*2^52,1.01*2^52,1.01*2^52,1.01*2^52.
+ *    |g| bounded by 1.01*2^51,1.01*2^51,1.01*2^51,1.01*2^51,1.01*2^51.
+ *
+ * Postconditions:
+ *    |h| bounded by 1.01*2^53,1.01*2^53,1.01*2^53,1.01*2^53,1.01*2^53. */
+static void fe_add(fe h, const fe f, const fe g) {
+  unsigned i;
+  for (i = 0; i < 5; i++) {
+    h[i] = f[i] + g[i];
+  }
+}
+
+/* 4p, added to the minuend so that no limb of a difference goes negative. */
+static const uint64_t k4P0 = 0x1fffffffffffb4ULL;
+static const uint64_t k4P1234 = 0x1ffffffffffffcULL;
+
+/* h = f - g
+ * Can overlap h with f or g.
+ *
+ * Preconditions:
+ *    |f| bounded by 2^62,2^62,2^62,2^62,2^62.
+ *    |g| bounded by 1.99*2^52,1.99*2^52,1.99*2^52,1.99*2^52,1.99*2^52.
+ *
+ * Postconditions:
+ *    |h| bounded by 2^51,2^51+2^13,2^51,2^51,2^51. */
+static void fe_sub(fe h, const fe f, const fe g) {
+  fe t;
+
+  t[0] = (f[0] + k4P0) - g[0];
+  t[1] = (f[1] + k4P1234) - g[1];
+  t[2] = (f[2] + k4P1234) - g[2];
+  t[3] = (f[3] + k4P1234) - g[3];
+  t[4] = (f[4] + k4P1234) - g[4];
+  fe_carry(h, t);
+}
+
+/* h = t, where t is a sum of 128-bit products in radix 2^51.
+ *
+ * Preconditions:
+ *    t4 bounded by 2^110; t0...t3 bounded by 2^127.
+ *
+ * Postconditions:
+ *    |h| bounded by 2^51,2^51+2^13,2^51,2^51,2^51. */
+static void fe_carry_wide(fe h, uint128_t t0, uint128_t t1, uint128_t t2,
+                          uint128_t t3, uint128_t t4) {
+  uint64_t h0, h1, h2, h3, h4;
+
+  t1 += t0 >> 51; h0 = (uint64_t)t0 & kBottom51Bits;
+  t2 += t1 >> 51; h1 = (uint64_t)t1 & kBottom51Bits;
+  t3 += t2 >> 51; h2 = (uint64_t)t2 & kBottom51Bits;
+  t4 += t3 >> 51; h3 = (uint64_t)t3 & kBottom51Bits;
+  h0 += (uint64_t)(t4 >> 51) * 19; h4 = (uint64_t)t4 & kBottom51Bits;
+  h1 += h0 >> 51; h0 &= kBottom51Bits;
+
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+  h[3] = h3;
+  h[4] = h4;
+}
+
+/* h = f * g
+ * Can overlap h with f or g.
+ *
+ * Preconditions:
+ *    |f| bounded by 1.01*2^53,1.01*2^53,1.01*2^53,1.01*2^53,1.01*2^53.
+ *    |g| bounded by 1.01*2^53,1.01*2^53,1.01*2^53,1.01*2^53,1.01*2^53.
+ *
+ * Postconditions:
+ *    |h| bounded by 2^51,2^51+2^13,2^51,2^51,2^51.
+ *
+ * Schoolbook multiplication into 128-bit column sums; the terms that wrap
+ * past 2^255 are folded back with a factor of 19 before the carry chain. */
+static void fe_mul(fe h, const fe f, const fe g) {
+  uint64_t f0 = f[0];
+  uint64_t f1 = f[1];
+  uint64_t f2 = f[2];
+  uint64_t f3 = f[3];
+  uint64_t f4 = f[4];
+  uint64_t g0 = g[0];
+  uint64_t g1 = g[1];
+  uint64_t g2 = g[2];
+  uint64_t g3 = g[3];
+  uint64_t g4 = g[4];
+  uint64_t g1_19 = 19 * g1;
+  uint64_t g2_19 = 19 * g2;
+  uint64_t g3_19 = 19 * g3;
+  uint64_t g4_19 = 19 * g4;
+  uint128_t t0, t1, t2, t3, t4;
+
+  t0 = (uint128_t)f0 * g0 + (uint128_t)f1 * g4_19 + (uint128_t)f2 * g3_19 +
+       (uint128_t)f3 * g2_19 + (uint128_t)f4 * g1_19;
+  t1 = (uint128_t)f0 * g1 + (uint128_t)f1 * g0 + (uint128_t)f2 * g4_19 +
+       (uint128_t)f3 * g3_19 + (uint128_t)f4 * g2_19;
+  t2 = (uint128_t)f0 * g2 + (uint128_t)f1 * g1 + (uint128_t)f2 * g0 +
+       (uint128_t)f3 * g4_19 + (uint128_t)f4 * g3_19;
+  t3 = (uint128_t)f0 * g3 + (uint128_t)f1 * g2 + (uint128_t)f2 * g1 +
+       (uint128_t)f3 * g0 + (uint128_t)f4 * g4_19;
+  t4 = (uint128_t)f0 * g4 + (uint128_t)f1 * g3 + (uint128_t)f2 * g2 +
+       (uint128_t)f3 * g1 + (uint128_t)f4 * g0;
+
+  fe_carry_wide(h, t0, t1, t2, t3, t4);
+}
+
+/* h = f * f
+ * Can overlap h with f.
+ *
+ * Preconditions:
+ *    |f| bounded by 1.01*2^53,1.01*2^53,1.01*2^53,1.01*2^53,1.01*2^53.
+ *
+ * Postconditions:
+ *    |h| bounded by 2^51,2^51+2^13,2^51,2^51,2^51.
+ *
+ * See fe_mul for discussion of implementation strategy. */
+static void fe_sq(fe h, const fe f) {
+  uint64_t f0 = f[0];
+  uint64_t f1 = f[1];
+  uint64_t f2 = f[2];
+  uint64_t f3 = f[3];
+  uint64_t f4 = f[4];
+  uint64_t f0_2 = 2 * f0;
+  uint64_t f1_2 = 2 * f1;
+  uint64_t f1_38 = 38 * f1;
+  uint64_t f2_38 = 38 * f2;
+  uint64_t f3_38 = 38 * f3;
+  uint64_t f3_19 = 19 * f3;
+  uint64_t f4_19 = 19 * f4;
+  uint128_t t0, t1, t2, t3, t4;
+
+  t0 = (uint128_t)f0 * f0 + (uint128_t)f1_38 * f4 + (uint128_t)f2_38 * f3;
+  t1 = (uint128_t)f0_2 * f1 + (uint128_t)f2_38 * f4 + (uint128_t)f3_19 * f3;
+  t2 = (uint128_t)f0_2 * f2 + (uint128_t)f1 * f1 + (uint128_t)f3_38 * f4;
+  t3 = (uint128_t)f0_2 * f3 + (uint128_t)f1_2 * f2 + (uint128_t)f4_19 * f4;
+  t4 = (uint128_t)f0_2 * f4 + (uint128_t)f1_2 * f3 + (uint128_t)f2 * f2;
+
+  fe_carry_wide(h, t0, t1, t2, t3, t4);
+}
+#else
 /* h = f + g
  * Can overlap h with f or g.
  *
@@ -634,6 +876,7 @@ static void fe_sq(fe h, const fe f) {
   h[8] = h8;
   h[9] = h9;
 }
+#endif
 
 static void fe_invert(fe out, const fe z) {
   fe t0;
@@ -699,6 +942,20 @@ static void fe_invert(fe out, const fe z) {
   fe_mul(out, t1, t0);
 }
 
+#ifdef CURVE25519_64BIT
+/* h = -f
+ *
+ * Preconditions:
+ *    |f| bounded by 1.99*2^52,1.99*2^52,1.99*2^52,1.99*2^52,1.99*2^52.
+ *
+ * Postconditions:
+ *    |h| bounded by 2^51,2^51+2^13,2^51,2^51,2^51. */
+static void fe_neg(fe h, const fe f) {
+  fe zero;
+  fe_0(zero);
+  fe_sub(h, zero, f);
+}
+#else
 /* h = -f
  *
  * Preconditions:
@@ -712,17 +969,18 @@ static void fe_neg(fe h, const fe f) {
     h[i] = -f[i];
   }
 }
+#endif
 
 /* Replace (f,g) with (g,g) if b == 1;
  * replace (f,g) with (f,g) if b == 0.
  *
  * Preconditions: b in {0,1}. */
 static void fe_cmov(fe f, const fe g, unsigned b) {
-  b = 0-b;
+  fe_limb_t mask = 0 - (fe_limb_t)b;
   unsigned i;
-  for (i = 0; i < 10; i++) {
-    int32_t x = f[i] ^ g[i];
-    x &= b;
+  for (i = 0; i < FE_NUM_LIMBS; i++) {
+    fe_limb_t x = f[i] ^ g[i];
+    x &= mask;
     f[i] ^= x;
   }
 }
@@ -751,6 +1009,41 @@ static int fe_isnegative(const fe f) {
   return s[0] & 1;
 }
 
+#ifdef CURVE25519_64BIT
+/* h = 2 * f * f
+ * Can overlap h with f.
+ *
+ * Preconditions:
+ *    |f| bounded by 1.01*2^53,1.01*2^53,1.01*2^53,1.01*2^53,1.01*2^53.
+ *
+ * Postconditions:
+ *    |h| bounded by 2^51,2^51+2^13,2^51,2^51,2^51.
+ *
+ * See fe_sq. */
+static void fe_sq2(fe h, const fe f) {
+  uint64_t f0 = f[0];
+  uint64_t f1 = f[1];
+  uint64_t f2 = f[2];
+  uint64_t f3 = f[3];
+  uint64_t f4 = f[4];
+  uint64_t f0_2 = 2 * f0;
+  uint64_t f1_2 = 2 * f1;
+  uint64_t f1_38 = 38 * f1;
+  uint64_t f2_38 = 38 * f2;
+  uint64_t f3_38 = 38 * f3;
+  uint64_t f3_19 = 19 * f3;
+  uint64_t f4_19 = 19 * f4;
+  uint128_t t0, t1, t2, t3, t4;
+
+  t0 = (uint128_t)f0 * f0 + (uint128_t)f1_38 * f4 + (uint128_t)f2_38 * f3;
+  t1 = (uint128_t)f0_2 * f1 + (uint128_t)f2_38 * f4 + (uint128_t)f3_19 * f3;
+  t2 = (uint128_t)f0_2 * f2 + (uint128_t)f1 * f1 + (uint128_t)f3_38 * f4;
+  t3 = (uint128_t)f0_2 * f3 + (uint128_t)f1_2 * f2 + (uint128_t)f4_19 * f4;
+  t4 = (uint128_t)f0_2 * f4 + (uint128_t)f1_2 * f3 + (uint128_t)f2 * f2;
+
+  fe_carry_wide(h, 2 * t0, 2 * t1, 2 * t2, 2 * t3, 2 * t4);
+}
+#else
 /* h = 2 * f * f
  * Can overlap h with f.
  *
@@ -902,6 +1195,7 @@ static void fe_sq2(fe h, const fe f) {
   h[8] = h8;
   h[9] = h9;
 }
+#endif
 
 static void fe_pow22523(fe out, const fe z) {
   fe t0;
@@ -992,11 +1286,19 @@ static void ge_p3_tobytes(uint8_t *s, const ge_p3 *h) {
 }
 #endif
 
+#ifdef CURVE25519_64BIT
+static const fe d = {0x34dca135978a3, 0x1a8283b156ebd, 0x5e7a26001c029,
+                     0x739c663a03cbb, 0x52036cee2b6ff};
+
+static const fe sqrtm1 = {0x61b274a0ea0b0, 0xd5a5fc8f189d, 0x7ef5e9cbd0c60,
+                          0x78595a6804c9e, 0x2b8324804fc1d};
+#else
 static const fe d = {-10913610, 13857413, -15372611, 6949391,   114729,
                      -8787816,  -6275908, -3247719,  -18696448, -12055116};
 
 static const fe sqrtm1 = {-32595792, -7943725,  9377950,  3500415, 12389472,
                           -272473,   -25146209, -2005654, 326686,  11406482};
+#endif
 
 int x25519_ge_frombytes_vartime(ge_p3 *h, const uint8_t *s) {
   fe u;
@@ -1074,8 +1376,13 @@ static void ge_p3_to_p2(ge_p2 *r, const ge_p3 *p) {
   fe_copy(r->Z, p->Z);
 }
 
+#ifdef CURVE25519_64BIT
+static const fe d2 = {0x69b9426b2f159, 0x35050762add7a, 0x3cf44c0038052,
+                      0x6738cc7407977, 0x2406d9dc56dff};
+#else
 static const fe d2 = {-21827239, -5839606,  -30745221, 13898782, 229458,
                       15978800,  -12551817, -6495438,  29715968, 9444199};
+#endif
 
 /* r = p */
 void x25519_ge_p3_to_cached(ge_cached *r, const ge_p3 *p) {
@@ -1213,6 +1520,50 @@ static void cmov(ge_precomp *t, const ge_precomp *u, uint8_t b) {
   fe_cmov(t->xy2d, u->xy2d, b);
 }
 
+#if !defined(OPENSSL_SMALL) || defined(ED25519)
+#ifdef CURVE25519_64BIT
+/* The constant point tables below are kept in the 32-bit representation. An
+ * entry is selected in that form and only then widened to 64-bit limbs. */
+typedef struct {
+  int32_t yplusx[10];
+  int32_t yminusx[10];
+  int32_t xy2d[10];
+} ge_precomp_tbl;
+
+/* h = f, where f is in the 32-bit representation.
+ *
+ * Preconditions:
+ *    |f| bounded by 1.1*2^25,1.1*2^24,1.1*2^25,1.1*2^24,etc.
+ *
+ * Postconditions:
+ *    |h| bounded by 2^51,2^51+2^13,2^51,2^51,2^51. */
+static void fe_from_tbl(fe h, const int32_t f[10]) {
+  fe t;
+  unsigned i;
+
+  /* Each pair of limbs is a signed value below 2^51; adding 4p keeps the
+   * limbs positive. */
+  for (i = 0; i < 5; i++) {
+    int64_t l = f[2 * i] + (int64_t)f[2 * i + 1] * (1 << 26);
+    t[i] = (uint64_t)l + (i == 0 ? k4P0 : k4P1234);
+  }
+  fe_carry(h, t);
+}
+
+static void precomp_from_tbl(ge_precomp *h, const ge_precomp_tbl *f) {
+  fe_from_tbl(h->yplusx, f->yplusx);
+  fe_from_tbl(h->yminusx, f->yminusx);
+  fe_from_tbl(h->xy2d, f->xy2d);
+}
+#else
+typedef ge_precomp ge_precomp_tbl;
+
+static void precomp_from_tbl(ge_precomp *h, const ge_precomp_tbl *f) {
+  *h = *f;
+}
+#endif
+#endif
+
 void x25519_ge_scalarmult_small_precomp(
     ge_p3 *h, const uint8_t a[32], const uint8_t precomp_table[15 * 2 * 32]) {
   /* precomp_table is first expanded into matching |ge_precomp|
@@ -1365,7 +1716,7 @@ void x25519_ge_scalarmult_base(ge_p3 *h, const uint8_t a[32]) {
 #else
 
 /* k25519Precomp[i][j] = (j+1)*256^i*B */
-static const ge_precomp k25519Precomp[32][8] = {
+static const ge_precomp_tbl k25519Precomp[32][8] = {
     {
         {
             {25967493, -14356035, 29566456, 3660896, -12694345, 4014787,
@@ -3486,20 +3837,36 @@ static uint8_t negative(signed char b) {
   return x;
 }
 
+static void cmov_tbl(ge_precomp_tbl *t, const ge_precomp_tbl *u, uint8_t b) {
+#ifdef CURVE25519_64BIT
+  int32_t mask = 0 - (int32_t)b;
+  unsigned i;
+  for (i = 0; i < 10; i++) {
+    t->yplusx[i] ^= (t->yplusx[i] ^ u->yplusx[i]) & mask;
+    t->yminusx[i] ^= (t->yminusx[i] ^ u->yminusx[i]) & mask;
+    t->xy2d[i] ^= (t->xy2d[i] ^ u->xy2d[i]) & mask;
+  }
+#else
+  cmov(t, u, b);
+#endif
+}
+
 static void table_select(ge_precomp *t, int pos, signed char b) {
+  static const ge_precomp_tbl zero = {{1}, {1}, {0}};
+  ge_precomp_tbl e = zero;
   ge_precomp minust;
   uint8_t bnegative = negative(b);
   uint8_t babs = b - ((uint8_t)((-bnegative) & b) << 1);
 
-  ge_precomp_0(t);
-  cmov(t, &k25519Precomp[pos][0], equal(babs, 1));
-  cmov(t, &k25519Precomp[pos][1], equal(babs, 2));
-  cmov(t, &k25519Precomp[pos][2], equal(babs, 3));
-  cmov(t, &k25519Precomp[pos][3], equal(babs, 4));
-  cmov(t, &k25519Precomp[pos][4], equal(babs, 5));
-  cmov(t, &k25519Precomp[pos][5], equal(babs, 6));
-  cmov(t, &k25519Precomp[pos][6], equal(babs, 7));
-  cmov(t, &k25519Precomp[pos][7], equal(babs, 8));
+  cmov_tbl(&e, &k25519Precomp[pos][0], equal(babs, 1));
+  cmov_tbl(&e, &k25519Precomp[pos][1], equal(babs, 2));
+  cmov_tbl(&e, &k25519Precomp[pos][2], equal(babs, 3));
+  cmov_tbl(&e, &k25519Precomp[pos][3], equal(babs, 4));
+  cmov_tbl(&e, &k25519Precomp[pos][4], equal(babs, 5));
+  cmov_tbl(&e, &k25519Precomp[pos][5], equal(babs, 6));
+  cmov_tbl(&e, &k25519Precomp[pos][6], equal(babs, 7));
+  cmov_tbl(&e, &k25519Precomp[pos][7], equal(babs, 8));
+  precomp_from_tbl(t, &e);
   fe_copy(minust.yplusx, t->yminusx);
   fe_copy(minust.yminusx, t->yplusx);
   fe_neg(minust.xy2d, t->xy2d);
@@ -3658,7 +4025,7 @@ static void slide(signed char *r, const uint8_t *a) {
   }
 }
 
-static const ge_precomp Bi[8] = {
+static const ge_precomp_tbl Bi[8] = {
     {
         {25967493, -14356035, 29566456, 3660896, -12694345, 4014787, 27544626,
          -11754271, -6079156, 2047605},
@@ -3735,6 +4102,7 @@ ge_double_scalarmult_vartime(ge_p2 *r, const uint8_t *a,
   signed char aslide[256];
   signed char bslide[256];
   ge_cached Ai[8]; /* A,3A,5A,7A,9A,11A,13A,15A */
+  ge_precomp B[8]; /* Bi in the fe representation */
   ge_p1p1 t;
   ge_p3 u;
   ge_p3 A2;
@@ -3743,6 +4111,10 @@ ge_double_scalarmult_vartime(ge_p2 *r, const uint8_t *a,
   slide(aslide, a);
   slide(bslide, b);
 
+  for (i = 0; i < 8; i++) {
+    precomp_from_tbl(&B[i], &Bi[i]);
+  }
+
   x25519_ge_p3_to_cached(&Ai[0], A);
   ge_p3_dbl(&t, A);
   x25519_ge_p1p1_to_p3(&A2, &t);
@@ -3789,10 +4161,10 @@ ge_double_scalarmult_vartime(ge_p2 *r, const uint8_t *a,
 
     if (bslide[i] > 0) {
       x25519_ge_p1p1_to_p3(&u, &t);
-      ge_madd(&t, &u, &Bi[bslide[i] / 2]);
+      ge_madd(&t, &u, &B[bslide[i] / 2]);
     } else if (bslide[i] < 0) {
       x25519_ge_p1p1_to_p3(&u, &t);
-      ge_msub(&t, &u, &Bi[(-bslide[i]) / 2]);
+      ge_msub(&t, &u, &B[(-bslide[i]) / 2]);
     }
 
     x25519_ge_p1p1_to_p2(r, &t);
@@ -4691,21 +5063,74 @@ int ED25519_sign(uint8_t *out_sig, const uint8_t *message, size_t message_len,
   return 1;
 }
 
+/* r = p */
+static void ge_p2_to_p3(ge_p3 *r, const ge_p2 *p) {
+  fe_mul(r->X, p->X, p->Z);
+  fe_mul(r->Y, p->Y, p->Z);
+  fe_sq(r->Z, p->Z);
+  fe_mul(r->T, p->X, p->Y);
+}
+
+/* Returns 1 if [8]p is the identity, that is, if p lies in the small-order
+ * subgroup. */
+static int ge_p2_is_small_order(const ge_p2 *p) {
+  ge_p1p1 t;
+  ge_p2 q;
+  fe check;
+  int i;
+
+  q = *p;
+  for (i = 0; i < 3; i++) {
+    ge_p2_dbl(&t, &q);
+    x25519_ge_p1p1_to_p2(&q, &t);
+  }
+
+  /* The identity is (0:Z:Z). */
+  fe_sub(check, q.Y, q.Z);
+  return !fe_isnonzero(q.X) && !fe_isnonzero(check);
+}
+
+/* Returns 1 if |s| is the encoding that |ge_p3_tobytes| gives for the point
+ * it decodes to. |x25519_ge_frombytes_vartime| also accepts y >= p and a set
+ * sign bit on a point with x = 0; R must not be encoded that way. */
+static int ge_is_canonical(const uint8_t s[32]) {
+  unsigned ones = 0, zeros = 0;
+  int i;
+
+  for (i = 1; i < 31; i++) {
+    ones += (s[i] == 0xff);
+    zeros += (s[i] == 0);
+  }
+  if (ones == 30 && (s[31] & 0x7f) == 0x7f) {
+    /* y = p-1 has x = 0. */
+    if (s[0] >= 0xed || (s[0] == 0xec && (s[31] & 0x80) != 0)) {
+      return 0;
+    }
+  }
+  /* y = 1 has x = 0. */
+  if (zeros == 30 && s[0] == 1 && s[31] == 0x80) {
+    return 0;
+  }
+  return 1;
+}
+
+/* Signatures are checked with the cofactor, [8][S]B = [8]R + [8][h]A, as
+ * RFC 8032 section 5.1.7 allows. The same equation is what makes batch
+ * verification agree with one-at-a-time verification: without the cofactor,
+ * a small-order component in R or A cancels from a random linear combination
+ * whenever its z_i is even. */
 int ED25519_verify(const uint8_t *message, size_t message_len,
                    const uint8_t signature[64], const uint8_t public_key[32]) {
-  ge_p3 A;
-  if ((signature[63] & 224) != 0 ||
-      x25519_ge_frombytes_vartime(&A, public_key) != 0) {
+  ge_p3 A, R;
+  if ((signature[63] & 224) != 0 || !ge_is_canonical(signature) ||
+      x25519_ge_frombytes_vartime(&A, public_key) != 0 ||
+      x25519_ge_frombytes_vartime(&R, signature) != 0) {
     return 0;
   }
 
   fe_neg(A.X, A.X);
   fe_neg(A.T, A.T);
 
-  uint8_t pkcopy[32];
-  memcpy(pkcopy, public_key, 32);
-  uint8_t rcopy[32];
-  memcpy(rcopy, signature, 32);
   uint8_t scopy[32];
   memcpy(scopy, signature + 32, 32);
 
@@ -4719,13 +5144,241 @@ int ED25519_verify(const uint8_t *message, size_t message_len,
 
   x25519_sc_reduce(h);
 
-  ge_p2 R;
-  ge_double_scalarmult_vartime(&R, h, &A, scopy);
+  /* [S]B - [h]A - R */
+  ge_p2 sb_ha, check;
+  ge_p3 u;
+  ge_cached r_cached;
+  ge_p1p1 t;
+  ge_double_scalarmult_vartime(&sb_ha, h, &A, scopy);
+  ge_p2_to_p3(&u, &sb_ha);
+  x25519_ge_p3_to_cached(&r_cached, &R);
+  x25519_ge_sub(&t, &u, &r_cached);
+  x25519_ge_p1p1_to_p2(&check, &t);
+
+  return ge_p2_is_small_order(&check);
+}
+
+/* Signatures are checked in chunks of at most this many; a chunk that fails
+ * is verified again one signature at a time. */
+#define ED25519_BATCH_MAX 64
+
+struct ed25519_batch_point {
+  ge_p3 P;
+  uint8_t scalar[32];
+  ge_cached multiples[8]; /* P,3P,5P,7P,9P,11P,13P,15P */
+  signed char slide[256];
+};
+
+static void ge_batch_point_precompute(struct ed25519_batch_point *bp) {
+  ge_p1p1 t;
+  ge_p3 u;
+  ge_p3 P2;
+  int i;
+
+  slide(bp->slide, bp->scalar);
+
+  x25519_ge_p3_to_cached(&bp->multiples[0], &bp->P);
+  ge_p3_dbl(&t, &bp->P);
+  x25519_ge_p1p1_to_p3(&P2, &t);
+  for (i = 1; i < 8; i++) {
+    x25519_ge_add(&t, &P2, &bp->multiples[i - 1]);
+    x25519_ge_p1p1_to_p3(&u, &t);
+    x25519_ge_p3_to_cached(&bp->multiples[i], &u);
+  }
+}
+
+/* Checks |count| signatures at once. With random 128-bit z_i, every
+ * signature is valid only if
+ *
+ *   [sum z_i S_i]B - sum [z_i h_i]A_i - sum [z_i]R_i
+ *
+ * is the identity, where h_i is the hash of R_i, A_i and the message. The
+ * sum is computed as one multi-scalar multiplication that shares its
+ * doublings between all terms (Straus). Signatures under the same public key
+ * share a single A term.
+ *
+ * Like |ED25519_verify|, the sum is multiplied by the cofactor before the
+ * check. What is left of each term lies in the prime-order subgroup, so a
+ * batch holding a signature that |ED25519_verify| rejects passes with
+ * probability at most 2^-128.
+ *
+ * Returns 1 if the batch verifies and 0 if it does not or if any input fails
+ * the checks that |ED25519_verify| makes before its scalar multiplication. */
+static int ed25519_verify_batch_chunk(const uint8_t * const *messages,
+                                      const size_t *message_lens,
+                                      const uint8_t * const *signatures,
+                                      const uint8_t * const *public_keys,
+                                      size_t count) {
+  struct ed25519_batch_point *points, *A, *R;
+  size_t key_point[ED25519_BATCH_MAX];
+  ge_precomp B[8]; /* Bi in the fe representation */
+  signed char bslide[256];
+  uint8_t z[32], h[SHA512_DIGEST_LENGTH], sum[32];
+  SHA512_CTX hash_ctx;
+  ge_p3 u;
+  ge_p1p1 t;
+  ge_p2 r;
+  size_t i, j, k, npoints = 0;
+  int top, ret = 0;
+
+  if (count > ED25519_BATCH_MAX) {
+    return 0;
+  }
+  if ((points = reallocarray(NULL, 2 * count, sizeof(*points))) == NULL) {
+    return 0;
+  }
+
+  memset(sum, 0, sizeof(sum));
+  memset(z, 0, sizeof(z));
+
+  for (i = 0; i < count; i++) {
+    const uint8_t *sig = signatures[i];
+
+    if ((sig[63] & 224) != 0 || !ge_is_canonical(sig)) {
+      goto err;
+    }
+
+    for (k = 0; k < i; k++) {
+      if (memcmp(public_keys[k], public_keys[i], 32) == 0) {
+        break;
+      }
+    }
+    if (k < i) {
+      key_point[i] = key_point[k];
+      A = &points[key_point[i]];
+    } else {
+      key_point[i] = npoints;
+      A = &points[npoints++];
+      if (x25519_ge_frombytes_vartime(&A->P, public_keys[i]) != 0) {
+        goto err;
+      }
+      fe_neg(A->P.X, A->P.X);
+      fe_neg(A->P.T, A->P.T);
+      memset(A->scalar, 0, sizeof(A->scalar));
+    }
+
+    R = &points[npoints++];
+    if (x25519_ge_frombytes_vartime(&R->P, sig) != 0) {
+      goto err;
+    }
+    fe_neg(R->P.X, R->P.X);
+    fe_neg(R->P.T, R->P.T);
+
+    SHA512_Init(&hash_ctx);
+    SHA512_Update(&hash_ctx, sig, 32);
+    SHA512_Update(&hash_ctx, public_keys[i], 32);
+    SHA512_Update(&hash_ctx, messages[i], message_lens[i]);
+    SHA512_Final(h, &hash_ctx);
+    x25519_sc_reduce(h);
+
+    arc4random_buf(z, 16);
+    memcpy(R->scalar, z, sizeof(z));
+    sc_muladd(A->scalar, z, h, A->scalar);
+    sc_muladd(sum, z, sig + 32, sum);
+  }
+
+  for (j = 0; j < npoints; j++) {
+    ge_batch_point_precompute(&points[j]);
+  }
 
-  uint8_t rcheck[32];
-  x25519_ge_tobytes(rcheck, &R);
+  slide(bslide, sum);
+  for (i = 0; i < 8; i++) {
+    precomp_from_tbl(&B[i], &Bi[i]);
+  }
 
-  return timingsafe_memcmp(rcheck, rcopy, sizeof(rcheck)) == 0;
+  for (top = 255; top >= 0; --top) {
+    if (bslide[top]) {
+      break;
+    }
+    for (j = 0; j < npoints; j++) {
+      if (points[j].slide[top]) {
+        break;
+      }
+    }
+    if (j < npoints) {
+      break;
+    }
+  }
+
+  ge_p2_0(&r);
+
+  for (; top >= 0; --top) {
+    ge_p2_dbl(&t, &r);
+
+    for (j = 0; j < npoints; j++) {
+      signed char s = points[j].slide[top];
+
+      if (s > 0) {
+        x25519_ge_p1p1_to_p3(&u, &t);
+        x25519_ge_add(&t, &u, &points[j].multiples[s / 2]);
+      } else if (s < 0) {
+        x25519_ge_p1p1_to_p3(&u, &t);
+        x25519_ge_sub(&t, &u, &points[j].multiples[(-s) / 2]);
+      }
+    }
+
+    if (bslide[top] > 0) {
+      x25519_ge_p1p1_to_p3(&u, &t);
+      ge_madd(&t, &u, &B[bslide[top] / 2]);
+    } else if (bslide[top] < 0) {
+      x25519_ge_p1p1_to_p3(&u, &t);
+      ge_msub(&t, &u, &B[(-bslide[top]) / 2]);
+    }
+
+    x25519_ge_p1p1_to_p2(&r, &t);
+  }
+
+  ret = ge_p2_is_small_order(&r);
+
+ err:
+  explicit_bzero(z, sizeof(z));
+  free(points);
+  return ret;
+}
+
+/* ED25519_verify_batch checks |count| signatures, the ith of which is
+ * |signatures[i]| over |messages[i]| by |public_keys[i]|. It returns 1 if all
+ * of them are valid and 0 otherwise. If |valid| is not NULL, |valid[i]| is set
+ * to the result |ED25519_verify| gives for the ith signature. */
+int ED25519_verify_batch(const uint8_t * const *messages,
+                         const size_t *message_lens,
+                         const uint8_t * const *signatures,
+                         const uint8_t * const *public_keys, size_t count,
+                         int *valid) {
+  size_t i, j, n;
+  int ok, ret = 1;
+
+  for (i = 0; i < count; i += n) {
+    n = count - i;
+    if (n > ED25519_BATCH_MAX) {
+      n = ED25519_BATCH_MAX;
+    }
+
+    if (n > 1 && ed25519_verify_batch_chunk(messages + i, message_lens + i,
+                                            signatures + i, public_keys + i,
+                                            n)) {
+      if (valid != NULL) {
+        for (j = 0; j < n; j++) {
+          valid[i + j] = 1;
+        }
+      }
+      continue;
+    }
+
+    /* Find the bad signatures one at a time. */
+    for (j = 0; j < n; j++) {
+      ok = ED25519_verify(messages[i + j], message_lens[i + j],
+                          signatures[i + j], public_keys[i + j]);
+      if (valid != NULL) {
+        valid[i + j] = ok;
+      }
+      if (!ok) {
+        ret = 0;
+      }
+    }
+  }
+
+  return ret;
 }
 #endif
 
@@ -4734,16 +5387,32 @@ int ED25519_verify(const uint8_t *message, size_t message_len,
  *
  * Preconditions: b in {0,1}. */
 static void fe_cswap(fe f, fe g, unsigned int b) {
-  b = 0-b;
+  fe_limb_t mask = 0 - (fe_limb_t)b;
   unsigned i;
-  for (i = 0; i < 10; i++) {
-    int32_t x = f[i] ^ g[i];
-    x &= b;
+  for (i = 0; i < FE_NUM_LIMBS; i++) {
+    fe_limb_t x = f[i] ^ g[i];
+    x &= mask;
     f[i] ^= x;
     g[i] ^= x;
   }
 }
 
+#ifdef CURVE25519_64BIT
+/* h = f * 121666
+ * Can overlap h with f.
+ *
+ * Preconditions:
+ *    |f| bounded by 1.01*2^53,1.01*2^53,1.01*2^53,1.01*2^53,1.01*2^53.
+ *
+ * Postconditions:
+ *    |h| bounded by 2^51,2^51+2^13,2^51,2^51,2^51. */
+static void fe_mul121666(fe h, fe f) {
+  fe_carry_wide(h, (uint128_t)f[0] * 121666, (uint128_t)f[1] * 121666,
+                (uint128_t)f[2] * 121666, (uint128_t)f[3] * 121666,
+                (uint128_t)f[4] * 121666);
+}
+#else
+
 /* h = f * 121666
  * Can overlap h with f.
  *
@@ -4807,6 +5476,7 @@ static void fe_mul121666(fe h, fe f) {
   h[8] = h8;
   h[9] = h9;
 }
+#endif
 
 void
 x25519_scalar_mult_generic(uint8_t out[32], const uint8_t scalar[32],
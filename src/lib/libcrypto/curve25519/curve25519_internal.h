@@ -17,15 +17,33 @@
 #ifndef HEADER_CURVE25519_INTERNAL_H
 #define HEADER_CURVE25519_INTERNAL_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 __BEGIN_HIDDEN_DECLS
 
+/* LP64 targets with a 128-bit integer type use 64-bit limbs in radix 2^51;
+ * everything else keeps the 32-bit ref10 representation. */
+#if defined(_LP64) && defined(__SIZEOF_INT128__)
+#define CURVE25519_64BIT
+#endif
+
+#ifdef CURVE25519_64BIT
+/* fe means field element. Here the field is \Z/(2^255-19). An element t,
+ * entries t[0]...t[4], represents the integer t[0]+2^51 t[1]+2^102 t[2]+2^153
+ * t[3]+2^204 t[4]. Bounds on each t[i] vary depending on context.  */
+typedef uint64_t fe_limb_t;
+#define FE_NUM_LIMBS 5
+#else
 /* fe means field element. Here the field is \Z/(2^255-19). An element t,
  * entries t[0]...t[9], represents the integer t[0]+2^26 t[1]+2^51 t[2]+2^77
  * t[3]+2^102 t[4]+...+2^230 t[9]. Bounds on each t[i] vary depending on
  * context.  */
-typedef int32_t fe[10];
+typedef int32_t fe_limb_t;
+#define FE_NUM_LIMBS 10
+#endif
+
+typedef fe_limb_t fe[FE_NUM_LIMBS];
 
 /* ge means group element.
 
@@ -93,6 +111,31 @@ void x25519_scalar_mult(uint8_t out[32], const uint8_t scalar[32],
 void x25519_scalar_mult_generic(uint8_t out[32], const uint8_t scalar[32],
     const uint8_t point[32]);
 
+#ifdef ED25519
+#define ED25519_PRIVATE_KEY_LENGTH 64
+#define ED25519_PUBLIC_KEY_LENGTH 32
+#define ED25519_SIGNATURE_LENGTH 64
+
+void ED25519_keypair(uint8_t out_public_key[ED25519_PUBLIC_KEY_LENGTH],
+    uint8_t out_private_key[ED25519_PRIVATE_KEY_LENGTH]);
+int ED25519_sign(uint8_t *out_sig, const uint8_t *message, size_t message_len,
+    const uint8_t private_key[ED25519_PRIVATE_KEY_LENGTH]);
+
+/* Verification checks the cofactored equation [8][S]B = [8]R + [8][h]A. */
+int ED25519_verify(const uint8_t *message, size_t message_len,
+    const uint8_t signature[ED25519_SIGNATURE_LENGTH],
+    const uint8_t public_key[ED25519_PUBLIC_KEY_LENGTH]);
+
+/* ED25519_verify_batch checks |count| signatures, the ith of which is
+ * |signatures[i]| over the |message_lens[i]| bytes of |messages[i]| by
+ * |public_keys[i]|. It returns one if all of them are valid and zero
+ * otherwise. If |valid| is not NULL, |valid[i]| is set to the result that
+ * ED25519_verify gives for the ith signature. */
+int ED25519_verify_batch(const uint8_t * const *messages,
+    const size_t *message_lens, const uint8_t * const *signatures,
+    const uint8_t * const *public_keys, size_t count, int *valid);
+#endif
+
 __END_HIDDEN_DECLS
 
 #endif  /* HEADER_CURVE25519_INTERNAL_H */
@@ -108,7 +108,7 @@ generate_key(DH *dh)
 	BN_MONT_CTX *mont = NULL;
 	BIGNUM *pub_key = NULL, *priv_key = NULL;
 
-	ctx = BN_CTX_new();
+	ctx = bn_ctx_cache_get();
 	if (ctx == NULL)
 		goto err;
 
@@ -171,7 +171,7 @@ err:
 		BN_free(pub_key);
 	if (priv_key != NULL && dh->priv_key == NULL)
 		BN_free(priv_key);
-	BN_CTX_free(ctx);
+	bn_ctx_cache_put(ctx);
 	return ok;
 }
 
@@ -189,7 +189,7 @@ compute_key(unsigned char *key, const BIGNUM *pub_key, DH *dh)
 		goto err;
 	}
 
-	ctx = BN_CTX_new();
+	ctx = bn_ctx_cache_get();
 	if (ctx == NULL)
 		goto err;
 	BN_CTX_start(ctx);
@@ -226,7 +226,7 @@ compute_key(unsigned char *key, const BIGNUM *pub_key, DH *dh)
 err:
 	if (ctx != NULL) {
 		BN_CTX_end(ctx);
-		BN_CTX_free(ctx);
+		bn_ctx_cache_put(ctx);
 	}
 	return ret;
 }
@@ -52,6 +52,10 @@
 # on benchmark. Lower coefficients are for ECDSA sign, relatively fastest
 # server-side operation. Keep in mind that +100% means 2x improvement.
 
+# The field multiplication, squaring and the point operations built on
+# them are also generated in a MULX/ADCX/ADOX flavour, selected at run
+# time when the processor supports both BMI2 and ADX.
+
 $flavour = shift;
 $output  = shift;
 if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
@@ -66,8 +70,13 @@ die "can't locate x86_64-xlate.pl";
 open OUT,"| \"$^X\" \"$xlate\" $flavour \"$output\"";
 *STDOUT=*OUT;
 
+# Capabilities required by the MULX/ADCX/ADOX code paths.
+$bmi2adx="(IA32CAP_EXT_MASK_BMI2|IA32CAP_EXT_MASK_ADX)";
+
 $code.=<<___;
 .text
+.extern	OPENSSL_ia32cap_ext_P
+.hidden	OPENSSL_ia32cap_ext_P
 
 # The polynomial
 .align 64
@@ -200,6 +209,8 @@ $code.=<<___;
 .type	ecp_nistz256_mul_mont,\@function,3
 .align	32
 ecp_nistz256_mul_mont:
+	mov	OPENSSL_ia32cap_ext_P(%rip), %ecx
+	and	\$$bmi2adx, %ecx
 .Lmul_mont:
 	push	%rbp
 	push	%rbx
@@ -207,6 +218,8 @@ ecp_nistz256_mul_mont:
 	push	%r13
 	push	%r14
 	push	%r15
+	cmp	\$$bmi2adx, %ecx
+	je	.Lmul_montx
 
 	mov	$b_org, $b_ptr
 	mov	8*0($b_org), %rax
@@ -216,7 +229,20 @@ ecp_nistz256_mul_mont:
 	mov	8*3($a_ptr), $acc4
 
 	call	__ecp_nistz256_mul_montq
+	jmp	.Lmul_mont_done
 
+.align	32
+.Lmul_montx:
+	mov	$b_org, $b_ptr
+	mov	8*0($b_org), %rdx
+	mov	8*0($a_ptr), $acc1
+	mov	8*1($a_ptr), $acc2
+	mov	8*2($a_ptr), $acc3
+	mov	8*3($a_ptr), $acc4
+	lea	-128($a_ptr), $a_ptr	# control u-op density
+
+	call	__ecp_nistz256_mul_montx
+.Lmul_mont_done:
 	pop	%r15
 	pop	%r14
 	pop	%r13
@@ -453,12 +479,16 @@ __ecp_nistz256_mul_montq:
 .type	ecp_nistz256_sqr_mont,\@function,2
 .align	32
 ecp_nistz256_sqr_mont:
+	mov	OPENSSL_ia32cap_ext_P(%rip), %ecx
+	and	\$$bmi2adx, %ecx
 	push	%rbp
 	push	%rbx
 	push	%r12
 	push	%r13
 	push	%r14
 	push	%r15
+	cmp	\$$bmi2adx, %ecx
+	je	.Lsqr_montx
 
 	mov	8*0($a_ptr), %rax
 	mov	8*1($a_ptr), $acc6
@@ -466,7 +496,18 @@ ecp_nistz256_sqr_mont:
 	mov	8*3($a_ptr), $acc0
 
 	call	__ecp_nistz256_sqr_montq
+	jmp	.Lsqr_mont_done
 
+.align	32
+.Lsqr_montx:
+	mov	8*0($a_ptr), %rdx
+	mov	8*1($a_ptr), $acc6
+	mov	8*2($a_ptr), $acc7
+	mov	8*3($a_ptr), $acc0
+	lea	-128($a_ptr), $a_ptr	# control u-op density
+
+	call	__ecp_nistz256_sqr_montx
+.Lsqr_mont_done:
 	pop	%r15
 	pop	%r14
 	pop	%r13
@@ -639,6 +680,231 @@ __ecp_nistz256_sqr_montq:
 .size	__ecp_nistz256_sqr_montq,.-__ecp_nistz256_sqr_montq
 ___
 
+{
+# The MULX/ADCX/ADOX flavour. Both subroutines expect $a_ptr to be biased
+# by -128 and the first multiplier word in %rdx, and leave their results
+# in the same registers as their "q" counterparts.
+my @acc=($acc0,$acc1,$acc2,$acc3,$acc4,$acc5);
+
+$code.=<<___;
+.type	__ecp_nistz256_mul_montx,\@abi-omnipotent
+.align	32
+__ecp_nistz256_mul_montx:
+	########################################################################
+	# Multiply by b[0]
+	mulx	$acc1, $acc0, $acc1
+	mulx	$acc2, $t0, $acc2
+	mov	\$32, $poly1
+	xor	$acc5, $acc5		# cf=0
+	mulx	$acc3, $t1, $acc3
+	mov	.Lpoly+8*3(%rip), $poly3
+	adc	$t0, $acc1
+	mulx	$acc4, $t0, $acc4
+	 mov	$acc0, %rdx
+	adc	$t1, $acc2
+	adc	$t0, $acc3
+	 shlx	$poly1, $acc0, $t0
+	 shrx	$poly1, $acc0, $t1
+	adc	\$0, $acc4
+___
+for (my $i=1; $i<4; $i++) {
+my ($r0,$r1,$r2,$r3,$r4,$r5)=map($acc[($_+$i-1)%6],(0..5));
+my $step=("First","Second","Third")[$i-1];
+
+$code.=<<___;
+
+	########################################################################
+	# $step reduction step
+	add	$t0, $r1
+	adc	$t1, $r2
+
+	mulx	$poly3, $t0, $t1
+	 mov	8*$i($b_ptr), %rdx
+	adc	$t0, $r3
+	adc	$t1, $r4
+	adc	\$0, $r5
+	xor	$r0, $r0		# $r0=0,cf=0,of=0
+
+	########################################################################
+	# Multiply by b[$i]
+	mulx	8*0+128($a_ptr), $t0, $t1
+	adcx	$t0, $r1
+	adox	$t1, $r2
+
+	mulx	8*1+128($a_ptr), $t0, $t1
+	adcx	$t0, $r2
+	adox	$t1, $r3
+
+	mulx	8*2+128($a_ptr), $t0, $t1
+	adcx	$t0, $r3
+	adox	$t1, $r4
+
+	mulx	8*3+128($a_ptr), $t0, $t1
+	 mov	$r1, %rdx
+	adcx	$t0, $r4
+	 shlx	$poly1, $r1, $t0
+	adox	$t1, $r5
+	 shrx	$poly1, $r1, $t1
+
+	adcx	$r0, $r5
+	adox	$r0, $r0
+	adc	\$0, $r0
+___
+}
+$code.=<<___;
+
+	########################################################################
+	# Final reduction step
+	add	$t0, $acc4
+	adc	$t1, $acc5
+
+	mulx	$poly3, $t0, $t1
+	 mov	$acc4, $t2
+	mov	.Lpoly+8*1(%rip), $poly1
+	adc	$t0, $acc0
+	 mov	$acc5, $t3
+	adc	$t1, $acc1
+	adc	\$0, $acc2
+
+	########################################################################
+	# Branch-less conditional subtraction of P
+	sub	\$-1, $acc4		# .Lpoly[0]
+	 mov	$acc0, $t0
+	sbb	$poly1, $acc5		# .Lpoly[1]
+	sbb	\$0, $acc0		# .Lpoly[2]
+	 mov	$acc1, $t1
+	sbb	$poly3, $acc1		# .Lpoly[3]
+	sbb	\$0, $acc2
+
+	cmovc	$t2, $acc4
+	cmovc	$t3, $acc5
+	mov	$acc4, 8*0($r_ptr)
+	cmovc	$t0, $acc0
+	mov	$acc5, 8*1($r_ptr)
+	cmovc	$t1, $acc1
+	mov	$acc0, 8*2($r_ptr)
+	mov	$acc1, 8*3($r_ptr)
+
+	ret
+.size	__ecp_nistz256_mul_montx,.-__ecp_nistz256_mul_montx
+
+.type	__ecp_nistz256_sqr_montx,\@abi-omnipotent
+.align	32
+__ecp_nistz256_sqr_montx:
+	mulx	$acc6, $acc1, $acc2	# a[0]*a[1]
+	mulx	$acc7, $t0, $acc3	# a[0]*a[2]
+	xor	%eax, %eax		# cf=0
+	adc	$t0, $acc2
+	mulx	$acc0, $t1, $acc4	# a[0]*a[3]
+	 mov	$acc6, %rdx
+	adc	$t1, $acc3
+	adc	\$0, $acc4
+	xor	$acc5, $acc5		# $acc5=0,cf=0,of=0
+
+	#################################
+	mulx	$acc7, $t0, $t1		# a[1]*a[2]
+	adcx	$t0, $acc3
+	adox	$t1, $acc4
+
+	mulx	$acc0, $t0, $t1		# a[1]*a[3]
+	 mov	$acc7, %rdx
+	adcx	$t0, $acc4
+	adox	$t1, $acc5
+	adc	\$0, $acc5
+
+	#################################
+	mulx	$acc0, $t0, $acc6	# a[2]*a[3]
+	 mov	8*0+128($a_ptr), %rdx
+	xor	$acc7, $acc7		# $acc7=0,cf=0,of=0
+	 adcx	$acc1, $acc1		# acc1:6<<1
+	adox	$t0, $acc5
+	 adcx	$acc2, $acc2
+	adox	$acc7, $acc6		# of=0
+
+	mulx	%rdx, $acc0, $t1	# a[0]*a[0]
+	mov	8*1+128($a_ptr), %rdx
+	 adcx	$acc3, $acc3
+	adox	$t1, $acc1
+	 adcx	$acc4, $acc4
+	mulx	%rdx, $t0, $t4		# a[1]*a[1]
+	mov	8*2+128($a_ptr), %rdx
+	 adcx	$acc5, $acc5
+	adox	$t0, $acc2
+	 adcx	$acc6, $acc6
+	mulx	%rdx, $t0, $t1		# a[2]*a[2]
+	mov	8*3+128($a_ptr), %rdx
+	adox	$t4, $acc3
+	 adcx	$acc7, $acc7
+	adox	$t0, $acc4
+	 mov	\$32, $a_ptr
+	adox	$t1, $acc5
+	mulx	%rdx, $t0, $t4		# a[3]*a[3]
+	 mov	.Lpoly+8*3(%rip), %rdx
+	adox	$t0, $acc6
+	 shlx	$a_ptr, $acc0, $t0
+	adox	$t4, $acc7
+	 shrx	$a_ptr, $acc0, $t4
+	mov	%rdx, $t1
+___
+for (my $i=0; $i<4; $i++) {
+my ($r0,$r1,$r2,$r3)=map($acc[($_+$i)%4],(0..3));
+my $step=("First","Second","Third","Last")[$i];
+
+$code.=<<___;
+
+	##########################################
+	# $step iteration
+	add	$t0, $r1
+	adc	$t4, $r2
+
+	mulx	$r0, $t0, $r0
+	adc	$t0, $r3
+___
+$code.=<<___	if ($i<3);
+	 shlx	$a_ptr, $r1, $t0
+	adc	\$0, $r0
+	 shrx	$a_ptr, $r1, $t4
+___
+$code.=<<___	if ($i==3);
+	adc	\$0, $r0
+___
+}
+$code.=<<___;
+
+	############################################
+	# Add the rest of the acc
+	xor	$t3, $t3
+	add	$acc0, $acc4
+	 mov	.Lpoly+8*1(%rip), $a_ptr
+	adc	$acc1, $acc5
+	 mov	$acc4, $acc0
+	adc	$acc2, $acc6
+	adc	$acc3, $acc7
+	 mov	$acc5, $acc1
+	adc	\$0, $t3
+
+	sub	\$-1, $acc4		# .Lpoly[0]
+	 mov	$acc6, $acc2
+	sbb	$a_ptr, $acc5		# .Lpoly[1]
+	sbb	\$0, $acc6		# .Lpoly[2]
+	 mov	$acc7, $acc3
+	sbb	$t1, $acc7		# .Lpoly[3]
+	sbb	\$0, $t3
+
+	cmovc	$acc0, $acc4
+	cmovc	$acc1, $acc5
+	mov	$acc4, 8*0($r_ptr)
+	cmovc	$acc2, $acc6
+	mov	$acc5, 8*1($r_ptr)
+	cmovc	$acc3, $acc7
+	mov	$acc6, 8*2($r_ptr)
+	mov	$acc7, 8*3($r_ptr)
+
+	ret
+.size	__ecp_nistz256_sqr_montx,.-__ecp_nistz256_sqr_montx
+___
+}
+
 }
 {
 my ($r_ptr,$in_ptr)=("%rdi","%rsi");
@@ -975,11 +1241,15 @@ my $bias = $src0 eq "%rax" ? 0 : -128;
 # operate in 4-5-0-1 "name space" that matches multiplication output
 #
 my ($a0,$a1,$a2,$a3,$t3,$t4)=($acc4,$acc5,$acc0,$acc1,$acc2,$acc3);
+#
+# These don't involve multiplication, so the MULX/ADCX/ADOX flavour of
+# the point operations shares them under the "x" names.
 
 $code.=<<___;
 .type	__ecp_nistz256_add_toq,\@abi-omnipotent
 .align	32
 __ecp_nistz256_add_toq:
+__ecp_nistz256_add_tox:
 	add	8*0($b_ptr), $a0
 	adc	8*1($b_ptr), $a1
 	 mov	$a0, $t0
@@ -1011,6 +1281,7 @@ __ecp_nistz256_add_toq:
 .type	__ecp_nistz256_sub_fromq,\@abi-omnipotent
 .align	32
 __ecp_nistz256_sub_fromq:
+__ecp_nistz256_sub_fromx:
 	sub	8*0($b_ptr), $a0
 	sbb	8*1($b_ptr), $a1
 	 mov	$a0, $t0
@@ -1042,6 +1313,7 @@ __ecp_nistz256_sub_fromq:
 .type	__ecp_nistz256_subq,\@abi-omnipotent
 .align	32
 __ecp_nistz256_subq:
+__ecp_nistz256_subx:
 	sub	$a0, $t0
 	sbb	$a1, $t1
 	 mov	$t0, $a0
@@ -1069,6 +1341,7 @@ __ecp_nistz256_subq:
 .type	__ecp_nistz256_mul_by_2q,\@abi-omnipotent
 .align	32
 __ecp_nistz256_mul_by_2q:
+__ecp_nistz256_mul_by_2x:
 	add	$a0, $a0		# a0:a3+a0:a3
 	adc	$a1, $a1
 	 mov	$a0, $t0
@@ -1113,6 +1386,10 @@ $code.=<<___;
 .type	ecp_nistz256_point_double,\@function,2
 .align	32
 ecp_nistz256_point_double:
+	mov	OPENSSL_ia32cap_ext_P(%rip), %ecx
+	and	\$$bmi2adx, %ecx
+	cmp	\$$bmi2adx, %ecx
+	je	.Lpoint_doublex
 ___
     } else {
 	$src0 = "%rdx";
@@ -1316,6 +1593,7 @@ $code.=<<___;
 ___
 }
 &gen_double("q");
+&gen_double("x");
 
 sub gen_add () {
     my $x = shift;
@@ -1337,11 +1615,22 @@ $code.=<<___;
 .type	ecp_nistz256_point_add,\@function,3
 .align	32
 ecp_nistz256_point_add:
+	mov	OPENSSL_ia32cap_ext_P(%rip), %ecx
+	and	\$$bmi2adx, %ecx
+	cmp	\$$bmi2adx, %ecx
+	je	.Lpoint_addx
 ___
     } else {
 	$src0 = "%rdx";
 	$sfx  = "x";
 	$bias = 128;
+
+$code.=<<___;
+.type	ecp_nistz256_point_addx,\@function,3
+.align	32
+ecp_nistz256_point_addx:
+.Lpoint_addx:
+___
     }
 $code.=<<___;
 	push	%rbp
@@ -1672,6 +1961,7 @@ $code.=<<___;
 ___
 }
 &gen_add("q");
+&gen_add("x");
 
 sub gen_add_affine () {
     my $x = shift;
@@ -1692,11 +1982,22 @@ $code.=<<___;
 .type	ecp_nistz256_point_add_affine,\@function,3
 .align	32
 ecp_nistz256_point_add_affine:
+	mov	OPENSSL_ia32cap_ext_P(%rip), %ecx
+	and	\$$bmi2adx, %ecx
+	cmp	\$$bmi2adx, %ecx
+	je	.Lpoint_add_affinex
 ___
     } else {
 	$src0 = "%rdx";
 	$sfx  = "x";
 	$bias = 128;
+
+$code.=<<___;
+.type	ecp_nistz256_point_add_affinex,\@function,3
+.align	32
+ecp_nistz256_point_add_affinex:
+.Lpoint_add_affinex:
+___
     }
 $code.=<<___;
 	push	%rbp
@@ -1963,6 +2264,7 @@ $code.=<<___;
 ___
 }
 &gen_add_affine("q");
+&gen_add_affine("x");
 
 }}}
 
@@ -826,6 +826,14 @@ void EC_KEY_set_asn1_flag(EC_KEY *eckey, int asn1_flag);
  */
 int EC_KEY_precompute_mult(EC_KEY *key, BN_CTX *ctx);
 
+/** Creates a table of pre-computed multiples of the public key to
+ *  accelerate verification of signatures made with the key.
+ *  \param  key  EC_KEY object
+ *  \param  ctx  BN_CTX object (optional)
+ *  \return 1 on success and 0 if an error occurred.
+ */
+int EC_KEY_precompute_pub_mult(EC_KEY *key, BN_CTX *ctx);
+
 /** Creates a new ec private (and optional a new public) key.
  *  \param  key  EC_KEY object
  *  \return 1 on success and 0 if an error occurred.
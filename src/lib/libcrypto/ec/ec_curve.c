@@ -3251,6 +3251,53 @@ err:
 	return group;
 }
 
+/*
+ * Groups for the built-in curves, each with precomputed multiples of its
+ * generator, created on first use and never freed. The groups returned by
+ * EC_GROUP_new_by_curve_name() are copies, which share the read-only
+ * precomputation with these by reference.
+ */
+static EC_GROUP *curve_groups[curve_list_length];
+
+static EC_GROUP *
+ec_group_new_precomputed(size_t i)
+{
+	EC_GROUP *group;
+
+	CRYPTO_r_lock(CRYPTO_LOCK_EC);
+	group = curve_groups[i];
+	CRYPTO_r_unlock(CRYPTO_LOCK_EC);
+	if (group != NULL)
+		return EC_GROUP_dup(group);
+
+	if ((group = ec_group_new_from_data(curve_list[i])) == NULL)
+		return NULL;
+	EC_GROUP_set_curve_name(group, curve_list[i].nid);
+
+	/*
+	 * Methods with a built-in table for the generator need nothing.
+	 * Failing to precompute is not fatal, the group is merely slower.
+	 */
+	if (!EC_GROUP_have_precompute_mult(group)) {
+		ERR_set_mark();
+		if (!EC_GROUP_precompute_mult(group, NULL)) {
+			ERR_pop_to_mark();
+			return group;
+		}
+		ERR_pop_to_mark();
+	}
+
+	CRYPTO_w_lock(CRYPTO_LOCK_EC);
+	if (curve_groups[i] == NULL)
+		curve_groups[i] = group;
+	else
+		EC_GROUP_free(group);
+	group = curve_groups[i];
+	CRYPTO_w_unlock(CRYPTO_LOCK_EC);
+
+	return EC_GROUP_dup(group);
+}
+
 EC_GROUP *
 EC_GROUP_new_by_curve_name(int nid)
 {
@@ -3262,14 +3309,13 @@ EC_GROUP_new_by_curve_name(int nid)
 
 	for (i = 0; i < curve_list_length; i++)
 		if (curve_list[i].nid == nid) {
-			ret = ec_group_new_from_data(curve_list[i]);
+			ret = ec_group_new_precomputed(i);
 			break;
 		}
 	if (ret == NULL) {
 		ECerror(EC_R_UNKNOWN_GROUP);
 		return NULL;
 	}
-	EC_GROUP_set_curve_name(ret, nid);
 
 	return ret;
 }
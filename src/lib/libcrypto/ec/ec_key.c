@@ -65,6 +65,7 @@
 
 #include <openssl/opensslconf.h>
 
+#include "bn_lcl.h"
 #include "ec_lcl.h"
 #include <openssl/err.h>
 
@@ -87,6 +88,7 @@ EC_KEY_new(void)
 	ret->conv_form = POINT_CONVERSION_UNCOMPRESSED;
 	ret->references = 1;
 	ret->method_data = NULL;
+	ret->pub_mult_group = NULL;
 	return (ret);
 }
 
@@ -121,6 +123,7 @@ EC_KEY_free(EC_KEY * r)
 	BN_clear_free(r->priv_key);
 
 	EC_EX_DATA_free_all_data(&r->method_data);
+	EC_GROUP_free(r->pub_mult_group);
 
 	freezero(r, sizeof(EC_KEY));
 }
@@ -154,6 +157,14 @@ EC_KEY_copy(EC_KEY * dest, const EC_KEY * src)
 		if (!EC_POINT_copy(dest->pub_key, src->pub_key))
 			return NULL;
 	}
+	/* share the precomputed multiples of the public key */
+	EC_GROUP_free(dest->pub_mult_group);
+	dest->pub_mult_group = NULL;
+	if (src->pub_mult_group != NULL) {
+		dest->pub_mult_group = EC_GROUP_dup(src->pub_mult_group);
+		if (dest->pub_mult_group == NULL)
+			return NULL;
+	}
 	/* copy the private key */
 	if (src->priv_key) {
 		if (dest->priv_key == NULL) {
@@ -220,7 +231,7 @@ EC_KEY_generate_key(EC_KEY * eckey)
 	}
 	if ((order = BN_new()) == NULL)
 		goto err;
-	if ((ctx = BN_CTX_new()) == NULL)
+	if ((ctx = bn_ctx_cache_get()) == NULL)
 		goto err;
 
 	if (eckey->priv_key == NULL) {
@@ -259,7 +270,7 @@ err:
 		EC_POINT_free(pub_key);
 	if (priv_key != NULL && eckey->priv_key == NULL)
 		BN_free(priv_key);
-	BN_CTX_free(ctx);
+	bn_ctx_cache_put(ctx);
 	return (ok);
 }
 
@@ -411,6 +422,8 @@ EC_KEY_get0_group(const EC_KEY * key)
 int 
 EC_KEY_set_group(EC_KEY * key, const EC_GROUP * group)
 {
+	EC_GROUP_free(key->pub_mult_group);
+	key->pub_mult_group = NULL;
 	EC_GROUP_free(key->group);
 	key->group = EC_GROUP_dup(group);
 	return (key->group == NULL) ? 0 : 1;
@@ -439,6 +452,8 @@ EC_KEY_get0_public_key(const EC_KEY * key)
 int 
 EC_KEY_set_public_key(EC_KEY * key, const EC_POINT * pub_key)
 {
+	EC_GROUP_free(key->pub_mult_group);
+	key->pub_mult_group = NULL;
 	EC_POINT_free(key->pub_key);
 	key->pub_key = EC_POINT_dup(pub_key, key->group);
 	return (key->pub_key == NULL) ? 0 : 1;
@@ -517,6 +532,67 @@ EC_KEY_precompute_mult(EC_KEY * key, BN_CTX * ctx)
 	return EC_GROUP_precompute_mult(key->group, ctx);
 }
 
+int
+EC_KEY_precompute_pub_mult(EC_KEY *key, BN_CTX *ctx)
+{
+	EC_GROUP *group;
+
+	if (key->group == NULL || key->pub_key == NULL) {
+		ECerror(ERR_R_PASSED_NULL_PARAMETER);
+		return 0;
+	}
+	if ((group = EC_GROUP_dup(key->group)) == NULL)
+		return 0;
+	if (!EC_GROUP_set_generator(group, key->pub_key, &key->group->order,
+	    &key->group->cofactor))
+		goto err;
+	if (!EC_GROUP_precompute_mult(group, ctx))
+		goto err;
+
+	EC_GROUP_free(key->pub_mult_group);
+	key->pub_mult_group = group;
+	return 1;
+
+err:
+	EC_GROUP_free(group);
+	return 0;
+}
+
+/*
+ * Compute r = g_scalar * generator + p_scalar * pub_key. If there are
+ * precomputed multiples of pub_key, both halves use a fixed-base table.
+ * The public key may have been changed behind our back through the ASN.1
+ * decoders, so check that the table is still for it.
+ */
+int
+ec_key_pub_mul(const EC_KEY *key, EC_POINT *r, const BIGNUM *g_scalar,
+    const BIGNUM *p_scalar, BN_CTX *ctx)
+{
+	const EC_GROUP *group = key->group;
+	EC_POINT *t = NULL;
+	int ret = 0;
+
+	if (key->pub_mult_group == NULL || EC_POINT_cmp(group, key->pub_key,
+	    EC_GROUP_get0_generator(key->pub_mult_group), ctx) != 0)
+		return EC_POINT_mul(group, r, g_scalar, key->pub_key, p_scalar,
+		    ctx);
+
+	if ((t = EC_POINT_new(group)) == NULL)
+		goto err;
+	if (!EC_POINT_mul(group, r, g_scalar, NULL, NULL, ctx))
+		goto err;
+	if (!EC_POINT_mul(key->pub_mult_group, t, p_scalar, NULL, NULL, ctx))
+		goto err;
+	if (!EC_POINT_add(group, r, r, t, ctx))
+		goto err;
+
+	ret = 1;
+
+err:
+	EC_POINT_free(t);
+	return ret;
+}
+
 int 
 EC_KEY_get_flags(const EC_KEY * key)
 {
@@ -256,6 +256,9 @@ struct ec_key_st {
 	int	flags;
 
 	EC_EXTRA_DATA *method_data;
+
+	/* pub_key as generator, with precomputed multiples */
+	EC_GROUP *pub_mult_group;
 } /* EC_KEY */;
 
 /* Basically a 'mixin' for extra data, but available for EC_GROUPs/EC_KEYs only
@@ -274,6 +277,10 @@ void EC_EX_DATA_clear_free_data(EC_EXTRA_DATA **,
 void EC_EX_DATA_free_all_data(EC_EXTRA_DATA **);
 void EC_EX_DATA_clear_free_all_data(EC_EXTRA_DATA **);
 
+/* also used by ECDSA verification, see ecs_locl.h */
+int ec_key_pub_mul(const EC_KEY *key, EC_POINT *r, const BIGNUM *g_scalar,
+	const BIGNUM *p_scalar, BN_CTX *ctx);
+
 
 
 struct ec_point_st {
@@ -68,6 +68,7 @@
 #include <openssl/err.h>
 #include <openssl/opensslv.h>
 
+#include "bn_lcl.h"
 #include "ec_lcl.h"
 
 /* functions for EC_GROUP objects */
@@ -476,7 +477,7 @@ EC_GROUP_cmp(const EC_GROUP * a, const EC_GROUP * b, BN_CTX * ctx)
 		return 1;
 
 	if (!ctx)
-		ctx_new = ctx = BN_CTX_new();
+		ctx_new = ctx = bn_ctx_cache_get();
 	if (!ctx)
 		return -1;
 
@@ -522,14 +523,14 @@ EC_GROUP_cmp(const EC_GROUP * a, const EC_GROUP * b, BN_CTX * ctx)
 	}
 	BN_CTX_end(ctx);
 	if (ctx_new)
-		BN_CTX_free(ctx);
+		bn_ctx_cache_put(ctx);
 
 	return r;
 
 err:
 	BN_CTX_end(ctx);
 	if (ctx_new)
-		BN_CTX_free(ctx);
+		bn_ctx_cache_put(ctx);
 	return -1;
 }
 
@@ -1040,7 +1041,8 @@ EC_POINTs_mul(const EC_GROUP *group, EC_POINT *r, const BIGNUM *scalar,
 		/* use default */
 		return ec_wNAF_mul(group, r, scalar, num, points, scalars, ctx);
 
-	return group->meth->mul(group, r, scalar, num, points, scalars, ctx);
+	/* Parenthesised so that the mul() macro from bn_lcl.h does not apply. */
+	return (group->meth->mul)(group, r, scalar, num, points, scalars, ctx);
 }
 
 int 
@@ -65,6 +65,7 @@
 
 #include <openssl/err.h>
 
+#include "bn_lcl.h"
 #include "ec_lcl.h"
 
 
@@ -376,7 +377,7 @@ ec_wNAF_mul(const EC_GROUP * group, EC_POINT * r, const BIGNUM * scalar,
 	}
 
 	if (ctx == NULL) {
-		ctx = new_ctx = BN_CTX_new();
+		ctx = new_ctx = bn_ctx_cache_get();
 		if (ctx == NULL)
 			goto err;
 	}
@@ -679,7 +680,7 @@ ec_wNAF_mul(const EC_GROUP * group, EC_POINT * r, const BIGNUM * scalar,
 	ret = 1;
 
 err:
-	BN_CTX_free(new_ctx);
+	bn_ctx_cache_put(new_ctx);
 	EC_POINT_free(tmp);
 	free(wsize);
 	free(wNAF_len);
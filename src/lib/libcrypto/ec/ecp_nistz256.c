@@ -46,6 +46,7 @@
 #include <openssl/ec.h>
 #include <openssl/err.h>
 
+#include "bn_lcl.h"
 #include "ec_lcl.h"
 
 #if BN_BITS2 != 64
@@ -487,9 +488,15 @@ ecp_nistz256_windowed_mul(const EC_GROUP *group, P256_POINT *r,
 		 * table[0] is implicitly (0,0,0) (the point at infinity),
 		 * therefore it is not stored. All other values are actually
 		 * stored with an offset of -1 in table.
+		 *
+		 * The assembly routines recognise the point at infinity by
+		 * X and Y both being zero, whereas an EC_POINT at infinity
+		 * only has Z zero, so such points have to be converted.
 		 */
 
-		if (!ecp_nistz256_bignum_to_field_elem(row[1 - 1].X,
+		if (EC_POINT_is_at_infinity(group, point[i]))
+			memset(&row[1 - 1], 0, sizeof(row[1 - 1]));
+		else if (!ecp_nistz256_bignum_to_field_elem(row[1 - 1].X,
 		      &point[i]->X) ||
 		    !ecp_nistz256_bignum_to_field_elem(row[1 - 1].Y,
 		      &point[i]->Y) ||
@@ -702,6 +709,7 @@ ecp_nistz256_mult_precompute(EC_GROUP *group, BN_CTX *ctx)
 	ec_pre_comp->group = group;
 	ec_pre_comp->w = 7;
 	ec_pre_comp->precomp = precomp;
+	precomp = NULL;
 
 	if (!EC_EX_DATA_set_data(&group->extra_data, ec_pre_comp,
 	    ecp_nistz256_pre_comp_dup, ecp_nistz256_pre_comp_free,
@@ -724,29 +732,28 @@ err:
 	return ret;
 }
 
+/*
+ * The precomputed tables hold coordinates in Montgomery form, which is
+ * also the internal representation of the point, so they are copied in
+ * without conversion.
+ */
 static int
 ecp_nistz256_set_from_affine(EC_POINT *out, const EC_GROUP *group,
     const P256_POINT_AFFINE *in, BN_CTX *ctx)
 {
-	BIGNUM x, y;
-	BN_ULONG d_x[P256_LIMBS], d_y[P256_LIMBS];
-	int ret = 0;
+	BN_ULONG x[P256_LIMBS], y[P256_LIMBS], z[P256_LIMBS];
 
-	memcpy(d_x, in->X, sizeof(d_x));
-	x.d = d_x;
-	x.dmax = x.top = P256_LIMBS;
-	x.neg = 0;
-	x.flags = BN_FLG_STATIC_DATA;
+	memcpy(x, in->X, sizeof(x));
+	memcpy(y, in->Y, sizeof(y));
+	memcpy(z, ONE, sizeof(z));
 
-	memcpy(d_y, in->Y, sizeof(d_y));
-	y.d = d_y;
-	y.dmax = y.top = P256_LIMBS;
-	y.neg = 0;
-	y.flags = BN_FLG_STATIC_DATA;
-
-	ret = EC_POINT_set_affine_coordinates_GFp(group, out, &x, &y, ctx);
+	if (!ecp_nistz256_set_words(&out->X, x) ||
+	    !ecp_nistz256_set_words(&out->Y, y) ||
+	    !ecp_nistz256_set_words(&out->Z, z))
+		return 0;
+	out->Z_is_one = 1;
 
-	return ret;
+	return 1;
 }
 
 /* r = scalar*G + sum(scalars[i]*points[i]) */
@@ -794,7 +801,7 @@ ecp_nistz256_points_mul(const EC_GROUP *group, EC_POINT *r,
 	}
 
 	if (ctx == NULL) {
-		ctx = new_ctx = BN_CTX_new();
+		ctx = new_ctx = bn_ctx_cache_get();
 		if (ctx == NULL)
 			goto err;
 	}
@@ -988,7 +995,7 @@ ecp_nistz256_points_mul(const EC_GROUP *group, EC_POINT *r,
 err:
 	if (ctx)
 		BN_CTX_end(ctx);
-	BN_CTX_free(new_ctx);
+	bn_ctx_cache_put(new_ctx);
 	free(new_points);
 	free(new_scalars);
 	return ret;
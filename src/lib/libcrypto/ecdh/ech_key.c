@@ -77,6 +77,7 @@
 #include <openssl/obj_mac.h>
 #include <openssl/sha.h>
 
+#include "bn_lcl.h"
 #include "ech_locl.h"
 
 static int ecdh_compute_key(void *out, size_t len, const EC_POINT *pub_key,
@@ -110,7 +111,7 @@ ecdh_compute_key(void *out, size_t outlen, const EC_POINT *pub_key,
 		return -1;
 	}
 
-	if ((ctx = BN_CTX_new()) == NULL)
+	if ((ctx = bn_ctx_cache_get()) == NULL)
 		goto err;
 	BN_CTX_start(ctx);
 	if ((x = BN_CTX_get(ctx)) == NULL)
@@ -195,7 +196,7 @@ err:
 	EC_POINT_free(tmp);
 	if (ctx)
 		BN_CTX_end(ctx);
-	BN_CTX_free(ctx);
+	bn_ctx_cache_put(ctx);
 	free(buf);
 	return (ret);
 }
@@ -81,6 +81,10 @@ typedef struct ecdsa_data_st {
  */
 ECDSA_DATA *ecdsa_check(EC_KEY *eckey);
 
+/* g_scalar * generator + p_scalar * pub_key, defined in ec_key.c */
+int ec_key_pub_mul(const EC_KEY *key, EC_POINT *r, const BIGNUM *g_scalar,
+    const BIGNUM *p_scalar, BN_CTX *ctx);
+
 __END_HIDDEN_DECLS
 
 #endif /* HEADER_ECS_LOCL_H */
@@ -100,7 +100,7 @@ ecdsa_sign_setup(EC_KEY *eckey, BN_CTX *ctx_in, BIGNUM **kinvp, BIGNUM **rp)
 	}
 
 	if (ctx_in == NULL) {
-		if ((ctx = BN_CTX_new()) == NULL) {
+		if ((ctx = bn_ctx_cache_get()) == NULL) {
 			ECDSAerror(ERR_R_MALLOC_FAILURE);
 			return 0;
 		}
@@ -192,7 +192,7 @@ err:
 		BN_clear_free(r);
 	}
 	if (ctx_in == NULL)
-		BN_CTX_free(ctx);
+		bn_ctx_cache_put(ctx);
 	BN_free(order);
 	EC_POINT_free(tmp_point);
 	BN_clear_free(X);
@@ -229,7 +229,7 @@ ecdsa_do_sign(const unsigned char *dgst, int dgst_len,
 	}
 	s = ret->s;
 
-	if ((ctx = BN_CTX_new()) == NULL || (order = BN_new()) == NULL ||
+	if ((ctx = bn_ctx_cache_get()) == NULL || (order = BN_new()) == NULL ||
 	    (tmp = BN_new()) == NULL || (m = BN_new()) == NULL) {
 		ECDSAerror(ERR_R_MALLOC_FAILURE);
 		goto err;
@@ -300,7 +300,7 @@ err:
 		ECDSA_SIG_free(ret);
 		ret = NULL;
 	}
-	BN_CTX_free(ctx);
+	bn_ctx_cache_put(ctx);
 	BN_clear_free(m);
 	BN_clear_free(tmp);
 	BN_free(order);
@@ -326,7 +326,7 @@ ecdsa_do_verify(const unsigned char *dgst, int dgst_len, const ECDSA_SIG *sig,
 		return -1;
 	}
 
-	ctx = BN_CTX_new();
+	ctx = bn_ctx_cache_get();
 	if (!ctx) {
 		ECDSAerror(ERR_R_MALLOC_FAILURE);
 		return -1;
@@ -390,7 +390,7 @@ ecdsa_do_verify(const unsigned char *dgst, int dgst_len, const ECDSA_SIG *sig,
 		ECDSAerror(ERR_R_MALLOC_FAILURE);
 		goto err;
 	}
-	if (!EC_POINT_mul(group, point, u1, pub_key, u2, ctx)) {
+	if (!ec_key_pub_mul(eckey, point, u1, u2, ctx)) {
 		ECDSAerror(ERR_R_EC_LIB);
 		goto err;
 	}
@@ -421,7 +421,7 @@ ecdsa_do_verify(const unsigned char *dgst, int dgst_len, const ECDSA_SIG *sig,
 
 err:
 	BN_CTX_end(ctx);
-	BN_CTX_free(ctx);
+	bn_ctx_cache_put(ctx);
 	EC_POINT_free(point);
 	return ret;
 }
@@ -184,6 +184,8 @@ OpenSSL_add_all_ciphers(void)
 #if !defined(OPENSSL_NO_SHA) && !defined(OPENSSL_NO_SHA1)
 	EVP_add_cipher(EVP_aes_128_cbc_hmac_sha1());
 	EVP_add_cipher(EVP_aes_256_cbc_hmac_sha1());
+	EVP_add_cipher(EVP_aes_128_cbc_hmac_sha256());
+	EVP_add_cipher(EVP_aes_256_cbc_hmac_sha256());
 #endif
 #endif
 
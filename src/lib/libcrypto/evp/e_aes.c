@@ -1425,14 +1425,17 @@ aead_aes_gcm_cleanup(EVP_AEAD_CTX *ctx)
 	freezero(gcm_ctx, sizeof(*gcm_ctx));
 }
 
+/*
+ * Seal or open one message using gcm, which holds a copy of the key's
+ * GCM128_CONTEXT that is reset by setting the IV, so that a batch of
+ * messages only needs to make a single copy.
+ */
 static int
-aead_aes_gcm_seal(const EVP_AEAD_CTX *ctx, unsigned char *out, size_t *out_len,
-    size_t max_out_len, const unsigned char *nonce, size_t nonce_len,
-    const unsigned char *in, size_t in_len, const unsigned char *ad,
-    size_t ad_len)
+aes_gcm_seal(const struct aead_aes_gcm_ctx *gcm_ctx, GCM128_CONTEXT *gcm,
+    unsigned char *out, size_t *out_len, size_t max_out_len,
+    const unsigned char *nonce, size_t nonce_len, const unsigned char *in,
+    size_t in_len, const unsigned char *ad, size_t ad_len)
 {
-	const struct aead_aes_gcm_ctx *gcm_ctx = ctx->aead_state;
-	GCM128_CONTEXT gcm;
 	size_t bulk = 0;
 
 	if (max_out_len < in_len + gcm_ctx->tag_len) {
@@ -1440,37 +1443,34 @@ aead_aes_gcm_seal(const EVP_AEAD_CTX *ctx, unsigned char *out, size_t *out_len,
 		return 0;
 	}
 
-	memcpy(&gcm, &gcm_ctx->gcm, sizeof(gcm));
-	CRYPTO_gcm128_setiv(&gcm, nonce, nonce_len);
+	CRYPTO_gcm128_setiv(gcm, nonce, nonce_len);
 
-	if (ad_len > 0 && CRYPTO_gcm128_aad(&gcm, ad, ad_len))
+	if (ad_len > 0 && CRYPTO_gcm128_aad(gcm, ad, ad_len))
 		return 0;
 
 	if (gcm_ctx->ctr) {
-		if (CRYPTO_gcm128_encrypt_ctr32(&gcm, in + bulk, out + bulk,
+		if (CRYPTO_gcm128_encrypt_ctr32(gcm, in + bulk, out + bulk,
 		    in_len - bulk, gcm_ctx->ctr))
 			return 0;
 	} else {
-		if (CRYPTO_gcm128_encrypt(&gcm, in + bulk, out + bulk,
+		if (CRYPTO_gcm128_encrypt(gcm, in + bulk, out + bulk,
 		    in_len - bulk))
 			return 0;
 	}
 
-	CRYPTO_gcm128_tag(&gcm, out + in_len, gcm_ctx->tag_len);
+	CRYPTO_gcm128_tag(gcm, out + in_len, gcm_ctx->tag_len);
 	*out_len = in_len + gcm_ctx->tag_len;
 
 	return 1;
 }
 
 static int
-aead_aes_gcm_open(const EVP_AEAD_CTX *ctx, unsigned char *out, size_t *out_len,
-    size_t max_out_len, const unsigned char *nonce, size_t nonce_len,
-    const unsigned char *in, size_t in_len, const unsigned char *ad,
-    size_t ad_len)
+aes_gcm_open(const struct aead_aes_gcm_ctx *gcm_ctx, GCM128_CONTEXT *gcm,
+    unsigned char *out, size_t *out_len, size_t max_out_len,
+    const unsigned char *nonce, size_t nonce_len, const unsigned char *in,
+    size_t in_len, const unsigned char *ad, size_t ad_len)
 {
-	const struct aead_aes_gcm_ctx *gcm_ctx = ctx->aead_state;
 	unsigned char tag[EVP_AEAD_AES_GCM_TAG_LEN];
-	GCM128_CONTEXT gcm;
 	size_t plaintext_len;
 	size_t bulk = 0;
 
@@ -1486,23 +1486,22 @@ aead_aes_gcm_open(const EVP_AEAD_CTX *ctx, unsigned char *out, size_t *out_len,
 		return 0;
 	}
 
-	memcpy(&gcm, &gcm_ctx->gcm, sizeof(gcm));
-	CRYPTO_gcm128_setiv(&gcm, nonce, nonce_len);
+	CRYPTO_gcm128_setiv(gcm, nonce, nonce_len);
 
-	if (CRYPTO_gcm128_aad(&gcm, ad, ad_len))
+	if (CRYPTO_gcm128_aad(gcm, ad, ad_len))
 		return 0;
 
 	if (gcm_ctx->ctr) {
-		if (CRYPTO_gcm128_decrypt_ctr32(&gcm, in + bulk, out + bulk,
+		if (CRYPTO_gcm128_decrypt_ctr32(gcm, in + bulk, out + bulk,
 		    in_len - bulk - gcm_ctx->tag_len, gcm_ctx->ctr))
 			return 0;
 	} else {
-		if (CRYPTO_gcm128_decrypt(&gcm, in + bulk, out + bulk,
+		if (CRYPTO_gcm128_decrypt(gcm, in + bulk, out + bulk,
 		    in_len - bulk - gcm_ctx->tag_len))
 			return 0;
 	}
 
-	CRYPTO_gcm128_tag(&gcm, tag, gcm_ctx->tag_len);
+	CRYPTO_gcm128_tag(gcm, tag, gcm_ctx->tag_len);
 	if (timingsafe_memcmp(tag, in + plaintext_len, gcm_ctx->tag_len) != 0) {
 		EVPerror(EVP_R_BAD_DECRYPT);
 		return 0;
@@ -1513,6 +1512,84 @@ aead_aes_gcm_open(const EVP_AEAD_CTX *ctx, unsigned char *out, size_t *out_len,
 	return 1;
 }
 
+static int
+aead_aes_gcm_seal(const EVP_AEAD_CTX *ctx, unsigned char *out, size_t *out_len,
+    size_t max_out_len, const unsigned char *nonce, size_t nonce_len,
+    const unsigned char *in, size_t in_len, const unsigned char *ad,
+    size_t ad_len)
+{
+	const struct aead_aes_gcm_ctx *gcm_ctx = ctx->aead_state;
+	GCM128_CONTEXT gcm;
+
+	memcpy(&gcm, &gcm_ctx->gcm, sizeof(gcm));
+
+	return aes_gcm_seal(gcm_ctx, &gcm, out, out_len, max_out_len,
+	    nonce, nonce_len, in, in_len, ad, ad_len);
+}
+
+static int
+aead_aes_gcm_open(const EVP_AEAD_CTX *ctx, unsigned char *out, size_t *out_len,
+    size_t max_out_len, const unsigned char *nonce, size_t nonce_len,
+    const unsigned char *in, size_t in_len, const unsigned char *ad,
+    size_t ad_len)
+{
+	const struct aead_aes_gcm_ctx *gcm_ctx = ctx->aead_state;
+	GCM128_CONTEXT gcm;
+
+	memcpy(&gcm, &gcm_ctx->gcm, sizeof(gcm));
+
+	return aes_gcm_open(gcm_ctx, &gcm, out, out_len, max_out_len,
+	    nonce, nonce_len, in, in_len, ad, ad_len);
+}
+
+static void
+aead_aes_gcm_seal_batch(const EVP_AEAD_CTX *ctx, EVP_AEAD_MSG *msgs,
+    size_t num_msgs)
+{
+	const struct aead_aes_gcm_ctx *gcm_ctx = ctx->aead_state;
+	GCM128_CONTEXT gcm;
+	EVP_AEAD_MSG *msg;
+	size_t i;
+
+	memcpy(&gcm, &gcm_ctx->gcm, sizeof(gcm));
+
+	for (i = 0; i < num_msgs; i++) {
+		msg = &msgs[i];
+		if (!msg->status)
+			continue;
+		msg->status = aes_gcm_seal(gcm_ctx, &gcm, msg->out,
+		    &msg->out_len, msg->max_out_len, msg->nonce,
+		    msg->nonce_len, msg->in, msg->in_len, msg->ad,
+		    msg->ad_len);
+	}
+
+	explicit_bzero(&gcm, sizeof(gcm));
+}
+
+static void
+aead_aes_gcm_open_batch(const EVP_AEAD_CTX *ctx, EVP_AEAD_MSG *msgs,
+    size_t num_msgs)
+{
+	const struct aead_aes_gcm_ctx *gcm_ctx = ctx->aead_state;
+	GCM128_CONTEXT gcm;
+	EVP_AEAD_MSG *msg;
+	size_t i;
+
+	memcpy(&gcm, &gcm_ctx->gcm, sizeof(gcm));
+
+	for (i = 0; i < num_msgs; i++) {
+		msg = &msgs[i];
+		if (!msg->status)
+			continue;
+		msg->status = aes_gcm_open(gcm_ctx, &gcm, msg->out,
+		    &msg->out_len, msg->max_out_len, msg->nonce,
+		    msg->nonce_len, msg->in, msg->in_len, msg->ad,
+		    msg->ad_len);
+	}
+
+	explicit_bzero(&gcm, sizeof(gcm));
+}
+
 static const EVP_AEAD aead_aes_128_gcm = {
 	.key_len = 16,
 	.nonce_len = 12,
@@ -1523,6 +1600,8 @@ static const EVP_AEAD aead_aes_128_gcm = {
 	.cleanup = aead_aes_gcm_cleanup,
 	.seal = aead_aes_gcm_seal,
 	.open = aead_aes_gcm_open,
+	.seal_batch = aead_aes_gcm_seal_batch,
+	.open_batch = aead_aes_gcm_open_batch,
 };
 
 static const EVP_AEAD aead_aes_256_gcm = {
@@ -1535,6 +1614,8 @@ static const EVP_AEAD aead_aes_256_gcm = {
 	.cleanup = aead_aes_gcm_cleanup,
 	.seal = aead_aes_gcm_seal,
 	.open = aead_aes_gcm_open,
+	.seal_batch = aead_aes_gcm_seal_batch,
+	.open_batch = aead_aes_gcm_open_batch,
 };
 
 const EVP_AEAD *
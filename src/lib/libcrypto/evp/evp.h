@@ -788,6 +788,8 @@ const EVP_CIPHER *EVP_aes_256_xts(void);
 #if !defined(OPENSSL_NO_SHA) && !defined(OPENSSL_NO_SHA1)
 const EVP_CIPHER *EVP_aes_128_cbc_hmac_sha1(void);
 const EVP_CIPHER *EVP_aes_256_cbc_hmac_sha1(void);
+const EVP_CIPHER *EVP_aes_128_cbc_hmac_sha256(void);
+const EVP_CIPHER *EVP_aes_256_cbc_hmac_sha256(void);
 #endif
 #endif
 #ifndef OPENSSL_NO_CAMELLIA
@@ -1320,6 +1322,38 @@ int EVP_AEAD_CTX_open(const EVP_AEAD_CTX *ctx, unsigned char *out,
     size_t nonce_len, const unsigned char *in, size_t in_len,
     const unsigned char *ad, size_t ad_len);
 
+/* EVP_AEAD_MSG describes one message for EVP_AEAD_CTX_seal_batch and
+ * EVP_AEAD_CTX_open_batch. The fields correspond to the arguments of
+ * EVP_AEAD_CTX_seal and EVP_AEAD_CTX_open, with out_len and status being
+ * set by the batch functions. */
+typedef struct evp_aead_msg_st {
+	unsigned char *out;
+	size_t out_len;
+	size_t max_out_len;
+	const unsigned char *nonce;
+	size_t nonce_len;
+	const unsigned char *in;
+	size_t in_len;
+	const unsigned char *ad;
+	size_t ad_len;
+	int status;
+} EVP_AEAD_MSG;
+
+/* EVP_AEAD_CTX_seal_batch seals each of the num_msgs messages in msgs, as
+ * EVP_AEAD_CTX_seal would, and returns the number of messages that were
+ * sealed. The status of each message is set to one on success, otherwise
+ * it is set to zero and its output is cleared. Messages are independent of
+ * each other and a failure does not stop the processing of the others. */
+size_t EVP_AEAD_CTX_seal_batch(const EVP_AEAD_CTX *ctx, EVP_AEAD_MSG *msgs,
+    size_t num_msgs);
+
+/* EVP_AEAD_CTX_open_batch opens each of the num_msgs messages in msgs, as
+ * EVP_AEAD_CTX_open would, and returns the number of messages that were
+ * opened. The status of each message is set to one if it was authenticated
+ * and decrypted, otherwise it is set to zero and its output is cleared. */
+size_t EVP_AEAD_CTX_open_batch(const EVP_AEAD_CTX *ctx, EVP_AEAD_MSG *msgs,
+    size_t num_msgs);
+
 void EVP_add_alg_module(void);
 
 /* BEGIN ERROR CODES */
@@ -142,3 +142,96 @@ error:
 	*out_len = 0;
 	return 0;
 }
+
+size_t
+EVP_AEAD_CTX_seal_batch(const EVP_AEAD_CTX *ctx, EVP_AEAD_MSG *msgs,
+    size_t num_msgs)
+{
+	EVP_AEAD_MSG *msg;
+	size_t i, sealed = 0;
+
+	for (i = 0; i < num_msgs; i++) {
+		msg = &msgs[i];
+		msg->out_len = 0;
+		msg->status = 1;
+
+		/* Overflow. */
+		if (msg->in_len + ctx->aead->overhead < msg->in_len) {
+			EVPerror(EVP_R_TOO_LARGE);
+			msg->status = 0;
+		} else if (!check_alias(msg->in, msg->in_len, msg->out)) {
+			EVPerror(EVP_R_OUTPUT_ALIASES_INPUT);
+			msg->status = 0;
+		}
+	}
+
+	if (ctx->aead->seal_batch != NULL)
+		ctx->aead->seal_batch(ctx, msgs, num_msgs);
+	else {
+		for (i = 0; i < num_msgs; i++) {
+			msg = &msgs[i];
+			if (msg->status)
+				msg->status = ctx->aead->seal(ctx, msg->out,
+				    &msg->out_len, msg->max_out_len, msg->nonce,
+				    msg->nonce_len, msg->in, msg->in_len,
+				    msg->ad, msg->ad_len);
+		}
+	}
+
+	for (i = 0; i < num_msgs; i++) {
+		msg = &msgs[i];
+		if (msg->status) {
+			sealed++;
+			continue;
+		}
+		/* As for EVP_AEAD_CTX_seal, never leave raw data behind. */
+		memset(msg->out, 0, msg->max_out_len);
+		msg->out_len = 0;
+	}
+
+	return sealed;
+}
+
+size_t
+EVP_AEAD_CTX_open_batch(const EVP_AEAD_CTX *ctx, EVP_AEAD_MSG *msgs,
+    size_t num_msgs)
+{
+	EVP_AEAD_MSG *msg;
+	size_t i, opened = 0;
+
+	for (i = 0; i < num_msgs; i++) {
+		msg = &msgs[i];
+		msg->out_len = 0;
+		msg->status = 1;
+
+		if (!check_alias(msg->in, msg->in_len, msg->out)) {
+			EVPerror(EVP_R_OUTPUT_ALIASES_INPUT);
+			msg->status = 0;
+		}
+	}
+
+	if (ctx->aead->open_batch != NULL)
+		ctx->aead->open_batch(ctx, msgs, num_msgs);
+	else {
+		for (i = 0; i < num_msgs; i++) {
+			msg = &msgs[i];
+			if (msg->status)
+				msg->status = ctx->aead->open(ctx, msg->out,
+				    &msg->out_len, msg->max_out_len, msg->nonce,
+				    msg->nonce_len, msg->in, msg->in_len,
+				    msg->ad, msg->ad_len);
+		}
+	}
+
+	for (i = 0; i < num_msgs; i++) {
+		msg = &msgs[i];
+		if (msg->status) {
+			opened++;
+			continue;
+		}
+		memset(msg->out, 0, msg->max_out_len);
+		msg->out_len = 0;
+	}
+
+	return opened;
+}
@@ -365,6 +365,14 @@ struct evp_aead_st {
 	    size_t *out_len, size_t max_out_len, const unsigned char *nonce,
 	    size_t nonce_len, const unsigned char *in, size_t in_len,
 	    const unsigned char *ad, size_t ad_len);
+
+	/* Optional. Called with status set to one for the messages that
+	 * passed the generic checks; other messages must be skipped and the
+	 * status cleared for those that fail. */
+	void (*seal_batch)(const struct evp_aead_ctx_st *ctx,
+	    EVP_AEAD_MSG *msgs, size_t num_msgs);
+	void (*open_batch)(const struct evp_aead_ctx_st *ctx,
+	    EVP_AEAD_MSG *msgs, size_t num_msgs);
 };
 
 __END_HIDDEN_DECLS
@@ -138,6 +138,7 @@
  *
  */
 
+#include <openssl/bn.h>
 #include <openssl/err.h>
 #include <openssl/lhash.h>
 
@@ -548,12 +549,14 @@ CRYPTO_ex_data_new_class(void)
 /* Release all "ex_data" state to prevent memory leaks. This can't be made
  * thread-safe without overhauling a lot of stuff, and shouldn't really be
  * called under potential race-conditions anyway (it's for program shutdown
- * after all). */
+ * after all). The BN_CTX cache is library-wide state as well, so it is
+ * freed here too. */
 void
 CRYPTO_cleanup_all_ex_data(void)
 {
 	IMPL_CHECK
 	EX_IMPL(cleanup)();
+	BN_CTX_cache_cleanup();
 }
 
 /* Inside an existing class, get/register a new index. */
@@ -0,0 +1,299 @@
+#!/usr/bin/env perl
+# $OpenBSD$
+#
+# Copyright (c) 2026 The LibreSSL project.
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# Stitched AES-NI CTR32 and PCLMULQDQ GHASH.
+#
+# size_t aesni_gcm_encrypt(const unsigned char *in, unsigned char *out,
+#     size_t len, const void *key, unsigned char ivec[16], u64 Xi[2]);
+# size_t aesni_gcm_decrypt(const unsigned char *in, unsigned char *out,
+#     size_t len, const void *key, unsigned char ivec[16], u64 Xi[2]);
+#
+# The input is processed six blocks at a time, with the AES rounds for
+# one group of counter blocks interleaved with the carry-less multiplies
+# hashing a group of ciphertext blocks, so that each block is only
+# brought into registers once. Decryption hashes the group being
+# decrypted, encryption hashes the group produced by the previous
+# iteration and the last group is hashed on its own.
+#
+# The six products are accumulated unreduced, as (Xi + C0) * H^6 +
+# C1 * H^5 + ... + C5 * H, and reduced once per group. The powers of H
+# are taken from the Htable of the GCM128_CONTEXT, which immediately
+# follows Xi and H, and where gcm_init_clmul stores H, H^2, ..., H^6.
+#
+# Only whole groups are processed; the number of bytes processed, a
+# multiple of 96, is returned. The 32-bit big-endian counter in ivec is
+# advanced accordingly and Xi is updated.
+
+$flavour = shift;
+$output  = shift;
+if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+open OUT,"| \"$^X\" $xlate $flavour $output";
+*STDOUT=*OUT;
+
+($inp,$out,$len,$key,$ivp,$Xip)=("%rdi","%rsi","%rdx","%rcx","%r8","%r9");
+($rounds,$lastkey)=("%r10d","%r11");
+
+my @inout=map("%xmm$_",(0..5));
+my $rk="%xmm6";
+my ($Xlo,$Xhi,$Xmid)=map("%xmm$_",(7..9));
+my ($Y,$T,$Hp)=map("%xmm$_",(10..12));
+my ($CTR,$BSWAP,$ONE)=map("%xmm$_",(13..15));
+
+# Htable, holding H^1 to H^6, follows Xi and H.
+sub hpow { my $n=shift; return (32+16*($n-1))."($Xip)"; }
+
+# Load the next six counter blocks, whitened with round key 0.
+sub ctr_blocks {
+	my $code="\tmovups\t($key),$rk\n";
+	for (my $i=0; $i<6; $i++) {
+		$code.=<<___;
+	movdqa	$CTR,$inout[$i]
+	paddd	$ONE,$CTR
+	pshufb	$BSWAP,$inout[$i]
+	pxor	$rk,$inout[$i]
+___
+	}
+	return $code;
+}
+
+sub aes_round {
+	my $n=shift;
+	my $code="\tmovups\t".(16*$n)."($key),$rk\n";
+	$code.="\taesenc\t$rk,$_\n" for (@inout);
+	return $code;
+}
+
+# Last round, with the input folded into the round key, and store.
+sub aes_last {
+	my $code="\tmovups\t($lastkey),$rk\n";
+	for (my $i=0; $i<6; $i++) {
+		$code.=<<___;
+	movdqu	`16*$i`($inp),$T
+	pxor	$rk,$T
+	aesenclast	$T,$inout[$i]
+	movdqu	$inout[$i],`16*$i`($out)
+___
+	}
+	return $code;
+}
+
+# GHASH of the six blocks at $off($base), returned as eight chunks of
+# code to be interleaved with the AES rounds. The first block is added to Xi,
+# which is held in $Xlo, the accumulated product is left in $Xlo.
+sub ghash_chunks {
+	my ($off,$base)=@_;
+	my @chunks;
+
+	for (my $j=0; $j<6; $j++) {
+		my $code=<<___;
+	movdqu	`$off+16*$j`($base),$Y
+	movdqu	${\hpow(6-$j)},$Hp
+	pshufb	$BSWAP,$Y
+___
+		if ($j==0) {
+			$code.=<<___;
+	pxor	$Xlo,$Y
+	movdqa	$Y,$Xlo
+	movdqa	$Y,$Xhi
+	movdqa	$Y,$Xmid
+	pclmulqdq	\$0x00,$Hp,$Xlo
+	pclmulqdq	\$0x11,$Hp,$Xhi
+	pclmulqdq	\$0x01,$Hp,$Xmid
+	pclmulqdq	\$0x10,$Hp,$Y
+	pxor	$Y,$Xmid
+___
+		} else {
+			$code.=<<___;
+	movdqa	$Y,$T
+	pclmulqdq	\$0x00,$Hp,$T
+	pxor	$T,$Xlo
+	movdqa	$Y,$T
+	pclmulqdq	\$0x11,$Hp,$T
+	pxor	$T,$Xhi
+	movdqa	$Y,$T
+	pclmulqdq	\$0x01,$Hp,$T
+	pxor	$T,$Xmid
+	pclmulqdq	\$0x10,$Hp,$Y
+	pxor	$Y,$Xmid
+___
+		}
+		push @chunks,$code;
+	}
+
+	# Fold the middle terms and reduce, as reduction_alg9 in
+	# ghash-x86_64.pl does.
+	push @chunks,<<___;
+	movdqa	$Xmid,$T
+	psrldq	\$8,$Xmid
+	pslldq	\$8,$T
+	pxor	$Xmid,$Xhi
+	pxor	$T,$Xlo
+
+	movdqa	$Xlo,$T
+	psllq	\$1,$Xlo
+	pxor	$T,$Xlo
+	psllq	\$5,$Xlo
+	pxor	$T,$Xlo
+	psllq	\$57,$Xlo
+	movdqa	$Xlo,$Y
+	pslldq	\$8,$Xlo
+	psrldq	\$8,$Y
+	pxor	$T,$Xlo
+	pxor	$Y,$Xhi
+___
+	push @chunks,<<___;
+	movdqa	$Xlo,$Y
+	psrlq	\$5,$Xlo
+	pxor	$Y,$Xlo
+	psrlq	\$1,$Xlo
+	pxor	$Y,$Xlo
+	pxor	$Xhi,$Y
+	psrlq	\$1,$Xlo
+	pxor	$Y,$Xlo
+___
+	return @chunks;
+}
+
+# One group of six blocks: the AES rounds, with the given GHASH chunks
+# issued after rounds 1 to 8.
+sub aes_group {
+	my ($sfx,@chunks)=@_;
+	my $code=ctr_blocks();
+
+	for (my $n=1; $n<=9; $n++) {
+		$code.=aes_round($n);
+		$code.=shift(@chunks) if (@chunks);
+	}
+	$code.=<<___;
+	cmp	\$11,$rounds
+	jb	.Llast$sfx
+___
+	$code.=aes_round(10);
+	$code.=aes_round(11);
+	$code.="\tje\t.Llast$sfx\n";
+	$code.=aes_round(12);
+	$code.=aes_round(13);
+	$code.=".Llast$sfx:\n";
+	$code.=aes_last();
+	$code.=<<___;
+	lea	96($inp),$inp
+	lea	96($out),$out
+	sub	\$96,$len
+	add	\$96,%rax
+___
+	return $code;
+}
+
+sub prologue {
+	my $sfx=shift;
+	return <<___;
+	xor	%eax,%eax
+	cmp	\$96,$len
+	jb	.Ldone$sfx
+
+	movdqa	.Lbswap_mask(%rip),$BSWAP
+	movdqa	.Lone(%rip),$ONE
+	movdqu	($ivp),$CTR
+	movdqu	($Xip),$Xlo
+	pshufb	$BSWAP,$CTR
+	pshufb	$BSWAP,$Xlo
+
+	mov	240($key),$rounds	# key->rounds
+	mov	$rounds,%r11d
+	shl	\$4,%r11
+	lea	16($key,%r11),$lastkey	# last round key
+___
+}
+
+sub epilogue {
+	my $sfx=shift;
+	return <<___;
+	pshufb	$BSWAP,$CTR
+	pshufb	$BSWAP,$Xlo
+	movdqu	$CTR,($ivp)
+	movdqu	$Xlo,($Xip)
+.Ldone$sfx:
+	ret
+___
+}
+
+$code=<<___;
+.text
+
+.globl	aesni_gcm_encrypt
+.type	aesni_gcm_encrypt,\@function,6
+.align	32
+aesni_gcm_encrypt:
+___
+$code.=prologue("_enc");
+$code.=aes_group("_enc_first");
+$code.=<<___;
+	jmp	.Lenc_check
+
+.align	32
+.Lenc_loop:
+___
+$code.=aes_group("_enc",ghash_chunks(-96,$out));
+$code.=<<___;
+.Lenc_check:
+	cmp	\$96,$len
+	jae	.Lenc_loop
+
+___
+$code.=join("",ghash_chunks(-96,$out));
+$code.=epilogue("_enc");
+$code.=<<___;
+.size	aesni_gcm_encrypt,.-aesni_gcm_encrypt
+
+.globl	aesni_gcm_decrypt
+.type	aesni_gcm_decrypt,\@function,6
+.align	32
+aesni_gcm_decrypt:
+___
+$code.=prologue("_dec");
+$code.=<<___;
+
+.align	32
+.Ldec_loop:
+___
+$code.=aes_group("_dec",ghash_chunks(0,$inp));
+$code.=<<___;
+	cmp	\$96,$len
+	jae	.Ldec_loop
+
+___
+$code.=epilogue("_dec");
+$code.=<<___;
+.size	aesni_gcm_decrypt,.-aesni_gcm_decrypt
+
+.align	64
+.Lbswap_mask:
+	.byte	15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0
+.Lone:
+	.long	1,0,0,0
+___
+
+$code =~ s/\`([^\`]*)\`/eval($1)/gem;
+
+print $code;
+close STDOUT;
@@ -437,6 +437,16 @@ ___
 $code.=<<___;
 	movdqu		$Hkey,($Htbl)		# save H
 	movdqu		$Xi,16($Htbl)		# save H^2
+___
+	# H^3 to H^6, for aesni-gcm-x86_64
+	for ($i=2;$i<6;$i++) {
+	&clmul64x64_T2	($Xhi,$Xi,$Hkey);
+	&reduction_alg9	($Xhi,$Xi);
+$code.=<<___;
+	movdqu		$Xi,`16*$i`($Htbl)	# save H^`$i+1`
+___
+	}
+$code.=<<___;
 	ret
 .size	gcm_init_clmul,.-gcm_init_clmul
 ___
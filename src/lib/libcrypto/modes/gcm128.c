@@ -651,6 +651,24 @@ void gcm_init_clmul(u128 Htable[16],const u64 Xi[2]);
 void gcm_gmult_clmul(u64 Xi[2],const u128 Htable[16]);
 void gcm_ghash_clmul(u64 Xi[2],const u128 Htable[16],const u8 *inp,size_t len);
 
+#  if	defined(AESNI_GCM_ASM)
+/*
+ * Stitched AES-NI CTR32 and GHASH, using the powers of H stored in
+ * Htable by gcm_init_clmul. They require the key schedule to be set up
+ * by aesni_set_encrypt_key, which is known to be the case when the
+ * stream function is aesni_ctr32_encrypt_blocks.
+ */
+void aesni_ctr32_encrypt_blocks(const u8 *in,u8 *out,size_t blocks,
+			const void *key,const u8 ivec[16]);
+size_t aesni_gcm_encrypt(const u8 *in,u8 *out,size_t len,
+			const void *key,u8 ivec[16],u64 Xi[2]);
+size_t aesni_gcm_decrypt(const u8 *in,u8 *out,size_t len,
+			const void *key,u8 ivec[16],u64 Xi[2]);
+#   define AESNI_GCM_CAPABLE(ctx,stream) \
+	((stream) == (ctr128_f)aesni_ctr32_encrypt_blocks && \
+	 (ctx)->ghash == gcm_ghash_clmul)
+#  endif
+
 #  if	defined(__i386) || defined(__i386__) || defined(_M_IX86)
 #   define GHASH_ASM_X86
 void gcm_gmult_4bit_mmx(u64 Xi[2],const u128 Htable[16]);
@@ -1305,6 +1323,15 @@ int CRYPTO_gcm128_encrypt_ctr32(GCM128_CONTEXT *ctx,
 			return 0;
 		}
 	}
+#if defined(AESNI_GCM_ASM)
+	if (len>=96 && AESNI_GCM_CAPABLE(ctx,stream)) {
+		i = aesni_gcm_encrypt(in,out,len,key,ctx->Yi.c,ctx->Xi.u);
+		ctr = BSWAP4(ctx->Yi.d[3]);
+		in  += i;
+		out += i;
+		len -= i;
+	}
+#endif
 #if defined(GHASH) && !defined(OPENSSL_SMALL_FOOTPRINT)
 	while (len>=GHASH_CHUNK) {
 		(*stream)(in,out,GHASH_CHUNK/16,key,ctx->Yi.c);
@@ -1425,6 +1452,15 @@ int CRYPTO_gcm128_decrypt_ctr32(GCM128_CONTEXT *ctx,
 			return 0;
 		}
 	}
+#if defined(AESNI_GCM_ASM)
+	if (len>=96 && AESNI_GCM_CAPABLE(ctx,stream)) {
+		i = aesni_gcm_decrypt(in,out,len,key,ctx->Yi.c,ctx->Xi.u);
+		ctr = BSWAP4(ctx->Yi.d[3]);
+		in  += i;
+		out += i;
+		len -= i;
+	}
+#endif
 #if defined(GHASH) && !defined(OPENSSL_SMALL_FOOTPRINT)
 	while (len>=GHASH_CHUNK) {
 		GHASH(ctx,in,GHASH_CHUNK);
@@ -0,0 +1,230 @@
+#!/usr/bin/env perl
+# $OpenBSD$
+#
+# Copyright (c) 2026 The LibreSSL project.
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# Four-way AVX2 Poly1305 block function.
+#
+# void poly1305_blocks_avx2(unsigned long h[5], const unsigned char *m,
+#     size_t blocks, const unsigned int table[18][8]);
+#
+# The accumulator h is kept in radix 2^26, as in poly1305-donna.c. The
+# message is processed 64 bytes at a time, with each of the four 64-bit
+# lanes accumulating every fourth block:
+#
+#	H = (H + M) * r^4
+#
+# except for the last 64 bytes, where the lanes are multiplied by r^4,
+# r^3, r^2 and r respectively before being summed. The input h is added
+# to the lane holding the first block. Since the message blocks are
+# loaded with vpunpck{l,h}qdq, the lanes hold blocks 0, 2, 1 and 3.
+#
+# The table is prepared by the caller and holds, one row per ymm:
+#	rows 0-4	the limbs of r^4, in all dwords
+#	rows 5-8	the limbs 1-4 of r^4, multiplied by 5
+#	rows 9-13	the limbs of r^4, r^2, r^3, r in the even dwords
+#	rows 14-17	the limbs 1-4 of the above, multiplied by 5
+#
+# blocks must be a non-zero multiple of 4, all blocks are full blocks
+# (with the 2^128 bit set), and h is left partially reduced, as done
+# by poly1305_blocks().
+
+$flavour = shift;
+$output  = shift;
+if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+open OUT,"| \"$^X\" $xlate $flavour $output";
+*STDOUT=*OUT;
+
+($hp,$inp,$blocks,$tbl)=("%rdi","%rsi","%rdx","%rcx");
+
+my @H=map("%ymm$_",(0..4));
+my @D=map("%ymm$_",(5..9));
+my ($T0,$T1,$MASK)=map("%ymm$_",(10..12));
+my ($LO,$HI)=map("%ymm$_",(13..14));
+
+sub row { my $n=shift; return 32*$n."($tbl)"; }
+
+# D = H * R, with the multipliers taken from the table rows starting at
+# $r (r0-r4) and $s (5*r1-5*r4).
+sub mul {
+	my ($r,$s)=@_;
+	my $code="";
+
+	for (my $i=0; $i<5; $i++) {
+		# d_i = sum over j of h_j * r_(i-j), wrapping with 5 * r
+		for (my $j=0; $j<5; $j++) {
+			my $k=$i-$j;
+			my $m=($k>=0) ? row($r+$k) : row($s+$k+4);
+			if ($j==0) {
+				$code.="\tvpmuludq\t$m,$H[$j],$D[$i]\n";
+			} else {
+				$code.="\tvpmuludq\t$m,$H[$j],$T0\n";
+				$code.="\tvpaddq\t$T0,$D[$i],$D[$i]\n";
+			}
+		}
+	}
+	return $code;
+}
+
+# H = D, partially reduced.
+sub carry {
+	my $code="";
+	for (my $i=0; $i<4; $i++) {
+		$code.="\tvpsrlq\t\$26,$D[$i],$T0\n";
+		$code.="\tvpand\t$MASK,$D[$i],$H[$i]\n";
+		$code.="\tvpaddq\t$T0,$D[$i+1],$D[$i+1]\n";
+	}
+	$code.="\tvpsrlq\t\$26,$D[4],$T0\n";
+	$code.="\tvpand\t$MASK,$D[4],$H[4]\n";
+	$code.="\tvpsllq\t\$2,$T0,$T1\n";
+	$code.="\tvpaddq\t$T1,$T0,$T0\n";
+	$code.="\tvpaddq\t$T0,$H[0],$H[0]\n";
+	$code.="\tvpsrlq\t\$26,$H[0],$T0\n";
+	$code.="\tvpand\t$MASK,$H[0],$H[0]\n";
+	$code.="\tvpaddq\t$T0,$H[1],$H[1]\n";
+	return $code;
+}
+
+# H += the next 64 bytes of message.
+sub load {
+	my $code=<<___;
+	vmovdqu	0($inp),$T0
+	vmovdqu	32($inp),$T1
+	lea	64($inp),$inp
+	vpunpcklqdq	$T1,$T0,$LO
+	vpunpckhqdq	$T1,$T0,$HI
+
+	vpand	$MASK,$LO,$T0
+	vpaddq	$T0,$H[0],$H[0]
+	vpsrlq	\$26,$LO,$T0
+	vpand	$MASK,$T0,$T0
+	vpaddq	$T0,$H[1],$H[1]
+	vpsrlq	\$52,$LO,$T0
+	vpsllq	\$12,$HI,$T1
+	vpor	$T1,$T0,$T0
+	vpand	$MASK,$T0,$T0
+	vpaddq	$T0,$H[2],$H[2]
+	vpsrlq	\$14,$HI,$T0
+	vpand	$MASK,$T0,$T0
+	vpaddq	$T0,$H[3],$H[3]
+	vpsrlq	\$40,$HI,$T0
+	vpor	.Lhibit(%rip),$T0,$T0
+	vpaddq	$T0,$H[4],$H[4]
+___
+	return $code;
+}
+
+$code=<<___;
+.text
+
+.globl	poly1305_blocks_avx2
+.type	poly1305_blocks_avx2,\@function,4
+.align	32
+poly1305_blocks_avx2:
+	test	$blocks,$blocks
+	jz	.Ldone
+	shr	\$2,$blocks
+	vzeroupper
+
+	vpbroadcastq	.Lmask26(%rip),$MASK
+___
+for (my $i=0; $i<5; $i++) {
+	# only lane 0 starts with the incoming accumulator
+	$code.="\tvmovq\t".(8*$i)."($hp),%xmm$i\n";
+}
+$code.=<<___;
+	jmp	.Lcheck
+
+.align	32
+.Lloop:
+___
+$code.=load();
+$code.=mul(0,5);
+$code.=carry();
+$code.=<<___;
+.Lcheck:
+	dec	$blocks
+	jnz	.Lloop
+
+___
+$code.=load();
+$code.=mul(9,14);
+$code.=carry();
+
+# Sum the lanes, then fully propagate the carries as poly1305_blocks()
+# does, using general purpose registers.
+my @h=("%r8","%r9","%r10","%r11","%rax");
+for (my $i=0; $i<5; $i++) {
+	$code.=<<___;
+	vextracti128	\$1,$H[$i],%xmm10
+	vpaddq	%xmm10,%xmm$i,%xmm$i
+	vpshufd	\$0x4e,%xmm$i,%xmm10
+	vpaddq	%xmm10,%xmm$i,%xmm$i
+	vmovq	%xmm$i,$h[$i]
+___
+}
+$code.=<<___;
+	vzeroall
+
+	mov	$h[0],%rcx
+	shr	\$26,%rcx
+	and	\$0x3ffffff,$h[0]
+	add	%rcx,$h[1]
+	mov	$h[1],%rcx
+	shr	\$26,%rcx
+	and	\$0x3ffffff,$h[1]
+	add	%rcx,$h[2]
+	mov	$h[2],%rcx
+	shr	\$26,%rcx
+	and	\$0x3ffffff,$h[2]
+	add	%rcx,$h[3]
+	mov	$h[3],%rcx
+	shr	\$26,%rcx
+	and	\$0x3ffffff,$h[3]
+	add	%rcx,$h[4]
+	mov	$h[4],%rcx
+	shr	\$26,%rcx
+	and	\$0x3ffffff,$h[4]
+	lea	(%rcx,%rcx,4),%rcx
+	add	%rcx,$h[0]
+	mov	$h[0],%rcx
+	shr	\$26,%rcx
+	and	\$0x3ffffff,$h[0]
+	add	%rcx,$h[1]
+
+	mov	$h[0],0($hp)
+	mov	$h[1],8($hp)
+	mov	$h[2],16($hp)
+	mov	$h[3],24($hp)
+	mov	$h[4],32($hp)
+.Ldone:
+	ret
+.size	poly1305_blocks_avx2,.-poly1305_blocks_avx2
+
+.align	32
+.Lhibit:
+	.quad	0x1000000,0x1000000,0x1000000,0x1000000
+.Lmask26:
+	.quad	0x3ffffff
+___
+
+print $code;
+close STDOUT;
@@ -31,6 +31,13 @@ typedef struct poly1305_state_internal_t {
 	unsigned char final;
 } poly1305_state_internal_t;
 
+#ifdef POLY1305_ASM
+#define POLY1305_SIMD_MIN	256
+
+static size_t poly1305_blocks_simd(poly1305_state_internal_t *st,
+    const unsigned char *m, size_t bytes);
+#endif
+
 /* interpret four 8 bit unsigned integers as a 32 bit unsigned integer in little endian */
 static unsigned long
 U8TO32(const unsigned char *p)
@@ -195,6 +202,15 @@ poly1305_update(poly1305_context *ctx, const unsigned char *m, size_t bytes)
 		st->leftover = 0;
 	}
 
+#ifdef POLY1305_ASM
+	/* process as many blocks as possible with the vector code */
+	if (bytes >= POLY1305_SIMD_MIN) {
+		size_t want = poly1305_blocks_simd(st, m, bytes);
+		m += want;
+		bytes -= want;
+	}
+#endif
+
 	/* process full blocks */
 	if (bytes >= poly1305_block_size) {
 		size_t want = (bytes & ~(poly1305_block_size - 1));
@@ -18,6 +18,98 @@
 #include <openssl/poly1305.h>
 #include "poly1305-donna.c"
 
+#ifdef POLY1305_ASM
+#include <stdint.h>
+#include <string.h>
+
+#include <openssl/crypto.h>
+
+#include "cryptlib.h"
+#include "x86_arch.h"
+
+void poly1305_blocks_avx2(unsigned long h[5], const unsigned char *m,
+    size_t blocks, const unsigned int table[18][8]);
+
+/* out = a * b, partially reduced modulo 2^130 - 5, in radix 2^26. */
+static void
+poly1305_mul(uint32_t out[5], const uint32_t a[5], const uint32_t b[5])
+{
+	uint64_t d[5], c;
+	uint32_t s[5];
+	int i, j;
+
+	for (i = 1; i < 5; i++)
+		s[i] = b[i] * 5;
+
+	for (i = 0; i < 5; i++) {
+		d[i] = 0;
+		for (j = 0; j <= i; j++)
+			d[i] += (uint64_t)a[j] * b[i - j];
+		for (; j < 5; j++)
+			d[i] += (uint64_t)a[j] * s[i - j + 5];
+	}
+
+	for (i = 0; i < 4; i++) {
+		c = d[i] >> 26;
+		out[i] = d[i] & 0x3ffffff;
+		d[i + 1] += c;
+	}
+	c = d[4] >> 26;
+	out[4] = d[4] & 0x3ffffff;
+	c = out[0] + c * 5;
+	out[0] = c & 0x3ffffff;
+	out[1] += c >> 26;
+}
+
+/*
+ * Process as many 64 byte chunks as possible using the vector code and
+ * return the number of bytes consumed.
+ */
+static size_t
+poly1305_blocks_simd(poly1305_state_internal_t *st, const unsigned char *m,
+    size_t bytes)
+{
+	/* Lanes hold blocks 0, 2, 1 and 3, hence r^4, r^2, r^3 and r. */
+	static const int lane_power[4] = { 3, 1, 2, 0 };
+	unsigned int table[18][8];
+	uint32_t r[4][5];
+	size_t blocks;
+	int i, j;
+
+	if ((OPENSSL_cpu_caps_ext() & IA32CAP_EXT_MASK_AVX2) == 0)
+		return 0;
+
+	blocks = (bytes / 64) * 4;
+
+	for (i = 0; i < 5; i++)
+		r[0][i] = st->r[i];
+	poly1305_mul(r[1], r[0], r[0]);
+	poly1305_mul(r[2], r[1], r[0]);
+	poly1305_mul(r[3], r[1], r[1]);
+
+	memset(table, 0, sizeof(table));
+	for (i = 0; i < 5; i++) {
+		for (j = 0; j < 8; j++)
+			table[i][j] = r[3][i];
+		for (j = 0; j < 4; j++)
+			table[9 + i][2 * j] = r[lane_power[j]][i];
+	}
+	for (i = 1; i < 5; i++) {
+		for (j = 0; j < 8; j++) {
+			table[4 + i][j] = table[i][j] * 5;
+			table[13 + i][j] = table[9 + i][j] * 5;
+		}
+	}
+
+	poly1305_blocks_avx2(st->h, m, blocks, table);
+
+	explicit_bzero(table, sizeof(table));
+	explicit_bzero(r, sizeof(r));
+
+	return blocks * poly1305_block_size;
+}
+#endif
+
 void
 CRYPTO_poly1305_init(poly1305_context *ctx, const unsigned char key[32])
 {
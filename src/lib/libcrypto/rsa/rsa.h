@@ -151,6 +151,8 @@ struct rsa_st {
 	 * NULL */
 	BN_BLINDING *blinding;
 	BN_BLINDING *mt_blinding;
+	/* blindings lent to threads other than blinding's owner */
+	struct rsa_thread_blinding *thread_blinding;
 };
 
 #ifndef OPENSSL_RSA_MAX_MODULUS_BITS
@@ -60,9 +60,49 @@
 
 #include <openssl/asn1t.h>
 #include <openssl/bn.h>
+#include <openssl/crypto.h>
+#include <openssl/err.h>
 #include <openssl/rsa.h>
 #include <openssl/x509.h>
 
+#include "bn_lcl.h"
+#include "rsa_locl.h"
+
+/*
+ * Build the Montgomery context for n as soon as a key is decoded, so that
+ * the public key operations never have to create it or take the RSA lock
+ * to read it. A failure here is not fatal, the context is then made on
+ * first use, under the lock.
+ */
+static void
+rsa_set_mont_n(RSA *rsa)
+{
+	BN_CTX *ctx;
+
+	BN_MONT_CTX_free(rsa->_method_mod_n);
+	rsa->_method_mod_n = NULL;
+	rsa->flags &= ~RSA_FLAG_MONT_N_DECODED;
+
+	if ((rsa->flags & RSA_FLAG_CACHE_PUBLIC) == 0 || rsa->n == NULL ||
+	    !BN_is_odd(rsa->n) ||
+	    BN_num_bits(rsa->n) > OPENSSL_RSA_MAX_MODULUS_BITS)
+		return;
+	if ((ctx = bn_ctx_cache_get()) == NULL)
+		return;
+
+	ERR_set_mark();
+	if ((rsa->_method_mod_n = BN_MONT_CTX_new()) != NULL &&
+	    !BN_MONT_CTX_set(rsa->_method_mod_n, rsa->n, ctx)) {
+		BN_MONT_CTX_free(rsa->_method_mod_n);
+		rsa->_method_mod_n = NULL;
+	}
+	if (rsa->_method_mod_n != NULL)
+		rsa->flags |= RSA_FLAG_MONT_N_DECODED;
+	ERR_pop_to_mark();
+
+	bn_ctx_cache_put(ctx);
+}
+
 /* Override the default free and new methods */
 static int
 rsa_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it, void *exarg)
@@ -76,6 +116,8 @@ rsa_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it, void *exarg)
 		RSA_free((RSA *)*pval);
 		*pval = NULL;
 		return 2;
+	} else if (operation == ASN1_OP_D2I_POST) {
+		rsa_set_mont_n((RSA *)*pval);
 	}
 	return 1;
 }
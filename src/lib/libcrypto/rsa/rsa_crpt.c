@@ -57,6 +57,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <openssl/opensslconf.h>
 
@@ -67,6 +68,7 @@
 #include <openssl/rsa.h>
 
 #include "bn_lcl.h"
+#include "rsa_locl.h"
 
 #ifndef OPENSSL_NO_ENGINE
 #include <openssl/engine.h>
@@ -117,6 +119,7 @@ RSA_blinding_off(RSA *rsa)
 {
 	BN_BLINDING_free(rsa->blinding);
 	rsa->blinding = NULL;
+	rsa_thread_blinding_free(rsa);
 	rsa->flags |= RSA_FLAG_NO_BLINDING;
 }
 
@@ -168,6 +171,19 @@ err:
 	return ret;
 }
 
+void
+rsa_thread_blinding_free(RSA *rsa)
+{
+	int i;
+
+	if (rsa->thread_blinding == NULL)
+		return;
+	for (i = 0; i < RSA_THREAD_BLINDING_SLOTS; i++)
+		BN_BLINDING_free(rsa->thread_blinding[i].blinding);
+	free(rsa->thread_blinding);
+	rsa->thread_blinding = NULL;
+}
+
 BN_BLINDING *
 RSA_setup_blinding(RSA *rsa, BN_CTX *in_ctx)
 {
@@ -110,6 +110,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <openssl/opensslconf.h>
@@ -119,7 +120,10 @@
 #include <openssl/rsa.h>
 
 #include "bn_lcl.h"
+#include "rsa_locl.h"
 
+static int RSA_eay_public_mod_exp(BIGNUM *r, const BIGNUM *f, RSA *rsa,
+    BN_CTX *ctx);
 static int RSA_eay_public_encrypt(int flen, const unsigned char *from,
     unsigned char *to, RSA *rsa, int padding);
 static int RSA_eay_private_encrypt(int flen, const unsigned char *from,
@@ -150,6 +154,62 @@ RSA_PKCS1_SSLeay(void)
 	return &rsa_pkcs1_eay_meth;
 }
 
+/*
+ * The Montgomery context for n. One built when the key was decoded is read
+ * directly; one built on first use is only read through
+ * BN_MONT_CTX_set_locked(), as another thread may be setting it up.
+ */
+static BN_MONT_CTX *
+rsa_mont_n(RSA *rsa, BN_CTX *ctx)
+{
+	if ((rsa->flags & RSA_FLAG_MONT_N_DECODED) != 0)
+		return rsa->_method_mod_n;
+	return BN_MONT_CTX_set_locked(&rsa->_method_mod_n, CRYPTO_LOCK_RSA,
+	    rsa->n, ctx);
+}
+
+/*
+ * r = f^e mod n for the public operations. The exponent is public, so the
+ * usual e = 65537 is done with a fixed chain of sixteen squarings and one
+ * multiplication instead of a constant time exponentiation.
+ */
+static int
+RSA_eay_public_mod_exp(BIGNUM *r, const BIGNUM *f, RSA *rsa, BN_CTX *ctx)
+{
+	BN_MONT_CTX *mont;
+	BIGNUM *a;
+	int i, ret = 0;
+
+	mont = NULL;
+	if ((rsa->flags & RSA_FLAG_CACHE_PUBLIC) != 0) {
+		if ((mont = rsa_mont_n(rsa, ctx)) == NULL)
+			return 0;
+	}
+
+	if (mont == NULL || !BN_is_word(rsa->e, RSA_F4) ||
+	    (rsa->meth->bn_mod_exp != BN_mod_exp_mont_ct &&
+	    rsa->meth->bn_mod_exp != BN_mod_exp_mont_nonct))
+		return rsa->meth->bn_mod_exp(r, f, rsa->e, rsa->n, ctx, mont);
+
+	BN_CTX_start(ctx);
+	if ((a = BN_CTX_get(ctx)) == NULL)
+		goto err;
+	if (!BN_to_montgomery(a, f, mont, ctx))
+		goto err;
+	for (i = 0; i < 16; i++) {
+		if (!BN_mod_mul_montgomery(a, a, a, mont, ctx))
+			goto err;
+	}
+	/* Multiplying by f outside Montgomery form also converts back. */
+	if (!BN_mod_mul_montgomery(r, a, f, mont, ctx))
+		goto err;
+	ret = 1;
+
+ err:
+	BN_CTX_end(ctx);
+	return ret;
+}
+
 static int
 RSA_eay_public_encrypt(int flen, const unsigned char *from, unsigned char *to,
     RSA *rsa, int padding)
@@ -177,7 +237,7 @@ RSA_eay_public_encrypt(int flen, const unsigned char *from, unsigned char *to,
 		}
 	}
 
-	if ((ctx = BN_CTX_new()) == NULL)
+	if ((ctx = bn_ctx_cache_get()) == NULL)
 		goto err;
 
 	BN_CTX_start(ctx);
@@ -219,13 +279,7 @@ RSA_eay_public_encrypt(int flen, const unsigned char *from, unsigned char *to,
 		goto err;
 	}
 
-	if (rsa->flags & RSA_FLAG_CACHE_PUBLIC)
-		if (!BN_MONT_CTX_set_locked(&rsa->_method_mod_n,
-		    CRYPTO_LOCK_RSA, rsa->n, ctx))
-			goto err;
-
-	if (!rsa->meth->bn_mod_exp(ret, f, rsa->e, rsa->n, ctx,
-	    rsa->_method_mod_n))
+	if (!RSA_eay_public_mod_exp(ret, f, rsa, ctx))
 		goto err;
 
 	/* put in leading 0 bytes if the number is less than the
@@ -239,66 +293,154 @@ RSA_eay_public_encrypt(int flen, const unsigned char *from, unsigned char *to,
 err:
 	if (ctx != NULL) {
 		BN_CTX_end(ctx);
-		BN_CTX_free(ctx);
+		bn_ctx_cache_put(ctx);
 	}
 	freezero(buf, num);
 	return r;
 }
 
-static BN_BLINDING *
-rsa_get_blinding(RSA *rsa, int *local, BN_CTX *ctx)
+/*
+ * Claim a free slot of the per-thread blinding table. Probing starts from a
+ * hash of the thread id, so a thread normally gets back the slot, and the
+ * BN_BLINDING, that it used last time. A slot is held only for the length
+ * of one private key operation, so threads that exit leave nothing behind
+ * and thread churn cannot use up the table. Returns NULL if every slot is
+ * busy.
+ */
+static struct rsa_thread_blinding *
+rsa_thread_blinding_claim(struct rsa_thread_blinding *table,
+    CRYPTO_THREADID *cur)
 {
-	BN_BLINDING *ret;
-	int got_write_lock = 0;
-	CRYPTO_THREADID cur;
+	struct rsa_thread_blinding *slot;
+	unsigned long h, x;
+	int i;
+
+	/* Thread ids are often aligned addresses, so fold in every bit. */
+	h = CRYPTO_THREADID_hash(cur);
+	for (x = h >> RSA_THREAD_BLINDING_BITS; x != 0;
+	    x >>= RSA_THREAD_BLINDING_BITS)
+		h ^= x;
+
+	for (i = 0; i < RSA_THREAD_BLINDING_SLOTS; i++) {
+		slot = &table[(h + i) & (RSA_THREAD_BLINDING_SLOTS - 1)];
+		if (!slot->busy &&
+		    __sync_bool_compare_and_swap(&slot->busy, 0, 1))
+			return slot;
+	}
+	return NULL;
+}
 
-	CRYPTO_r_lock(CRYPTO_LOCK_RSA);
+static void
+rsa_thread_blinding_release(struct rsa_thread_blinding *slot)
+{
+	if (slot != NULL)
+		__sync_lock_release(&slot->busy);
+}
 
-	if (rsa->blinding == NULL) {
-		CRYPTO_r_unlock(CRYPTO_LOCK_RSA);
-		CRYPTO_w_lock(CRYPTO_LOCK_RSA);
-		got_write_lock = 1;
+/*
+ * Set *p to v under the write lock unless another thread got there first.
+ * v is complete before the store, so the lock free readers in
+ * rsa_get_blinding() may use whatever they load after a barrier. Returns
+ * the value that ends up in *p.
+ */
+static void *
+rsa_blinding_publish(void **p, void *v, void (*free_fn)(void *))
+{
+	void *ret;
 
-		if (rsa->blinding == NULL)
-			rsa->blinding = RSA_setup_blinding(rsa, ctx);
+	CRYPTO_w_lock(CRYPTO_LOCK_RSA);
+	if ((ret = *p) == NULL) {
+		__sync_synchronize();
+		*p = ret = v;
+		v = NULL;
 	}
+	CRYPTO_w_unlock(CRYPTO_LOCK_RSA);
+
+	if (v != NULL)
+		free_fn(v);
+	return ret;
+}
+
+static void
+rsa_blinding_free_cb(void *b)
+{
+	BN_BLINDING_free(b);
+}
+
+/*
+ * The first thread to use the key owns rsa->blinding. Every other thread
+ * borrows a BN_BLINDING from rsa->thread_blinding for the length of one
+ * operation and gives it back with rsa_thread_blinding_release(). Only
+ * when every slot is busy do threads share rsa->mt_blinding, whose use is
+ * serialised by CRYPTO_LOCK_RSA_BLINDING.
+ *
+ * rsa->blinding, rsa->thread_blinding and rsa->mt_blinding are each set
+ * once and then only read, so once they exist no lock is taken here.
+ */
+static BN_BLINDING *
+rsa_get_blinding(RSA *rsa, struct rsa_thread_blinding **slot, int *local,
+    BN_CTX *ctx)
+{
+	struct rsa_thread_blinding *table;
+	BN_BLINDING *ret;
+	CRYPTO_THREADID cur;
+
+	*slot = NULL;
 
 	ret = rsa->blinding;
-	if (ret == NULL)
-		goto err;
+	__sync_synchronize();
+	if (ret == NULL) {
+		if ((ret = RSA_setup_blinding(rsa, ctx)) == NULL)
+			return NULL;
+		ret = rsa_blinding_publish((void **)&rsa->blinding, ret,
+		    rsa_blinding_free_cb);
+	}
 
 	CRYPTO_THREADID_current(&cur);
 	if (!CRYPTO_THREADID_cmp(&cur, BN_BLINDING_thread_id(ret))) {
 		/* rsa->blinding is ours! */
 		*local = 1;
-	} else {
-		/* resort to rsa->mt_blinding instead */
-		/*
-		 * Instruct rsa_blinding_convert(), rsa_blinding_invert()
-		 * that the BN_BLINDING is shared, meaning that accesses
-		 * require locks, and that the blinding factor must be
-		 * stored outside the BN_BLINDING
-		 */
-		*local = 0;
-
-		if (rsa->mt_blinding == NULL) {
-			if (!got_write_lock) {
-				CRYPTO_r_unlock(CRYPTO_LOCK_RSA);
-				CRYPTO_w_lock(CRYPTO_LOCK_RSA);
-				got_write_lock = 1;
-			}
+		return ret;
+	}
 
-			if (rsa->mt_blinding == NULL)
-				rsa->mt_blinding = RSA_setup_blinding(rsa, ctx);
+	table = rsa->thread_blinding;
+	__sync_synchronize();
+	if (table == NULL) {
+		if ((table = calloc(RSA_THREAD_BLINDING_SLOTS,
+		    sizeof(*table))) != NULL)
+			table = rsa_blinding_publish(
+			    (void **)&rsa->thread_blinding, table, free);
+	}
+	if (table != NULL &&
+	    (*slot = rsa_thread_blinding_claim(table, &cur)) != NULL) {
+		/* Only the holder of the slot touches its blinding. */
+		if ((*slot)->blinding == NULL &&
+		    ((*slot)->blinding = RSA_setup_blinding(rsa, ctx)) == NULL) {
+			rsa_thread_blinding_release(*slot);
+			*slot = NULL;
+			return NULL;
 		}
-		ret = rsa->mt_blinding;
+		*local = 1;
+		return (*slot)->blinding;
 	}
 
-err:
-	if (got_write_lock)
-		CRYPTO_w_unlock(CRYPTO_LOCK_RSA);
-	else
-		CRYPTO_r_unlock(CRYPTO_LOCK_RSA);
+	/* resort to rsa->mt_blinding instead */
+	/*
+	 * Instruct rsa_blinding_convert(), rsa_blinding_invert()
+	 * that the BN_BLINDING is shared, meaning that accesses
+	 * require locks, and that the blinding factor must be
+	 * stored outside the BN_BLINDING
+	 */
+	*local = 0;
+
+	ret = rsa->mt_blinding;
+	__sync_synchronize();
+	if (ret == NULL) {
+		if ((ret = RSA_setup_blinding(rsa, ctx)) == NULL)
+			return NULL;
+		ret = rsa_blinding_publish((void **)&rsa->mt_blinding, ret,
+		    rsa_blinding_free_cb);
+	}
 	return ret;
 }
 
@@ -355,8 +497,9 @@ RSA_eay_private_encrypt(int flen, const unsigned char *from, unsigned char *to,
 	 */
 	BIGNUM *unblind = NULL;
 	BN_BLINDING *blinding = NULL;
+	struct rsa_thread_blinding *slot = NULL;
 
-	if ((ctx = BN_CTX_new()) == NULL)
+	if ((ctx = bn_ctx_cache_get()) == NULL)
 		goto err;
 
 	BN_CTX_start(ctx);
@@ -397,7 +540,7 @@ RSA_eay_private_encrypt(int flen, const unsigned char *from, unsigned char *to,
 	}
 
 	if (!(rsa->flags & RSA_FLAG_NO_BLINDING)) {
-		blinding = rsa_get_blinding(rsa, &local_blinding, ctx);
+		blinding = rsa_get_blinding(rsa, &slot, &local_blinding, ctx);
 		if (blinding == NULL) {
 			RSAerror(ERR_R_INTERNAL_ERROR);
 			goto err;
@@ -425,8 +568,7 @@ RSA_eay_private_encrypt(int flen, const unsigned char *from, unsigned char *to,
 		BN_with_flags(&d, rsa->d, BN_FLG_CONSTTIME);
 
 		if (rsa->flags & RSA_FLAG_CACHE_PUBLIC)
-			if (!BN_MONT_CTX_set_locked(&rsa->_method_mod_n,
-			    CRYPTO_LOCK_RSA, rsa->n, ctx))
+			if (rsa_mont_n(rsa, ctx) == NULL)
 				goto err;
 
 		if (!rsa->meth->bn_mod_exp(ret, f, &d, rsa->n, ctx,
@@ -457,9 +599,10 @@ RSA_eay_private_encrypt(int flen, const unsigned char *from, unsigned char *to,
 
 	r = num;
 err:
+	rsa_thread_blinding_release(slot);
 	if (ctx != NULL) {
 		BN_CTX_end(ctx);
-		BN_CTX_free(ctx);
+		bn_ctx_cache_put(ctx);
 	}
 	freezero(buf, num);
 	return r;
@@ -482,8 +625,9 @@ RSA_eay_private_decrypt(int flen, const unsigned char *from, unsigned char *to,
 	 */
 	BIGNUM *unblind = NULL;
 	BN_BLINDING *blinding = NULL;
+	struct rsa_thread_blinding *slot = NULL;
 
-	if ((ctx = BN_CTX_new()) == NULL)
+	if ((ctx = bn_ctx_cache_get()) == NULL)
 		goto err;
 
 	BN_CTX_start(ctx);
@@ -514,7 +658,7 @@ RSA_eay_private_decrypt(int flen, const unsigned char *from, unsigned char *to,
 	}
 
 	if (!(rsa->flags & RSA_FLAG_NO_BLINDING)) {
-		blinding = rsa_get_blinding(rsa, &local_blinding, ctx);
+		blinding = rsa_get_blinding(rsa, &slot, &local_blinding, ctx);
 		if (blinding == NULL) {
 			RSAerror(ERR_R_INTERNAL_ERROR);
 			goto err;
@@ -543,8 +687,7 @@ RSA_eay_private_decrypt(int flen, const unsigned char *from, unsigned char *to,
 		BN_with_flags(&d, rsa->d, BN_FLG_CONSTTIME);
 
 		if (rsa->flags & RSA_FLAG_CACHE_PUBLIC)
-			if (!BN_MONT_CTX_set_locked(&rsa->_method_mod_n,
-			    CRYPTO_LOCK_RSA, rsa->n, ctx))
+			if (rsa_mont_n(rsa, ctx) == NULL)
 				goto err;
 
 		if (!rsa->meth->bn_mod_exp(ret, f, &d, rsa->n, ctx,
@@ -580,9 +723,10 @@ RSA_eay_private_decrypt(int flen, const unsigned char *from, unsigned char *to,
 		RSAerror(RSA_R_PADDING_CHECK_FAILED);
 
 err:
+	rsa_thread_blinding_release(slot);
 	if (ctx != NULL) {
 		BN_CTX_end(ctx);
-		BN_CTX_free(ctx);
+		bn_ctx_cache_put(ctx);
 	}
 	freezero(buf, num);
 	return r;
@@ -617,7 +761,7 @@ RSA_eay_public_decrypt(int flen, const unsigned char *from, unsigned char *to,
 		}
 	}
 
-	if ((ctx = BN_CTX_new()) == NULL)
+	if ((ctx = bn_ctx_cache_get()) == NULL)
 		goto err;
 
 	BN_CTX_start(ctx);
@@ -646,13 +790,7 @@ RSA_eay_public_decrypt(int flen, const unsigned char *from, unsigned char *to,
 		goto err;
 	}
 
-	if (rsa->flags & RSA_FLAG_CACHE_PUBLIC)
-		if (!BN_MONT_CTX_set_locked(&rsa->_method_mod_n,
-		    CRYPTO_LOCK_RSA, rsa->n, ctx))
-			goto err;
-
-	if (!rsa->meth->bn_mod_exp(ret, f, rsa->e, rsa->n, ctx,
-	    rsa->_method_mod_n))
+	if (!RSA_eay_public_mod_exp(ret, f, rsa, ctx))
 		goto err;
 
 	if (padding == RSA_X931_PADDING && (ret->d[0] & 0xf) != 12)
@@ -682,7 +820,7 @@ RSA_eay_public_decrypt(int flen, const unsigned char *from, unsigned char *to,
 err:
 	if (ctx != NULL) {
 		BN_CTX_end(ctx);
-		BN_CTX_free(ctx);
+		bn_ctx_cache_put(ctx);
 	}
 	freezero(buf, num);
 	return r;
@@ -727,8 +865,7 @@ RSA_eay_mod_exp(BIGNUM *r0, const BIGNUM *I, RSA *rsa, BN_CTX *ctx)
 	}
 
 	if (rsa->flags & RSA_FLAG_CACHE_PUBLIC)
-		if (!BN_MONT_CTX_set_locked(&rsa->_method_mod_n,
-		    CRYPTO_LOCK_RSA, rsa->n, ctx))
+		if (rsa_mont_n(rsa, ctx) == NULL)
 			goto err;
 
 	/* compute I mod q */
@@ -70,6 +70,8 @@
 #include <openssl/engine.h>
 #endif
 
+#include "rsa_locl.h"
+
 static const RSA_METHOD *default_RSA_meth = NULL;
 
 RSA *
@@ -174,6 +176,7 @@ RSA_new_method(ENGINE *engine)
 	ret->_method_mod_q = NULL;
 	ret->blinding = NULL;
 	ret->mt_blinding = NULL;
+	ret->thread_blinding = NULL;
 	ret->flags = ret->meth->flags & ~RSA_FLAG_NON_FIPS_ALLOW;
 	if (!CRYPTO_new_ex_data(CRYPTO_EX_INDEX_RSA, ret, &ret->ex_data)) {
 #ifndef OPENSSL_NO_ENGINE
@@ -227,6 +230,7 @@ RSA_free(RSA *r)
 	BN_clear_free(r->iqmp);
 	BN_BLINDING_free(r->blinding);
 	BN_BLINDING_free(r->mt_blinding);
+	rsa_thread_blinding_free(r);
 	free(r);
 }
 
@@ -2,6 +2,24 @@
 
 __BEGIN_HIDDEN_DECLS
 
+/* Size of the per-thread blinding table, see rsa_get_blinding(). */
+#define RSA_THREAD_BLINDING_BITS	6
+#define RSA_THREAD_BLINDING_SLOTS	(1 << RSA_THREAD_BLINDING_BITS)
+
+/*
+ * Set when rsa->_method_mod_n was built as the key was decoded. The key
+ * could not be shared yet, so the context may be read without a lock.
+ */
+#define RSA_FLAG_MONT_N_DECODED	0x40000000
+
+/* A slot of rsa->thread_blinding, held by one thread at a time. */
+struct rsa_thread_blinding {
+	BN_BLINDING *blinding;
+	volatile int busy;
+};
+
+void rsa_thread_blinding_free(RSA *rsa);
+
 extern int int_rsa_verify(int dtype, const unsigned char *m,
     unsigned int m_len, unsigned char *rm, size_t *prm_len,
     const unsigned char *sigbuf, size_t siglen, RSA *rsa);
@@ -0,0 +1,337 @@
+#!/usr/bin/env perl
+# $OpenBSD$
+#
+# Copyright (c) 2026 The LibreSSL project.
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+# Multi-buffer SHA-256 block functions.
+#
+# void sha256_multi_block_ssse3(SHA_LONG h[8][4],
+#     const unsigned char *inp[4], const unsigned int num[4]);
+# void sha256_multi_block_avx2(SHA_LONG h[8][8],
+#     const unsigned char *inp[8], const unsigned int num[8]);
+#
+# Each 32-bit lane of the xmm (ymm) registers hashes a different message,
+# so four (eight) independent messages are processed at once. The state is
+# kept transposed, h[i][lane] holding word i of the hash of each lane.
+# Lane n processes num[n] consecutive blocks starting at inp[n]; once its
+# blocks are used up, a lane reads the round constants instead of input
+# and its state is left alone. Padding is left to the caller.
+#
+# There are no vector rotates, so each rotate is two shifts and the
+# message schedule is computed on the fly, sixteen words at a time being
+# kept on the stack.
+
+$flavour = shift;
+$output  = shift;
+if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+open OUT,"| \"$^X\" $xlate $flavour $output";
+*STDOUT=*OUT;
+
+@Sigma0=( 2,13,22);
+@Sigma1=( 6,11,25);
+@sigma0=( 7,18, 3);
+@sigma1=(17,19,10);
+
+($ctx,$inp,$num)=("%rdi","%rsi","%rdx");
+$Tbl="%rbp";
+$blocks="%eax";
+
+my ($avx,$lanes,$REG,$code);
+
+# Three operand instructions; the SSE versions copy the first source to
+# the destination first, unless the operation commutes and the
+# destination already holds the second source.
+sub op3 {
+	my ($op,$src2,$src1,$dst)=@_;
+	my %commutes=map { $_ => 1 } qw(paddd pand pxor por);
+
+	if ($avx) {
+		$code.="\tv$op\t$src2,$src1,$dst\n";
+	} elsif ($dst eq $src1) {
+		$code.="\t$op\t$src2,$dst\n";
+	} elsif ($dst eq $src2 && $commutes{$op}) {
+		$code.="\t$op\t$src1,$dst\n";
+	} else {
+		die "$op: destination $dst is also a source" if ($dst eq $src2);
+		$code.="\tmovdqa\t$src1,$dst\n\t$op\t$src2,$dst\n";
+	}
+}
+
+sub shift3 {
+	my ($op,$n,$src,$dst)=@_;
+
+	if ($avx) {
+		$code.="\tv$op\t\$$n,$src,$dst\n";
+	} else {
+		$code.="\tmovdqa\t$src,$dst\n" if ($src ne $dst);
+		$code.="\t$op\t\$$n,$dst\n";
+	}
+}
+
+sub mov3 {
+	my ($src,$dst)=@_;
+	$code.=($avx ? "\tvmovdqa" : "\tmovdqa")."\t$src,$dst\n";
+}
+
+sub movu3 {
+	my ($src,$dst)=@_;
+	$code.=($avx ? "\tvmovdqu" : "\tmovdqu")."\t$src,$dst\n";
+}
+
+# $acc = ROTR($x,$r[0]) ^ ROTR($x,$r[1]) ^ ROTR($x,$r[2]), or with SHR for
+# the last term if $shr is set.
+sub rotxor {
+	my ($x,$acc,$t,$shr,@r)=@_;
+
+	&shift3("psrld",$r[0],$x,$acc);
+	&shift3("pslld",32-$r[0],$x,$t);
+	&op3("pxor",$t,$acc,$acc);
+	&shift3("psrld",$r[1],$x,$t);
+	&op3("pxor",$t,$acc,$acc);
+	&shift3("pslld",32-$r[1],$x,$t);
+	&op3("pxor",$t,$acc,$acc);
+	&shift3("psrld",$r[2],$x,$t);
+	&op3("pxor",$t,$acc,$acc);
+	if (!$shr) {
+		&shift3("pslld",32-$r[2],$x,$t);
+		&op3("pxor",$t,$acc,$acc);
+	}
+}
+
+sub Wslot { my $i=shift; return ($REG*($i&15))."(%rsp)"; }
+
+sub ROUND {
+	my ($i,$a,$b,$c,$d,$e,$f,$g,$h)=@_;
+
+	if ($i>=16) {
+		# W[i] = sigma1(W[i-2]) + W[i-7] + sigma0(W[i-15]) + W[i-16]
+		&mov3(&Wslot($i+1),$W);
+		&rotxor($W,$t1,$t2,1,@sigma0);
+		&mov3(&Wslot($i+14),$W);
+		&rotxor($W,$t2,$ab,1,@sigma1);
+		&op3("paddd",$t2,$t1,$W);
+		&op3("paddd",&Wslot($i+9),$W,$W);
+		&op3("paddd",&Wslot($i),$W,$W);
+		&mov3($W,&Wslot($i));
+	} else {
+		&mov3(&Wslot($i),$W);
+	}
+
+	&op3("paddd",$W,$h,$h);
+	&op3("paddd",($i*32)."($Tbl)",$h,$h);	# h+=W[i]+K[i]
+	&rotxor($e,$t1,$t2,0,@Sigma1);
+	&op3("paddd",$t1,$h,$h);		# h+=Sigma1(e)
+	&op3("pand",$f,$e,$t1);
+	&op3("pandn",$g,$e,$t2);
+	&op3("pxor",$t2,$t1,$t1);		# Ch(e,f,g)
+	&op3("paddd",$t1,$h,$h);
+	&op3("paddd",$h,$d,$d);			# d+=T1
+	&rotxor($a,$t1,$t2,0,@Sigma0);
+	&op3("paddd",$t1,$h,$h);		# h+=Sigma0(a)
+	&op3("pxor",$b,$a,$ab);			# a^b, b^c in next round
+	&op3("pand",$ab,$bc,$bc);
+	&op3("pxor",$b,$bc,$bc);		# Maj(a,b,c)
+	&op3("paddd",$bc,$h,$h);
+
+	($ab,$bc)=($bc,$ab);
+}
+
+sub multi_block {
+	my $func=shift;
+	my $x=$avx ? "%ymm" : "%xmm";
+	my @ptr=map("%r$_",(8..(8+$lanes-1)));
+	my $wfrm=16*$REG;
+	my ($_cnt,$_rsp)=("$wfrm(%rsp)","$wfrm+$REG(%rsp)");
+	my @V=map("$x$_",(0..7));
+	my ($A,$B,$C,$D,$E,$F,$G,$H)=@V;
+	my $BSWAP="${x}15";
+	my $i;
+
+	($ab,$bc,$W,$t1,$t2)=map("$x$_",(8..12));
+
+	$code.=<<___;
+.globl	$func
+.type	$func,\@function,3
+.align	32
+$func:
+	push	%rbx
+	push	%rbp
+	push	%r12
+	push	%r13
+	push	%r14
+	push	%r15
+	mov	%rsp,%r11
+	sub	\$`$wfrm+2*$REG`,%rsp
+	and	\$-64,%rsp
+	mov	%r11,$_rsp		# save copy of %rsp
+
+	lea	K256_mb(%rip),$Tbl
+	xor	$blocks,$blocks
+___
+	for ($i=0; $i<$lanes; $i++) {
+		$code.=<<___;
+	mov	`8*$i`($inp),$ptr[$i]
+	mov	`4*$i`($num),%ecx
+	mov	%ecx,$wfrm+`4*$i`(%rsp)
+	cmp	%ecx,$blocks
+	cmovb	%ecx,$blocks		# find maximum
+___
+	}
+	$code.=<<___;
+	test	$blocks,$blocks
+	jz	.Ldone$func
+___
+	$code.=$avx ?
+	    "\tvbroadcasti128\t.Lbswap_mb(%rip),$BSWAP\n" :
+	    "\tmovdqa\t.Lbswap_mb(%rip),$BSWAP\n";
+	$code.=<<___;
+
+.align	32
+.Loop$func:
+___
+	for ($i=0; $i<$lanes; $i++) {
+		$code.=<<___;
+	cmpl	\$0,$wfrm+`4*$i`(%rsp)
+	cmovle	$Tbl,$ptr[$i]		# lane is done, read K256_mb instead
+___
+	}
+
+	# Load and transpose the block of each lane, four words at a time.
+	# With AVX2 lanes 4 to 7 go in the upper halves.
+	for (my $j=0; $j<4; $j++) {
+		for ($i=0; $i<4; $i++) {
+			if ($avx) {
+				$code.=<<___;
+	vmovdqu	`16*$j`($ptr[$i]),%xmm$i
+	vinserti128	\$1,`16*$j`($ptr[$i+4]),$V[$i],$V[$i]
+___
+			} else {
+				$code.="\tmovdqu\t".(16*$j)."($ptr[$i]),$V[$i]\n";
+			}
+		}
+		&op3("punpckldq",$V[1],$V[0],$V[4]);
+		&op3("punpckhdq",$V[1],$V[0],$V[5]);
+		&op3("punpckldq",$V[3],$V[2],$V[6]);
+		&op3("punpckhdq",$V[3],$V[2],$V[7]);
+		&op3("punpcklqdq",$V[6],$V[4],$V[0]);
+		&op3("punpckhqdq",$V[6],$V[4],$V[1]);
+		&op3("punpcklqdq",$V[7],$V[5],$V[2]);
+		&op3("punpckhqdq",$V[7],$V[5],$V[3]);
+		for ($i=0; $i<4; $i++) {
+			&op3("pshufb",$BSWAP,$V[$i],$V[$i]);
+			&mov3($V[$i],&Wslot(4*$j+$i));
+		}
+	}
+	for ($i=0; $i<$lanes; $i++) {
+		$code.="\tlea\t64($ptr[$i]),$ptr[$i]\n";
+	}
+
+	for ($i=0; $i<8; $i++) {
+		&movu3(($REG*$i)."($ctx)",$V[$i]);
+	}
+	&op3("pxor",$C,$B,$bc);
+
+	my @ROT=@V;
+	for ($i=0; $i<64; $i++) {
+		&ROUND($i,@ROT);
+		unshift(@ROT,pop(@ROT));
+	}
+
+	# Add the working variables to the state of the lanes that still
+	# had a block, and count those down.
+	&mov3($_cnt,$t1);
+	&op3("pxor",$t2,$t2,$t2);
+	&op3("pcmpgtd",$t2,$t1,$W);		# lanes with blocks left
+	&op3("paddd",$W,$t1,$t1);
+	&mov3($t1,$_cnt);
+	for ($i=0; $i<8; $i++) {
+		&op3("pand",$W,$V[$i],$V[$i]);
+		&movu3(($REG*$i)."($ctx)",$t2);
+		&op3("paddd",$t2,$V[$i],$V[$i]);
+		&movu3($V[$i],($REG*$i)."($ctx)");
+	}
+
+	$code.=<<___;
+	dec	$blocks
+	jnz	.Loop$func
+
+.Ldone$func:
+___
+	$code.="\tvzeroupper\n" if ($avx);
+	$code.=<<___;
+	mov	$_rsp,%rsi
+	mov	(%rsi),%r15
+	mov	8(%rsi),%r14
+	mov	16(%rsi),%r13
+	mov	24(%rsi),%r12
+	mov	32(%rsi),%rbp
+	mov	40(%rsi),%rbx
+	lea	48(%rsi),%rsp
+	ret
+.size	$func,.-$func
+
+___
+}
+
+$code=".text\n\n";
+
+($avx,$lanes,$REG)=(0,4,16);
+&multi_block("sha256_multi_block_ssse3");
+
+($avx,$lanes,$REG)=(1,8,32);
+&multi_block("sha256_multi_block_avx2");
+
+# The round constants, each repeated for eight lanes.
+@K256=(	0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,
+	0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+	0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,
+	0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+	0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,
+	0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+	0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,
+	0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+	0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,
+	0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+	0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,
+	0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+	0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,
+	0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+	0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,
+	0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2	);
+
+$code.=<<___;
+.align	64
+.type	K256_mb,\@object
+K256_mb:
+___
+foreach (@K256) {
+	$code.=sprintf("\t.long\t0x%08x,0x%08x,0x%08x,0x%08x\n",$_,$_,$_,$_) x 2;
+}
+$code.=<<___;
+.size	K256_mb,.-K256_mb
+.Lbswap_mb:
+	.byte	3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12
+___
+
+$code =~ s/\`([^\`]*)\`/eval($1)/gem;
+
+print $code;
+close STDOUT;
@@ -39,6 +39,15 @@
 # contrary, 64-bit version, sha512_block, is ~30% *slower* than 32-bit
 # sha256_block:-( This is presumably because 64-bit shifts/rotates
 # apparently are not atomic instructions, but implemented in microcode.
+#
+# Two further code paths are selected at run time. Where the SHA
+# extensions are available, sha256_block_data_order uses sha256rnds2 and
+# the sha256msg instructions, which process the whole block in xmm
+# registers. Otherwise, where AVX2 and BMI1/BMI2 are available, both
+# functions compute the message schedule of two blocks at a time, one in
+# each 128-bit lane of the ymm registers, store it with the round
+# constants added to the stack, and then run the rounds of each block with
+# rorx and andn, which leave their inputs intact.
 
 $flavour = shift;
 $output  = shift;
@@ -168,13 +177,28 @@ ___
 	&ROUND_00_15(@_);
 }
 
+$avx2bmi="(IA32CAP_EXT_MASK_AVX2|IA32CAP_EXT_MASK_BMI1|IA32CAP_EXT_MASK_BMI2)";
+
 $code=<<___;
 .text
+.extern	OPENSSL_ia32cap_ext_P
+.hidden	OPENSSL_ia32cap_ext_P
 
 .globl	$func
 .type	$func,\@function,4
 .align	16
 $func:
+	mov	OPENSSL_ia32cap_ext_P(%rip),%r11d
+___
+$code.=<<___ if ($SZ==4);
+	test	\$IA32CAP_EXT_MASK_SHA,%r11d
+	jnz	${func}_shaext
+___
+$code.=<<___;
+	and	\$$avx2bmi,%r11d
+	cmp	\$$avx2bmi,%r11d
+	je	${func}_avx2
+
 	push	%rbx
 	push	%rbp
 	push	%r12
@@ -267,8 +291,377 @@ $code.=<<___;
 .size	$func,.-$func
 ___
 
+######################################################################
+# SHA extensions code path. The state is kept as ABEF and CDGH in two
+# xmm registers, as sha256rnds2 expects, and each sha256rnds2 performs two
+# rounds, taking W[i]+K[i] for them from %xmm0.
+#
 if ($SZ==4) {
+my ($Wi,$ABEF,$CDGH,$TMP,$BSWAP,$ABEF_SAVE,$CDGH_SAVE)=
+    map("%xmm$_",(0..2,7..10));
+my @MSG=map("%xmm$_",(3..6));
+my ($ctx,$inp,$num)=("%rdi","%rsi","%rdx");
+
 $code.=<<___;
+.type	${func}_shaext,\@function,3
+.align	64
+${func}_shaext:
+	lea	$TABLE(%rip),%rcx
+	movdqu	($ctx),$ABEF		# DCBA
+	movdqu	16($ctx),$CDGH		# HGFE
+	movdqa	.Lbswap4(%rip),$TMP
+
+	pshufd	\$0x1b,$ABEF,$Wi	# ABCD
+	pshufd	\$0xb1,$ABEF,$ABEF	# CDAB
+	pshufd	\$0x1b,$CDGH,$CDGH	# EFGH
+	movdqa	$TMP,$BSWAP
+	palignr	\$8,$CDGH,$ABEF	# ABEF
+	punpcklqdq	$Wi,$CDGH	# CDGH
+	jmp	.Loop_shaext
+
+.align	16
+.Loop_shaext:
+	movdqu	($inp),@MSG[0]
+	movdqu	0x10($inp),@MSG[1]
+	movdqu	0x20($inp),@MSG[2]
+	pshufb	$TMP,@MSG[0]
+	movdqu	0x30($inp),@MSG[3]
+
+	movdqa	0*16(%rcx),$Wi
+	paddd	@MSG[0],$Wi
+	pshufb	$TMP,@MSG[1]
+	movdqa	$CDGH,$CDGH_SAVE
+	sha256rnds2	$ABEF,$CDGH		# 0-3
+	pshufd	\$0x0e,$Wi,$Wi
+	movdqa	$ABEF,$ABEF_SAVE
+	sha256rnds2	$CDGH,$ABEF
+
+	movdqa	1*16(%rcx),$Wi
+	paddd	@MSG[1],$Wi
+	pshufb	$TMP,@MSG[2]
+	sha256rnds2	$ABEF,$CDGH		# 4-7
+	pshufd	\$0x0e,$Wi,$Wi
+	lea	0x40($inp),$inp
+	sha256msg1	@MSG[1],@MSG[0]
+	sha256rnds2	$CDGH,$ABEF
+
+	movdqa	2*16(%rcx),$Wi
+	paddd	@MSG[2],$Wi
+	pshufb	$TMP,@MSG[3]
+	sha256rnds2	$ABEF,$CDGH		# 8-11
+	pshufd	\$0x0e,$Wi,$Wi
+	movdqa	@MSG[3],$TMP
+	palignr	\$4,@MSG[2],$TMP
+	paddd	$TMP,@MSG[0]
+	sha256msg1	@MSG[2],@MSG[1]
+	sha256rnds2	$CDGH,$ABEF
+___
+for ($i=3; $i<13; $i++) {
+$code.=<<___;
+	movdqa	$i*16(%rcx),$Wi
+	paddd	@MSG[3],$Wi
+	sha256msg2	@MSG[3],@MSG[0]
+	sha256rnds2	$ABEF,$CDGH		# `4*$i`-`4*$i+3`
+	pshufd	\$0x0e,$Wi,$Wi
+	movdqa	@MSG[0],$TMP
+	palignr	\$4,@MSG[3],$TMP
+	paddd	$TMP,@MSG[1]
+	sha256msg1	@MSG[3],@MSG[2]
+	sha256rnds2	$CDGH,$ABEF
+___
+	push(@MSG,shift(@MSG));
+}
+$code.=<<___;
+	movdqa	13*16(%rcx),$Wi
+	paddd	@MSG[3],$Wi
+	sha256msg2	@MSG[3],@MSG[0]
+	sha256rnds2	$ABEF,$CDGH		# 52-55
+	pshufd	\$0x0e,$Wi,$Wi
+	movdqa	@MSG[0],$TMP
+	palignr	\$4,@MSG[3],$TMP
+	sha256rnds2	$CDGH,$ABEF
+	paddd	$TMP,@MSG[1]
+
+	movdqa	14*16(%rcx),$Wi
+	paddd	@MSG[0],$Wi
+	sha256rnds2	$ABEF,$CDGH		# 56-59
+	pshufd	\$0x0e,$Wi,$Wi
+	sha256msg2	@MSG[0],@MSG[1]
+	movdqa	$BSWAP,$TMP
+	sha256rnds2	$CDGH,$ABEF
+
+	movdqa	15*16(%rcx),$Wi
+	paddd	@MSG[1],$Wi
+	sha256rnds2	$ABEF,$CDGH		# 60-63
+	pshufd	\$0x0e,$Wi,$Wi
+	dec	$num
+	sha256rnds2	$CDGH,$ABEF
+
+	paddd	$CDGH_SAVE,$CDGH
+	paddd	$ABEF_SAVE,$ABEF
+	jnz	.Loop_shaext
+
+	pshufd	\$0xb1,$CDGH,$CDGH	# DCHG
+	pshufd	\$0x1b,$ABEF,$TMP	# FEBA
+	pshufd	\$0xb1,$ABEF,$ABEF	# BAFE
+	punpckhqdq	$CDGH,$ABEF	# DCBA
+	palignr	\$8,$TMP,$CDGH		# HGFE
+
+	movdqu	$ABEF,($ctx)
+	movdqu	$CDGH,16($ctx)
+	ret
+.size	${func}_shaext,.-${func}_shaext
+___
+}
+
+######################################################################
+# AVX2 code path. Each ymm register holds four (SHA-256) or two
+# (SHA-512) message words of two blocks, the first block in the low
+# lane and the next one in the high lane; when only one block is left it
+# is loaded into both lanes. The message schedule of both blocks, with
+# the round constants added, is computed up front and stored in the
+# frame, 32 bytes per row of one xmm worth of words of each block.
+#
+{
+my ($ctx,$inp,$end,$inp2,$Ktbl)=("%rdi","%rsi","%rbp","%r12","%r13");
+my ($a3,$a4)=($SZ==4)?("%r12d","%edi"):("%r12","%rdi");	# zap $inp2, $ctx
+my $rows=$rounds*$SZ/16;
+my $wkfrm=$rows*32;
+my ($_ctx,$_rsp)=("$wkfrm+0*8(%rsp)","$wkfrm+1*8(%rsp)");
+my @X=map("%ymm$_",(0..$SZ-1));
+my ($t0,$t1,$t2,$t3)=map("%ymm$_",(8..11));
+my $BSWAP="%ymm12";
+
+sub SCHED_256()
+{ my $j=shift;
+# W[t]=sigma1(W[t-2])+W[t-7]+sigma0(W[t-15])+W[t-16], four words at a
+# time; sigma1 of the first two new words is needed for the last two.
+$code.=<<___;
+	vpalignr	\$4,@X[0],@X[1],$t0		# X[1..4]
+	vpalignr	\$4,@X[2],@X[3],$t3		# X[9..12]
+	vpaddd	$t3,@X[0],@X[0]
+
+	vpsrld	\$$sigma0[2],$t0,$t1
+	vpsrld	\$$sigma0[0],$t0,$t2
+	vpslld	\$`32-$sigma0[1]`,$t0,$t3
+	vpxor	$t2,$t1,$t1
+	vpsrld	\$$sigma0[1],$t0,$t2
+	vpxor	$t3,$t1,$t1
+	vpslld	\$`32-$sigma0[0]`,$t0,$t3
+	vpxor	$t2,$t1,$t1
+	vpxor	$t3,$t1,$t1			# sigma0(X[1..4])
+	vpaddd	$t1,@X[0],@X[0]
+
+	vpshufd	\$0xfa,@X[3],$t0		# X[14,14,15,15]
+	vpsrld	\$$sigma1[2],$t0,$t1
+	vpsrlq	\$$sigma1[0],$t0,$t2
+	vpxor	$t2,$t1,$t1
+	vpsrlq	\$$sigma1[1],$t0,$t2
+	vpxor	$t2,$t1,$t1
+	vpshufd	\$0x88,$t1,$t1
+	vpsrldq	\$8,$t1,$t1			# sigma1(X[14..15]),0,0
+	vpaddd	$t1,@X[0],@X[0]
+
+	vpshufd	\$0x50,@X[0],$t0		# X[16,16,17,17]
+	vpsrld	\$$sigma1[2],$t0,$t1
+	vpsrlq	\$$sigma1[0],$t0,$t2
+	vpxor	$t2,$t1,$t1
+	vpsrlq	\$$sigma1[1],$t0,$t2
+	vpxor	$t2,$t1,$t1
+	vpshufd	\$0x88,$t1,$t1
+	vpslldq	\$8,$t1,$t1			# 0,0,sigma1(X[16..17])
+	vpaddd	$t1,@X[0],@X[0]
+
+	vbroadcasti128	`16*$j`($Ktbl),$t0
+	vpaddd	@X[0],$t0,$t0
+	vmovdqa	$t0,`32*$j`(%rsp)
+___
+}
+
+sub SCHED_512()
+{ my $j=shift;
+# The same two words at a time, where sigma1 only needs words that are
+# already known.
+$code.=<<___;
+	vpalignr	\$8,@X[0],@X[1],$t0		# X[1..2]
+	vpalignr	\$8,@X[4],@X[5],$t3		# X[9..10]
+	vpaddq	$t3,@X[0],@X[0]
+
+	vpsrlq	\$$sigma0[2],$t0,$t1
+	vpsrlq	\$$sigma0[0],$t0,$t2
+	vpsllq	\$`64-$sigma0[0]`,$t0,$t3
+	vpxor	$t2,$t1,$t1
+	vpsrlq	\$$sigma0[1],$t0,$t2
+	vpxor	$t3,$t1,$t1
+	vpsllq	\$`64-$sigma0[1]`,$t0,$t3
+	vpxor	$t2,$t1,$t1
+	vpxor	$t3,$t1,$t1			# sigma0(X[1..2])
+	vpaddq	$t1,@X[0],@X[0]
+
+	vpsrlq	\$$sigma1[2],@X[7],$t1
+	vpsrlq	\$$sigma1[0],@X[7],$t2
+	vpsllq	\$`64-$sigma1[0]`,@X[7],$t3
+	vpxor	$t2,$t1,$t1
+	vpsrlq	\$$sigma1[1],@X[7],$t2
+	vpxor	$t3,$t1,$t1
+	vpsllq	\$`64-$sigma1[1]`,@X[7],$t3
+	vpxor	$t2,$t1,$t1
+	vpxor	$t3,$t1,$t1			# sigma1(X[14..15])
+	vpaddq	$t1,@X[0],@X[0]
+
+	vbroadcasti128	`16*$j`($Ktbl),$t0
+	vpaddq	@X[0],$t0,$t0
+	vmovdqa	$t0,`32*$j`(%rsp)
+___
+}
+
+sub ROUND_AVX2()
+{ my ($i,$lane,$a,$b,$c,$d,$e,$f,$g,$h) = @_;
+my $wk=32*int($i*$SZ/16)+($i*$SZ)%16+16*$lane;
+
+$code.=<<___;
+	add	$wk(%rsp),$h		# h+=X[i]+K[i]
+	andn	$g,$e,$a2		# ~e&g
+	rorx	\$$Sigma1[0],$e,$a0
+	rorx	\$$Sigma1[1],$e,$a1
+	add	$a2,$h
+	mov	$f,$a2
+	and	$e,$a2			# e&f
+	xor	$a1,$a0
+	rorx	\$$Sigma1[2],$e,$a1
+	add	$a2,$h			# h+=Ch(e,f,g)
+	xor	$a1,$a0			# Sigma1(e)
+	mov	$a,$a3
+	rorx	\$$Sigma0[0],$a,$a1
+	add	$a0,$h			# h+=Sigma1(e)
+	rorx	\$$Sigma0[1],$a,$a2
+	xor	$b,$a3			# a^b, b^c in next round
+	add	$h,$d			# d+=T1
+	xor	$a2,$a1
+	and	$a3,$a4			# (b^c)&(a^b)
+	rorx	\$$Sigma0[2],$a,$a2
+	xor	$b,$a4			# Maj(a,b,c)
+	xor	$a2,$a1			# Sigma0(a)
+	add	$a4,$h
+	add	$a1,$h			# h+=Sigma0(a)+Maj(a,b,c)
+___
+}
+
+sub BLOCK_AVX2()
+{ my $lane=shift;
+$code.=<<___;
+	mov	$B,$a4
+	xor	$C,$a4			# b^c
+___
+	for ($i=0; $i<$rounds; $i++) {
+		&ROUND_AVX2($i,$lane,@ROT);
+		unshift(@ROT,pop(@ROT));
+		($a3,$a4)=($a4,$a3);
+	}
+$code.=<<___;
+	mov	$_ctx,$ctx
+	add	$SZ*0($ctx),$A
+	add	$SZ*1($ctx),$B
+	add	$SZ*2($ctx),$C
+	add	$SZ*3($ctx),$D
+	add	$SZ*4($ctx),$E
+	add	$SZ*5($ctx),$F
+	add	$SZ*6($ctx),$G
+	add	$SZ*7($ctx),$H
+	mov	$A,$SZ*0($ctx)
+	mov	$B,$SZ*1($ctx)
+	mov	$C,$SZ*2($ctx)
+	mov	$D,$SZ*3($ctx)
+	mov	$E,$SZ*4($ctx)
+	mov	$F,$SZ*5($ctx)
+	mov	$G,$SZ*6($ctx)
+	mov	$H,$SZ*7($ctx)
+___
+}
+
+$code.=<<___;
+.type	${func}_avx2,\@function,3
+.align	64
+${func}_avx2:
+	push	%rbx
+	push	%rbp
+	push	%r12
+	push	%r13
+	push	%r14
+	push	%r15
+	mov	%rsp,%r11
+	sub	\$`$wkfrm+16`,%rsp
+	and	\$-64,%rsp
+	mov	$ctx,$_ctx		# save ctx, 1st arg
+	mov	%r11,$_rsp		# save copy of %rsp
+
+	shl	\$`log(16*$SZ)/log(2)`,%rdx
+	lea	($inp,%rdx),$end	# end of input
+	vbroadcasti128	.Lbswap$SZ(%rip),$BSWAP
+
+	mov	$SZ*0($ctx),$A
+	mov	$SZ*1($ctx),$B
+	mov	$SZ*2($ctx),$C
+	mov	$SZ*3($ctx),$D
+	mov	$SZ*4($ctx),$E
+	mov	$SZ*5($ctx),$F
+	mov	$SZ*6($ctx),$G
+	mov	$SZ*7($ctx),$H
+
+.align	16
+.Loop_avx2:
+	lea	16*$SZ($inp),$inp2	# next block, or this one again
+	cmp	$end,$inp2
+	cmovae	$inp,$inp2
+	lea	$TABLE(%rip),$Ktbl
+___
+for ($j=0; $j<$SZ; $j++) {
+$code.=<<___;
+	vmovdqu	`16*$j`($inp),%xmm$j
+	vinserti128	\$1,`16*$j`($inp2),@X[$j],@X[$j]
+	vpshufb	$BSWAP,@X[$j],@X[$j]
+	vbroadcasti128	`16*$j`($Ktbl),$t0
+	vpadd`$SZ==4?"d":"q"`	@X[$j],$t0,$t0
+	vmovdqa	$t0,`32*$j`(%rsp)
+___
+}
+for (; $j<$rows; $j++) {
+	if ($SZ==4)	{ &SCHED_256($j); }
+	else		{ &SCHED_512($j); }
+	push(@X,shift(@X));
+}
+&BLOCK_AVX2(0);
+$code.=<<___;
+	lea	16*$SZ($inp),$inp
+	cmp	$end,$inp
+	jae	.Ldone_avx2
+___
+&BLOCK_AVX2(1);
+$code.=<<___;
+	lea	16*$SZ($inp),$inp
+	cmp	$end,$inp
+	jb	.Loop_avx2
+
+.Ldone_avx2:
+	vzeroupper
+	mov	$_rsp,%rsi
+	mov	(%rsi),%r15
+	mov	8(%rsi),%r14
+	mov	16(%rsi),%r13
+	mov	24(%rsi),%r12
+	mov	32(%rsi),%rbp
+	mov	40(%rsi),%rbx
+	lea	48(%rsi),%rsp
+	ret
+.size	${func}_avx2,.-${func}_avx2
+___
+}
+
+if ($SZ==4) {
+$code.=<<___;
+.align	16
+.Lbswap4:
+	.byte	3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12
 .align	64
 .type	$TABLE,\@object
 $TABLE:
@@ -291,6 +684,9 @@ $TABLE:
 ___
 } else {
 $code.=<<___;
+.align	16
+.Lbswap8:
+	.byte	7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8
 .align	64
 .type	$TABLE,\@object
 $TABLE:
@@ -134,6 +134,8 @@ int SHA256_Update(SHA256_CTX *c, const void *data, size_t len)
 int SHA256_Final(unsigned char *md, SHA256_CTX *c);
 unsigned char *SHA256(const unsigned char *d, size_t n,unsigned char *md)
 	__attribute__ ((__bounded__(__buffer__,1,2)));
+void SHA256_multi(const unsigned char * const *d, const size_t *n,
+    unsigned char **md, size_t count);
 void SHA256_Transform(SHA256_CTX *c, const unsigned char *data);
 #endif
 
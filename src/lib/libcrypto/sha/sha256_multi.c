@@ -0,0 +1,172 @@
+/* $OpenBSD$ */
+/*
+ * Copyright (c) 2026 The LibreSSL project.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <openssl/opensslconf.h>
+
+#if !defined(OPENSSL_NO_SHA) && !defined(OPENSSL_NO_SHA256)
+
+#include <stdint.h>
+#include <string.h>
+
+#include <openssl/crypto.h>
+#include <openssl/sha.h>
+
+#ifdef SHA256_MB_ASM
+#include "cryptlib.h"
+#include "x86_arch.h"
+
+#define SHA256_MB_LANES		8
+
+/* The kernels count blocks in signed 32-bit lanes. */
+#define SHA256_MB_MAX_BLOCKS	(1 << 24)
+
+void sha256_multi_block_ssse3(SHA_LONG *h, const unsigned char **inp,
+    const unsigned int *num);
+void sha256_multi_block_avx2(SHA_LONG *h, const unsigned char **inp,
+    const unsigned int *num);
+
+static const SHA_LONG sha256_iv[8] = {
+	0x6a09e667UL, 0xbb67ae85UL, 0x3c6ef372UL, 0xa54ff53aUL,
+	0x510e527fUL, 0x9b05688cUL, 0x1f83d9abUL, 0x5be0cd19UL,
+};
+
+/*
+ * Hash count <= lanes messages, one per lane. The full blocks are hashed
+ * straight from the messages, then the last partial block and the padding
+ * of each message are built in tail and hashed in a final pass.
+ */
+static void
+sha256_multi_lanes(int lanes, const unsigned char * const *d,
+    const size_t *n, unsigned char **md, size_t count)
+{
+	unsigned char tail[SHA256_MB_LANES][2 * SHA256_CBLOCK];
+	const unsigned char *inp[SHA256_MB_LANES];
+	unsigned int num[SHA256_MB_LANES];
+	SHA_LONG h[8 * SHA256_MB_LANES];
+	size_t done[SHA256_MB_LANES];
+	size_t left, rem;
+	uint64_t bits;
+	unsigned char *p;
+	int i, l, more;
+
+	void (*multi_block)(SHA_LONG *, const unsigned char **,
+	    const unsigned int *);
+
+	multi_block = (lanes == 8) ? sha256_multi_block_avx2 :
+	    sha256_multi_block_ssse3;
+
+	for (i = 0; i < 8; i++) {
+		for (l = 0; l < lanes; l++)
+			h[i * lanes + l] = sha256_iv[i];
+	}
+
+	memset(inp, 0, sizeof(inp));
+	memset(num, 0, sizeof(num));
+	memset(done, 0, sizeof(done));
+	do {
+		more = 0;
+		for (l = 0; l < lanes; l++) {
+			inp[l] = NULL;
+			num[l] = 0;
+			if ((size_t)l >= count)
+				continue;
+			left = n[l] / SHA256_CBLOCK - done[l];
+			if (left > SHA256_MB_MAX_BLOCKS)
+				left = SHA256_MB_MAX_BLOCKS;
+			inp[l] = d[l] + done[l] * SHA256_CBLOCK;
+			num[l] = left;
+			done[l] += left;
+			if (left > 0)
+				more = 1;
+		}
+		if (more)
+			multi_block(h, inp, num);
+	} while (more);
+
+	for (l = 0; l < lanes; l++) {
+		inp[l] = NULL;
+		num[l] = 0;
+		if ((size_t)l >= count)
+			continue;
+
+		rem = n[l] % SHA256_CBLOCK;
+		memset(tail[l], 0, sizeof(tail[l]));
+		if (rem > 0)
+			memcpy(tail[l], d[l] + n[l] - rem, rem);
+		tail[l][rem] = 0x80;
+		num[l] = (rem < SHA256_CBLOCK - 8) ? 1 : 2;
+
+		bits = (uint64_t)n[l] << 3;
+		p = tail[l] + num[l] * SHA256_CBLOCK - 8;
+		for (i = 7; i >= 0; i--) {
+			p[i] = bits & 0xff;
+			bits >>= 8;
+		}
+		inp[l] = tail[l];
+	}
+	multi_block(h, inp, num);
+
+	for (l = 0; l < lanes && (size_t)l < count; l++) {
+		p = md[l];
+		for (i = 0; i < 8; i++) {
+			*(p++) = h[i * lanes + l] >> 24;
+			*(p++) = h[i * lanes + l] >> 16;
+			*(p++) = h[i * lanes + l] >> 8;
+			*(p++) = h[i * lanes + l];
+		}
+	}
+
+	explicit_bzero(tail, sizeof(tail));
+	explicit_bzero(h, sizeof(h));
+}
+#endif
+
+void
+SHA256_multi(const unsigned char * const *d, const size_t *n,
+    unsigned char **md, size_t count)
+{
+	size_t i = 0;
+#ifdef SHA256_MB_ASM
+	size_t group;
+	int lanes = 0;
+
+	/*
+	 * With the SHA extensions, sha256_block_data_order hashes a single
+	 * message faster than the AVX2 code hashes eight.
+	 */
+	if ((OPENSSL_cpu_caps_ext() & IA32CAP_EXT_MASK_SHA) != 0)
+		lanes = 0;
+	else if ((OPENSSL_cpu_caps_ext() & IA32CAP_EXT_MASK_AVX2) != 0)
+		lanes = 8;
+	else if ((OPENSSL_cpu_caps() & CPUCAP_MASK_SSSE3) != 0)
+		lanes = 4;
+
+	/* A lone message is faster on its own. */
+	while (lanes > 0 && count - i > 1) {
+		group = count - i;
+		if (group > (size_t)lanes)
+			group = lanes;
+		sha256_multi_lanes(lanes, d + i, n + i, md + i, group);
+		i += group;
+	}
+#endif
+
+	for (; i < count; i++)
+		SHA256(d[i], n[i], md[i]);
+}
+
+#endif /* OPENSSL_NO_SHA256 */
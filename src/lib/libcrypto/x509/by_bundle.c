@@ -0,0 +1,482 @@
+/* $OpenBSD$ */
+/*
+ * Copyright (c) 2026 The LibreSSL project.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Certificate bundles: a file of DER certificates behind an index sorted
+ * by subject name hash. The file is mapped read-only and shared, and a
+ * certificate is only decoded and added to the store the first time a
+ * lookup asks for its subject.
+ *
+ * The store only consults its lookup methods for a subject when it holds
+ * no certificate with that subject, so a certificate in the bundle is
+ * never loaded if one with the same subject was added to the store by
+ * other means.
+ *
+ * All integers are 32 bit big endian.
+ *
+ *	magic[8]	"\0X509BND"
+ *	version		X509_BUNDLE_VERSION
+ *	count		number of index entries
+ *	index[count]	{ hash, offset, length }, sorted by hash
+ *	data		the DER certificates
+ *
+ * The hash is X509_NAME_hash() of the subject and the offset is from
+ * the start of the file.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/x509.h>
+
+#include "x509_lcl.h"
+
+#define X509_BUNDLE_VERSION	1
+#define X509_BUNDLE_HEADER_LEN	16
+#define X509_BUNDLE_ENTRY_LEN	12
+
+static const unsigned char x509_bundle_magic[X509_BUNDLE_MAGIC_LEN] = {
+	'\0', 'X', '5', '0', '9', 'B', 'N', 'D',
+};
+
+struct x509_bundle {
+	unsigned char *data;
+	size_t len;
+	int mapped;
+	uint32_t count;
+	unsigned char *loaded;
+	struct x509_bundle *next;
+};
+
+static int new_bundle(X509_LOOKUP *lu);
+static void free_bundle(X509_LOOKUP *lu);
+static int bundle_ctrl(X509_LOOKUP *lu, int cmd, const char *argp,
+    long argl, char **ret);
+static int get_cert_by_subject(X509_LOOKUP *lu, int type, X509_NAME *name,
+    X509_OBJECT *ret);
+
+static X509_LOOKUP_METHOD x509_bundle_lookup = {
+	.name = "Load certs from a certificate bundle",
+	.new_item = new_bundle,
+	.free = free_bundle,
+	.init = NULL,
+	.shutdown = NULL,
+	.ctrl = bundle_ctrl,
+	.get_by_subject = get_cert_by_subject,
+	.get_by_issuer_serial = NULL,
+	.get_by_fingerprint = NULL,
+	.get_by_alias = NULL,
+};
+
+X509_LOOKUP_METHOD *
+X509_LOOKUP_bundle(void)
+{
+	return (&x509_bundle_lookup);
+}
+
+static uint32_t
+bundle_get32(const unsigned char *p)
+{
+	return ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+	    (uint32_t)p[2] << 8 | (uint32_t)p[3]);
+}
+
+static void
+bundle_put32(unsigned char *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void
+bundle_entry(const struct x509_bundle *b, uint32_t i, uint32_t *hash,
+    uint32_t *offset, uint32_t *length)
+{
+	const unsigned char *p;
+
+	p = b->data + X509_BUNDLE_HEADER_LEN + i * X509_BUNDLE_ENTRY_LEN;
+	*hash = bundle_get32(p);
+	*offset = bundle_get32(p + 4);
+	*length = bundle_get32(p + 8);
+}
+
+int
+x509_bundle_magic_match(const void *buf, size_t len)
+{
+	if (len < X509_BUNDLE_MAGIC_LEN)
+		return (0);
+	return (memcmp(buf, x509_bundle_magic, X509_BUNDLE_MAGIC_LEN) == 0);
+}
+
+/*
+ * Check the header and the index against the size of the bundle, so that
+ * lookups can trust them. The certificates themselves are only looked at
+ * when they are decoded.
+ */
+static int
+bundle_check(struct x509_bundle *b)
+{
+	uint32_t i, hash, offset, length, last = 0;
+	size_t start;
+
+	if (!x509_bundle_magic_match(b->data, b->len) ||
+	    b->len < X509_BUNDLE_HEADER_LEN)
+		return (0);
+	if (bundle_get32(b->data + 8) != X509_BUNDLE_VERSION)
+		return (0);
+	b->count = bundle_get32(b->data + 12);
+	if (b->count > (b->len - X509_BUNDLE_HEADER_LEN) /
+	    X509_BUNDLE_ENTRY_LEN)
+		return (0);
+	start = X509_BUNDLE_HEADER_LEN + b->count * X509_BUNDLE_ENTRY_LEN;
+
+	for (i = 0; i < b->count; i++) {
+		bundle_entry(b, i, &hash, &offset, &length);
+		if (hash < last)
+			return (0);
+		if (offset < start || offset > b->len ||
+		    length == 0 || length > b->len - offset)
+			return (0);
+		last = hash;
+	}
+	return (1);
+}
+
+static void
+bundle_free(struct x509_bundle *b)
+{
+	if (b == NULL)
+		return;
+	if (b->mapped)
+		munmap(b->data, b->len);
+	else
+		free(b->data);
+	free(b->loaded);
+	free(b);
+}
+
+static int
+bundle_add(X509_LOOKUP *lu, struct x509_bundle *b)
+{
+	struct x509_bundle **bp;
+
+	if (!bundle_check(b)) {
+		X509error(X509_R_BAD_X509_FILETYPE);
+		return (0);
+	}
+	if (b->count > 0 && (b->loaded = calloc(b->count, 1)) == NULL) {
+		X509error(ERR_R_MALLOC_FAILURE);
+		return (0);
+	}
+
+	CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
+	for (bp = (struct x509_bundle **)&lu->method_data; *bp != NULL;
+	    bp = &(*bp)->next)
+		;
+	*bp = b;
+	CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
+
+	return (1);
+}
+
+/*
+ * The mapping is shared, so processes using the same bundle share its
+ * pages. A bundle must be replaced by renaming a new file over it, as
+ * certhash does; truncating or rewriting it in place while it is mapped
+ * faults the processes using it.
+ */
+static int
+bundle_load_file(X509_LOOKUP *lu, const char *file)
+{
+	struct x509_bundle *b = NULL;
+	struct stat sb;
+	void *data;
+	int fd;
+
+	if ((fd = open(file, O_RDONLY)) == -1) {
+		X509error(ERR_R_SYS_LIB);
+		return (0);
+	}
+	if (fstat(fd, &sb) == -1 || sb.st_size < X509_BUNDLE_HEADER_LEN ||
+	    (uintmax_t)sb.st_size > SIZE_MAX) {
+		X509error(X509_R_BAD_X509_FILETYPE);
+		close(fd);
+		return (0);
+	}
+	data = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		X509error(ERR_R_SYS_LIB);
+		return (0);
+	}
+
+	if ((b = calloc(1, sizeof(*b))) == NULL) {
+		X509error(ERR_R_MALLOC_FAILURE);
+		munmap(data, sb.st_size);
+		return (0);
+	}
+	b->data = data;
+	b->len = sb.st_size;
+	b->mapped = 1;
+
+	if (!bundle_add(lu, b)) {
+		bundle_free(b);
+		return (0);
+	}
+	return (1);
+}
+
+/*
+ * The caller may free its buffer once the store is set up, so the bundle
+ * has to be copied.
+ */
+static int
+bundle_load_mem(X509_LOOKUP *lu, const struct iovec *iov)
+{
+	struct x509_bundle *b = NULL;
+
+	if ((b = calloc(1, sizeof(*b))) == NULL)
+		goto err;
+	if (iov->iov_len > 0 && (b->data = malloc(iov->iov_len)) == NULL)
+		goto err;
+	memcpy(b->data, iov->iov_base, iov->iov_len);
+	b->len = iov->iov_len;
+
+	if (!bundle_add(lu, b)) {
+		bundle_free(b);
+		return (0);
+	}
+	return (1);
+
+ err:
+	X509error(ERR_R_MALLOC_FAILURE);
+	bundle_free(b);
+	return (0);
+}
+
+static int
+new_bundle(X509_LOOKUP *lu)
+{
+	lu->method_data = NULL;
+	return (1);
+}
+
+static void
+free_bundle(X509_LOOKUP *lu)
+{
+	struct x509_bundle *b, *next;
+
+	for (b = (struct x509_bundle *)lu->method_data; b != NULL; b = next) {
+		next = b->next;
+		bundle_free(b);
+	}
+	lu->method_data = NULL;
+}
+
+static int
+bundle_ctrl(X509_LOOKUP *lu, int cmd, const char *argp, long argl,
+    char **ret)
+{
+	switch (cmd) {
+	case X509_L_BUNDLE_LOAD:
+		if (argp == NULL)
+			return (0);
+		return (bundle_load_file(lu, argp));
+	case X509_L_BUNDLE_MEM:
+		if (argp == NULL)
+			return (0);
+		return (bundle_load_mem(lu, (const struct iovec *)argp));
+	}
+	return (0);
+}
+
+/*
+ * Decode and add to the store every certificate of the bundle whose
+ * subject hashes to hash. Certificates that were already added are
+ * skipped, so each one is decoded at most once in the common case; a race
+ * with another thread only costs a duplicate that the store ignores.
+ */
+static void
+bundle_load_hash(X509_LOOKUP *lu, struct x509_bundle *b, uint32_t hash)
+{
+	uint32_t lo, hi, mid, h, offset, length;
+	const unsigned char *p;
+	int loaded;
+	X509 *x;
+
+	lo = 0;
+	hi = b->count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		bundle_entry(b, mid, &h, &offset, &length);
+		if (h < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < b->count; lo++) {
+		bundle_entry(b, lo, &h, &offset, &length);
+		if (h != hash)
+			break;
+
+		CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
+		loaded = b->loaded[lo];
+		CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
+		if (loaded)
+			continue;
+
+		ERR_set_mark();
+		p = b->data + offset;
+		if ((x = d2i_X509(NULL, &p, length)) != NULL) {
+			X509_STORE_add_cert(lu->store_ctx, x);
+			X509_free(x);
+		}
+		ERR_pop_to_mark();
+
+		CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
+		b->loaded[lo] = 1;
+		CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
+	}
+}
+
+static int
+get_cert_by_subject(X509_LOOKUP *lu, int type, X509_NAME *name,
+    X509_OBJECT *ret)
+{
+	struct x509_bundle *b;
+	X509_OBJECT *tmp;
+	uint32_t hash;
+
+	if (type != X509_LU_X509 || name == NULL)
+		return (0);
+
+	hash = X509_NAME_hash(name);
+	for (b = (struct x509_bundle *)lu->method_data; b != NULL; b = b->next)
+		bundle_load_hash(lu, b, hash);
+
+	CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
+	tmp = x509_store_lookup(lu->store_ctx, type, name);
+	CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
+	if (tmp == NULL)
+		return (0);
+
+	ret->type = tmp->type;
+	memcpy(&ret->data, &tmp->data, sizeof(ret->data));
+	return (1);
+}
+
+struct x509_bundle_cert {
+	uint32_t hash;
+	unsigned char *der;
+	int len;
+};
+
+static int
+bundle_cert_cmp(const void *a, const void *b)
+{
+	const struct x509_bundle_cert *ca = a, *cb = b;
+
+	if (ca->hash != cb->hash)
+		return (ca->hash < cb->hash ? -1 : 1);
+	if (ca->len != cb->len)
+		return (ca->len < cb->len ? -1 : 1);
+	return (memcmp(ca->der, cb->der, ca->len));
+}
+
+int
+X509_bundle_write_bio(BIO *bp, STACK_OF(X509) *certs)
+{
+	struct x509_bundle_cert *c = NULL;
+	unsigned char buf[X509_BUNDLE_HEADER_LEN];
+	size_t count = 0, n, i, j, offset;
+	X509 *x;
+	int ret = 0;
+
+	n = sk_X509_num(certs);
+	if (n > 0 && (c = reallocarray(NULL, n, sizeof(*c))) == NULL) {
+		X509error(ERR_R_MALLOC_FAILURE);
+		return (0);
+	}
+	for (i = 0; i < n; i++) {
+		x = sk_X509_value(certs, i);
+		c[count].der = NULL;
+		if ((c[count].len = i2d_X509(x, &c[count].der)) <= 0) {
+			X509error(ERR_R_ASN1_LIB);
+			goto err;
+		}
+		c[count].hash = X509_subject_name_hash(x);
+		count++;
+	}
+
+	/* Sort the index and drop certificates that appear twice. */
+	if (count > 0)
+		qsort(c, count, sizeof(*c), bundle_cert_cmp);
+	for (i = j = 0; i < count; i++) {
+		if (j > 0 && bundle_cert_cmp(&c[j - 1], &c[i]) == 0) {
+			free(c[i].der);
+			continue;
+		}
+		c[j++] = c[i];
+	}
+	count = j;
+
+	offset = X509_BUNDLE_HEADER_LEN + count * X509_BUNDLE_ENTRY_LEN;
+	memcpy(buf, x509_bundle_magic, X509_BUNDLE_MAGIC_LEN);
+	bundle_put32(buf + 8, X509_BUNDLE_VERSION);
+	bundle_put32(buf + 12, count);
+	if (BIO_write(bp, buf, sizeof(buf)) != sizeof(buf))
+		goto err;
+
+	for (i = 0; i < count; i++) {
+		if (offset > UINT32_MAX - c[i].len) {
+			X509error(ERR_R_BUF_LIB);
+			goto err;
+		}
+		bundle_put32(buf, c[i].hash);
+		bundle_put32(buf + 4, offset);
+		bundle_put32(buf + 8, c[i].len);
+		if (BIO_write(bp, buf, X509_BUNDLE_ENTRY_LEN) !=
+		    X509_BUNDLE_ENTRY_LEN)
+			goto err;
+		offset += c[i].len;
+	}
+	for (i = 0; i < count; i++) {
+		if (BIO_write(bp, c[i].der, c[i].len) != c[i].len)
+			goto err;
+	}
+
+	ret = 1;
+
+ err:
+	for (i = 0; i < count; i++)
+		free(c[i].der);
+	free(c);
+
+	return (ret);
+}
@@ -72,6 +72,8 @@
 
 # include <sys/stat.h>
 
+#include "x509_lcl.h"
+
 typedef struct lookup_dir_hashes_st {
 	unsigned long hash;
 	int suffix;
@@ -262,36 +264,19 @@ get_cert_by_subject(X509_LOOKUP *xl, int type, X509_NAME *name,
     X509_OBJECT *ret)
 {
 	BY_DIR *ctx;
-	union	{
-		struct	{
-			X509 st_x509;
-			X509_CINF st_x509_cinf;
-		} x509;
-		struct	{
-			X509_CRL st_crl;
-			X509_CRL_INFO st_crl_info;
-		} crl;
-	} data;
 	int ok = 0;
 	int i, j, k;
 	unsigned long h;
 	BUF_MEM *b = NULL;
-	X509_OBJECT stmp, *tmp;
+	X509_OBJECT *tmp;
 	const char *postfix="";
 
 	if (name == NULL)
 		return (0);
 
-	stmp.type = type;
 	if (type == X509_LU_X509) {
-		data.x509.st_x509.cert_info = &data.x509.st_x509_cinf;
-		data.x509.st_x509_cinf.subject = name;
-		stmp.data.x509 = &data.x509.st_x509;
 		postfix="";
 	} else if (type == X509_LU_CRL) {
-		data.crl.st_crl.crl = &data.crl.st_crl_info;
-		data.crl.st_crl_info.issuer = name;
-		stmp.data.crl = &data.crl.st_crl;
 		postfix="r";
 	} else {
 		X509error(X509_R_WRONG_LOOKUP_TYPE);
@@ -356,13 +341,9 @@ get_cert_by_subject(X509_LOOKUP *xl, int type, X509_NAME *name,
 		}
 
 		/* we have added it to the cache so now pull it out again */
-		CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
-		j = sk_X509_OBJECT_find(xl->store_ctx->objs, &stmp);
-		if (j != -1)
-			tmp = sk_X509_OBJECT_value(xl->store_ctx->objs, j);
-		else
-			tmp = NULL;
-		CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
+		CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
+		tmp = x509_store_lookup(xl->store_ctx, type, name);
+		CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
 
 		/* If a CRL, update the last file suffix added for this */
 		if (type == X509_LU_CRL) {
@@ -67,6 +67,8 @@
 #include <openssl/lhash.h>
 #include <openssl/x509.h>
 
+#include "x509_lcl.h"
+
 static int by_file_ctrl(X509_LOOKUP *ctx, int cmd, const char *argc,
     long argl, char **ret);
 
@@ -89,6 +91,36 @@ X509_LOOKUP_file(void)
 	return (&x509_file_lookup);
 }
 
+/*
+ * A certificate bundle given in place of a PEM file is handed to the
+ * bundle lookup, which maps it instead of loading it.
+ */
+static int
+by_file_is_bundle(const char *file)
+{
+	unsigned char magic[X509_BUNDLE_MAGIC_LEN];
+	size_t n;
+	FILE *fp;
+
+	if (file == NULL || (fp = fopen(file, "r")) == NULL)
+		return (0);
+	n = fread(magic, 1, sizeof(magic), fp);
+	fclose(fp);
+
+	return (x509_bundle_magic_match(magic, n));
+}
+
+static int
+by_file_load_bundle(X509_LOOKUP *ctx, const char *file)
+{
+	X509_LOOKUP *lu;
+
+	if ((lu = X509_STORE_add_lookup(ctx->store_ctx,
+	    X509_LOOKUP_bundle())) == NULL)
+		return (0);
+	return (X509_LOOKUP_load_bundle(lu, file) == 1);
+}
+
 static int
 by_file_ctrl(X509_LOOKUP *ctx, int cmd, const char *argp, long argl,
     char **ret)
@@ -98,14 +130,20 @@ by_file_ctrl(X509_LOOKUP *ctx, int cmd, const char *argp, long argl,
 	switch (cmd) {
 	case X509_L_FILE_LOAD:
 		if (argl == X509_FILETYPE_DEFAULT) {
-			ok = (X509_load_cert_crl_file(ctx,
-			    X509_get_default_cert_file(),
-			    X509_FILETYPE_PEM) != 0);
+			argp = X509_get_default_cert_file();
+			if (by_file_is_bundle(argp))
+				ok = by_file_load_bundle(ctx, argp);
+			else
+				ok = (X509_load_cert_crl_file(ctx, argp,
+				    X509_FILETYPE_PEM) != 0);
 			if (!ok) {
 				X509error(X509_R_LOADING_DEFAULTS);
 			}
 		} else {
-			if (argl == X509_FILETYPE_PEM)
+			if (argl == X509_FILETYPE_PEM &&
+			    by_file_is_bundle(argp))
+				ok = by_file_load_bundle(ctx, argp);
+			else if (argl == X509_FILETYPE_PEM)
 				ok = (X509_load_cert_crl_file(ctx, argp,
 				    X509_FILETYPE_PEM) != 0);
 			else
@@ -68,6 +68,8 @@
 #include <openssl/lhash.h>
 #include <openssl/x509.h>
 
+#include "x509_lcl.h"
+
 static int by_mem_ctrl(X509_LOOKUP *, int, const char *, long, char **);
 
 static X509_LOOKUP_METHOD x509_mem_lookup = {
@@ -104,6 +106,14 @@ by_mem_ctrl(X509_LOOKUP *lu, int cmd, const char *buf,
 	if (!(cmd == X509_L_MEM && type == X509_FILETYPE_PEM))
 		goto done;
 
+	/* Certificate bundles are left to the bundle lookup. */
+	if (x509_bundle_magic_match(iov->iov_base, iov->iov_len)) {
+		if ((lu = X509_STORE_add_lookup(lu->store_ctx,
+		    X509_LOOKUP_bundle())) == NULL)
+			return (0);
+		return (X509_LOOKUP_add_bundle_mem(lu, iov) == 1);
+	}
+
 	if ((in = BIO_new_mem_buf(iov->iov_base, iov->iov_len)) == NULL)
 		goto done;
 
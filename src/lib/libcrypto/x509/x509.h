@@ -464,6 +464,8 @@ struct X509_crl_st
 	STACK_OF(GENERAL_NAMES) *issuers;
 	const X509_CRL_METHOD *meth;
 	void *meth_data;
+	/* Revoked entries sorted by serial number */
+	struct x509_crl_index_st *revoked_index;
 	} /* X509_CRL */;
 
 DECLARE_STACK_OF(X509_CRL)
@@ -703,6 +705,7 @@ X509 *d2i_X509_bio(BIO *bp,X509 **x509);
 int i2d_X509_bio(BIO *bp,X509 *x509);
 X509_CRL *d2i_X509_CRL_bio(BIO *bp,X509_CRL **crl);
 int i2d_X509_CRL_bio(BIO *bp,X509_CRL *crl);
+X509_CRL *X509_CRL_read_compact_bio(BIO *bp);
 X509_REQ *d2i_X509_REQ_bio(BIO *bp,X509_REQ **req);
 int i2d_X509_REQ_bio(BIO *bp,X509_REQ *req);
 #ifndef OPENSSL_NO_RSA
@@ -919,6 +922,8 @@ int X509_CRL_add0_revoked(X509_CRL *crl, X509_REVOKED *rev);
 int X509_CRL_get0_by_serial(X509_CRL *crl,
 		X509_REVOKED **ret, ASN1_INTEGER *serial);
 int X509_CRL_get0_by_cert(X509_CRL *crl, X509_REVOKED **ret, X509 *x);
+size_t X509_CRL_revoked_index_size(const X509_CRL *crl);
+size_t X509_CRL_compact_count(const X509_CRL *crl);
 
 X509_PKEY *	X509_PKEY_new(void );
 void		X509_PKEY_free(X509_PKEY *a);
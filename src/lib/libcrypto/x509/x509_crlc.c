@@ -0,0 +1,886 @@
+/* $OpenBSD$ */
+/*
+ * Copyright (c) 2026 The LibreSSL project.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Compact CRLs.
+ *
+ * X509_CRL_read_compact_bio() reads a DER encoded CRL from a BIO one
+ * element at a time. The revoked certificates are never decoded into
+ * X509_REVOKED structures: only the serial number, the revocation date
+ * and the reason code of each entry are kept, in a sorted array. The
+ * TBSCertList is hashed as it is read, so the signature can be checked
+ * later without keeping or re-encoding the entries.
+ *
+ * The remaining fields are decoded by d2i_X509_CRL() from a copy of the
+ * CRL without its revokedCertificates, and the result is given a CRL
+ * method that answers lookups and signature checks from the compact data.
+ */
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <openssl/asn1.h>
+#include <openssl/bio.h>
+#include <openssl/buffer.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/objects.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include "asn1_locl.h"
+
+/* RFC 5280 limits serial numbers to 20 octets. */
+#define CRL_COMPACT_SERIAL_MAX	20
+
+/* Upper bounds on the elements that are held in memory while reading. */
+#define CRL_COMPACT_ENTRY_MAX	(64 * 1024)
+#define CRL_COMPACT_FIELD_MAX	(1024 * 1024)
+
+struct crl_compact_entry {
+	int64_t time;
+	unsigned char serial[CRL_COMPACT_SERIAL_MAX];
+	uint8_t serial_len;
+	uint8_t neg;
+	int8_t reason;
+	uint8_t pad;
+};
+
+struct crl_compact {
+	struct crl_compact_entry *entries;
+	size_t count;
+	size_t size;
+	const EVP_MD *md;
+	unsigned char digest[EVP_MAX_MD_SIZE];
+	unsigned int digest_len;
+	X509_REVOKED **revoked;
+};
+
+/* A DER reader over memory, in the manner of CBS. */
+struct crl_cbs {
+	const unsigned char *data;
+	size_t len;
+};
+
+/* A DER reader over a BIO, holding the current element. */
+struct crl_stream {
+	BIO *bio;
+	unsigned char *buf;
+	size_t buf_size;
+	unsigned char tag;
+	size_t hdr_len;
+	size_t len;
+};
+
+static const unsigned char crl_oid_reason[] = { 0x55, 0x1d, 0x15 };
+static const unsigned char crl_oid_cert_issuer[] = { 0x55, 0x1d, 0x1d };
+
+static int compact_crl_free(X509_CRL *crl);
+static int compact_crl_lookup(X509_CRL *crl, X509_REVOKED **ret,
+    ASN1_INTEGER *serial, X509_NAME *issuer);
+static int compact_crl_verify(X509_CRL *crl, EVP_PKEY *pkey);
+
+static const X509_CRL_METHOD compact_crl_meth = {
+	.crl_free = compact_crl_free,
+	.crl_lookup = compact_crl_lookup,
+	.crl_verify = compact_crl_verify,
+};
+
+/*
+ * Returned by lookups that find an entry but cannot allocate an
+ * X509_REVOKED for it, so that a revoked certificate is never taken
+ * to be good.
+ */
+static X509_REVOKED compact_crl_revoked_nomem = {
+	.reason = CRL_REASON_UNSPECIFIED,
+};
+
+/*
+ * Parse the identifier and length octets at p. Only the low tag number
+ * form and definite lengths of at most four octets are accepted.
+ */
+static int
+crl_der_header(const unsigned char *p, size_t avail, unsigned char *tag,
+    size_t *hdr_len, size_t *len)
+{
+	size_t i, n;
+
+	if (avail < 2)
+		return 0;
+	if ((p[0] & 0x1f) == 0x1f)
+		return 0;
+	*tag = p[0];
+	if ((p[1] & 0x80) == 0) {
+		*hdr_len = 2;
+		*len = p[1];
+		return 1;
+	}
+	n = p[1] & 0x7f;
+	if (n == 0 || n > 4 || avail < 2 + n)
+		return 0;
+	*len = 0;
+	for (i = 0; i < n; i++)
+		*len = (*len << 8) | p[2 + i];
+	*hdr_len = 2 + n;
+	return 1;
+}
+
+static int
+crl_cbs_get_any(struct crl_cbs *cbs, struct crl_cbs *out, unsigned char *tag)
+{
+	size_t hdr_len, len;
+
+	if (!crl_der_header(cbs->data, cbs->len, tag, &hdr_len, &len))
+		return 0;
+	if (len > cbs->len - hdr_len)
+		return 0;
+	out->data = cbs->data + hdr_len;
+	out->len = len;
+	cbs->data += hdr_len + len;
+	cbs->len -= hdr_len + len;
+	return 1;
+}
+
+static int
+crl_cbs_get(struct crl_cbs *cbs, struct crl_cbs *out, unsigned char tag)
+{
+	unsigned char t;
+
+	return crl_cbs_get_any(cbs, out, &t) && t == tag;
+}
+
+static int
+crl_cbs_peek(const struct crl_cbs *cbs, unsigned char tag)
+{
+	return cbs->len > 0 && cbs->data[0] == tag;
+}
+
+static int
+crl_stream_read(struct crl_stream *s, unsigned char *p, size_t n)
+{
+	int ret;
+
+	while (n > 0) {
+		ret = BIO_read(s->bio, p, n > INT_MAX ? INT_MAX : (int)n);
+		if (ret <= 0) {
+			ASN1error(ASN1_R_NOT_ENOUGH_DATA);
+			return 0;
+		}
+		p += ret;
+		n -= ret;
+	}
+	return 1;
+}
+
+/* Read the identifier and length octets of the next element. */
+static int
+crl_stream_header(struct crl_stream *s)
+{
+	size_t n = 0;
+
+	if (!crl_stream_read(s, s->buf, 2))
+		return 0;
+	if ((s->buf[1] & 0x80) != 0)
+		n = s->buf[1] & 0x7f;
+	if (n > 4 || !crl_stream_read(s, s->buf + 2, n))
+		goto err;
+	if (!crl_der_header(s->buf, 2 + n, &s->tag, &s->hdr_len, &s->len))
+		goto err;
+	return 1;
+
+ err:
+	ASN1error(ASN1_R_HEADER_TOO_LONG);
+	return 0;
+}
+
+/* Read the contents of the element whose header was just read. */
+static int
+crl_stream_content(struct crl_stream *s, size_t max)
+{
+	unsigned char *buf;
+	size_t size;
+
+	if (s->len > max) {
+		ASN1error(ASN1_R_TOO_LONG);
+		return 0;
+	}
+	if ((size = s->hdr_len + s->len) > s->buf_size) {
+		if ((buf = realloc(s->buf, size)) == NULL) {
+			ASN1error(ERR_R_MALLOC_FAILURE);
+			return 0;
+		}
+		s->buf = buf;
+		s->buf_size = size;
+	}
+	return crl_stream_read(s, s->buf + s->hdr_len, s->len);
+}
+
+static int
+crl_stream_element(struct crl_stream *s, size_t max)
+{
+	return crl_stream_header(s) && crl_stream_content(s, max);
+}
+
+static int
+crl_buf_append(BUF_MEM *b, const unsigned char *p, size_t n)
+{
+	size_t len = b->length;
+
+	if (BUF_MEM_grow(b, len + n) != len + n) {
+		ASN1error(ERR_R_MALLOC_FAILURE);
+		return 0;
+	}
+	memcpy(b->data + len, p, n);
+	return 1;
+}
+
+static size_t
+crl_der_put_header(unsigned char *p, unsigned char tag, size_t len)
+{
+	size_t i, n = 0;
+
+	p[0] = tag;
+	if (len < 0x80) {
+		p[1] = len;
+		return 2;
+	}
+	for (i = len; i > 0; i >>= 8)
+		n++;
+	p[1] = 0x80 | n;
+	for (i = 0; i < n; i++)
+		p[2 + i] = len >> (8 * (n - 1 - i));
+	return 2 + n;
+}
+
+static int
+crl_compact_cmp(const unsigned char *a, size_t a_len, int a_neg,
+    const unsigned char *b, size_t b_len, int b_neg)
+{
+	int ret;
+
+	/* The same order as ASN1_STRING_cmp(). */
+	if (a_len != b_len)
+		return a_len < b_len ? -1 : 1;
+	if ((ret = memcmp(a, b, a_len)) != 0)
+		return ret;
+	return a_neg - b_neg;
+}
+
+static int
+crl_compact_entry_cmp(const void *a, const void *b)
+{
+	const struct crl_compact_entry *ea = a, *eb = b;
+
+	return crl_compact_cmp(ea->serial, ea->serial_len, ea->neg,
+	    eb->serial, eb->serial_len, eb->neg);
+}
+
+/*
+ * Parse the extensions of one revoked entry. Only the reason code is
+ * kept; critical extensions are noted in flags as crl_set_issuers() does.
+ * Entries naming another certificate issuer belong to indirect CRLs,
+ * which need the full X509_REVOKED decoding.
+ */
+static int
+crl_parse_entry_exts(struct crl_cbs *exts, struct crl_compact_entry *e,
+    unsigned long *flags)
+{
+	struct crl_cbs ext, oid, crit, value, reason;
+
+	while (exts->len > 0) {
+		if (!crl_cbs_get(exts, &ext, 0x30) ||
+		    !crl_cbs_get(&ext, &oid, 0x06))
+			return 0;
+		crit.len = 0;
+		if (crl_cbs_peek(&ext, 0x01) && !crl_cbs_get(&ext, &crit, 0x01))
+			return 0;
+		if (!crl_cbs_get(&ext, &value, 0x04) || ext.len != 0)
+			return 0;
+
+		if (oid.len == sizeof(crl_oid_cert_issuer) &&
+		    memcmp(oid.data, crl_oid_cert_issuer, oid.len) == 0) {
+			X509error(X509_R_METHOD_NOT_SUPPORTED);
+			return 0;
+		}
+		if (crit.len == 1 && crit.data[0] != 0)
+			*flags |= EXFLAG_CRITICAL;
+
+		if (oid.len != sizeof(crl_oid_reason) ||
+		    memcmp(oid.data, crl_oid_reason, oid.len) != 0)
+			continue;
+		if (!crl_cbs_get(&value, &reason, 0x0a) || value.len != 0 ||
+		    reason.len != 1) {
+			*flags |= EXFLAG_INVALID;
+			continue;
+		}
+		e->reason = (int8_t)reason.data[0];
+	}
+	return 1;
+}
+
+static int
+crl_parse_entry(struct crl_compact *c, const unsigned char *p, size_t len,
+    unsigned long *flags)
+{
+	struct crl_cbs cbs, serial, date, exts;
+	struct crl_compact_entry *e;
+	ASN1_INTEGER *aint;
+	const unsigned char *q;
+	struct tm tm;
+	unsigned char tag;
+	size_t size;
+	time_t t;
+
+	cbs.data = p;
+	cbs.len = len;
+	if (!crl_cbs_get(&cbs, &serial, 0x02) ||
+	    !crl_cbs_get_any(&cbs, &date, &tag))
+		goto err;
+	if (tag != V_ASN1_UTCTIME && tag != V_ASN1_GENERALIZEDTIME)
+		goto err;
+
+	if (c->count == c->size) {
+		size = c->size > 0 ? c->size * 2 : 1024;
+		if ((e = reallocarray(c->entries, size, sizeof(*e))) == NULL) {
+			ASN1error(ERR_R_MALLOC_FAILURE);
+			return 0;
+		}
+		c->entries = e;
+		c->size = size;
+	}
+	e = &c->entries[c->count];
+	memset(e, 0, sizeof(*e));
+	e->reason = CRL_REASON_NONE;
+
+	/* Keep the serial the way c2i_ASN1_INTEGER() would. */
+	if (serial.len > 0 && (serial.data[0] & 0x80) != 0) {
+		q = serial.data;
+		if ((aint = c2i_ASN1_INTEGER(NULL, &q, serial.len)) == NULL)
+			return 0;
+		if (aint->length > CRL_COMPACT_SERIAL_MAX) {
+			ASN1_INTEGER_free(aint);
+			goto toolong;
+		}
+		memcpy(e->serial, aint->data, aint->length);
+		e->serial_len = aint->length;
+		e->neg = aint->type == V_ASN1_NEG_INTEGER;
+		ASN1_INTEGER_free(aint);
+	} else {
+		if (serial.len > 1 && serial.data[0] == 0) {
+			serial.data++;
+			serial.len--;
+		}
+		if (serial.len > CRL_COMPACT_SERIAL_MAX)
+			goto toolong;
+		memcpy(e->serial, serial.data, serial.len);
+		e->serial_len = serial.len;
+	}
+
+	memset(&tm, 0, sizeof(tm));
+	if (ASN1_time_parse((const char *)date.data, date.len, &tm,
+	    tag) == -1)
+		goto err;
+	if ((t = timegm(&tm)) == -1)
+		goto err;
+	e->time = t;
+
+	if (cbs.len > 0) {
+		if (!crl_cbs_get(&cbs, &exts, 0x30) || cbs.len != 0)
+			goto err;
+		if (!crl_parse_entry_exts(&exts, e, flags))
+			goto err;
+	}
+
+	c->count++;
+	return 1;
+
+ toolong:
+	X509error(X509_R_METHOD_NOT_SUPPORTED);
+	return 0;
+
+ err:
+	ASN1error(ASN1_R_DECODE_ERROR);
+	return 0;
+}
+
+/* Set up the digest named by the signature field of the TBSCertList. */
+static int
+crl_digest_init(struct crl_compact *c, EVP_MD_CTX *md_ctx,
+    const unsigned char *p, size_t len)
+{
+	X509_ALGOR *alg;
+	int mdnid, pknid;
+
+	if ((alg = d2i_X509_ALGOR(NULL, &p, len)) == NULL)
+		return 0;
+	if (!OBJ_find_sigid_algs(OBJ_obj2nid(alg->algorithm), &mdnid,
+	    &pknid)) {
+		X509_ALGOR_free(alg);
+		ASN1error(ASN1_R_UNKNOWN_SIGNATURE_ALGORITHM);
+		return 0;
+	}
+	X509_ALGOR_free(alg);
+
+	/*
+	 * Schemes such as RSA-PSS carry their digest in the parameters and
+	 * are verified by the key method from the whole TBSCertList.
+	 */
+	if (mdnid == NID_undef) {
+		X509error(X509_R_UNSUPPORTED_ALGORITHM);
+		return 0;
+	}
+	if ((c->md = EVP_get_digestbynid(mdnid)) == NULL) {
+		ASN1error(ASN1_R_UNKNOWN_MESSAGE_DIGEST_ALGORITHM);
+		return 0;
+	}
+	if (!EVP_DigestInit_ex(md_ctx, c->md, NULL)) {
+		ASN1error(ERR_R_EVP_LIB);
+		return 0;
+	}
+	return 1;
+}
+
+static void
+crl_compact_free(struct crl_compact *c)
+{
+	size_t i;
+
+	if (c == NULL)
+		return;
+	if (c->revoked != NULL) {
+		for (i = 0; i < c->count; i++)
+			X509_REVOKED_free(c->revoked[i]);
+		free(c->revoked);
+	}
+	free(c->entries);
+	free(c);
+}
+
+/*
+ * Build a CRL from the fields of the TBSCertList other than the revoked
+ * certificates (head) and from the outer signature fields (tail).
+ */
+static X509_CRL *
+crl_compact_skeleton(BUF_MEM *head, BUF_MEM *tail)
+{
+	X509_CRL *crl = NULL;
+	unsigned char *der, *p;
+	const unsigned char *q;
+	size_t len, tbs_len;
+
+	/* Each header is at most six octets. */
+	if ((der = malloc(head->length + tail->length + 12)) == NULL) {
+		ASN1error(ERR_R_MALLOC_FAILURE);
+		return NULL;
+	}
+	tbs_len = crl_der_put_header(der, 0x30, head->length) + head->length;
+	p = der + crl_der_put_header(der, 0x30, tbs_len + tail->length);
+	p += crl_der_put_header(p, 0x30, head->length);
+	memcpy(p, head->data, head->length);
+	p += head->length;
+	memcpy(p, tail->data, tail->length);
+	p += tail->length;
+	len = p - der;
+
+	q = der;
+	crl = d2i_X509_CRL(NULL, &q, len);
+	if (crl != NULL && q != der + len) {
+		ASN1error(ASN1_R_LENGTH_ERROR);
+		X509_CRL_free(crl);
+		crl = NULL;
+	}
+	free(der);
+	return crl;
+}
+
+X509_CRL *
+X509_CRL_read_compact_bio(BIO *bp)
+{
+	struct crl_stream s;
+	struct crl_compact *c = NULL;
+	EVP_MD_CTX md_ctx;
+	BUF_MEM *head = NULL, *tail = NULL;
+	X509_CRL *crl = NULL;
+	unsigned char tbs_hdr[6];
+	size_t outer_left, tbs_left, rev_left, n, tbs_hdr_len;
+	unsigned long flags = 0;
+	int stage = 0;
+
+	memset(&s, 0, sizeof(s));
+	EVP_MD_CTX_init(&md_ctx);
+
+	s.bio = bp;
+	s.buf_size = 256;
+	if ((s.buf = malloc(s.buf_size)) == NULL ||
+	    (c = calloc(1, sizeof(*c))) == NULL ||
+	    (head = BUF_MEM_new()) == NULL ||
+	    (tail = BUF_MEM_new()) == NULL) {
+		X509error(ERR_R_MALLOC_FAILURE);
+		goto err;
+	}
+
+	/* CertificateList and TBSCertList. */
+	if (!crl_stream_header(&s))
+		goto err;
+	if (s.tag != 0x30)
+		goto badtag;
+	outer_left = s.len;
+	if (!crl_stream_header(&s))
+		goto err;
+	if (s.tag != 0x30)
+		goto badtag;
+	if (s.hdr_len + s.len > outer_left)
+		goto badlen;
+	outer_left -= s.hdr_len + s.len;
+	tbs_left = s.len;
+	memcpy(tbs_hdr, s.buf, s.hdr_len);
+	tbs_hdr_len = s.hdr_len;
+
+	/* version and signature, then start hashing. */
+	if (!crl_stream_element(&s, CRL_COMPACT_FIELD_MAX))
+		goto err;
+	if (s.tag == V_ASN1_INTEGER) {
+		if (s.hdr_len + s.len > tbs_left)
+			goto badlen;
+		tbs_left -= s.hdr_len + s.len;
+		if (!crl_buf_append(head, s.buf, s.hdr_len + s.len))
+			goto err;
+		if (!crl_stream_element(&s, CRL_COMPACT_FIELD_MAX))
+			goto err;
+	}
+	if (s.tag != 0x30)
+		goto badtag;
+	if ((n = s.hdr_len + s.len) > tbs_left)
+		goto badlen;
+	tbs_left -= n;
+	if (!crl_buf_append(head, s.buf, n))
+		goto err;
+	if (!crl_digest_init(c, &md_ctx, s.buf, n))
+		goto err;
+	if (!EVP_DigestUpdate(&md_ctx, tbs_hdr, tbs_hdr_len) ||
+	    !EVP_DigestUpdate(&md_ctx, head->data, head->length))
+		goto evperr;
+
+	/* issuer and thisUpdate. */
+	if (!crl_stream_element(&s, CRL_COMPACT_FIELD_MAX))
+		goto err;
+	if (s.tag != 0x30)
+		goto badtag;
+	if ((n = s.hdr_len + s.len) > tbs_left)
+		goto badlen;
+	tbs_left -= n;
+	if (!crl_buf_append(head, s.buf, n) ||
+	    !EVP_DigestUpdate(&md_ctx, s.buf, n))
+		goto err;
+	if (!crl_stream_element(&s, CRL_COMPACT_FIELD_MAX))
+		goto err;
+	if (s.tag != V_ASN1_UTCTIME && s.tag != V_ASN1_GENERALIZEDTIME)
+		goto badtag;
+	if ((n = s.hdr_len + s.len) > tbs_left)
+		goto badlen;
+	tbs_left -= n;
+	if (!crl_buf_append(head, s.buf, n) ||
+	    !EVP_DigestUpdate(&md_ctx, s.buf, n))
+		goto err;
+
+	/* nextUpdate, revokedCertificates and crlExtensions, in order. */
+	while (tbs_left > 0) {
+		if (!crl_stream_header(&s))
+			goto err;
+		if (s.hdr_len + s.len > tbs_left)
+			goto badlen;
+		tbs_left -= s.hdr_len + s.len;
+
+		if (s.tag == 0x30 && stage < 2) {
+			stage = 2;
+			if (!EVP_DigestUpdate(&md_ctx, s.buf, s.hdr_len))
+				goto evperr;
+			for (rev_left = s.len; rev_left > 0; rev_left -= n) {
+				if (!crl_stream_element(&s,
+				    CRL_COMPACT_ENTRY_MAX))
+					goto err;
+				if (s.tag != 0x30)
+					goto badtag;
+				if ((n = s.hdr_len + s.len) > rev_left)
+					goto badlen;
+				if (!EVP_DigestUpdate(&md_ctx, s.buf, n))
+					goto evperr;
+				if (!crl_parse_entry(c, s.buf + s.hdr_len,
+				    s.len, &flags))
+					goto err;
+			}
+			continue;
+		}
+
+		if ((s.tag == V_ASN1_UTCTIME ||
+		    s.tag == V_ASN1_GENERALIZEDTIME) && stage < 1)
+			stage = 1;
+		else if (s.tag == 0xa0 && stage < 3)
+			stage = 3;
+		else
+			goto badtag;
+		if (!crl_stream_content(&s, CRL_COMPACT_FIELD_MAX))
+			goto err;
+		n = s.hdr_len + s.len;
+		if (!crl_buf_append(head, s.buf, n) ||
+		    !EVP_DigestUpdate(&md_ctx, s.buf, n))
+			goto err;
+	}
+	if (!EVP_DigestFinal_ex(&md_ctx, c->digest, &c->digest_len))
+		goto evperr;
+
+	/* signatureAlgorithm and signatureValue. */
+	if (!crl_stream_element(&s, CRL_COMPACT_FIELD_MAX))
+		goto err;
+	if (s.tag != 0x30)
+		goto badtag;
+	if ((n = s.hdr_len + s.len) > outer_left)
+		goto badlen;
+	outer_left -= n;
+	if (!crl_buf_append(tail, s.buf, n))
+		goto err;
+	if (!crl_stream_element(&s, CRL_COMPACT_FIELD_MAX))
+		goto err;
+	if (s.tag != V_ASN1_BIT_STRING)
+		goto badtag;
+	if ((n = s.hdr_len + s.len) != outer_left)
+		goto badlen;
+	if (!crl_buf_append(tail, s.buf, n))
+		goto err;
+
+	if (c->count > 1)
+		qsort(c->entries, c->count, sizeof(*c->entries),
+		    crl_compact_entry_cmp);
+
+	if ((crl = crl_compact_skeleton(head, tail)) == NULL)
+		goto err;
+	if (crl->meth->crl_free != NULL && !crl->meth->crl_free(crl))
+		goto err;
+	crl->meth = &compact_crl_meth;
+	crl->meth_data = c;
+	crl->flags |= flags;
+	c = NULL;
+	goto done;
+
+ evperr:
+	ASN1error(ERR_R_EVP_LIB);
+	goto err;
+ badlen:
+	ASN1error(ASN1_R_LENGTH_ERROR);
+	goto err;
+ badtag:
+	ASN1error(ASN1_R_WRONG_TAG);
+ err:
+	X509_CRL_free(crl);
+	crl = NULL;
+ done:
+	EVP_MD_CTX_cleanup(&md_ctx);
+	crl_compact_free(c);
+	BUF_MEM_free(head);
+	BUF_MEM_free(tail);
+	free(s.buf);
+	return crl;
+}
+
+static int
+compact_crl_free(X509_CRL *crl)
+{
+	crl_compact_free(crl->meth_data);
+	crl->meth_data = NULL;
+	return 1;
+}
+
+static X509_REVOKED *
+compact_crl_revoked(const struct crl_compact_entry *e)
+{
+	X509_REVOKED *rev;
+	ASN1_ENUMERATED *reason = NULL;
+
+	if ((rev = X509_REVOKED_new()) == NULL)
+		return NULL;
+	if (!ASN1_STRING_set(rev->serialNumber, e->serial, e->serial_len))
+		goto err;
+	rev->serialNumber->type = e->neg ? V_ASN1_NEG_INTEGER :
+	    V_ASN1_INTEGER;
+	if (ASN1_TIME_set(rev->revocationDate, (time_t)e->time) == NULL)
+		goto err;
+	rev->reason = e->reason;
+	if (e->reason != CRL_REASON_NONE) {
+		if ((reason = ASN1_ENUMERATED_new()) == NULL ||
+		    !ASN1_ENUMERATED_set(reason, e->reason) ||
+		    !X509_REVOKED_add1_ext_i2d(rev, NID_crl_reason, reason,
+		    0, 0))
+			goto err;
+		ASN1_ENUMERATED_free(reason);
+	}
+	return rev;
+
+ err:
+	ASN1_ENUMERATED_free(reason);
+	X509_REVOKED_free(rev);
+	return NULL;
+}
+
+/*
+ * Return the X509_REVOKED for entry e. Entries are materialised on first
+ * use into a slot of their own and kept for the lifetime of the CRL, since
+ * callers do not free what the lookup functions return. A slot is never
+ * changed once set, so later hits only need the read lock.
+ */
+static X509_REVOKED *
+compact_crl_found(struct crl_compact *c, const struct crl_compact_entry *e)
+{
+	X509_REVOKED *rev, *new;
+	size_t i = e - c->entries;
+
+	CRYPTO_r_lock(CRYPTO_LOCK_X509_CRL);
+	rev = c->revoked != NULL ? c->revoked[i] : NULL;
+	CRYPTO_r_unlock(CRYPTO_LOCK_X509_CRL);
+	if (rev != NULL)
+		return rev;
+
+	if ((new = compact_crl_revoked(e)) == NULL)
+		return NULL;
+
+	CRYPTO_w_lock(CRYPTO_LOCK_X509_CRL);
+	if (c->revoked == NULL)
+		c->revoked = calloc(c->count, sizeof(*c->revoked));
+	if (c->revoked != NULL) {
+		if (c->revoked[i] == NULL) {
+			c->revoked[i] = new;
+			new = NULL;
+		}
+		rev = c->revoked[i];
+	}
+	CRYPTO_w_unlock(CRYPTO_LOCK_X509_CRL);
+
+	X509_REVOKED_free(new);
+	return rev;
+}
+
+static int
+compact_crl_lookup(X509_CRL *crl, X509_REVOKED **ret, ASN1_INTEGER *serial,
+    X509_NAME *issuer)
+{
+	struct crl_compact *c = crl->meth_data;
+	const struct crl_compact_entry *e = NULL;
+	X509_REVOKED *rev;
+	size_t lo, hi, mid;
+	int cmp, neg;
+
+	if (issuer != NULL &&
+	    X509_NAME_cmp(issuer, X509_CRL_get_issuer(crl)) != 0)
+		return 0;
+	if (serial->length < 0 || serial->length > CRL_COMPACT_SERIAL_MAX)
+		return 0;
+	neg = serial->type == V_ASN1_NEG_INTEGER;
+
+	lo = 0;
+	hi = c->count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		cmp = crl_compact_cmp(c->entries[mid].serial,
+		    c->entries[mid].serial_len, c->entries[mid].neg,
+		    serial->data, serial->length, neg);
+		if (cmp == 0) {
+			e = &c->entries[mid];
+			break;
+		}
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (e == NULL)
+		return 0;
+
+	if (ret != NULL) {
+		if ((rev = compact_crl_found(c, e)) == NULL)
+			rev = &compact_crl_revoked_nomem;
+		*ret = rev;
+	}
+	if (e->reason == CRL_REASON_REMOVE_FROM_CRL)
+		return 2;
+	return 1;
+}
+
+static int
+compact_crl_verify(X509_CRL *crl, EVP_PKEY *pkey)
+{
+	struct crl_compact *c = crl->meth_data;
+	ASN1_BIT_STRING *sig = crl->signature;
+	EVP_PKEY_CTX *pctx = NULL;
+	int mdnid, pknid;
+	int ret = -1;
+
+	if (pkey == NULL) {
+		ASN1error(ERR_R_PASSED_NULL_PARAMETER);
+		return -1;
+	}
+	if (sig->type == V_ASN1_BIT_STRING && (sig->flags & 0x7) != 0) {
+		ASN1error(ASN1_R_INVALID_BIT_STRING_BITS_LEFT);
+		return -1;
+	}
+
+	/* The TBSCertList was hashed with the digest it names. */
+	if (!OBJ_find_sigid_algs(OBJ_obj2nid(crl->sig_alg->algorithm),
+	    &mdnid, &pknid)) {
+		ASN1error(ASN1_R_UNKNOWN_SIGNATURE_ALGORITHM);
+		return -1;
+	}
+	if (mdnid != EVP_MD_type(c->md)) {
+		ASN1error(ASN1_R_UNKNOWN_SIGNATURE_ALGORITHM);
+		return -1;
+	}
+	if (pkey->ameth == NULL ||
+	    EVP_PKEY_type(pknid) != pkey->ameth->pkey_id) {
+		ASN1error(ASN1_R_WRONG_PUBLIC_KEY_TYPE);
+		return -1;
+	}
+
+	if ((pctx = EVP_PKEY_CTX_new(pkey, NULL)) == NULL ||
+	    EVP_PKEY_verify_init(pctx) <= 0 ||
+	    EVP_PKEY_CTX_set_signature_md(pctx, c->md) <= 0) {
+		ASN1error(ERR_R_EVP_LIB);
+		goto done;
+	}
+	if (EVP_PKEY_verify(pctx, sig->data, sig->length, c->digest,
+	    c->digest_len) <= 0) {
+		ASN1error(ERR_R_EVP_LIB);
+		ret = 0;
+		goto done;
+	}
+	ret = 1;
+
+ done:
+	EVP_PKEY_CTX_free(pctx);
+	return ret;
+}
+
+size_t
+X509_CRL_compact_count(const X509_CRL *crl)
+{
+	const struct crl_compact *c;
+
+	if (crl->meth != &compact_crl_meth)
+		return 0;
+	c = crl->meth_data;
+	return c->count;
+}
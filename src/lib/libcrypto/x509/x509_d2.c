@@ -59,6 +59,7 @@
 #include <stdio.h>
 #include <sys/uio.h>
 
+#include <openssl/bio.h>
 #include <openssl/crypto.h>
 #include <openssl/err.h>
 #include <openssl/x509.h>
@@ -126,3 +127,24 @@ X509_STORE_load_mem(X509_STORE *ctx, void *buf, int len)
 
 	return (1);
 }
+
+int
+X509_STORE_load_compact_crl(X509_STORE *ctx, const char *file)
+{
+	X509_CRL		*crl;
+	BIO			*in;
+	int			 ret;
+
+	if ((in = BIO_new_file(file, "r")) == NULL) {
+		X509error(ERR_R_SYS_LIB);
+		return (0);
+	}
+	crl = X509_CRL_read_compact_bio(in);
+	BIO_free(in);
+	if (crl == NULL)
+		return (0);
+
+	ret = X509_STORE_add_crl(ctx, crl);
+	X509_CRL_free(crl);
+	return (ret);
+}
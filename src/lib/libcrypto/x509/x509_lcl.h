@@ -60,4 +60,15 @@ __BEGIN_HIDDEN_DECLS
 
 int x509_check_cert_time(X509_STORE_CTX *ctx, X509 *x, int quiet);
 
+#define X509_VERIFY_CACHE_KEY_LENGTH	SHA256_DIGEST_LENGTH
+
+X509_OBJECT *x509_store_lookup(X509_STORE *store, int type, X509_NAME *name);
+
+int x509_verify_cache_get(X509_STORE *store, const unsigned char *key);
+void x509_verify_cache_put(X509_STORE *store, const unsigned char *key);
+
+#define X509_BUNDLE_MAGIC_LEN	8
+
+int x509_bundle_magic_match(const void *buf, size_t len);
+
 __END_HIDDEN_DECLS
@@ -57,14 +57,57 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include <openssl/err.h>
 #include <openssl/lhash.h>
+#include <openssl/sha.h>
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
 #include "x509_lcl.h"
 
+/*
+ * Digests of chains that verified, with the parameters they verified
+ * under. The table is direct mapped: a new chain simply replaces
+ * whatever was in its slot.
+ */
+struct x509_verify_cache_entry {
+	unsigned char key[X509_VERIFY_CACHE_KEY_LENGTH];
+	int used;
+};
+
+struct x509_verify_cache_st {
+	struct x509_verify_cache_entry *entries;
+	size_t size;
+	unsigned long hits;
+	unsigned long misses;
+};
+
+/*
+ * Index of the store's certificates and CRLs by the hash of their subject
+ * (or CRL issuer) name and of the certificates by subject key identifier.
+ * Objects are never removed from a store, so readers only need the read
+ * lock while adding an object takes the write lock.
+ */
+struct x509_store_index_node {
+	X509_OBJECT *obj;
+	unsigned long name_hash;
+	unsigned long skid_hash;
+	struct x509_store_index_node *name_next;
+	struct x509_store_index_node *skid_next;
+};
+
+#define X509_STORE_INDEX_MIN_SIZE	64
+
+struct x509_store_index_st {
+	struct x509_store_index_node **name;
+	struct x509_store_index_node **skid;
+	size_t size;		/* number of buckets, a power of two */
+	size_t count;
+};
+
 static void X509_OBJECT_dec_ref_count(X509_OBJECT *a);
+static void x509_verify_cache_flush(X509_STORE *store);
 /* static void X509_OBJECT_up_ref_count(X509_OBJECT *a); */
 
 X509_LOOKUP *
@@ -193,6 +236,221 @@ x509_object_cmp(const X509_OBJECT * const *a, const X509_OBJECT * const *b)
 	return ret;
 }
 
+static unsigned long
+x509_store_hash(const unsigned char *p, size_t len)
+{
+	unsigned long h = 2166136261UL;
+
+	while (len-- > 0)
+		h = (h ^ *p++) * 16777619UL;
+	return h;
+}
+
+static int
+x509_store_name_hash(X509_NAME *name, unsigned long *hash)
+{
+	/* Ensure canonical encoding is present and up to date */
+	if ((name->canon_enc == NULL || name->modified) &&
+	    i2d_X509_NAME(name, NULL) < 0)
+		return 0;
+	*hash = x509_store_hash(name->canon_enc, name->canon_enclen);
+	return 1;
+}
+
+static X509_NAME *
+x509_object_name(X509_OBJECT *obj)
+{
+	switch (obj->type) {
+	case X509_LU_X509:
+		return X509_get_subject_name(obj->data.x509);
+	case X509_LU_CRL:
+		return X509_CRL_get_issuer(obj->data.crl);
+	}
+	return NULL;
+}
+
+static struct x509_store_index_st *
+x509_store_index_new(size_t size)
+{
+	struct x509_store_index_st *idx;
+
+	if ((idx = calloc(1, sizeof(*idx))) == NULL)
+		return NULL;
+	if ((idx->name = calloc(size, sizeof(*idx->name))) == NULL ||
+	    (idx->skid = calloc(size, sizeof(*idx->skid))) == NULL) {
+		free(idx->name);
+		free(idx);
+		return NULL;
+	}
+	idx->size = size;
+	return idx;
+}
+
+static void
+x509_store_index_free(struct x509_store_index_st *idx)
+{
+	struct x509_store_index_node *n, *next;
+	size_t i;
+
+	if (idx == NULL)
+		return;
+	for (i = 0; i < idx->size; i++) {
+		for (n = idx->name[i]; n != NULL; n = next) {
+			next = n->name_next;
+			free(n);
+		}
+	}
+	free(idx->name);
+	free(idx->skid);
+	free(idx);
+}
+
+/*
+ * Prepare an index node for obj. This is done before taking the store
+ * lock, as it may need to allocate and to cache the certificate's
+ * extensions.
+ */
+static struct x509_store_index_node *
+x509_store_index_node_new(X509_OBJECT *obj)
+{
+	struct x509_store_index_node *n;
+	ASN1_OCTET_STRING *skid = NULL;
+
+	if ((n = calloc(1, sizeof(*n))) == NULL)
+		return NULL;
+	n->obj = obj;
+	if (!x509_store_name_hash(x509_object_name(obj), &n->name_hash)) {
+		free(n);
+		return NULL;
+	}
+	if (obj->type == X509_LU_X509) {
+		X509_check_purpose(obj->data.x509, -1, 0);
+		skid = obj->data.x509->skid;
+	}
+	if (skid != NULL)
+		n->skid_hash = x509_store_hash(skid->data, skid->length);
+	return n;
+}
+
+static void
+x509_store_index_link(struct x509_store_index_st *idx,
+    struct x509_store_index_node *n)
+{
+	struct x509_store_index_node **pn;
+
+	/* Append, so that objects with the same name keep their order. */
+	n->name_next = NULL;
+	for (pn = &idx->name[n->name_hash & (idx->size - 1)]; *pn != NULL;
+	    pn = &(*pn)->name_next)
+		;
+	*pn = n;
+
+	n->skid_next = NULL;
+	if (n->obj->type != X509_LU_X509 || n->obj->data.x509->skid == NULL)
+		return;
+	for (pn = &idx->skid[n->skid_hash & (idx->size - 1)]; *pn != NULL;
+	    pn = &(*pn)->skid_next)
+		;
+	*pn = n;
+}
+
+/* Called with the store write locked. */
+static void
+x509_store_index_add(X509_STORE *store, struct x509_store_index_node *n)
+{
+	struct x509_store_index_st *idx = store->index, *nidx;
+	struct x509_store_index_node *p, *next;
+	size_t i;
+
+	/*
+	 * Keep the load factor below one. If the table cannot grow the
+	 * chains just get longer.
+	 */
+	if (idx->count >= idx->size &&
+	    (nidx = x509_store_index_new(idx->size * 2)) != NULL) {
+		for (i = 0; i < idx->size; i++) {
+			for (p = idx->name[i]; p != NULL; p = next) {
+				next = p->name_next;
+				x509_store_index_link(nidx, p);
+			}
+		}
+		nidx->count = idx->count;
+		free(idx->name);
+		free(idx->skid);
+		free(idx);
+		store->index = idx = nidx;
+	}
+	x509_store_index_link(idx, n);
+	idx->count++;
+}
+
+/*
+ * Return the first node from n on that holds an object of the given type
+ * and name. Called with the store locked.
+ */
+static struct x509_store_index_node *
+x509_store_index_find(struct x509_store_index_node *n, int type,
+    X509_NAME *name, unsigned long hash)
+{
+	for (; n != NULL; n = n->name_next) {
+		if (n->name_hash == hash && n->obj->type == type &&
+		    X509_NAME_cmp(x509_object_name(n->obj), name) == 0)
+			return n;
+	}
+	return NULL;
+}
+
+static struct x509_store_index_node *
+x509_store_index_first(X509_STORE *store, int type, X509_NAME *name,
+    unsigned long hash)
+{
+	struct x509_store_index_st *idx = store->index;
+
+	return x509_store_index_find(idx->name[hash & (idx->size - 1)],
+	    type, name, hash);
+}
+
+/*
+ * Return the first object of the given type and name in the store. Must be
+ * called with the store locked.
+ */
+X509_OBJECT *
+x509_store_lookup(X509_STORE *store, int type, X509_NAME *name)
+{
+	struct x509_store_index_node *n;
+	unsigned long hash;
+
+	if (!x509_store_name_hash(name, &hash))
+		return NULL;
+	if ((n = x509_store_index_first(store, type, name, hash)) == NULL)
+		return NULL;
+	return n->obj;
+}
+
+/* Find an object equal to obj. Called with the store locked. */
+static X509_OBJECT *
+x509_store_index_match(X509_STORE *store, struct x509_store_index_node *obj)
+{
+	struct x509_store_index_node *n;
+	X509_NAME *name = x509_object_name(obj->obj);
+	int type = obj->obj->type;
+
+	for (n = x509_store_index_first(store, type, name, obj->name_hash);
+	    n != NULL;
+	    n = x509_store_index_find(n->name_next, type, name,
+	    obj->name_hash)) {
+		if (type == X509_LU_X509) {
+			if (!X509_cmp(n->obj->data.x509, obj->obj->data.x509))
+				return n->obj;
+		} else {
+			if (!X509_CRL_match(n->obj->data.crl,
+			    obj->obj->data.crl))
+				return n->obj;
+		}
+	}
+	return NULL;
+}
+
 X509_STORE *
 X509_STORE_new(void)
 {
@@ -218,6 +476,11 @@ X509_STORE_new(void)
 	ret->lookup_certs = 0;
 	ret->lookup_crls = 0;
 	ret->cleanup = 0;
+	ret->verify_cache = NULL;
+
+	if ((ret->index = x509_store_index_new(X509_STORE_INDEX_MIN_SIZE)) ==
+	    NULL)
+		goto err;
 
 	if (!CRYPTO_new_ex_data(CRYPTO_EX_INDEX_X509_STORE, ret, &ret->ex_data))
 		goto err;
@@ -226,6 +489,7 @@ X509_STORE_new(void)
 	return ret;
 
 err:
+	x509_store_index_free(ret->index);
 	X509_VERIFY_PARAM_free(ret->param);
 	sk_X509_LOOKUP_free(ret->get_cert_methods);
 	sk_X509_OBJECT_free(ret->objs);
@@ -261,10 +525,14 @@ X509_STORE_free(X509_STORE *vfy)
 		X509_LOOKUP_free(lu);
 	}
 	sk_X509_LOOKUP_free(sk);
+	x509_store_index_free(vfy->index);
 	sk_X509_OBJECT_pop_free(vfy->objs, X509_OBJECT_free);
 
 	CRYPTO_free_ex_data(CRYPTO_EX_INDEX_X509_STORE, vfy, &vfy->ex_data);
 	X509_VERIFY_PARAM_free(vfy->param);
+	if (vfy->verify_cache != NULL)
+		free(vfy->verify_cache->entries);
+	free(vfy->verify_cache);
 	free(vfy);
 }
 
@@ -306,9 +574,9 @@ X509_STORE_get_by_subject(X509_STORE_CTX *vs, int type, X509_NAME *name,
 	X509_OBJECT stmp, *tmp;
 	int i, j;
 
-	CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
-	tmp = X509_OBJECT_retrieve_by_subject(ctx->objs, type, name);
-	CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
+	CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
+	tmp = x509_store_lookup(ctx, type, name);
+	CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
 
 	if (tmp == NULL || type == X509_LU_CRL) {
 		for (i = vs->current_method;
@@ -342,6 +610,7 @@ X509_STORE_get_by_subject(X509_STORE_CTX *vs, int type, X509_NAME *name,
 int
 X509_STORE_add_cert(X509_STORE *ctx, X509 *x)
 {
+	struct x509_store_index_node *node;
 	X509_OBJECT *obj;
 	int ret = 1;
 
@@ -355,11 +624,17 @@ X509_STORE_add_cert(X509_STORE *ctx, X509 *x)
 	obj->type = X509_LU_X509;
 	obj->data.x509 = x;
 
+	if ((node = x509_store_index_node_new(obj)) == NULL) {
+		X509error(ERR_R_MALLOC_FAILURE);
+		free(obj);
+		return 0;
+	}
+
 	CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
 
 	X509_OBJECT_up_ref_count(obj);
 
-	if (X509_OBJECT_retrieve_match(ctx->objs, obj)) {
+	if (x509_store_index_match(ctx, node)) {
 		X509error(X509_R_CERT_ALREADY_IN_HASH_TABLE);
 		ret = 0;
 	} else {
@@ -371,12 +646,17 @@ X509_STORE_add_cert(X509_STORE *ctx, X509 *x)
 
 	if (ret == 0)
 		X509_OBJECT_dec_ref_count(obj);
+	else {
+		x509_store_index_add(ctx, node);
+		x509_verify_cache_flush(ctx);
+	}
 
 	CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
 
 	if (ret == 0) {
 		obj->data.x509 = NULL; /* owned by the caller */
 		X509_OBJECT_free(obj);
+		free(node);
 	}
 
 	return ret;
@@ -385,6 +665,7 @@ X509_STORE_add_cert(X509_STORE *ctx, X509 *x)
 int
 X509_STORE_add_crl(X509_STORE *ctx, X509_CRL *x)
 {
+	struct x509_store_index_node *node;
 	X509_OBJECT *obj;
 	int ret = 1;
 
@@ -398,11 +679,17 @@ X509_STORE_add_crl(X509_STORE *ctx, X509_CRL *x)
 	obj->type = X509_LU_CRL;
 	obj->data.crl = x;
 
+	if ((node = x509_store_index_node_new(obj)) == NULL) {
+		X509error(ERR_R_MALLOC_FAILURE);
+		free(obj);
+		return 0;
+	}
+
 	CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
 
 	X509_OBJECT_up_ref_count(obj);
 
-	if (X509_OBJECT_retrieve_match(ctx->objs, obj)) {
+	if (x509_store_index_match(ctx, node)) {
 		X509error(X509_R_CERT_ALREADY_IN_HASH_TABLE);
 		ret = 0;
 	} else {
@@ -414,12 +701,17 @@ X509_STORE_add_crl(X509_STORE *ctx, X509_CRL *x)
 
 	if (ret == 0)
 		X509_OBJECT_dec_ref_count(obj);
+	else {
+		x509_store_index_add(ctx, node);
+		x509_verify_cache_flush(ctx);
+	}
 
 	CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
 
 	if (ret == 0) {
 		obj->data.crl = NULL; /* owned by the caller */
 		X509_OBJECT_free(obj);
+		free(node);
 	}
 
 	return ret;
@@ -526,98 +818,109 @@ X509_OBJECT_retrieve_by_subject(STACK_OF(X509_OBJECT) *h, int type,
 	return sk_X509_OBJECT_value(h, idx);
 }
 
+/*
+ * Push all certificates in the store with subject name nm onto sk.
+ * Return the number found or -1 on failure.
+ */
+static int
+x509_store_get1_certs(X509_STORE *store, X509_NAME *nm, STACK_OF(X509) *sk)
+{
+	struct x509_store_index_node *n;
+	unsigned long hash;
+	X509 *x;
+	int cnt = 0;
+
+	if (!x509_store_name_hash(nm, &hash))
+		return -1;
+
+	CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
+	for (n = x509_store_index_first(store, X509_LU_X509, nm, hash);
+	    n != NULL;
+	    n = x509_store_index_find(n->name_next, X509_LU_X509, nm, hash)) {
+		x = n->obj->data.x509;
+		CRYPTO_add(&x->references, 1, CRYPTO_LOCK_X509);
+		if (!sk_X509_push(sk, x)) {
+			CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
+			X509_free(x);
+			return -1;
+		}
+		cnt++;
+	}
+	CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
+	return cnt;
+}
+
 STACK_OF(X509) *
 X509_STORE_get1_certs(X509_STORE_CTX *ctx, X509_NAME *nm)
 {
-	int i, idx, cnt;
 	STACK_OF(X509) *sk;
-	X509 *x;
-	X509_OBJECT *obj;
+	X509_OBJECT xobj;
+	int cnt;
 
 	sk = sk_X509_new_null();
 	if (sk == NULL)
 		return NULL;
-	CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
-	idx = x509_object_idx_cnt(ctx->ctx->objs, X509_LU_X509, nm, &cnt);
-	if (idx < 0) {
+	cnt = x509_store_get1_certs(ctx->ctx, nm, sk);
+	if (cnt == 0) {
 		/* Nothing found in cache: do lookup to possibly add new
 		 * objects to cache
 		 */
-		X509_OBJECT xobj;
-		CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
 		if (!X509_STORE_get_by_subject(ctx, X509_LU_X509, nm, &xobj)) {
 			sk_X509_free(sk);
 			return NULL;
 		}
 		X509_OBJECT_free_contents(&xobj);
-		CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
-		idx = x509_object_idx_cnt(ctx->ctx->objs,
-		    X509_LU_X509, nm, &cnt);
-		if (idx < 0) {
-			CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
-			sk_X509_free(sk);
-			return NULL;
-		}
+		cnt = x509_store_get1_certs(ctx->ctx, nm, sk);
 	}
-	for (i = 0; i < cnt; i++, idx++) {
-		obj = sk_X509_OBJECT_value(ctx->ctx->objs, idx);
-		x = obj->data.x509;
-		CRYPTO_add(&x->references, 1, CRYPTO_LOCK_X509);
-		if (!sk_X509_push(sk, x)) {
-			CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
-			X509_free(x);
-			sk_X509_pop_free(sk, X509_free);
-			return NULL;
-		}
+	if (cnt <= 0) {
+		sk_X509_pop_free(sk, X509_free);
+		return NULL;
 	}
-	CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
 	return sk;
-
 }
 
 STACK_OF(X509_CRL) *
 X509_STORE_get1_crls(X509_STORE_CTX *ctx, X509_NAME *nm)
 {
-	int i, idx, cnt;
+	struct x509_store_index_node *n;
+	unsigned long hash;
 	STACK_OF(X509_CRL) *sk;
 	X509_CRL *x;
-	X509_OBJECT *obj, xobj;
+	X509_OBJECT xobj;
 
+	if (!x509_store_name_hash(nm, &hash))
+		return NULL;
 	sk = sk_X509_CRL_new_null();
 	if (sk == NULL)
 		return NULL;
-	CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
-	/* Check cache first */
-	idx = x509_object_idx_cnt(ctx->ctx->objs, X509_LU_CRL, nm, &cnt);
 
 	/* Always do lookup to possibly add new CRLs to cache
 	 */
-	CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
 	if (!X509_STORE_get_by_subject(ctx, X509_LU_CRL, nm, &xobj)) {
 		sk_X509_CRL_free(sk);
 		return NULL;
 	}
 	X509_OBJECT_free_contents(&xobj);
-	CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
-	idx = x509_object_idx_cnt(ctx->ctx->objs, X509_LU_CRL, nm, &cnt);
-	if (idx < 0) {
-		CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
-		sk_X509_CRL_free(sk);
-		return NULL;
-	}
 
-	for (i = 0; i < cnt; i++, idx++) {
-		obj = sk_X509_OBJECT_value(ctx->ctx->objs, idx);
-		x = obj->data.crl;
+	CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
+	for (n = x509_store_index_first(ctx->ctx, X509_LU_CRL, nm, hash);
+	    n != NULL;
+	    n = x509_store_index_find(n->name_next, X509_LU_CRL, nm, hash)) {
+		x = n->obj->data.crl;
 		CRYPTO_add(&x->references, 1, CRYPTO_LOCK_X509_CRL);
 		if (!sk_X509_CRL_push(sk, x)) {
-			CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
+			CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
 			X509_CRL_free(x);
 			sk_X509_CRL_pop_free(sk, X509_CRL_free);
 			return NULL;
 		}
 	}
-	CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
+	CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
+
+	if (sk_X509_CRL_num(sk) == 0) {
+		sk_X509_CRL_free(sk);
+		return NULL;
+	}
 	return sk;
 }
 
@@ -650,6 +953,30 @@ X509_OBJECT_retrieve_match(STACK_OF(X509_OBJECT) *h, X509_OBJECT *x)
 }
 
 
+/* Find a valid issuer of x by its authority key identifier; store locked. */
+static X509 *
+x509_store_issuer_by_skid(X509_STORE_CTX *ctx, X509 *x)
+{
+	struct x509_store_index_st *idx = ctx->ctx->index;
+	struct x509_store_index_node *n;
+	ASN1_OCTET_STRING *keyid;
+	unsigned long hash;
+
+	if (x->akid == NULL || (keyid = x->akid->keyid) == NULL)
+		return NULL;
+	hash = x509_store_hash(keyid->data, keyid->length);
+	for (n = idx->skid[hash & (idx->size - 1)]; n != NULL;
+	    n = n->skid_next) {
+		if (n->skid_hash != hash ||
+		    ASN1_OCTET_STRING_cmp(keyid, n->obj->data.x509->skid) != 0)
+			continue;
+		if (ctx->check_issued(ctx, x, n->obj->data.x509) &&
+		    x509_check_cert_time(ctx, n->obj->data.x509, 1))
+			return n->obj->data.x509;
+	}
+	return NULL;
+}
+
 /* Try to get issuer certificate from store. Due to limitations
  * of the API this can only retrieve a single certificate matching
  * a given subject name. However it will fill the cache with all
@@ -664,12 +991,24 @@ X509_OBJECT_retrieve_match(STACK_OF(X509_OBJECT) *h, X509_OBJECT *x)
 int
 X509_STORE_CTX_get1_issuer(X509 **issuer, X509_STORE_CTX *ctx, X509 *x)
 {
+	struct x509_store_index_node *n;
+	unsigned long hash;
 	X509_NAME *xn;
-	X509_OBJECT obj, *pobj;
-	int i, ok, idx, ret;
+	X509_OBJECT obj;
+	int ok, ret;
 
 	*issuer = NULL;
 	xn = X509_get_issuer_name(x);
+
+	/* Try the certificates already in the store by key identifier. */
+	X509_check_purpose(x, -1, 0);
+	CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
+	if ((*issuer = x509_store_issuer_by_skid(ctx, x)) != NULL)
+		CRYPTO_add(&(*issuer)->references, 1, CRYPTO_LOCK_X509);
+	CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
+	if (*issuer != NULL)
+		return 1;
+
 	ok = X509_STORE_get_by_subject(ctx, X509_LU_X509, xn, &obj);
 	if (ok != X509_LU_X509) {
 		if (ok == X509_LU_RETRY) {
@@ -692,37 +1031,31 @@ X509_STORE_CTX_get1_issuer(X509 **issuer, X509_STORE_CTX *ctx, X509 *x)
 	}
 	X509_OBJECT_free_contents(&obj);
 
-	/* Else find index of first cert accepted by 'check_issued' */
+	if (!x509_store_name_hash(xn, &hash))
+		return -1;
+
+	/* Else find first cert accepted by 'check_issued' */
 	ret = 0;
-	CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
-	idx = X509_OBJECT_idx_by_subject(ctx->ctx->objs, X509_LU_X509, xn);
-	if (idx != -1) /* should be true as we've had at least one match */ {
-		/* Look through all matching certs for suitable issuer */
-		for (i = idx; i < sk_X509_OBJECT_num(ctx->ctx->objs); i++) {
-			pobj = sk_X509_OBJECT_value(ctx->ctx->objs, i);
-			/* See if we've run past the matches */
-			if (pobj->type != X509_LU_X509)
-				break;
-			if (X509_NAME_cmp(xn,
-			    X509_get_subject_name(pobj->data.x509)))
+	CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
+	for (n = x509_store_index_first(ctx->ctx, X509_LU_X509, xn, hash);
+	    n != NULL;
+	    n = x509_store_index_find(n->name_next, X509_LU_X509, xn, hash)) {
+		if (ctx->check_issued(ctx, x, n->obj->data.x509)) {
+			*issuer = n->obj->data.x509;
+			ret = 1;
+			/*
+			 * If times check, exit with match,
+			 * otherwise keep looking. Leave last
+			 * match in issuer so we return nearest
+			 * match if no certificate time is OK.
+			 */
+			if (x509_check_cert_time(ctx, *issuer, 1))
 				break;
-			if (ctx->check_issued(ctx, x, pobj->data.x509)) {
-				*issuer = pobj->data.x509;
-				ret = 1;
-				/*
-				 * If times check, exit with match,
-				 * otherwise keep looking. Leave last
-				 * match in issuer so we return nearest
-				 * match if no certificate time is OK.
-				 */
-				if (x509_check_cert_time(ctx, *issuer, 1))
-					break;
-			}
 		}
 	}
-	CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
 	if (*issuer)
 		CRYPTO_add(&(*issuer)->references, 1, CRYPTO_LOCK_X509);
+	CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
 	return ret;
 }
 
@@ -757,6 +1090,123 @@ X509_STORE_set1_param(X509_STORE *ctx, X509_VERIFY_PARAM *param)
 	return X509_VERIFY_PARAM_set1(ctx->param, param);
 }
 
+/*
+ * Remember up to size chains that verified, so that verifying one of them
+ * again only has to redo the checks that depend on the time, the peer
+ * identity or revocation. A size of 0 turns the cache off.
+ */
+int
+X509_STORE_set_verify_cache_size(X509_STORE *ctx, size_t size)
+{
+	struct x509_verify_cache_st *cache = NULL, *old;
+
+	if (size > 0) {
+		if ((cache = calloc(1, sizeof(*cache))) == NULL ||
+		    (cache->entries = calloc(size,
+		    sizeof(*cache->entries))) == NULL) {
+			free(cache);
+			X509error(ERR_R_MALLOC_FAILURE);
+			return 0;
+		}
+		cache->size = size;
+	}
+
+	CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
+	old = ctx->verify_cache;
+	if (old != NULL && cache != NULL) {
+		cache->hits = old->hits;
+		cache->misses = old->misses;
+	}
+	ctx->verify_cache = cache;
+	CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
+
+	if (old != NULL)
+		free(old->entries);
+	free(old);
+	return 1;
+}
+
+unsigned long
+X509_STORE_verify_cache_hits(X509_STORE *ctx)
+{
+	unsigned long ret = 0;
+
+	CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
+	if (ctx->verify_cache != NULL)
+		ret = ctx->verify_cache->hits;
+	CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
+	return ret;
+}
+
+unsigned long
+X509_STORE_verify_cache_misses(X509_STORE *ctx)
+{
+	unsigned long ret = 0;
+
+	CRYPTO_r_lock(CRYPTO_LOCK_X509_STORE);
+	if (ctx->verify_cache != NULL)
+		ret = ctx->verify_cache->misses;
+	CRYPTO_r_unlock(CRYPTO_LOCK_X509_STORE);
+	return ret;
+}
+
+static struct x509_verify_cache_entry *
+x509_verify_cache_slot(struct x509_verify_cache_st *cache,
+    const unsigned char *key)
+{
+	size_t i;
+
+	i = (size_t)key[0] << 24 | (size_t)key[1] << 16 |
+	    (size_t)key[2] << 8 | key[3];
+	return &cache->entries[i % cache->size];
+}
+
+/* Return 1 if the chain with this key has verified before. */
+int
+x509_verify_cache_get(X509_STORE *store, const unsigned char *key)
+{
+	struct x509_verify_cache_entry *e;
+	int ret = 0;
+
+	CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
+	if (store->verify_cache != NULL) {
+		e = x509_verify_cache_slot(store->verify_cache, key);
+		ret = e->used &&
+		    memcmp(e->key, key, X509_VERIFY_CACHE_KEY_LENGTH) == 0;
+		if (ret)
+			store->verify_cache->hits++;
+		else
+			store->verify_cache->misses++;
+	}
+	CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
+	return ret;
+}
+
+void
+x509_verify_cache_put(X509_STORE *store, const unsigned char *key)
+{
+	struct x509_verify_cache_entry *e;
+
+	CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
+	if (store->verify_cache != NULL) {
+		e = x509_verify_cache_slot(store->verify_cache, key);
+		memcpy(e->key, key, X509_VERIFY_CACHE_KEY_LENGTH);
+		e->used = 1;
+	}
+	CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
+}
+
+/* Called with the store locked whenever a certificate or CRL is added. */
+static void
+x509_verify_cache_flush(X509_STORE *store)
+{
+	struct x509_verify_cache_st *cache = store->verify_cache;
+
+	if (cache != NULL)
+		memset(cache->entries, 0, cache->size *
+		    sizeof(*cache->entries));
+}
+
 void
 X509_STORE_set_verify_cb(X509_STORE *ctx,
     int (*verify_cb)(int, X509_STORE_CTX *))
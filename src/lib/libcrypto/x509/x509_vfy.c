@@ -71,6 +71,7 @@
 #include <openssl/evp.h>
 #include <openssl/lhash.h>
 #include <openssl/objects.h>
+#include <openssl/sha.h>
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
 #include "asn1_locl.h"
@@ -142,6 +143,8 @@ static int X509_cmp_time_internal(const ASN1_TIME *ctm, time_t *cmp_time,
     int clamp_notafter);
 
 static int internal_verify(X509_STORE_CTX *ctx);
+static int verify_cache_key(X509_STORE_CTX *ctx, unsigned char *key);
+static int verify_cached_chain(X509_STORE_CTX *ctx);
 
 int ASN1_time_tm_clamp_notafter(struct tm *tm);
 
@@ -227,6 +230,8 @@ X509_verify_cert(X509_STORE_CTX *ctx)
 	X509 *x, *xtmp, *xtmp2, *chain_ss = NULL;
 	int bad_chain = 0;
 	X509_VERIFY_PARAM *param = ctx->param;
+	unsigned char cache_key[X509_VERIFY_CACHE_KEY_LENGTH];
+	int cacheable = 0;
 	int depth, i, ok = 0;
 	int num, j, retry, trust;
 	int (*cb) (int xok, X509_STORE_CTX *xctx);
@@ -505,6 +510,22 @@ X509_verify_cert(X509_STORE_CTX *ctx)
 			goto end;
 	}
 
+	/*
+	 * A trusted chain that verified before only needs the checks that
+	 * do not depend on the chain alone. This is only done when nothing
+	 * can observe the skipped checks through a callback.
+	 */
+	if (!bad_chain && ctx->ctx != NULL && ctx->ctx->verify_cache != NULL &&
+	    ctx->verify == internal_verify && ctx->verify_cb == null_callback &&
+	    ctx->check_policy == check_policy && ctx->crls == NULL &&
+	    verify_cache_key(ctx, cache_key)) {
+		if (x509_verify_cache_get(ctx->ctx, cache_key)) {
+			ok = verify_cached_chain(ctx);
+			goto end;
+		}
+		cacheable = 1;
+	}
+
 	/* We have the chain complete: now we need to check its purpose */
 	ok = check_chain_extensions(ctx);
 	if (!ok)
@@ -538,6 +559,9 @@ X509_verify_cert(X509_STORE_CTX *ctx)
 	if (!bad_chain && (ctx->param->flags & X509_V_FLAG_POLICY_CHECK))
 		ok = ctx->check_policy(ctx);
 
+	if (ok > 0 && cacheable && ctx->error == X509_V_OK)
+		x509_verify_cache_put(ctx->ctx, cache_key);
+
  end:
 	if (sktmp != NULL)
 		sk_X509_free(sktmp);
@@ -1838,6 +1862,70 @@ check_cert:
 	return 1;
 }
 
+/*
+ * The cache key covers every certificate in the chain, how much of it is
+ * untrusted and the parameters that the skipped checks depend on.
+ */
+static int
+verify_cache_key(X509_STORE_CTX *ctx, unsigned char *key)
+{
+	X509_VERIFY_PARAM *param = ctx->param;
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned int mdlen;
+	ASN1_OBJECT *obj;
+	SHA256_CTX sha;
+	long v[6];
+	int i;
+
+	SHA256_Init(&sha);
+
+	v[0] = sk_X509_num(ctx->chain);
+	v[1] = ctx->last_untrusted;
+	/* The times are checked again on every hit. */
+	v[2] = param->flags &
+	    ~(X509_V_FLAG_USE_CHECK_TIME | X509_V_FLAG_NO_CHECK_TIME);
+	v[3] = param->purpose;
+	v[4] = param->trust;
+	v[5] = param->depth;
+	SHA256_Update(&sha, v, sizeof(v));
+
+	for (i = 0; i < sk_X509_num(ctx->chain); i++) {
+		if (!X509_digest(sk_X509_value(ctx->chain, i), EVP_sha256(),
+		    md, &mdlen))
+			return 0;
+		SHA256_Update(&sha, md, mdlen);
+	}
+	for (i = 0; i < sk_ASN1_OBJECT_num(param->policies); i++) {
+		obj = sk_ASN1_OBJECT_value(param->policies, i);
+		SHA256_Update(&sha, &obj->length, sizeof(obj->length));
+		SHA256_Update(&sha, obj->data, obj->length);
+	}
+
+	SHA256_Final(key, &sha);
+	return 1;
+}
+
+/*
+ * Verify a chain found in the verify cache. The extensions, name
+ * constraints, signatures and policies were checked when it was added,
+ * so only the identity, revocation and validity times are left.
+ */
+static int
+verify_cached_chain(X509_STORE_CTX *ctx)
+{
+	int i;
+
+	if (!check_id(ctx))
+		return 0;
+	if (!ctx->check_revocation(ctx))
+		return 0;
+	for (i = sk_X509_num(ctx->chain) - 1; i >= 0; i--) {
+		if (!x509_check_cert_time(ctx, sk_X509_value(ctx->chain, i), i))
+			return 0;
+	}
+	return 1;
+}
+
 int
 X509_cmp_current_time(const ASN1_TIME *ctm)
 {
@@ -198,6 +198,11 @@ struct x509_store_st
 
 	CRYPTO_EX_DATA ex_data;
 	int references;
+
+	/* Chains that verified, see X509_STORE_set_verify_cache_size() */
+	struct x509_verify_cache_st *verify_cache;
+	/* Index of objs by name and key identifier */
+	struct x509_store_index_st *index;
 	} /* X509_STORE */;
 
 int X509_STORE_set_depth(X509_STORE *store, int depth);
@@ -279,6 +284,8 @@ void X509_STORE_CTX_set_depth(X509_STORE_CTX *ctx, int depth);
 #define X509_L_FILE_LOAD	1
 #define X509_L_ADD_DIR		2
 #define X509_L_MEM		3
+#define X509_L_BUNDLE_LOAD	4
+#define X509_L_BUNDLE_MEM	5
 
 #define X509_LOOKUP_load_file(x,name,type) \
 		X509_LOOKUP_ctrl((x),X509_L_FILE_LOAD,(name),(long)(type),NULL)
@@ -290,6 +297,13 @@ void X509_STORE_CTX_set_depth(X509_STORE_CTX *ctx, int depth);
 		X509_LOOKUP_ctrl((x),X509_L_MEM,(const char *)(iov),\
 		(long)(type),NULL)
 
+#define X509_LOOKUP_load_bundle(x,name) \
+		X509_LOOKUP_ctrl((x),X509_L_BUNDLE_LOAD,(name),0,NULL)
+
+#define X509_LOOKUP_add_bundle_mem(x,iov) \
+		X509_LOOKUP_ctrl((x),X509_L_BUNDLE_MEM,(const char *)(iov),\
+		0,NULL)
+
 #define		X509_V_OK					0
 #define		X509_V_ERR_UNSPECIFIED				1
 #define		X509_V_ERR_UNABLE_TO_GET_ISSUER_CERT		2
@@ -435,6 +449,9 @@ int X509_STORE_set_flags(X509_STORE *ctx, unsigned long flags);
 int X509_STORE_set_purpose(X509_STORE *ctx, int purpose);
 int X509_STORE_set_trust(X509_STORE *ctx, int trust);
 int X509_STORE_set1_param(X509_STORE *ctx, X509_VERIFY_PARAM *pm);
+int X509_STORE_set_verify_cache_size(X509_STORE *ctx, size_t size);
+unsigned long X509_STORE_verify_cache_hits(X509_STORE *ctx);
+unsigned long X509_STORE_verify_cache_misses(X509_STORE *ctx);
 
 void X509_STORE_set_verify_cb(X509_STORE *ctx,
 				  int (*verify_cb)(int, X509_STORE_CTX *));
@@ -454,6 +471,7 @@ X509_LOOKUP *X509_STORE_add_lookup(X509_STORE *v, X509_LOOKUP_METHOD *m);
 X509_LOOKUP_METHOD *X509_LOOKUP_hash_dir(void);
 X509_LOOKUP_METHOD *X509_LOOKUP_file(void);
 X509_LOOKUP_METHOD *X509_LOOKUP_mem(void);
+X509_LOOKUP_METHOD *X509_LOOKUP_bundle(void);
 
 int X509_STORE_add_cert(X509_STORE *ctx, X509 *x);
 int X509_STORE_add_crl(X509_STORE *ctx, X509_CRL *x);
@@ -467,6 +485,7 @@ int X509_LOOKUP_ctrl(X509_LOOKUP *ctx, int cmd, const char *argc,
 int X509_load_cert_file(X509_LOOKUP *ctx, const char *file, int type);
 int X509_load_crl_file(X509_LOOKUP *ctx, const char *file, int type);
 int X509_load_cert_crl_file(X509_LOOKUP *ctx, const char *file, int type);
+int X509_bundle_write_bio(BIO *bp, STACK_OF(X509) *certs);
 
 
 X509_LOOKUP *X509_LOOKUP_new(X509_LOOKUP_METHOD *method);
@@ -485,6 +504,7 @@ int X509_LOOKUP_shutdown(X509_LOOKUP *ctx);
 int	X509_STORE_load_locations (X509_STORE *ctx,
 		const char *file, const char *dir);
 int	X509_STORE_load_mem(X509_STORE *ctx, void *buf, int len);
+int	X509_STORE_load_compact_crl(X509_STORE *ctx, const char *file);
 int	X509_STORE_set_default_paths(X509_STORE *ctx);
 
 int X509_STORE_CTX_get_ex_new_index(long argl, void *argp, CRYPTO_EX_new *new_func,
@@ -22,6 +22,8 @@ print<<___;
 
 .extern	OPENSSL_ia32cap_P
 .hidden	OPENSSL_ia32cap_P
+.extern	OPENSSL_ia32cap_ext_P
+.hidden	OPENSSL_ia32cap_ext_P
 
 .text
 
@@ -146,6 +148,16 @@ OPENSSL_ia32_cpuid:
 	or	%ecx,%r9d		# merge AMD XOP flag
 
 	mov	%edx,%r10d		# %r9d:%r10d is copy of %ecx:%edx
+
+	xor	%ebx,%ebx
+	cmp	\$7,%r11d		# extended features leaf available?
+	jb	.Lno_extended
+	mov	\$7,%eax
+	xor	%ecx,%ecx
+	cpuid
+.Lno_extended:
+	mov	%ebx,OPENSSL_ia32cap_ext_P(%rip)
+
 	bt	\$IA32CAP_BIT1_OSXSAVE,%r9d	# check OSXSAVE bit
 	jnc	.Lclear_avx
 	xor	%ecx,%ecx		# XCR0
@@ -156,6 +168,7 @@ OPENSSL_ia32_cpuid:
 .Lclear_avx:
 	mov	\$(~(IA32CAP_MASK1_AVX | IA32CAP_MASK1_FMA3 | IA32CAP_MASK1_AMD_XOP)),%eax
 	and	%eax,%r9d		# clear AVX, FMA and AMD XOP bits
+	andl	\$(~IA32CAP_EXT_MASK_AVX2),OPENSSL_ia32cap_ext_P(%rip)
 .Ldone:
 	shl	\$32,%r9
 	mov	%r10d,%eax
@@ -37,6 +37,11 @@
  * Assembly routines usually address OPENSSL_ia32cap_P as two 32-bit words,
  * hence two sets of bit numbers and masks. OPENSSL_cpu_caps() returns the
  * complete 64-bit word.
+ *
+ * On amd64, the value of %ebx after running "cpuid 7" (extended features)
+ * is written to OPENSSL_ia32cap_ext_P, which is returned by
+ * OPENSSL_cpu_caps_ext(). The AVX2 bit is cleared if the operating system
+ * does not preserve the YMM state.
  */
 
 /* bit numbers for the low word */
@@ -61,6 +66,13 @@
 
 #define	IA32CAP_BIT1_AMD_XOP	11
 
+/* bit numbers for the extended word */
+#define	IA32CAP_EXT_BIT_BMI1	3
+#define	IA32CAP_EXT_BIT_AVX2	5
+#define	IA32CAP_EXT_BIT_BMI2	8
+#define	IA32CAP_EXT_BIT_ADX	19
+#define	IA32CAP_EXT_BIT_SHA	29
+
 /* bit masks for the low word */
 #define	IA32CAP_MASK0_MMX	(1 << IA32CAP_BIT0_MMX)
 #define	IA32CAP_MASK0_FXSR	(1 << IA32CAP_BIT0_FXSR)
@@ -80,6 +92,13 @@
 
 #define	IA32CAP_MASK1_AMD_XOP	(1 << IA32CAP_BIT1_AMD_XOP)
 
+/* bit masks for the extended word */
+#define	IA32CAP_EXT_MASK_BMI1	(1 << IA32CAP_EXT_BIT_BMI1)
+#define	IA32CAP_EXT_MASK_AVX2	(1 << IA32CAP_EXT_BIT_AVX2)
+#define	IA32CAP_EXT_MASK_BMI2	(1 << IA32CAP_EXT_BIT_BMI2)
+#define	IA32CAP_EXT_MASK_ADX	(1 << IA32CAP_EXT_BIT_ADX)
+#define	IA32CAP_EXT_MASK_SHA	(1 << IA32CAP_EXT_BIT_SHA)
+
 /* bit masks for OPENSSL_cpu_caps() */
 #define	CPUCAP_MASK_MMX		IA32CAP_MASK0_MMX
 #define	CPUCAP_MASK_FXSR	IA32CAP_MASK0_FXSR
@@ -88,3 +107,4 @@
 #define	CPUCAP_MASK_PCLMUL	(1ULL << (32 + IA32CAP_BIT1_PCLMUL))
 #define	CPUCAP_MASK_SSSE3	(1ULL << (32 + IA32CAP_BIT1_SSSE3))
 #define	CPUCAP_MASK_AESNI	(1ULL << (32 + IA32CAP_BIT1_AESNI))
+#define	CPUCAP_MASK_AVX		(1ULL << (32 + IA32CAP_BIT1_AVX))
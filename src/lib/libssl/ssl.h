@@ -560,9 +560,13 @@ struct ssl_session_st {
 /* Don't attempt to automatically build certificate chain */
 #define SSL_MODE_NO_AUTO_CHAIN 0x00000008L
 /* Save RAM by releasing read and write buffers when they're empty. (SSL3 and
- * TLS only.)  "Released" buffers are put onto a free-list in the context
- * or just freed (depending on the context's setting for freelist_max_len). */
+ * TLS only.)  "Released" buffers are put into the context's buffer pool
+ * or just freed (depending on SSL_CTX_set_buffer_pool_max()). */
 #define SSL_MODE_RELEASE_BUFFERS 0x00000010L
+/* Decrypt application data records directly into the buffer passed to
+ * SSL_read() when it can hold the whole record, rather than decrypting in
+ * the read buffer and copying out. (TLS with AEAD cipher suites only.) */
+#define SSL_MODE_ZERO_COPY_READ 0x00000020L
 
 /* Note: SSL[_CTX]_set_{options,mode} use |= op on the previous value,
  * they cannot be used to clear bits. */
@@ -697,6 +701,7 @@ struct ssl_ctx_st {
 	(SSL_SESS_CACHE_NO_INTERNAL_LOOKUP|SSL_SESS_CACHE_NO_INTERNAL_STORE)
 
 struct lhash_st_SSL_SESSION *SSL_CTX_sessions(SSL_CTX *ctx);
+struct lhash_st_SSL_SESSION *SSL_CTX_sessions_shard(SSL_CTX *ctx, int idx);
 #define SSL_CTX_sess_number(ctx) \
 	SSL_CTX_ctrl(ctx,SSL_CTRL_SESS_NUMBER,0,NULL)
 #define SSL_CTX_sess_connect(ctx) \
@@ -1124,6 +1129,14 @@ int PEM_write_SSL_SESSION(FILE *fp, SSL_SESSION *x);
 #define SSL_CTRL_SET_MIN_PROTO_VERSION			123
 #define SSL_CTRL_SET_MAX_PROTO_VERSION			124
 
+#define SSL_CTRL_SET_MAX_SEND_RECORDS			125
+
+#define SSL_CTRL_SET_BUFFER_POOL_MAX			126
+#define SSL_CTRL_GET_BUFFER_POOL_MAX			127
+#define SSL_CTRL_BUFFER_POOL_HITS			128
+#define SSL_CTRL_BUFFER_POOL_MISSES			129
+#define SSL_CTRL_BUFFER_POOL_PEAK			130
+
 #define DTLSv1_get_timeout(ssl, arg) \
 	SSL_ctrl(ssl,DTLS_CTRL_GET_TIMEOUT,0, (void *)arg)
 #define DTLSv1_handle_timeout(ssl) \
@@ -1490,6 +1503,22 @@ int SSL_get_ex_data_X509_STORE_CTX_idx(void );
 #define SSL_set_max_send_fragment(ssl,m) \
 	SSL_ctrl(ssl,SSL_CTRL_SET_MAX_SEND_FRAGMENT,m,NULL)
 
+#define SSL_CTX_set_max_send_records(ctx,m) \
+	SSL_CTX_ctrl(ctx,SSL_CTRL_SET_MAX_SEND_RECORDS,m,NULL)
+#define SSL_set_max_send_records(ssl,m) \
+	SSL_ctrl(ssl,SSL_CTRL_SET_MAX_SEND_RECORDS,m,NULL)
+
+#define SSL_CTX_set_buffer_pool_max(ctx,m) \
+	SSL_CTX_ctrl(ctx,SSL_CTRL_SET_BUFFER_POOL_MAX,m,NULL)
+#define SSL_CTX_get_buffer_pool_max(ctx) \
+	SSL_CTX_ctrl(ctx,SSL_CTRL_GET_BUFFER_POOL_MAX,0,NULL)
+#define SSL_CTX_buffer_pool_hits(ctx) \
+	SSL_CTX_ctrl(ctx,SSL_CTRL_BUFFER_POOL_HITS,0,NULL)
+#define SSL_CTX_buffer_pool_misses(ctx) \
+	SSL_CTX_ctrl(ctx,SSL_CTRL_BUFFER_POOL_MISSES,0,NULL)
+#define SSL_CTX_buffer_pool_peak(ctx) \
+	SSL_CTX_ctrl(ctx,SSL_CTRL_BUFFER_POOL_PEAK,0,NULL)
+
 /* NB: the keylength is only applicable when is_export is true */
 void SSL_CTX_set_tmp_rsa_callback(SSL_CTX *ctx,
     RSA *(*cb)(SSL *ssl, int is_export, int keylength));
@@ -687,6 +687,215 @@ err:
 	return (0);
 }
 
+/*
+ * Each thread keeps the last read buffer and the last write buffer that a
+ * pooling connection released on it, so that a connection that releases
+ * and sets up its buffers on the same thread, as SSL_MODE_RELEASE_BUFFERS
+ * does for every record, takes no locks. The context's pool only sees the
+ * buffers that do not fit there.
+ */
+typedef struct ssl3_buf_cache_st {
+	void *rbuf;
+	size_t rbuf_len;
+	void *wbuf;
+	size_t wbuf_len;
+} SSL3_BUF_CACHE;
+
+static pthread_key_t ssl3_buf_cache_key;
+static pthread_once_t ssl3_buf_cache_once = PTHREAD_ONCE_INIT;
+static int ssl3_buf_cache_key_ok;
+
+static void
+ssl3_buf_cache_free(void *arg)
+{
+	SSL3_BUF_CACHE *cache = arg;
+
+	free(cache->rbuf);
+	free(cache->wbuf);
+	free(cache);
+}
+
+static void
+ssl3_buf_cache_init(void)
+{
+	ssl3_buf_cache_key_ok = pthread_key_create(&ssl3_buf_cache_key,
+	    ssl3_buf_cache_free) == 0;
+}
+
+/* Return this thread's cache, or NULL if it cannot be set up. */
+static SSL3_BUF_CACHE *
+ssl3_buf_cache(void)
+{
+	SSL3_BUF_CACHE *cache;
+
+	if (pthread_once(&ssl3_buf_cache_once, ssl3_buf_cache_init) != 0 ||
+	    !ssl3_buf_cache_key_ok)
+		return NULL;
+	if ((cache = pthread_getspecific(ssl3_buf_cache_key)) != NULL)
+		return cache;
+	if ((cache = calloc(1, sizeof(*cache))) == NULL)
+		return NULL;
+	if (pthread_setspecific(ssl3_buf_cache_key, cache) != 0) {
+		free(cache);
+		return NULL;
+	}
+	return cache;
+}
+
+/*
+ * Take a buffer of len bytes from this thread's cache or the context's
+ * pool, falling back to malloc() if the connection does not pool buffers
+ * or neither has a buffer of that size.
+ */
+static void *
+ssl3_buf_freelist_extract(SSL *s, int for_read, size_t len)
+{
+	SSL_CTX *ctx = s->ctx;
+	SSL3_BUF_FREELIST *list;
+	SSL3_BUF_FREELIST_ENTRY *ent = NULL;
+	SSL3_BUF_CACHE *cache;
+	void *mem;
+
+	if (!s->internal->buffer_pool)
+		return malloc(len);
+
+	if ((cache = ssl3_buf_cache()) != NULL) {
+		if (for_read && cache->rbuf != NULL &&
+		    cache->rbuf_len == len) {
+			mem = cache->rbuf;
+			cache->rbuf = NULL;
+			return mem;
+		}
+		if (!for_read && cache->wbuf != NULL &&
+		    cache->wbuf_len == len) {
+			mem = cache->wbuf;
+			cache->wbuf = NULL;
+			return mem;
+		}
+	}
+
+	CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+	list = for_read ? &ctx->internal->rbuf_freelist :
+	    &ctx->internal->wbuf_freelist;
+	if (list->chunklen == len && list->head != NULL) {
+		ent = list->head;
+		list->head = ent->next;
+		list->len--;
+		ctx->internal->stats.buf_hit++;
+	} else
+		ctx->internal->stats.buf_miss++;
+	CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+
+	if (ent == NULL)
+		return malloc(len);
+	return ent;
+}
+
+/*
+ * Return a buffer of len bytes to this thread's cache or to the context's
+ * pool, or free it if the connection does not pool buffers or the pool is
+ * full or holds buffers of a different size. A buffer that is kept is
+ * cleared first, since it holds this connection's plaintext and the next
+ * user may be another connection.
+ */
+static void
+ssl3_buf_freelist_insert(SSL *s, int for_read, size_t len, void *mem)
+{
+	SSL_CTX *ctx = s->ctx;
+	SSL3_BUF_FREELIST *list;
+	SSL3_BUF_FREELIST_ENTRY *ent;
+	SSL3_BUF_CACHE *cache;
+	int n;
+
+	if (mem == NULL)
+		return;
+	if (!s->internal->buffer_pool ||
+	    len < sizeof(SSL3_BUF_FREELIST_ENTRY)) {
+		free(mem);
+		return;
+	}
+	explicit_bzero(mem, len);
+
+	if ((cache = ssl3_buf_cache()) != NULL) {
+		if (for_read && cache->rbuf == NULL) {
+			cache->rbuf = mem;
+			cache->rbuf_len = len;
+			return;
+		}
+		if (!for_read && cache->wbuf == NULL) {
+			cache->wbuf = mem;
+			cache->wbuf_len = len;
+			return;
+		}
+	}
+
+	CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+	list = for_read ? &ctx->internal->rbuf_freelist :
+	    &ctx->internal->wbuf_freelist;
+	if (list->len == 0)
+		list->chunklen = len;
+	if (list->chunklen == len &&
+	    list->len < ctx->internal->freelist_max_len) {
+		ent = mem;
+		ent->next = list->head;
+		list->head = ent;
+		list->len++;
+		mem = NULL;
+
+		n = ctx->internal->rbuf_freelist.len +
+		    ctx->internal->wbuf_freelist.len;
+		if (n > ctx->internal->stats.buf_peak)
+			ctx->internal->stats.buf_peak = n;
+	}
+	CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+
+	free(mem);
+}
+
+static void
+ssl3_buf_freelist_trim_list(SSL3_BUF_FREELIST *list, unsigned int max)
+{
+	SSL3_BUF_FREELIST_ENTRY *ent;
+
+	while (list->len > max) {
+		ent = list->head;
+		list->head = ent->next;
+		list->len--;
+		free(ent);
+	}
+}
+
+/*
+ * Set the number of buffers of each kind the pool may hold, freeing any
+ * above the new limit. Returns the previous limit.
+ */
+unsigned int
+ssl3_buf_freelist_set_max(SSL_CTX *ctx, unsigned int max)
+{
+	unsigned int old;
+
+	CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+	old = ctx->internal->freelist_max_len;
+	ctx->internal->freelist_max_len = max;
+	ssl3_buf_freelist_trim_list(&ctx->internal->rbuf_freelist, max);
+	ssl3_buf_freelist_trim_list(&ctx->internal->wbuf_freelist, max);
+	CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+
+	return old;
+}
+
+unsigned int
+ssl3_buf_freelist_get_max(SSL_CTX *ctx)
+{
+	unsigned int max;
+
+	CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
+	max = ctx->internal->freelist_max_len;
+	CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+
+	return max;
+}
+
 int
 ssl3_setup_read_buffer(SSL *s)
 {
@@ -703,7 +912,7 @@ ssl3_setup_read_buffer(SSL *s)
 	if (s->s3->rbuf.buf == NULL) {
 		len = SSL3_RT_MAX_PLAIN_LENGTH +
 		    SSL3_RT_MAX_ENCRYPTED_OVERHEAD + headerlen + align;
-		if ((p = malloc(len)) == NULL)
+		if ((p = ssl3_buf_freelist_extract(s, 1, len)) == NULL)
 			goto err;
 		s->s3->rbuf.buf = p;
 		s->s3->rbuf.len = len;
@@ -732,12 +941,16 @@ ssl3_setup_write_buffer(SSL *s)
 
 	if (s->s3->wbuf.buf == NULL) {
 		len = s->max_send_fragment +
-		    SSL3_RT_SEND_MAX_ENCRYPTED_OVERHEAD + headerlen + align;
+		    SSL3_RT_SEND_MAX_ENCRYPTED_OVERHEAD + headerlen;
+		/* Room for coalesced application data records. */
+		if (!SSL_IS_DTLS(s))
+			len *= s->internal->max_send_records;
+		len += align;
 		if (!(s->internal->options & SSL_OP_DONT_INSERT_EMPTY_FRAGMENTS))
 			len += headerlen + align +
 			    SSL3_RT_SEND_MAX_ENCRYPTED_OVERHEAD;
 
-		if ((p = malloc(len)) == NULL)
+		if ((p = ssl3_buf_freelist_extract(s, 0, len)) == NULL)
 			goto err;
 		s->s3->wbuf.buf = p;
 		s->s3->wbuf.len = len;
@@ -763,7 +976,8 @@ ssl3_setup_buffers(SSL *s)
 int
 ssl3_release_write_buffer(SSL *s)
 {
-	free(s->s3->wbuf.buf);
+	ssl3_buf_freelist_insert(s, 0, s->s3->wbuf.len,
+	    s->s3->wbuf.buf);
 	s->s3->wbuf.buf = NULL;
 	return 1;
 }
@@ -771,7 +985,8 @@ ssl3_release_write_buffer(SSL *s)
 int
 ssl3_release_read_buffer(SSL *s)
 {
-	free(s->s3->rbuf.buf);
+	ssl3_buf_freelist_insert(s, 1, s->s3->rbuf.len,
+	    s->s3->rbuf.buf);
 	s->s3->rbuf.buf = NULL;
 	return 1;
 }
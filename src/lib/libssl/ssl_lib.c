@@ -140,6 +140,7 @@
  * OTHERWISE.
  */
 
+#include <limits.h>
 #include <stdio.h>
 
 #include "ssl_locl.h"
@@ -297,6 +298,8 @@ SSL_new(SSL_CTX *ctx)
 	X509_VERIFY_PARAM_inherit(s->param, ctx->param);
 	s->internal->quiet_shutdown = ctx->internal->quiet_shutdown;
 	s->max_send_fragment = ctx->internal->max_send_fragment;
+	s->internal->max_send_records = ctx->internal->max_send_records;
+	s->internal->buffer_pool = ssl3_buf_freelist_get_max(ctx) > 0;
 
 	CRYPTO_add(&ctx->references, 1, CRYPTO_LOCK_SSL_CTX);
 	s->ctx = ctx;
@@ -430,6 +433,7 @@ SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
 	 * that would conflict with any new session built out of this
 	 * id/id_len and the ssl_version in use by this SSL.
 	 */
+	SSL_SESSION_CACHE_SHARD *sc;
 	SSL_SESSION r, *p;
 
 	if (id_len > sizeof r.session_id)
@@ -439,9 +443,10 @@ SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
 	r.session_id_length = id_len;
 	memcpy(r.session_id, id, id_len);
 
-	CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
-	p = lh_SSL_SESSION_retrieve(ssl->ctx->internal->sessions, &r);
-	CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+	sc = ssl_session_cache_shard(ssl->ctx, id, id_len);
+	pthread_mutex_lock(&sc->lock);
+	p = lh_SSL_SESSION_retrieve(sc->sessions, &r);
+	pthread_mutex_unlock(&sc->lock);
 	return (p != NULL);
 }
 
@@ -1070,6 +1075,11 @@ SSL_ctrl(SSL *s, int cmd, long larg, void *parg)
 			return (0);
 		s->max_send_fragment = larg;
 		return (1);
+	case SSL_CTRL_SET_MAX_SEND_RECORDS:
+		if (larg < 1 || larg > SSL_MAX_SEND_RECORDS)
+			return (0);
+		s->internal->max_send_records = larg;
+		return (1);
 	case SSL_CTRL_GET_RI_SUPPORT:
 		if (s->s3)
 			return (S3I(s)->send_connection_binding);
@@ -1096,10 +1106,52 @@ SSL_callback_ctrl(SSL *s, int cmd, void (*fp)(void))
 	}
 }
 
+static unsigned long ssl_session_LHASH_HASH(const void *arg);
+static int ssl_session_LHASH_COMP(const void *arg1, const void *arg2);
+
+/*
+ * The session cache is split into shards, each with its own hash. Gather
+ * the sessions of all shards into one hash, rebuilt on every call, so that
+ * callers walking it see the whole cache.
+ */
 struct lhash_st_SSL_SESSION *
 SSL_CTX_sessions(SSL_CTX *ctx)
 {
-	return (ctx->internal->sessions);
+	struct lhash_st_SSL_SESSION *all;
+	SSL_SESSION_CACHE_SHARD *sc;
+	size_t j;
+	int i, error = 0;
+
+	if ((all = lh_SSL_SESSION_new()) == NULL)
+		return (NULL);
+	for (i = 0; i < SSL_SESSION_CACHE_SHARDS && !error; i++) {
+		sc = &ctx->internal->session_cache[i];
+		pthread_mutex_lock(&sc->lock);
+		for (j = 0; j < sc->heap_len && !error; j++) {
+			(void)lh_SSL_SESSION_insert(all, sc->heap[j]);
+			error = lh_SSL_SESSION_error(all) > 0;
+		}
+		pthread_mutex_unlock(&sc->lock);
+	}
+	if (error) {
+		lh_SSL_SESSION_free(all);
+		return (NULL);
+	}
+
+	CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+	lh_SSL_SESSION_free(ctx->internal->session_cache_all);
+	ctx->internal->session_cache_all = all;
+	CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+
+	return (all);
+}
+
+struct lhash_st_SSL_SESSION *
+SSL_CTX_sessions_shard(SSL_CTX *ctx, int idx)
+{
+	if (idx < 0 || idx >= SSL_SESSION_CACHE_SHARDS)
+		return (NULL);
+	return (ctx->internal->session_cache[idx].sessions);
 }
 
 long
@@ -1140,7 +1192,7 @@ SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
 		return (ctx->internal->session_cache_mode);
 
 	case SSL_CTRL_SESS_NUMBER:
-		return (lh_SSL_SESSION_num_items(ctx->internal->sessions));
+		return (ssl_session_cache_num(ctx));
 	case SSL_CTRL_SESS_CONNECT:
 		return (ctx->internal->stats.sess_connect);
 	case SSL_CTRL_SESS_CONNECT_GOOD:
@@ -1176,6 +1228,24 @@ SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
 			return (0);
 		ctx->internal->max_send_fragment = larg;
 		return (1);
+	case SSL_CTRL_SET_MAX_SEND_RECORDS:
+		if (larg < 1 || larg > SSL_MAX_SEND_RECORDS)
+			return (0);
+		ctx->internal->max_send_records = larg;
+		return (1);
+
+	case SSL_CTRL_SET_BUFFER_POOL_MAX:
+		if (larg < 0 || larg > UINT_MAX)
+			return (0);
+		return (ssl3_buf_freelist_set_max(ctx, larg));
+	case SSL_CTRL_GET_BUFFER_POOL_MAX:
+		return (ssl3_buf_freelist_get_max(ctx));
+	case SSL_CTRL_BUFFER_POOL_HITS:
+		return (ctx->internal->stats.buf_hit);
+	case SSL_CTRL_BUFFER_POOL_MISSES:
+		return (ctx->internal->stats.buf_miss);
+	case SSL_CTRL_BUFFER_POOL_PEAK:
+		return (ctx->internal->stats.buf_peak);
 	default:
 		return (ssl3_ctx_ctrl(ctx, cmd, larg, parg));
 	}
@@ -1754,6 +1824,69 @@ ssl_session_LHASH_COMP(const void *arg1, const void *arg2)
 	return ssl_session_cmp(a, b);
 }
 
+static void ssl_session_cache_free(SSL_CTX *ctx);
+
+/* Set up the shards and their locks, or nothing at all. */
+static int
+ssl_session_cache_init(SSL_CTX *ctx)
+{
+	SSL_SESSION_CACHE_SHARD *sc;
+	int i;
+
+	ctx->internal->session_cache_count = 0;
+	if (pthread_mutex_init(&ctx->internal->session_cache_count_lock,
+	    NULL) != 0)
+		return 0;
+
+	for (i = 0; i < SSL_SESSION_CACHE_SHARDS; i++) {
+		sc = &ctx->internal->session_cache[i];
+		sc->heap = NULL;
+		sc->heap_len = 0;
+		sc->heap_max = 0;
+		if (pthread_mutex_init(&sc->lock, NULL) != 0)
+			goto err;
+		if ((sc->sessions = lh_SSL_SESSION_new()) == NULL) {
+			pthread_mutex_destroy(&sc->lock);
+			goto err;
+		}
+	}
+
+	return 1;
+
+ err:
+	if (i == 0)
+		pthread_mutex_destroy(&ctx->internal->session_cache_count_lock);
+	ssl_session_cache_free(ctx);
+	return 0;
+}
+
+/* Free the shards, which must have been flushed. */
+static void
+ssl_session_cache_free(SSL_CTX *ctx)
+{
+	SSL_SESSION_CACHE_SHARD *sc;
+	int i;
+
+	if (ctx->internal->session_cache[0].sessions == NULL)
+		return;
+
+	for (i = 0; i < SSL_SESSION_CACHE_SHARDS; i++) {
+		sc = &ctx->internal->session_cache[i];
+		if (sc->sessions == NULL)
+			break;
+		lh_SSL_SESSION_free(sc->sessions);
+		sc->sessions = NULL;
+		free(sc->heap);
+		sc->heap = NULL;
+		sc->heap_len = sc->heap_max = 0;
+		pthread_mutex_destroy(&sc->lock);
+	}
+	pthread_mutex_destroy(&ctx->internal->session_cache_count_lock);
+
+	lh_SSL_SESSION_free(ctx->internal->session_cache_all);
+	ctx->internal->session_cache_all = NULL;
+}
+
 SSL_CTX *
 SSL_CTX_new(const SSL_METHOD *meth)
 {
@@ -1786,8 +1919,6 @@ SSL_CTX_new(const SSL_METHOD *meth)
 	ret->cert_store = NULL;
 	ret->internal->session_cache_mode = SSL_SESS_CACHE_SERVER;
 	ret->internal->session_cache_size = SSL_SESSION_CACHE_MAX_SIZE_DEFAULT;
-	ret->internal->session_cache_head = NULL;
-	ret->internal->session_cache_tail = NULL;
 
 	/* We take the system default */
 	ret->session_timeout = meth->internal->get_timeout();
@@ -1823,8 +1954,7 @@ SSL_CTX_new(const SSL_METHOD *meth)
 	ret->internal->app_gen_cookie_cb = 0;
 	ret->internal->app_verify_cookie_cb = 0;
 
-	ret->internal->sessions = lh_SSL_SESSION_new();
-	if (ret->internal->sessions == NULL)
+	if (!ssl_session_cache_init(ret))
 		goto err;
 	ret->cert_store = X509_STORE_new();
 	if (ret->cert_store == NULL)
@@ -1850,6 +1980,7 @@ SSL_CTX_new(const SSL_METHOD *meth)
 	ret->extra_certs = NULL;
 
 	ret->internal->max_send_fragment = SSL3_RT_MAX_PLAIN_LENGTH;
+	ret->internal->max_send_records = 1;
 
 	ret->internal->tlsext_servername_callback = 0;
 	ret->internal->tlsext_servername_arg = NULL;
@@ -1919,12 +2050,11 @@ SSL_CTX_free(SSL_CTX *ctx)
 	 * free ex_data, then finally free the cache.
 	 * (See ticket [openssl.org #212].)
 	 */
-	if (ctx->internal->sessions != NULL)
-		SSL_CTX_flush_sessions(ctx, 0);
+	SSL_CTX_flush_sessions(ctx, 0);
 
 	CRYPTO_free_ex_data(CRYPTO_EX_INDEX_SSL_CTX, ctx, &ctx->internal->ex_data);
 
-	lh_SSL_SESSION_free(ctx->internal->sessions);
+	ssl_session_cache_free(ctx);
 
 	X509_STORE_free(ctx->cert_store);
 	sk_SSL_CIPHER_free(ctx->cipher_list);
@@ -1948,6 +2078,8 @@ SSL_CTX_free(SSL_CTX *ctx)
 
 	free(ctx->internal->alpn_client_proto_list);
 
+	ssl3_buf_freelist_set_max(ctx, 0);
+
 	free(ctx->internal);
 	free(ctx);
 }
@@ -2479,6 +2611,7 @@ SSL_dup(SSL *s)
 
 	ret->internal->options = s->internal->options;
 	ret->internal->mode = s->internal->mode;
+	ret->internal->max_send_records = s->internal->max_send_records;
 	SSL_set_max_cert_list(ret, SSL_get_max_cert_list(s));
 	SSL_set_read_ahead(ret, SSL_get_read_ahead(s));
 	ret->internal->msg_callback = s->internal->msg_callback;
@@ -2742,6 +2875,7 @@ SSL_set_SSL_CTX(SSL *ssl, SSL_CTX* ctx)
 	CRYPTO_add(&ctx->references, 1, CRYPTO_LOCK_SSL_CTX);
 	SSL_CTX_free(ssl->ctx); /* decrement reference count */
 	ssl->ctx = ctx;
+	ssl->internal->buffer_pool = ssl3_buf_freelist_get_max(ctx) > 0;
 	return (ssl->ctx);
 }
 
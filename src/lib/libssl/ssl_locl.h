@@ -146,6 +146,7 @@
 #include <sys/types.h>
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -192,6 +193,12 @@ __BEGIN_HIDDEN_DECLS
 #define SSL_DECRYPT	0
 #define SSL_ENCRYPT	1
 
+/* Upper bound for SSL_{CTX_,}set_max_send_records(). */
+#define SSL_MAX_SEND_RECORDS	32
+
+/* Number of independently locked parts of the session cache. */
+#define SSL_SESSION_CACHE_SHARDS	16
+
 /*
  * Define the Bitmasks for SSL_CIPHER.algorithms.
  * This bits are used packed as dense as possible. If new methods/ciphers
@@ -408,9 +415,14 @@ typedef struct ssl_method_internal_st {
 typedef struct ssl_session_internal_st {
 	CRYPTO_EX_DATA ex_data; /* application specific data */
 
-	/* These are used to make removal of session-ids more
-	 * efficient and to implement a maximum cache size. */
-	struct ssl_session_st *prev, *next;
+	/* The cache shard holding this session and its position in the
+	 * shard's expiry heap, used to remove and re-order it. */
+	struct ssl_session_cache_shard_st *cache_shard;
+	size_t cache_index;
+
+	/* Links the sessions that SSL_CTX_flush_sessions() has taken out
+	 * of a shard, until the remove callback has seen them. */
+	struct ssl_session_st *flush_next;
 
 	/* Used to indicate that session resumption is not allowed.
 	 * Applications can also set this bit for a new session via
@@ -442,6 +454,31 @@ typedef struct ssl_handshake_st {
 	unsigned char *key_block;
 } SSL_HANDSHAKE;
 
+/*
+ * One part of the session cache, holding the sessions whose IDs hash to
+ * it. The sessions are also kept in a binary heap ordered by expiry time,
+ * with the session that expires first at heap[0].
+ */
+typedef struct ssl_session_cache_shard_st {
+	struct lhash_st_SSL_SESSION *sessions;
+	struct ssl_session_st **heap;
+	size_t heap_len;
+	size_t heap_max;
+
+	pthread_mutex_t lock;
+} SSL_SESSION_CACHE_SHARD;
+
+typedef struct ssl3_buf_freelist_entry_st {
+	struct ssl3_buf_freelist_entry_st *next;
+} SSL3_BUF_FREELIST_ENTRY;
+
+/* Released buffers of chunklen bytes, kept for reuse. */
+typedef struct ssl3_buf_freelist_st {
+	size_t chunklen;
+	unsigned int len;
+	SSL3_BUF_FREELIST_ENTRY *head;
+} SSL3_BUF_FREELIST;
+
 typedef struct ssl_ctx_internal_st {
 	uint16_t min_version;
 	uint16_t max_version;
@@ -502,13 +539,19 @@ typedef struct ssl_ctx_internal_st {
 	int (*tlsext_status_cb)(SSL *ssl, void *arg);
 	void *tlsext_status_arg;
 
-	struct lhash_st_SSL_SESSION *sessions;
+	SSL_SESSION_CACHE_SHARD session_cache[SSL_SESSION_CACHE_SHARDS];
+
+	/* Number of sessions in all shards, taken after a shard lock. */
+	unsigned long session_cache_count;
+	pthread_mutex_t session_cache_count_lock;
+
+	/* All sessions of all shards, as last returned by
+	 * SSL_CTX_sessions(). */
+	struct lhash_st_SSL_SESSION *session_cache_all;
 
 	/* Most session-ids that will be cached, default is
 	 * SSL_SESSION_CACHE_MAX_SIZE_DEFAULT. 0 is unlimited. */
 	unsigned long session_cache_size;
-	struct ssl_session_st *session_cache_head;
-	struct ssl_session_st *session_cache_tail;
 
 	/* This can have one of 2 values, ored together,
 	 * SSL_SESS_CACHE_CLIENT,
@@ -534,6 +577,9 @@ typedef struct ssl_ctx_internal_st {
 					 * indicates that the application is
 					 * supplying session-id's from other
 					 * processes - spooky :-) */
+		int buf_hit;		/* buffer taken from the pool */
+		int buf_miss;		/* buffer allocated */
+		int buf_peak;		/* most buffers held in the pool */
 	} stats;
 
 	CRYPTO_EX_DATA ex_data;
@@ -560,6 +606,18 @@ typedef struct ssl_ctx_internal_st {
 	 */
 	unsigned int max_send_fragment;
 
+	/* Maximum number of application data records that are encrypted
+	 * into the write buffer and flushed with a single write. */
+	unsigned int max_send_records;
+
+	/* Pools of read and write buffers released by connections that
+	 * did not fit into the releasing thread's cache, protected by
+	 * CRYPTO_LOCK_SSL_CTX and each holding up to freelist_max_len
+	 * buffers. */
+	unsigned int freelist_max_len;
+	SSL3_BUF_FREELIST rbuf_freelist;
+	SSL3_BUF_FREELIST wbuf_freelist;
+
 #ifndef OPENSSL_NO_ENGINE
 	/* Engine to pass requests for client certs to
 	 */
@@ -714,6 +772,12 @@ typedef struct ssl_internal_st {
 	 * and SSL_write() calls, good for nbio debuging :-) */
 	int debug;
 	long max_cert_list;
+	unsigned int max_send_records;
+
+	/* Release buffers into the thread's cache and the context's pool,
+	 * as the context's pool was enabled when the connection was made. */
+	int buffer_pool;
+
 	int first_packet;
 
 	int servername_done;	/* no further mod of servername
@@ -1051,6 +1115,9 @@ extern SSL3_ENC_METHOD TLSv1_2_enc_data;
 
 void ssl_clear_cipher_ctx(SSL *s);
 int ssl_clear_bad_session(SSL *s);
+SSL_SESSION_CACHE_SHARD *ssl_session_cache_shard(SSL_CTX *ctx,
+    const unsigned char *id, unsigned int id_len);
+unsigned long ssl_session_cache_num(SSL_CTX *ctx);
 CERT *ssl_cert_new(void);
 CERT *ssl_cert_dup(CERT *cert);
 int ssl_cert_inst(CERT **o);
@@ -1123,6 +1190,8 @@ int	ssl3_setup_read_buffer(SSL *s);
 int	ssl3_setup_write_buffer(SSL *s);
 int	ssl3_release_read_buffer(SSL *s);
 int	ssl3_release_write_buffer(SSL *s);
+unsigned int ssl3_buf_freelist_set_max(SSL_CTX *ctx, unsigned int max);
+unsigned int ssl3_buf_freelist_get_max(SSL_CTX *ctx);
 int	ssl3_new(SSL *s);
 void	ssl3_free(SSL *s);
 int	ssl3_accept(SSL *s);
@@ -121,7 +121,9 @@
 
 static int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
     unsigned int len, int create_empty_fragment);
-static int ssl3_get_record(SSL *s);
+static int ssl3_create_record(SSL *s, unsigned char *p, int type,
+    const unsigned char *buf, unsigned int len, int mac_size);
+static int ssl3_get_record(SSL *s, unsigned char *buf, unsigned int len);
 
 /*
  * Force a WANT_READ return for certain error conditions where
@@ -322,13 +324,19 @@ ssl3_packet_extend(SSL *s, int plen)
  * ssl->s3->internal->rrec.type    - is the type of record
  * ssl->s3->internal->rrec.data, 	 - data
  * ssl->s3->internal->rrec.length, - number of bytes
+ *
+ * If buf is not NULL, an application data record whose plaintext fits into
+ * len bytes may be decrypted directly into buf, in which case rrec.data
+ * points at buf.
  */
 /* used only by ssl3_read_bytes */
 static int
-ssl3_get_record(SSL *s)
+ssl3_get_record(SSL *s, unsigned char *buf, unsigned int len)
 {
+	const SSL_AEAD_CTX *aead;
 	int al;
 	int enc_err, n, i, ret = -1;
+	unsigned int overhead;
 	SSL3_RECORD *rr;
 	SSL_SESSION *sess;
 	unsigned char md[EVP_MAX_MD_SIZE];
@@ -431,6 +439,22 @@ ssl3_get_record(SSL *s)
 	/* decrypt in place in 'rr->input' */
 	rr->data = rr->input;
 
+	/*
+	 * Unless the record can be decrypted straight into the caller's
+	 * buffer, which saves copying the plaintext out of the read buffer.
+	 * The plaintext length is known up front for AEAD ciphers only.
+	 */
+	aead = s->internal->aead_read_ctx;
+	if (buf != NULL && aead != NULL &&
+	    rr->type == SSL3_RT_APPLICATION_DATA &&
+	    !S3I(s)->change_cipher_spec) {
+		overhead = aead->tag_len;
+		if (aead->variable_nonce_in_record)
+			overhead += aead->variable_nonce_len;
+		if (rr->length >= overhead && rr->length - overhead <= len)
+			rr->data = buf;
+	}
+
 	enc_err = s->method->internal->ssl3_enc->enc(s, 0);
 	/* enc_err is:
 	 *    0: (in non-constant time) if the record is publically invalid.
@@ -565,7 +589,7 @@ int
 ssl3_write_bytes(SSL *s, int type, const void *buf_, int len)
 {
 	const unsigned char *buf = buf_;
-	unsigned int tot, n, nw;
+	unsigned int tot, n, nw, max;
 	int i;
 
 	if (len < 0) {
@@ -590,9 +614,18 @@ ssl3_write_bytes(SSL *s, int type, const void *buf_, int len)
 	if (len < tot)
 		len = tot;
 	n = (len - tot);
+
+	/*
+	 * Application data may be encrypted into several records, which
+	 * are then flushed together by do_ssl3_write().
+	 */
+	max = s->max_send_fragment;
+	if (type == SSL3_RT_APPLICATION_DATA)
+		max *= s->internal->max_send_records;
+
 	for (;;) {
-		if (n > s->max_send_fragment)
-			nw = s->max_send_fragment;
+		if (n > max)
+			nw = max;
 		else
 			nw = n;
 
@@ -623,12 +656,11 @@ static int
 do_ssl3_write(SSL *s, int type, const unsigned char *buf,
     unsigned int len, int create_empty_fragment)
 {
-	unsigned char *p, *plen;
+	unsigned char *p, *end;
+	unsigned int done, nw;
 	int i, mac_size, clear = 0;
 	int prefix_len = 0;
-	int eivlen;
 	size_t align;
-	SSL3_RECORD *wr;
 	SSL3_BUFFER *wb = &(s->s3->wbuf);
 	SSL_SESSION *sess;
 
@@ -656,7 +688,6 @@ do_ssl3_write(SSL *s, int type, const unsigned char *buf,
 	if (len == 0 && !create_empty_fragment)
 		return 0;
 
-	wr = &(S3I(s)->wrec);
 	sess = s->session;
 
 	if ((sess == NULL) || (s->internal->enc_write_ctx == NULL) ||
@@ -709,7 +740,14 @@ do_ssl3_write(SSL *s, int type, const unsigned char *buf,
 
 		p = wb->buf + align;
 		wb->offset = align;
-	} else if (prefix_len) {
+
+		/* we are in a recursive call;
+		 * just return the length, don't write out anything here
+		 */
+		return ssl3_create_record(s, p, type, buf, 0, mac_size);
+	}
+
+	if (prefix_len) {
 		p = wb->buf + wb->offset + prefix_len;
 	} else {
 		align = (size_t)wb->buf + SSL3_RT_HEADER_LENGTH;
@@ -719,6 +757,54 @@ do_ssl3_write(SSL *s, int type, const unsigned char *buf,
 		wb->offset = align;
 	}
 
+	/*
+	 * Encrypt the data into consecutive records, for as long as they
+	 * fit into the write buffer, so that a single write flushes them.
+	 * The first record always fits, the buffer being sized for it.
+	 */
+	end = wb->buf + wb->len;
+	wb->left = prefix_len;
+	done = 0;
+	do {
+		nw = len - done;
+		if (nw > s->max_send_fragment)
+			nw = s->max_send_fragment;
+		if (done > 0 && (size_t)(end - p) < SSL3_RT_HEADER_LENGTH +
+		    nw + SSL3_RT_SEND_MAX_ENCRYPTED_OVERHEAD)
+			break;
+		if ((i = ssl3_create_record(s, p, type, &buf[done], nw,
+		    mac_size)) <= 0)
+			goto err;
+		p += i;
+		wb->left += i;
+		done += nw;
+	} while (done < len);
+
+	/* memorize arguments so that ssl3_write_pending can detect
+	 * bad write retries later */
+	S3I(s)->wpend_tot = done;
+	S3I(s)->wpend_buf = buf;
+	S3I(s)->wpend_type = type;
+	S3I(s)->wpend_ret = done;
+
+	/* we now just need to write the buffer */
+	return ssl3_write_pending(s, type, buf, done);
+err:
+	return -1;
+}
+
+/*
+ * Write a record of type 'type' holding 'len' bytes from 'buf' at 'p',
+ * returning the length of the record including its header.
+ */
+static int
+ssl3_create_record(SSL *s, unsigned char *p, int type,
+    const unsigned char *buf, unsigned int len, int mac_size)
+{
+	SSL3_RECORD *wr = &(S3I(s)->wrec);
+	unsigned char *plen;
+	int eivlen;
+
 	/* write the header */
 
 	*(p++) = type&0xff;
@@ -774,7 +860,7 @@ do_ssl3_write(SSL *s, int type, const unsigned char *buf,
 	if (mac_size != 0) {
 		if (tls1_mac(s,
 		    &(p[wr->length + eivlen]), 1) < 0)
-			goto err;
+			return -1;
 		wr->length += mac_size;
 	}
 
@@ -800,27 +886,7 @@ do_ssl3_write(SSL *s, int type, const unsigned char *buf,
 	wr->type=type; /* not needed but helps for debugging */
 	wr->length += SSL3_RT_HEADER_LENGTH;
 
-	if (create_empty_fragment) {
-		/* we are in a recursive call;
-		 * just return the length, don't write out anything here
-		 */
-		return wr->length;
-	}
-
-	/* now let's set up wb */
-	wb->left = prefix_len + wr->length;
-
-	/* memorize arguments so that ssl3_write_pending can detect
-	 * bad write retries later */
-	S3I(s)->wpend_tot = len;
-	S3I(s)->wpend_buf = buf;
-	S3I(s)->wpend_type = type;
-	S3I(s)->wpend_ret = len;
-
-	/* we now just need to write the buffer */
-	return ssl3_write_pending(s, type, buf, len);
-err:
-	return -1;
+	return wr->length;
 }
 
 /* if s->s3->wbuf.left != 0, we need to call this */
@@ -984,7 +1050,15 @@ start:
 
 	/* get new packet if necessary */
 	if ((rr->length == 0) || (s->internal->rstate == SSL_ST_READ_BODY)) {
-		ret = ssl3_get_record(s);
+		/*
+		 * ssl3_get_record() only decrypts into buf if the whole
+		 * plaintext of the record fits into len bytes.
+		 */
+		if (type == SSL3_RT_APPLICATION_DATA && !peek && len > 0 &&
+		    (s->internal->mode & SSL_MODE_ZERO_COPY_READ))
+			ret = ssl3_get_record(s, buf, (unsigned int)len);
+		else
+			ret = ssl3_get_record(s, NULL, 0);
 		if (ret <= 0)
 			return (ret);
 	}
@@ -1027,9 +1101,13 @@ start:
 		else
 			n = (unsigned int)len;
 
-		memcpy(buf, &(rr->data[rr->off]), n);
+		/* Nothing to copy if the record was decrypted into buf. */
+		if (&(rr->data[rr->off]) != buf) {
+			memcpy(buf, &(rr->data[rr->off]), n);
+			if (!peek)
+				memset(&(rr->data[rr->off]), 0, n);
+		}
 		if (!peek) {
-			memset(&(rr->data[rr->off]), 0, n);
 			rr->length -= n;
 			rr->off += n;
 			if (rr->length == 0) {
@@ -143,9 +143,13 @@
 
 #include "ssl_locl.h"
 
-static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s);
-static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION *s);
-static int remove_session_lock(SSL_CTX *ctx, SSL_SESSION *c, int lck);
+static void SSL_SESSION_heap_remove(SSL_SESSION_CACHE_SHARD *sc,
+    SSL_SESSION *s);
+static int SSL_SESSION_heap_add(SSL_SESSION_CACHE_SHARD *sc,
+    SSL_SESSION *s);
+static void SSL_SESSION_heap_fix(SSL_SESSION_CACHE_SHARD *sc, size_t i);
+static unsigned long ssl_session_cache_count(SSL_CTX *ctx, long n);
+static void ssl_session_cache_evict(SSL_CTX *ctx);
 
 /* aka SSL_get0_session; gets 0 objects, just returns a copy of the pointer */
 SSL_SESSION *
@@ -213,8 +217,8 @@ SSL_SESSION_new(void)
 	ss->references = 1;
 	ss->timeout=60*5+4; /* 5 minute timeout by default */
 	ss->time = time(NULL);
-	ss->internal->prev = NULL;
-	ss->internal->next = NULL;
+	ss->internal->cache_shard = NULL;
+	ss->internal->cache_index = 0;
 	ss->tlsext_hostname = NULL;
 
 	ss->internal->tlsext_ecpointformatlist_length = 0;
@@ -446,19 +450,21 @@ ssl_get_prev_session(SSL *s, unsigned char *session_id, int len,
 	if (try_session_cache && ret == NULL &&
 	    !(s->session_ctx->internal->session_cache_mode &
 	     SSL_SESS_CACHE_NO_INTERNAL_LOOKUP)) {
+		SSL_SESSION_CACHE_SHARD *sc;
 		SSL_SESSION data;
 		data.ssl_version = s->version;
 		data.session_id_length = len;
 		memcpy(data.session_id, session_id, len);
 
-		CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
-		ret = lh_SSL_SESSION_retrieve(s->session_ctx->internal->sessions, &data);
+		sc = ssl_session_cache_shard(s->session_ctx, session_id, len);
+		pthread_mutex_lock(&sc->lock);
+		ret = lh_SSL_SESSION_retrieve(sc->sessions, &data);
 		if (ret != NULL) {
 			/* Don't allow other threads to steal it. */
 			CRYPTO_add(&ret->references, 1,
 			    CRYPTO_LOCK_SSL_SESSION);
 		}
-		CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+		pthread_mutex_unlock(&sc->lock);
 
 		if (ret == NULL)
 			s->session_ctx->internal->stats.sess_miss++;
@@ -572,13 +578,14 @@ err:
 int
 SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 {
-	int ret = 0;
+	SSL_SESSION_CACHE_SHARD *sc;
+	unsigned long num = 0;
 	SSL_SESSION *s;
 
 	/*
 	 * Add just 1 reference count for the SSL_CTX's session cache
-	 * even though it has two ways of access: each session is in a
-	 * doubly linked list and an lhash.
+	 * even though it has two ways of access: each session is in an
+	 * expiry heap and an lhash.
 	 */
 	CRYPTO_add(&c->references, 1, CRYPTO_LOCK_SSL_SESSION);
 
@@ -586,17 +593,19 @@ SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 	 * If session c is in already in cache, we take back the increment
 	 * later.
 	 */
-	CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
-	s = lh_SSL_SESSION_insert(ctx->internal->sessions, c);
+	sc = ssl_session_cache_shard(ctx, c->session_id, c->session_id_length);
+	pthread_mutex_lock(&sc->lock);
+	s = lh_SSL_SESSION_insert(sc->sessions, c);
 
 	/*
 	 * s != NULL iff we already had a session with the given PID.
 	 * In this case, s == c should hold (then we did not really modify
-	 * ctx->internal->sessions), or we're in trouble.
+	 * the cache), or we're in trouble.
 	 */
 	if (s != NULL && s != c) {
 		/* We *are* in trouble ... */
-		SSL_SESSION_list_remove(ctx, s);
+		SSL_SESSION_heap_remove(sc, s);
+		ssl_session_cache_count(ctx, -1);
 		SSL_SESSION_free(s);
 		/*
 		 * ... so pretend the other session did not exist in cache
@@ -608,9 +617,17 @@ SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 		s = NULL;
 	}
 
-	/* Put at the head of the queue unless it is already in the cache */
-	if (s == NULL)
-		SSL_SESSION_list_add(ctx, c);
+	if (s == NULL) {
+		if (!SSL_SESSION_heap_add(sc, c)) {
+			(void)lh_SSL_SESSION_delete(sc->sessions, c);
+			pthread_mutex_unlock(&sc->lock);
+			SSL_SESSION_free(c);
+			SSLerrorx(ERR_R_MALLOC_FAILURE);
+			return (0);
+		}
+		num = ssl_session_cache_count(ctx, 1);
+	}
+	pthread_mutex_unlock(&sc->lock);
 
 	if (s != NULL) {
 		/*
@@ -619,52 +636,35 @@ SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 		 * cache.
 		 */
 		SSL_SESSION_free(s); /* s == c */
-		ret = 0;
-	} else {
-		/*
-		 * New cache entry -- remove old ones if cache has become
-		 * too large.
-		 */
+		return (0);
+	}
 
-		ret = 1;
+	/* New cache entry -- remove old ones if cache has become too large. */
+	if (SSL_CTX_sess_get_cache_size(ctx) > 0 &&
+	    num > (unsigned long)SSL_CTX_sess_get_cache_size(ctx))
+		ssl_session_cache_evict(ctx);
 
-		if (SSL_CTX_sess_get_cache_size(ctx) > 0) {
-			while (SSL_CTX_sess_number(ctx) >
-			    SSL_CTX_sess_get_cache_size(ctx)) {
-				if (!remove_session_lock(ctx,
-				    ctx->internal->session_cache_tail, 0))
-					break;
-				else
-					ctx->internal->stats.sess_cache_full++;
-			}
-		}
-	}
-	CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
-	return (ret);
+	return (1);
 }
 
 int
 SSL_CTX_remove_session(SSL_CTX *ctx, SSL_SESSION *c)
 {
-	return remove_session_lock(ctx, c, 1);
-}
-
-static int
-remove_session_lock(SSL_CTX *ctx, SSL_SESSION *c, int lck)
-{
+	SSL_SESSION_CACHE_SHARD *sc;
 	SSL_SESSION *r;
 	int ret = 0;
 
 	if ((c != NULL) && (c->session_id_length != 0)) {
-		if (lck)
-			CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
-		if ((r = lh_SSL_SESSION_retrieve(ctx->internal->sessions, c)) == c) {
+		sc = ssl_session_cache_shard(ctx, c->session_id,
+		    c->session_id_length);
+		pthread_mutex_lock(&sc->lock);
+		if ((r = lh_SSL_SESSION_retrieve(sc->sessions, c)) == c) {
 			ret = 1;
-			r = lh_SSL_SESSION_delete(ctx->internal->sessions, c);
-			SSL_SESSION_list_remove(ctx, c);
+			r = lh_SSL_SESSION_delete(sc->sessions, c);
+			SSL_SESSION_heap_remove(sc, c);
+			ssl_session_cache_count(ctx, -1);
 		}
-		if (lck)
-			CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+		pthread_mutex_unlock(&sc->lock);
 
 		if (ret) {
 			r->internal->not_resumable = 1;
@@ -753,12 +753,43 @@ SSL_set_session(SSL *s, SSL_SESSION *session)
 	return (ret);
 }
 
+/*
+ * Change the expiry time of a session, moving it in the expiry heap of
+ * the cache shard that holds it, if any. The shard is only stable while
+ * its lock is held, so look again whenever it changes under us.
+ */
+static void
+SSL_SESSION_set_expiry(SSL_SESSION *s, time_t stime, long timeout)
+{
+	SSL_SESSION_CACHE_SHARD *sc;
+
+	for (;;) {
+		if ((sc = s->internal->cache_shard) == NULL) {
+			s->time = stime;
+			s->timeout = timeout;
+			if (s->internal->cache_shard == NULL)
+				return;
+			continue;
+		}
+
+		pthread_mutex_lock(&sc->lock);
+		if (s->internal->cache_shard == sc) {
+			s->time = stime;
+			s->timeout = timeout;
+			SSL_SESSION_heap_fix(sc, s->internal->cache_index);
+			pthread_mutex_unlock(&sc->lock);
+			return;
+		}
+		pthread_mutex_unlock(&sc->lock);
+	}
+}
+
 long
 SSL_SESSION_set_timeout(SSL_SESSION *s, long t)
 {
 	if (s == NULL)
 		return (0);
-	s->timeout = t;
+	SSL_SESSION_set_expiry(s, s->time, t);
 	return (1);
 }
 
@@ -785,7 +816,7 @@ SSL_SESSION_set_time(SSL_SESSION *s, long t)
 {
 	if (s == NULL)
 		return (0);
-	s->time = t;
+	SSL_SESSION_set_expiry(s, t, s->timeout);
 	return (t);
 }
 
@@ -882,56 +913,107 @@ SSL_set_session_ticket_ext(SSL *s, void *ext_data, int ext_len)
 	return 0;
 }
 
-typedef struct timeout_param_st {
-	SSL_CTX *ctx;
-	long time;
-	struct lhash_st_SSL_SESSION *cache;
-} TIMEOUT_PARAM;
-
-static void
-timeout_doall_arg(SSL_SESSION *s, TIMEOUT_PARAM *p)
+/*
+ * Remove the sessions that have expired at time t, or all sessions if t
+ * is 0. The expiry heaps give the expired sessions first, so only those
+ * need to be visited. They are taken out of each shard under its lock and
+ * handed to the remove callback after it is released, since the callback
+ * may use the cache.
+ */
+/* XXX 2038 */
+void
+SSL_CTX_flush_sessions(SSL_CTX *s, long t)
 {
-	if ((p->time == 0) || (p->time > (s->time + s->timeout))) {
-		/* timeout */
-		/* The reason we don't call SSL_CTX_remove_session() is to
-		 * save on locking overhead */
-		(void)lh_SSL_SESSION_delete(p->cache, s);
-		SSL_SESSION_list_remove(p->ctx, s);
-		s->internal->not_resumable = 1;
-		if (p->ctx->internal->remove_session_cb != NULL)
-			p->ctx->internal->remove_session_cb(p->ctx, s);
-		SSL_SESSION_free(s);
+	SSL_SESSION_CACHE_SHARD *sc;
+	SSL_SESSION *ss, *victims, **tail;
+	long n;
+	int i;
+
+	for (i = 0; i < SSL_SESSION_CACHE_SHARDS; i++) {
+		sc = &s->internal->session_cache[i];
+		if (sc->sessions == NULL)
+			continue;
+
+		n = 0;
+		victims = NULL;
+		tail = &victims;
+		pthread_mutex_lock(&sc->lock);
+		while (sc->heap_len > 0) {
+			ss = sc->heap[0];
+			if (t != 0 && t <= ss->time + ss->timeout)
+				break;
+			/* The reason we don't call SSL_CTX_remove_session() is
+			 * to save on locking overhead */
+			(void)lh_SSL_SESSION_delete(sc->sessions, ss);
+			SSL_SESSION_heap_remove(sc, ss);
+			*tail = ss;
+			tail = &ss->internal->flush_next;
+			n++;
+		}
+		*tail = NULL;
+		if (n > 0)
+			ssl_session_cache_count(s, -n);
+		pthread_mutex_unlock(&sc->lock);
+
+		while ((ss = victims) != NULL) {
+			victims = ss->internal->flush_next;
+			ss->internal->flush_next = NULL;
+			ss->internal->not_resumable = 1;
+			if (s->internal->remove_session_cb != NULL)
+				s->internal->remove_session_cb(s, ss);
+			SSL_SESSION_free(ss);
+		}
 	}
 }
 
+/*
+ * Remove the sessions that expire first until the cache is back within
+ * its size. The oldest session is looked for in all shards, taking one
+ * shard lock at a time.
+ */
 static void
-timeout_LHASH_DOALL_ARG(void *arg1, void *arg2)
+ssl_session_cache_evict(SSL_CTX *ctx)
 {
-	SSL_SESSION *a = arg1;
-	TIMEOUT_PARAM *b = arg2;
+	SSL_SESSION_CACHE_SHARD *sc, *victim;
+	SSL_SESSION *ss;
+	long expiry = 0;
+	int i;
 
-	timeout_doall_arg(a, b);
-}
+	while (SSL_CTX_sess_get_cache_size(ctx) > 0 &&
+	    ssl_session_cache_num(ctx) >
+	    (unsigned long)SSL_CTX_sess_get_cache_size(ctx)) {
+		victim = NULL;
+		for (i = 0; i < SSL_SESSION_CACHE_SHARDS; i++) {
+			sc = &ctx->internal->session_cache[i];
+			pthread_mutex_lock(&sc->lock);
+			if (sc->heap_len > 0 && (victim == NULL ||
+			    sc->heap[0]->time + sc->heap[0]->timeout < expiry)) {
+				victim = sc;
+				expiry = sc->heap[0]->time + sc->heap[0]->timeout;
+			}
+			pthread_mutex_unlock(&sc->lock);
+		}
+		if (victim == NULL)
+			break;
 
-/* XXX 2038 */
-void
-SSL_CTX_flush_sessions(SSL_CTX *s, long t)
-{
-	unsigned long i;
-	TIMEOUT_PARAM tp;
+		ss = NULL;
+		pthread_mutex_lock(&victim->lock);
+		if (victim->heap_len > 0) {
+			ss = victim->heap[0];
+			(void)lh_SSL_SESSION_delete(victim->sessions, ss);
+			SSL_SESSION_heap_remove(victim, ss);
+			ssl_session_cache_count(ctx, -1);
+		}
+		pthread_mutex_unlock(&victim->lock);
 
-	tp.ctx = s;
-	tp.cache = s->internal->sessions;
-	if (tp.cache == NULL)
-		return;
-	tp.time = t;
-	CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
-	i = CHECKED_LHASH_OF(SSL_SESSION, tp.cache)->down_load;
-	CHECKED_LHASH_OF(SSL_SESSION, tp.cache)->down_load = 0;
-	lh_SSL_SESSION_doall_arg(tp.cache, timeout_LHASH_DOALL_ARG,
-	TIMEOUT_PARAM, &tp);
-	CHECKED_LHASH_OF(SSL_SESSION, tp.cache)->down_load = i;
-	CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+		if (ss != NULL) {
+			ctx->internal->stats.sess_cache_full++;
+			ss->internal->not_resumable = 1;
+			if (ctx->internal->remove_session_cb != NULL)
+				ctx->internal->remove_session_cb(ctx, ss);
+			SSL_SESSION_free(ss);
+		}
+	}
 }
 
 int
@@ -945,56 +1027,125 @@ ssl_clear_bad_session(SSL *s)
 		return (0);
 }
 
-/* locked by SSL_CTX in the calling function */
+static int
+SSL_SESSION_heap_before(const SSL_SESSION *a, const SSL_SESSION *b)
+{
+	return (a->time + a->timeout < b->time + b->timeout);
+}
+
 static void
-SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s)
+SSL_SESSION_heap_set(SSL_SESSION_CACHE_SHARD *sc, size_t i, SSL_SESSION *s)
 {
-	if ((s->internal->next == NULL) || (s->internal->prev == NULL))
-		return;
+	sc->heap[i] = s;
+	s->internal->cache_index = i;
+}
 
-	if (s->internal->next == (SSL_SESSION *)&(ctx->internal->session_cache_tail)) {
-		/* last element in list */
-		if (s->internal->prev == (SSL_SESSION *)&(ctx->internal->session_cache_head)) {
-			/* only one element in list */
-			ctx->internal->session_cache_head = NULL;
-			ctx->internal->session_cache_tail = NULL;
-		} else {
-			ctx->internal->session_cache_tail = s->internal->prev;
-			s->internal->prev->internal->next =
-			    (SSL_SESSION *)&(ctx->internal->session_cache_tail);
-		}
-	} else {
-		if (s->internal->prev == (SSL_SESSION *)&(ctx->internal->session_cache_head)) {
-			/* first element in list */
-			ctx->internal->session_cache_head = s->internal->next;
-			s->internal->next->internal->prev =
-			    (SSL_SESSION *)&(ctx->internal->session_cache_head);
-		} else {
-			/* middle of list */
-			s->internal->next->internal->prev = s->internal->prev;
-			s->internal->prev->internal->next = s->internal->next;
-		}
+/* Move the session at heap[i] up or down to its place. */
+static void
+SSL_SESSION_heap_fix(SSL_SESSION_CACHE_SHARD *sc, size_t i)
+{
+	SSL_SESSION *s = sc->heap[i];
+	size_t child, parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (!SSL_SESSION_heap_before(s, sc->heap[parent]))
+			break;
+		SSL_SESSION_heap_set(sc, i, sc->heap[parent]);
+		i = parent;
 	}
-	s->internal->prev = s->internal->next = NULL;
+	for (;;) {
+		child = 2 * i + 1;
+		if (child >= sc->heap_len)
+			break;
+		if (child + 1 < sc->heap_len &&
+		    SSL_SESSION_heap_before(sc->heap[child + 1], sc->heap[child]))
+			child++;
+		if (!SSL_SESSION_heap_before(sc->heap[child], s))
+			break;
+		SSL_SESSION_heap_set(sc, i, sc->heap[child]);
+		i = child;
+	}
+	SSL_SESSION_heap_set(sc, i, s);
 }
 
+/* locked by the shard in the calling function */
 static void
-SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION *s)
+SSL_SESSION_heap_remove(SSL_SESSION_CACHE_SHARD *sc, SSL_SESSION *s)
 {
-	if ((s->internal->next != NULL) && (s->internal->prev != NULL))
-		SSL_SESSION_list_remove(ctx, s);
-
-	if (ctx->internal->session_cache_head == NULL) {
-		ctx->internal->session_cache_head = s;
-		ctx->internal->session_cache_tail = s;
-		s->internal->prev = (SSL_SESSION *)&(ctx->internal->session_cache_head);
-		s->internal->next = (SSL_SESSION *)&(ctx->internal->session_cache_tail);
-	} else {
-		s->internal->next = ctx->internal->session_cache_head;
-		s->internal->next->internal->prev = s;
-		s->internal->prev = (SSL_SESSION *)&(ctx->internal->session_cache_head);
-		ctx->internal->session_cache_head = s;
+	SSL_SESSION *last;
+	size_t i;
+
+	if (s->internal->cache_shard != sc)
+		return;
+
+	i = s->internal->cache_index;
+	last = sc->heap[--sc->heap_len];
+	if (last != s) {
+		SSL_SESSION_heap_set(sc, i, last);
+		SSL_SESSION_heap_fix(sc, i);
+	}
+	s->internal->cache_shard = NULL;
+	s->internal->cache_index = 0;
+}
+
+/* locked by the shard in the calling function */
+static int
+SSL_SESSION_heap_add(SSL_SESSION_CACHE_SHARD *sc, SSL_SESSION *s)
+{
+	SSL_SESSION **heap;
+	size_t max;
+
+	if (sc->heap_len == sc->heap_max) {
+		max = sc->heap_max == 0 ? 16 : sc->heap_max * 2;
+		if ((heap = reallocarray(sc->heap, max, sizeof(*heap))) == NULL)
+			return 0;
+		sc->heap = heap;
+		sc->heap_max = max;
 	}
+
+	s->internal->cache_shard = sc;
+	SSL_SESSION_heap_set(sc, sc->heap_len++, s);
+	SSL_SESSION_heap_fix(sc, s->internal->cache_index);
+
+	return 1;
+}
+
+/*
+ * Session IDs may come from an application callback rather than being
+ * random, so all of their bytes are hashed to pick the shard.
+ */
+SSL_SESSION_CACHE_SHARD *
+ssl_session_cache_shard(SSL_CTX *ctx, const unsigned char *id,
+    unsigned int id_len)
+{
+	uint32_t h = 2166136261U;
+	unsigned int i;
+
+	for (i = 0; i < id_len; i++)
+		h = (h ^ id[i]) * 16777619U;
+
+	return &ctx->internal->session_cache[h % SSL_SESSION_CACHE_SHARDS];
+}
+
+/* Adjust the number of cached sessions by n and return the new number. */
+static unsigned long
+ssl_session_cache_count(SSL_CTX *ctx, long n)
+{
+	unsigned long num;
+
+	pthread_mutex_lock(&ctx->internal->session_cache_count_lock);
+	ctx->internal->session_cache_count += n;
+	num = ctx->internal->session_cache_count;
+	pthread_mutex_unlock(&ctx->internal->session_cache_count_lock);
+
+	return num;
+}
+
+unsigned long
+ssl_session_cache_num(SSL_CTX *ctx)
+{
+	return ssl_session_cache_count(ctx, 0);
 }
 
 void
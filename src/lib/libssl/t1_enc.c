@@ -853,9 +853,12 @@ tls1_enc(SSL *s, int send)
 			/* receive */
 			size_t len = rec->length;
 
-			if (rec->data != rec->input)
-				return -1;  /* internal error - should never happen. */
-			out = in = rec->input;
+			/*
+			 * The plaintext is either written in place, or to the
+			 * separate buffer that rec->data points at.
+			 */
+			in = rec->input;
+			out = rec->data;
 
 			if (len < aead->variable_nonce_len)
 				return 0;
@@ -884,9 +887,10 @@ tls1_enc(SSL *s, int send)
 			}
 
 			if (aead->variable_nonce_in_record) {
+				if (out == in)
+					out += aead->variable_nonce_len;
 				in += aead->variable_nonce_len;
 				len -= aead->variable_nonce_len;
-				out += aead->variable_nonce_len;
 			}
 
 			if (len < aead->tag_len)
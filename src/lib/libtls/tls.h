@@ -148,6 +148,9 @@ int tls_config_parse_protocols(uint32_t *_protocols, const char *_protostr);
 int tls_config_set_session_id(struct tls_config *_config,
     const unsigned char *_session_id, size_t _len);
 int tls_config_set_session_lifetime(struct tls_config *_config, int _lifetime);
+int tls_config_set_session_cache_size(struct tls_config *_config,
+    size_t _size);
+int tls_config_set_session_fd(struct tls_config *_config, int _session_fd);
 int tls_config_add_ticket_key(struct tls_config *_config, uint32_t _keyrev,
     unsigned char *_key, size_t _keylen);
 
@@ -189,6 +192,7 @@ const char *tls_conn_alpn_selected(struct tls *_ctx);
 const char *tls_conn_cipher(struct tls *_ctx);
 const char *tls_conn_servername(struct tls *_ctx);
 const char *tls_conn_version(struct tls *_ctx);
+int tls_conn_session_resumed(struct tls *_ctx);
 
 uint8_t *tls_load_file(const char *_file, size_t *_len, char *_password);
 void tls_unload_file(uint8_t *_buf, size_t len);
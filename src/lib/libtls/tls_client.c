@@ -17,10 +17,12 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
 
+#include <limits.h>
 #include <netdb.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -158,6 +160,182 @@ tls_connect_servername(struct tls *ctx, const char *host, const char *port,
 	return (rv);
 }
 
+static int
+tls_client_read_session(struct tls *ctx)
+{
+	int sfd = ctx->config->session_fd;
+	uint8_t *session = NULL;
+	size_t session_len = 0;
+	SSL_SESSION *ss = NULL;
+	BIO *bio = NULL;
+	struct stat sb;
+	ssize_t n;
+	int rv = -1;
+
+	if (fstat(sfd, &sb) == -1) {
+		tls_set_error(ctx, "failed to stat session file");
+		goto err;
+	}
+	if (sb.st_size < 0 || sb.st_size > INT_MAX) {
+		tls_set_errorx(ctx, "invalid session file size");
+		goto err;
+	}
+	session_len = (size_t)sb.st_size;
+
+	/* A zero size file means that we do not yet have a valid session. */
+	if (session_len == 0)
+		goto done;
+
+	if ((session = malloc(session_len)) == NULL)
+		goto err;
+
+	n = pread(sfd, session, session_len, 0);
+	if (n < 0 || (size_t)n != session_len) {
+		tls_set_error(ctx, "failed to read session file");
+		goto err;
+	}
+	if ((bio = BIO_new_mem_buf(session, session_len)) == NULL)
+		goto err;
+	if ((ss = d2i_SSL_SESSION_bio(bio, NULL)) == NULL) {
+		tls_set_errorx(ctx, "failed to parse session");
+		goto err;
+	}
+
+	if (SSL_set_session(ctx->ssl_conn, ss) != 1) {
+		tls_set_errorx(ctx, "failed to set session");
+		goto err;
+	}
+
+ done:
+	rv = 0;
+
+ err:
+	freezero(session, session_len);
+	SSL_SESSION_free(ss);
+	BIO_free(bio);
+
+	return (rv);
+}
+
+static int
+tls_client_write_session(struct tls *ctx)
+{
+	int sfd = ctx->config->session_fd;
+	SSL_SESSION *ss = NULL;
+	BIO *bio = NULL;
+	long data_len;
+	char *data;
+	off_t offset;
+	size_t len;
+	ssize_t n;
+	int rv = -1;
+
+	if ((ss = SSL_get1_session(ctx->ssl_conn)) == NULL) {
+		if (ftruncate(sfd, 0) == -1) {
+			tls_set_error(ctx, "failed to truncate session file");
+			goto err;
+		}
+		goto done;
+	}
+
+	if ((bio = BIO_new(BIO_s_mem())) == NULL)
+		goto err;
+	if (i2d_SSL_SESSION_bio(bio, ss) == 0)
+		goto err;
+	if ((data_len = BIO_get_mem_data(bio, &data)) <= 0)
+		goto err;
+
+	len = (size_t)data_len;
+	offset = 0;
+
+	if (ftruncate(sfd, len) == -1) {
+		tls_set_error(ctx, "failed to truncate session file");
+		goto err;
+	}
+	while (len > 0) {
+		if ((n = pwrite(sfd, data + offset, len, offset)) == -1) {
+			tls_set_error(ctx, "failed to write session file");
+			goto err;
+		}
+		offset += n;
+		len -= n;
+	}
+
+ done:
+	rv = 0;
+
+ err:
+	SSL_SESSION_free(ss);
+	BIO_free_all(bio);
+
+	return (rv);
+}
+
+/*
+ * Offer a session for resumption, preferring one that is cached in memory
+ * over the one stored in the session file.
+ */
+static int
+tls_client_set_session(struct tls *ctx)
+{
+	SSL_SESSION *ss;
+	int rv = -1;
+
+	if ((ss = tls_config_session_get(ctx->config,
+	    ctx->servername)) != NULL) {
+		if (SSL_set_session(ctx->ssl_conn, ss) != 1) {
+			tls_set_errorx(ctx, "failed to set session");
+			goto err;
+		}
+		goto done;
+	}
+
+	if (ctx->config->session_fd != -1) {
+		/* Do not read the file while another context writes it. */
+		pthread_mutex_lock(&ctx->config->mutex);
+		rv = tls_client_read_session(ctx);
+		pthread_mutex_unlock(&ctx->config->mutex);
+		if (rv == -1)
+			goto err;
+	}
+
+ done:
+	rv = 0;
+
+ err:
+	SSL_SESSION_free(ss);
+
+	return (rv);
+}
+
+static int
+tls_client_save_session(struct tls *ctx)
+{
+	SSL_SESSION *ss;
+	int rv = 0;
+
+	if ((ss = SSL_get_session(ctx->ssl_conn)) == NULL)
+		return (0);
+
+	if (tls_config_session_put(ctx->config, ctx->servername, ss) == -1) {
+		tls_set_errorx(ctx, "out of memory");
+		return (-1);
+	}
+
+	/*
+	 * A resumed session is already in the session file, unless the
+	 * file was written by another process in the meantime.
+	 */
+	if (ctx->config->session_fd != -1 &&
+	    !SSL_session_reused(ctx->ssl_conn)) {
+		pthread_mutex_lock(&ctx->config->mutex);
+		rv = tls_client_write_session(ctx);
+		pthread_mutex_unlock(&ctx->config->mutex);
+	}
+
+	return (rv);
+}
+
 static int
 tls_connect_common(struct tls *ctx, const char *servername)
 {
@@ -211,6 +389,11 @@ tls_connect_common(struct tls *ctx, const char *servername)
 		goto err;
 	}
 
+	/* Sessions are only resumed via tickets. */
+	if (ctx->config->session_cache_size > 0 ||
+	    ctx->config->session_fd != -1)
+		SSL_CTX_clear_options(ctx->ssl_ctx, SSL_OP_NO_TICKET);
+
 	if ((ctx->ssl_conn = SSL_new(ctx->ssl_ctx)) == NULL) {
 		tls_set_errorx(ctx, "ssl connection failure");
 		goto err;
@@ -226,6 +409,9 @@ tls_connect_common(struct tls *ctx, const char *servername)
 		goto err;
 	}
 
+	if (tls_client_set_session(ctx) == -1)
+		goto err;
+
 	/*
 	 * RFC4366 (SNI): Literal IPv4 and IPv6 addresses are not
 	 * permitted in "HostName".
@@ -335,6 +521,9 @@ tls_handshake_client(struct tls *ctx)
 		}
 	}
 
+	if (tls_client_save_session(ctx) == -1)
+		goto err;
+
 	ctx->state |= TLS_HANDSHAKE_COMPLETE;
 	rv = 0;
 
@@ -204,10 +204,16 @@ tls_config_new(void)
 	if ((config = calloc(1, sizeof(*config))) == NULL)
 		return (NULL);
 
+	if (pthread_mutex_init(&config->mutex, NULL) != 0) {
+		free(config);
+		return (NULL);
+	}
+
 	if ((config->keypair = tls_keypair_new()) == NULL)
 		goto err;
 
 	config->refcount = 1;
+	config->session_fd = -1;
 
 	/*
 	 * Default configuration.
@@ -246,15 +252,56 @@ tls_config_new(void)
 	return (NULL);
 }
 
+static void
+tls_session_free(struct tls_session *sess)
+{
+	if (sess == NULL)
+		return;
+
+	free(sess->servername);
+	freezero(sess->data, sess->data_len);
+	free(sess);
+}
+
+/*
+ * Drop the least recently used sessions beyond the cache size. The caller
+ * holds the config mutex.
+ */
+static void
+tls_config_session_trim(struct tls_config *config)
+{
+	struct tls_session *sess, *next, **prev;
+	size_t n = 0;
+
+	for (prev = &config->sessions; (sess = *prev) != NULL;
+	    prev = &sess->next) {
+		if (++n > config->session_cache_size)
+			break;
+	}
+	*prev = NULL;
+
+	while (sess != NULL) {
+		next = sess->next;
+		tls_session_free(sess);
+		config->sessions_len--;
+		sess = next;
+	}
+}
+
 void
 tls_config_free(struct tls_config *config)
 {
 	struct tls_keypair *kp, *nkp;
+	int refcount;
 
 	if (config == NULL)
 		return;
 
-	if (--config->refcount > 0)
+	pthread_mutex_lock(&config->mutex);
+	refcount = --config->refcount;
+	pthread_mutex_unlock(&config->mutex);
+
+	if (refcount > 0)
 		return;
 
 	for (kp = config->keypair; kp != NULL; kp = nkp) {
@@ -262,6 +309,10 @@ tls_config_free(struct tls_config *config)
 		tls_keypair_free(kp);
 	}
 
+	config->session_cache_size = 0;
+	tls_config_session_trim(config);
+	pthread_mutex_destroy(&config->mutex);
+
 	free(config->error.msg);
 
 	free(config->alpn);
@@ -901,6 +952,193 @@ tls_config_set_session_lifetime(struct tls_config *config, int lifetime)
 	return (0);
 }
 
+int
+tls_config_set_session_cache_size(struct tls_config *config, size_t size)
+{
+	pthread_mutex_lock(&config->mutex);
+	config->session_cache_size = size;
+	tls_config_session_trim(config);
+	pthread_mutex_unlock(&config->mutex);
+
+	return (0);
+}
+
+int
+tls_config_set_session_fd(struct tls_config *config, int session_fd)
+{
+	struct stat sb;
+	mode_t mugo;
+
+	if (session_fd == -1) {
+		config->session_fd = session_fd;
+		return (0);
+	}
+
+	if (fstat(session_fd, &sb) == -1) {
+		tls_config_set_error(config, "failed to stat session file");
+		return (-1);
+	}
+	if (!S_ISREG(sb.st_mode)) {
+		tls_config_set_errorx(config,
+		    "session file is not a regular file");
+		return (-1);
+	}
+
+	if (sb.st_uid != getuid()) {
+		tls_config_set_errorx(config, "session file has incorrect "
+		    "owner (uid %i != %i)", sb.st_uid, getuid());
+		return (-1);
+	}
+	mugo = sb.st_mode & (S_IRWXU|S_IRWXG|S_IRWXO);
+	if (mugo != (S_IRUSR|S_IWUSR)) {
+		tls_config_set_errorx(config, "session file has incorrect "
+		    "permissions (%#03o != 0600)", mugo);
+		return (-1);
+	}
+
+	config->session_fd = session_fd;
+
+	return (0);
+}
+
+static SSL_SESSION *
+tls_config_session_get_locked(struct tls_config *config,
+    const char *servername)
+{
+	struct tls_session *sess, **prev;
+	const unsigned char *p;
+
+	for (prev = &config->sessions; (sess = *prev) != NULL;
+	    prev = &sess->next) {
+		if (strcmp(sess->servername, servername) == 0)
+			break;
+	}
+	if (sess == NULL)
+		return (NULL);
+
+	*prev = sess->next;
+
+	if (time(NULL) > sess->expiry) {
+		tls_session_free(sess);
+		config->sessions_len--;
+		return (NULL);
+	}
+
+	/* Move to the front of the list, as the most recently used. */
+	sess->next = config->sessions;
+	config->sessions = sess;
+
+	p = sess->data;
+	return (d2i_SSL_SESSION(NULL, &p, sess->data_len));
+}
+
+/*
+ * Look up the client session cached for servername, returning a new
+ * session decoded from it. Expired sessions are dropped from the cache.
+ */
+SSL_SESSION *
+tls_config_session_get(struct tls_config *config, const char *servername)
+{
+	SSL_SESSION *ssl_session;
+
+	if (servername == NULL)
+		return (NULL);
+
+	pthread_mutex_lock(&config->mutex);
+	ssl_session = tls_config_session_get_locked(config, servername);
+	pthread_mutex_unlock(&config->mutex);
+
+	return (ssl_session);
+}
+
+static int
+tls_config_session_put_locked(struct tls_config *config,
+    const char *servername, unsigned char *data, size_t data_len,
+    time_t expiry)
+{
+	struct tls_session *sess, **prev;
+
+	for (prev = &config->sessions; (sess = *prev) != NULL;
+	    prev = &sess->next) {
+		if (strcmp(sess->servername, servername) == 0)
+			break;
+	}
+
+	if (sess != NULL) {
+		*prev = sess->next;
+		freezero(sess->data, sess->data_len);
+	} else {
+		if ((sess = calloc(1, sizeof(*sess))) == NULL)
+			return (-1);
+		if ((sess->servername = strdup(servername)) == NULL) {
+			free(sess);
+			return (-1);
+		}
+		config->sessions_len++;
+	}
+
+	sess->data = data;
+	sess->data_len = data_len;
+	sess->expiry = expiry;
+
+	sess->next = config->sessions;
+	config->sessions = sess;
+
+	tls_config_session_trim(config);
+
+	return (0);
+}
+
+/*
+ * Cache the client session for servername, replacing any session that
+ * was previously cached for it. The cache is shared by all contexts using
+ * the config, so it holds an encoded copy of the session rather than the
+ * connection's SSL_SESSION, and is protected by the config mutex.
+ */
+int
+tls_config_session_put(struct tls_config *config, const char *servername,
+    SSL_SESSION *ssl_session)
+{
+	unsigned char *data = NULL, *p;
+	size_t data_len = 0;
+	time_t expiry;
+	size_t cache_size;
+	int len, rv = -1;
+
+	if (servername == NULL)
+		return (0);
+
+	pthread_mutex_lock(&config->mutex);
+	cache_size = config->session_cache_size;
+	pthread_mutex_unlock(&config->mutex);
+	if (cache_size == 0)
+		return (0);
+
+	if ((len = i2d_SSL_SESSION(ssl_session, NULL)) <= 0)
+		goto err;
+	data_len = len;
+	if ((data = malloc(data_len)) == NULL)
+		goto err;
+	p = data;
+	if (i2d_SSL_SESSION(ssl_session, &p) != len)
+		goto err;
+	expiry = SSL_SESSION_get_time(ssl_session) +
+	    SSL_SESSION_get_timeout(ssl_session);
+
+	pthread_mutex_lock(&config->mutex);
+	if (config->session_cache_size == 0) {
+		rv = 0;
+	} else if ((rv = tls_config_session_put_locked(config, servername,
+	    data, data_len, expiry)) == 0)
+		data = NULL;
+	pthread_mutex_unlock(&config->mutex);
+
+ err:
+	freezero(data, data_len);
+
+	return (rv);
+}
+
 int
 tls_config_add_ticket_key(struct tls_config *config, uint32_t keyrev,
     unsigned char *key, size_t keylen)
@@ -254,6 +254,8 @@ tls_conninfo_populate(struct tls *ctx)
 	if (ctx->conninfo->version == NULL)
 		goto err;
 
+	ctx->conninfo->session_resumed = SSL_session_reused(ctx->ssl_conn);
+
 	if (tls_get_peer_cert_info(ctx) == -1)
 		goto err;
 
@@ -322,6 +324,14 @@ tls_conn_servername(struct tls *ctx)
 	return (ctx->conninfo->servername);
 }
 
+int
+tls_conn_session_resumed(struct tls *ctx)
+{
+	if (ctx->conninfo == NULL)
+		return (0);
+	return (ctx->conninfo->session_resumed);
+}
+
 const char *
 tls_conn_version(struct tls *ctx)
 {
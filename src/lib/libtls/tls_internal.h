@@ -22,6 +22,8 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 
+#include <pthread.h>
+
 #include <openssl/ssl.h>
 
 __BEGIN_HIDDEN_DECLS
@@ -74,9 +76,19 @@ struct tls_ticket_key {
 	time_t		time;
 };
 
+struct tls_session {
+	struct tls_session *next;
+
+	char *servername;
+	unsigned char *data;
+	size_t data_len;
+	time_t expiry;
+};
+
 struct tls_config {
 	struct tls_error error;
 
+	pthread_mutex_t mutex;
 	int refcount;
 
 	char *alpn;
@@ -96,6 +108,10 @@ struct tls_config {
 	uint32_t protocols;
 	unsigned char session_id[TLS_MAX_SESSION_ID_LENGTH];
 	int session_lifetime;
+	struct tls_session *sessions;
+	size_t sessions_len;
+	size_t session_cache_size;
+	int session_fd;
 	struct tls_ticket_key ticket_keys[TLS_NUM_TICKETS];
 	uint32_t ticket_keyrev;
 	int ticket_autorekey;
@@ -122,6 +138,8 @@ struct tls_conninfo {
 
 	time_t notbefore;
 	time_t notafter;
+
+	int session_resumed;
 };
 
 #define TLS_CLIENT		(1 << 0)
@@ -213,6 +231,10 @@ int tls_handshake_server(struct tls *ctx);
 int tls_config_load_file(struct tls_error *error, const char *filetype,
     const char *filename, char **buf, size_t *len);
 int tls_config_ticket_autorekey(struct tls_config *config);
+SSL_SESSION *tls_config_session_get(struct tls_config *config,
+    const char *servername);
+int tls_config_session_put(struct tls_config *config, const char *servername,
+    SSL_SESSION *ssl_session);
 int tls_host_port(const char *hostport, char **host, char **port);
 
 int tls_set_cbs(struct tls *ctx,
@@ -145,6 +145,85 @@ aead_from_name(const EVP_AEAD **aead, const char *name)
 	return 1;
 }
 
+#define NUM_BATCH 3
+
+/*
+ * Seal the test vector as several messages in one batch, then open them
+ * with the middle one corrupted, which must only fail that message.
+ */
+static int
+run_batch_test_case(EVP_AEAD_CTX *ctx, unsigned char bufs[NUM_TYPES][BUF_MAX],
+    const unsigned int lengths[NUM_TYPES], unsigned int line_no)
+{
+	unsigned char out[NUM_BATCH][BUF_MAX + EVP_AEAD_MAX_TAG_LENGTH];
+	unsigned char out2[NUM_BATCH][BUF_MAX];
+	EVP_AEAD_MSG msgs[NUM_BATCH];
+	size_t i;
+
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < NUM_BATCH; i++) {
+		msgs[i].out = out[i];
+		msgs[i].max_out_len = sizeof(out[i]);
+		msgs[i].nonce = bufs[NONCE];
+		msgs[i].nonce_len = lengths[NONCE];
+		msgs[i].in = bufs[IN];
+		msgs[i].in_len = lengths[IN];
+		msgs[i].ad = bufs[AD];
+		msgs[i].ad_len = lengths[AD];
+	}
+
+	if (EVP_AEAD_CTX_seal_batch(ctx, msgs, NUM_BATCH) != NUM_BATCH) {
+		fprintf(stderr, "Failed to run batch AEAD on line %u\n",
+		    line_no);
+		return 0;
+	}
+
+	for (i = 0; i < NUM_BATCH; i++) {
+		if (msgs[i].status != 1 ||
+		    msgs[i].out_len != lengths[CT] + lengths[TAG] ||
+		    memcmp(out[i], bufs[CT], lengths[CT]) != 0 ||
+		    memcmp(out[i] + lengths[CT], bufs[TAG],
+		    lengths[TAG]) != 0) {
+			fprintf(stderr, "Bad batch output %zu on line %u\n",
+			    i, line_no);
+			return 0;
+		}
+	}
+
+	for (i = 0; i < NUM_BATCH; i++) {
+		msgs[i].in = out[i];
+		msgs[i].in_len = msgs[i].out_len;
+		msgs[i].out = out2[i];
+		msgs[i].max_out_len = lengths[IN];
+	}
+	out[1][0] ^= 0x80;
+
+	if (EVP_AEAD_CTX_open_batch(ctx, msgs, NUM_BATCH) != NUM_BATCH - 1) {
+		fprintf(stderr, "Bad batch decrypt count on line %u\n",
+		    line_no);
+		return 0;
+	}
+
+	for (i = 0; i < NUM_BATCH; i++) {
+		if (i == 1) {
+			if (msgs[i].status != 0 || msgs[i].out_len != 0) {
+				fprintf(stderr, "Batch decrypted bad data on "
+				    "line %u\n", line_no);
+				return 0;
+			}
+			continue;
+		}
+		if (msgs[i].status != 1 || msgs[i].out_len != lengths[IN] ||
+		    memcmp(out2[i], bufs[IN], lengths[IN]) != 0) {
+			fprintf(stderr, "Batch plaintext mismatch %zu on "
+			    "line %u\n", i, line_no);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
 static int
 run_test_case(const EVP_AEAD* aead, unsigned char bufs[NUM_TYPES][BUF_MAX],
     const unsigned int lengths[NUM_TYPES], unsigned int line_no)
@@ -205,6 +284,9 @@ run_test_case(const EVP_AEAD* aead, unsigned char bufs[NUM_TYPES][BUF_MAX],
 		return 0;
 	}
 
+	if (!run_batch_test_case(&ctx, bufs, lengths, line_no))
+		return 0;
+
 	EVP_AEAD_CTX_cleanup(&ctx);
 	return 1;
 }
@@ -0,0 +1,251 @@
+/* $OpenBSD$ */
+/*
+ * Copyright (c) 2026 The LibreSSL project.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Tests for the BN_CTX cache used by the public key operations, and the
+ * BN_CTX_cache_* counters.
+ */
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/bn.h>
+#include <openssl/crypto.h>
+#include <openssl/rsa.h>
+
+#include "bn_lcl.h"
+
+/* These match bn_ctx.c. */
+#define CACHE_MAX	16
+#define CACHE_MAX_BNS	64
+
+struct counters {
+	unsigned long hits, misses, grows;
+};
+
+static void
+counters_get(struct counters *c)
+{
+	c->hits = BN_CTX_cache_hits();
+	c->misses = BN_CTX_cache_misses();
+	c->grows = BN_CTX_pool_grows();
+}
+
+static int
+counters_check(const char *desc, const struct counters *before,
+    unsigned long hits, unsigned long misses, unsigned long grows)
+{
+	struct counters after;
+
+	counters_get(&after);
+	if (after.hits - before->hits != hits ||
+	    after.misses - before->misses != misses ||
+	    after.grows - before->grows != grows) {
+		fprintf(stderr, "FAIL: %s: got %lu hits, %lu misses, %lu grows, "
+		    "want %lu, %lu, %lu\n", desc, after.hits - before->hits,
+		    after.misses - before->misses, after.grows - before->grows,
+		    hits, misses, grows);
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Use n bignums from ctx, each set to a nonzero value. */
+static void
+ctx_use(BN_CTX *ctx, int n)
+{
+	BIGNUM *bn;
+	int i;
+
+	BN_CTX_start(ctx);
+	for (i = 0; i < n; i++) {
+		if ((bn = BN_CTX_get(ctx)) == NULL)
+			errx(1, "BN_CTX_get failed");
+		if (!BN_set_word(bn, 0x5a5a5a5a) ||
+		    !BN_lshift(bn, bn, 1024))
+			errx(1, "BN_lshift failed");
+	}
+	BN_CTX_end(ctx);
+}
+
+static int
+ctx_cache_test(void)
+{
+	BN_CTX *ctx, *ctxs[CACHE_MAX + 1];
+	struct counters c;
+	BIGNUM *bn;
+	int i, j, failed = 0;
+
+	BN_CTX_cache_cleanup();
+
+	/* An empty cache misses, then the returned context is reused. */
+	counters_get(&c);
+	if ((ctx = bn_ctx_cache_get()) == NULL)
+		errx(1, "bn_ctx_cache_get failed");
+	ctx_use(ctx, 4);
+	bn_ctx_cache_put(ctx);
+	failed |= !counters_check("first use", &c, 0, 1, 1);
+
+	counters_get(&c);
+	if (bn_ctx_cache_get() != ctx) {
+		fprintf(stderr, "FAIL: cached context not reused\n");
+		failed = 1;
+	}
+
+	/* Its bignums come back zeroed, with their storage. */
+	BN_CTX_start(ctx);
+	for (i = 0; i < 4; i++) {
+		if ((bn = BN_CTX_get(ctx)) == NULL)
+			errx(1, "BN_CTX_get failed");
+		if (!BN_is_zero(bn) || bn->d == NULL) {
+			fprintf(stderr, "FAIL: bignum %d not cleared\n", i);
+			failed = 1;
+			continue;
+		}
+		for (j = 0; j < bn->dmax; j++) {
+			if (bn->d[j] != 0) {
+				fprintf(stderr, "FAIL: bignum %d word %d not "
+				    "zeroed\n", i, j);
+				failed = 1;
+				break;
+			}
+		}
+	}
+	BN_CTX_end(ctx);
+	bn_ctx_cache_put(ctx);
+	failed |= !counters_check("reuse", &c, 1, 0, 0);
+
+	/* A context still in use is freed instead of cached. */
+	counters_get(&c);
+	ctx = bn_ctx_cache_get();
+	BN_CTX_start(ctx);
+	bn_ctx_cache_put(ctx);
+	ctx = bn_ctx_cache_get();
+	bn_ctx_cache_put(ctx);
+	failed |= !counters_check("context in use", &c, 1, 1, 0);
+
+	/* So is one with too many bignums, but its growth is counted. */
+	counters_get(&c);
+	ctx = bn_ctx_cache_get();
+	ctx_use(ctx, CACHE_MAX_BNS + 1);
+	bn_ctx_cache_put(ctx);
+	ctx = bn_ctx_cache_get();
+	bn_ctx_cache_put(ctx);
+	failed |= !counters_check("oversized context", &c, 1, 1,
+	    (CACHE_MAX_BNS + 1 + 15) / 16);
+
+	/* The cache holds at most CACHE_MAX contexts. */
+	BN_CTX_cache_cleanup();
+	counters_get(&c);
+	for (i = 0; i < CACHE_MAX + 1; i++)
+		ctxs[i] = bn_ctx_cache_get();
+	for (i = 0; i < CACHE_MAX + 1; i++)
+		bn_ctx_cache_put(ctxs[i]);
+	for (i = 0; i < CACHE_MAX + 1; i++)
+		ctxs[i] = bn_ctx_cache_get();
+	for (i = 0; i < CACHE_MAX + 1; i++)
+		bn_ctx_cache_put(ctxs[i]);
+	failed |= !counters_check("full cache", &c, CACHE_MAX,
+	    CACHE_MAX + 2, 0);
+
+	/* Cleanup empties the cache. */
+	BN_CTX_cache_cleanup();
+	counters_get(&c);
+	ctx = bn_ctx_cache_get();
+	bn_ctx_cache_put(ctx);
+	failed |= !counters_check("after cleanup", &c, 0, 1, 0);
+
+	/* So does the general cleanup at shutdown. */
+	ctx = bn_ctx_cache_get();
+	bn_ctx_cache_put(ctx);
+	CRYPTO_cleanup_all_ex_data();
+	counters_get(&c);
+	ctx = bn_ctx_cache_get();
+	bn_ctx_cache_put(ctx);
+	failed |= !counters_check("after CRYPTO_cleanup_all_ex_data", &c, 0,
+	    1, 0);
+
+	return !failed;
+}
+
+/*
+ * Once warmed up, RSA private key operations take their contexts from the
+ * cache and do not grow them.
+ */
+static int
+rsa_cache_test(void)
+{
+	unsigned char msg[32], sig[256], out[256];
+	struct counters c, after;
+	BIGNUM *e;
+	RSA *rsa;
+	int i, failed = 0;
+
+	if ((e = BN_new()) == NULL || !BN_set_word(e, RSA_F4))
+		errx(1, "BN_set_word failed");
+	if ((rsa = RSA_new()) == NULL ||
+	    !RSA_generate_key_ex(rsa, 2048, e, NULL))
+		errx(1, "RSA_generate_key_ex failed");
+
+	arc4random_buf(msg, sizeof(msg));
+	for (i = 0; i < 4; i++) {
+		if (RSA_private_encrypt(sizeof(msg), msg, sig, rsa,
+		    RSA_PKCS1_PADDING) != RSA_size(rsa))
+			errx(1, "RSA_private_encrypt failed");
+	}
+
+	counters_get(&c);
+	for (i = 0; i < 16; i++) {
+		if (RSA_private_encrypt(sizeof(msg), msg, sig, rsa,
+		    RSA_PKCS1_PADDING) != RSA_size(rsa) ||
+		    RSA_public_decrypt(RSA_size(rsa), sig, out, rsa,
+		    RSA_PKCS1_PADDING) != sizeof(msg) ||
+		    memcmp(msg, out, sizeof(msg)) != 0)
+			errx(1, "RSA round trip failed");
+	}
+	counters_get(&after);
+
+	if (after.hits - c.hits < 16 || after.misses != c.misses ||
+	    after.grows != c.grows) {
+		fprintf(stderr, "FAIL: RSA: %lu hits, %lu misses, %lu grows\n",
+		    after.hits - c.hits, after.misses - c.misses,
+		    after.grows - c.grows);
+		failed = 1;
+	}
+
+	RSA_free(rsa);
+	BN_free(e);
+
+	return !failed;
+}
+
+int
+main(int argc, char **argv)
+{
+	int failed = 0;
+
+	failed |= !ctx_cache_test();
+	failed |= !rsa_cache_test();
+
+	if (!failed)
+		printf("PASS\n");
+
+	return failed;
+}
@@ -0,0 +1,271 @@
+/* $OpenBSD$ */
+/*
+ * Copyright (c) 2026 The LibreSSL project.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Test the Montgomery multiplication and constant time exponentiation
+ * code paths against plain modular arithmetic. On amd64 each test runs
+ * both with and without the mulx/adcx/adox code in bn_mul_mont.
+ */
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/bn.h>
+
+#define MAX_WORDS	64
+
+static BN_CTX *ctx;
+
+/* Set bn to a random value of exactly words words, below m if given. */
+static void
+rand_words(BIGNUM *bn, int words, const BIGNUM *m)
+{
+	do {
+		if (m != NULL) {
+			if (!BN_rand_range(bn, m))
+				errx(1, "BN_rand_range failed");
+		} else if (!BN_rand(bn, words * BN_BITS2, 0, 0))
+			errx(1, "BN_rand failed");
+	} while (bn->top != words);
+}
+
+/*
+ * Compare BN_mod_mul_montgomery(a, b) with a * b * R^-1 mod m, where
+ * R = 2^(words * BN_BITS2).
+ */
+static int
+mont_mul_check(const char *path, const char *desc, const BIGNUM *a,
+    const BIGNUM *b, const BIGNUM *m, BN_MONT_CTX *mont, const BIGNUM *rinv)
+{
+	BIGNUM *got, *want;
+	int ret = 0;
+
+	BN_CTX_start(ctx);
+	got = BN_CTX_get(ctx);
+	if ((want = BN_CTX_get(ctx)) == NULL)
+		errx(1, "BN_CTX_get failed");
+
+	if (!BN_mod_mul_montgomery(got, a, b, mont, ctx))
+		errx(1, "BN_mod_mul_montgomery failed");
+	if (!BN_mod_mul(want, a, b, m, ctx) ||
+	    !BN_mod_mul(want, want, rinv, m, ctx))
+		errx(1, "BN_mod_mul failed");
+
+	if (BN_cmp(got, want) != 0) {
+		fprintf(stderr, "FAIL: %s: %d words, %s\n", path, m->top, desc);
+		fprintf(stderr, "m = ");
+		BN_print_fp(stderr, m);
+		fprintf(stderr, "\na = ");
+		BN_print_fp(stderr, a);
+		fprintf(stderr, "\nb = ");
+		BN_print_fp(stderr, b);
+		fprintf(stderr, "\ngot  ");
+		BN_print_fp(stderr, got);
+		fprintf(stderr, "\nwant ");
+		BN_print_fp(stderr, want);
+		fprintf(stderr, "\n");
+		goto done;
+	}
+
+	ret = 1;
+
+ done:
+	BN_CTX_end(ctx);
+
+	return ret;
+}
+
+static int
+mont_mul_test(const char *path, const BIGNUM *m)
+{
+	BN_MONT_CTX *mont;
+	BIGNUM *a, *b, *r, *rinv;
+	int words, i, failed = 0;
+
+	words = m->top;
+
+	BN_CTX_start(ctx);
+	a = BN_CTX_get(ctx);
+	b = BN_CTX_get(ctx);
+	r = BN_CTX_get(ctx);
+	if ((rinv = BN_CTX_get(ctx)) == NULL)
+		errx(1, "BN_CTX_get failed");
+
+	if ((mont = BN_MONT_CTX_new()) == NULL)
+		errx(1, "BN_MONT_CTX_new failed");
+	if (!BN_MONT_CTX_set(mont, m, ctx))
+		errx(1, "BN_MONT_CTX_set failed");
+
+	if (!BN_one(r) || !BN_lshift(r, r, words * BN_BITS2) ||
+	    BN_mod_inverse(rinv, r, m, ctx) == NULL)
+		errx(1, "BN_mod_inverse failed");
+
+	for (i = 0; i < 8; i++) {
+		rand_words(a, words, m);
+		rand_words(b, words, m);
+		failed |= !mont_mul_check(path, "random", a, b, m, mont, rinv);
+		/* The same operand twice takes the squaring path. */
+		failed |= !mont_mul_check(path, "square", a, a, m, mont, rinv);
+	}
+
+	/* The largest operands maximise the carries. */
+	if (BN_copy(a, m) == NULL || !BN_sub_word(a, 1))
+		errx(1, "BN_sub_word failed");
+	rand_words(b, words, m);
+	failed |= !mont_mul_check(path, "m - 1 by random", a, b, m, mont,
+	    rinv);
+	failed |= !mont_mul_check(path, "m - 1 squared", a, a, m, mont, rinv);
+
+	BN_MONT_CTX_free(mont);
+	BN_CTX_end(ctx);
+
+	return !failed;
+}
+
+static int
+mod_exp_test(const char *path, const BIGNUM *m)
+{
+	BIGNUM *a, *p, *got, *want;
+	int i, failed = 0;
+
+	BN_CTX_start(ctx);
+	a = BN_CTX_get(ctx);
+	p = BN_CTX_get(ctx);
+	got = BN_CTX_get(ctx);
+	if ((want = BN_CTX_get(ctx)) == NULL)
+		errx(1, "BN_CTX_get failed");
+
+	for (i = 0; i < 2; i++) {
+		rand_words(a, m->top, m);
+		rand_words(p, m->top, NULL);
+
+		if (!BN_mod_exp_mont_consttime(got, a, p, m, ctx, NULL))
+			errx(1, "BN_mod_exp_mont_consttime failed");
+		if (!BN_mod_exp_recp(want, a, p, m, ctx))
+			errx(1, "BN_mod_exp_recp failed");
+
+		if (BN_cmp(got, want) != 0) {
+			fprintf(stderr, "FAIL: %s: %d words, "
+			    "BN_mod_exp_mont_consttime differs\n", path,
+			    m->top);
+			failed = 1;
+		}
+	}
+
+	BN_CTX_end(ctx);
+
+	return !failed;
+}
+
+static int
+montmul_tests(const char *path)
+{
+	BIGNUM *m;
+	int words, failed = 0;
+
+	BN_CTX_start(ctx);
+	if ((m = BN_CTX_get(ctx)) == NULL)
+		errx(1, "BN_CTX_get failed");
+
+	for (words = 2; words <= MAX_WORDS; words++) {
+		/* A random odd modulus with the top bit set. */
+		if (!BN_rand(m, words * BN_BITS2, 1, 1))
+			errx(1, "BN_rand failed");
+		failed |= !mont_mul_test(path, m);
+
+		/* 2^n - 1, where every word is all ones. */
+		if (!BN_zero(m) || !BN_set_bit(m, words * BN_BITS2) ||
+		    !BN_sub_word(m, 1))
+			errx(1, "BN_set_bit failed");
+		failed |= !mont_mul_test(path, m);
+
+		/* 2^(n-1) + 1, where the middle words are zero. */
+		if (!BN_zero(m) || !BN_set_bit(m, words * BN_BITS2 - 1) ||
+		    !BN_add_word(m, 1))
+			errx(1, "BN_set_bit failed");
+		failed |= !mont_mul_test(path, m);
+
+		if (words % 4 == 0 && words <= 32) {
+			if (!BN_rand(m, words * BN_BITS2, 1, 1))
+				errx(1, "BN_rand failed");
+			failed |= !mod_exp_test(path, m);
+		}
+	}
+
+	BN_CTX_end(ctx);
+
+	if (!failed)
+		fprintf(stdout, "%s: passed.\n", path);
+
+	return !failed;
+}
+
+#if defined(__x86_64__) && !defined(OPENSSL_NO_ASM)
+#include "x86_arch.h"
+
+extern uint32_t OPENSSL_ia32cap_ext_P;
+void OPENSSL_cpuid_setup(void);
+
+#define MULX_CAPS	(IA32CAP_EXT_MASK_BMI2 | IA32CAP_EXT_MASK_ADX)
+
+static int
+cpu_paths_test(void)
+{
+	uint32_t caps;
+	int failed = 0;
+
+	OPENSSL_cpuid_setup();
+	caps = OPENSSL_ia32cap_ext_P;
+
+	OPENSSL_ia32cap_ext_P = caps & ~MULX_CAPS;
+	failed |= !montmul_tests("mul4x");
+
+	if ((caps & MULX_CAPS) == MULX_CAPS) {
+		OPENSSL_ia32cap_ext_P = caps;
+		failed |= !montmul_tests("mulx4x");
+	} else
+		fprintf(stdout, "Skipping mulx4x, not supported.\n");
+
+	OPENSSL_ia32cap_ext_P = caps;
+
+	return !failed;
+}
+#else
+static int
+cpu_paths_test(void)
+{
+	return montmul_tests("generic");
+}
+#endif
+
+int
+main(int argc, char **argv)
+{
+	int failed;
+
+	if ((ctx = BN_CTX_new()) == NULL)
+		errx(1, "BN_CTX_new failed");
+
+	failed = !cpu_paths_test();
+
+	BN_CTX_free(ctx);
+
+	return failed;
+}
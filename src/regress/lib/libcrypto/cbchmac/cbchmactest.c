@@ -0,0 +1,346 @@
+/* $OpenBSD$ */
+/*
+ * Copyright (c) 2026 The LibreSSL project.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Tests for the stitched AES-CBC-HMAC-SHA1 and AES-CBC-HMAC-SHA256 ciphers
+ * in their TLS mode of operation. Records are checked against the same
+ * record built with HMAC and plain AES-CBC, then decrypted, and tampered
+ * records must be rejected.
+ */
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#define AES_BLOCK_SIZE	16
+#define MAX_PAYLOAD	1500
+#define MAX_RECORD	(AES_BLOCK_SIZE + MAX_PAYLOAD + EVP_MAX_MD_SIZE + \
+			    AES_BLOCK_SIZE)
+
+struct cbc_hmac_cipher {
+	const char *name;
+	const EVP_CIPHER *(*cipher)(void);
+	const EVP_CIPHER *(*cbc)(void);
+	const EVP_MD *(*md)(void);
+};
+
+static const struct cbc_hmac_cipher cbc_hmac_ciphers[] = {
+	{
+		.name = "AES-128-CBC-HMAC-SHA1",
+		.cipher = EVP_aes_128_cbc_hmac_sha1,
+		.cbc = EVP_aes_128_cbc,
+		.md = EVP_sha1,
+	},
+	{
+		.name = "AES-256-CBC-HMAC-SHA1",
+		.cipher = EVP_aes_256_cbc_hmac_sha1,
+		.cbc = EVP_aes_256_cbc,
+		.md = EVP_sha1,
+	},
+	{
+		.name = "AES-128-CBC-HMAC-SHA256",
+		.cipher = EVP_aes_128_cbc_hmac_sha256,
+		.cbc = EVP_aes_128_cbc,
+		.md = EVP_sha256,
+	},
+	{
+		.name = "AES-256-CBC-HMAC-SHA256",
+		.cipher = EVP_aes_256_cbc_hmac_sha256,
+		.cbc = EVP_aes_256_cbc,
+		.md = EVP_sha256,
+	},
+};
+
+#define N_CBC_HMAC_CIPHERS \
+    (sizeof(cbc_hmac_ciphers) / sizeof(cbc_hmac_ciphers[0]))
+
+static const uint16_t tls_versions[] = {
+	0x0301,		/* TLS 1.0, implicit IV */
+	0x0303,		/* TLS 1.2, explicit IV */
+};
+
+struct record {
+	unsigned char key[32];
+	unsigned char mac_key[32];
+	unsigned char iv[AES_BLOCK_SIZE];
+	unsigned char seq[8];
+	uint16_t version;
+	size_t payload_len;
+	unsigned char payload[MAX_PAYLOAD];
+};
+
+static void
+record_aad(const struct record *r, size_t len, unsigned char aad[13])
+{
+	memcpy(aad, r->seq, 8);
+	aad[8] = 23;		/* application data */
+	aad[9] = r->version >> 8;
+	aad[10] = r->version & 0xff;
+	aad[11] = len >> 8;
+	aad[12] = len & 0xff;
+}
+
+/*
+ * Build the record with HMAC and AES-CBC: explicit IV (TLS 1.1 and
+ * later), payload, MAC and padding, encrypted with the record's IV.
+ */
+static size_t
+record_encrypt_ref(const struct cbc_hmac_cipher *c, const struct record *r,
+    unsigned char *out)
+{
+	unsigned char buf[MAX_RECORD], aad[13];
+	unsigned char mac[EVP_MAX_MD_SIZE];
+	unsigned int mac_len;
+	EVP_CIPHER_CTX ctx;
+	HMAC_CTX hctx;
+	size_t eiv, len, pad;
+	int out_len;
+
+	eiv = r->version >= 0x0302 ? AES_BLOCK_SIZE : 0;
+
+	record_aad(r, r->payload_len, aad);
+	HMAC_CTX_init(&hctx);
+	if (!HMAC_Init_ex(&hctx, r->mac_key, sizeof(r->mac_key), c->md(),
+	    NULL) ||
+	    !HMAC_Update(&hctx, aad, sizeof(aad)) ||
+	    !HMAC_Update(&hctx, r->payload, r->payload_len) ||
+	    !HMAC_Final(&hctx, mac, &mac_len))
+		errx(1, "HMAC failed");
+	HMAC_CTX_cleanup(&hctx);
+
+	/* The explicit IV is the encryption of a block of zeroes here. */
+	memset(buf, 0, eiv);
+	len = eiv;
+	memcpy(buf + len, r->payload, r->payload_len);
+	len += r->payload_len;
+	memcpy(buf + len, mac, mac_len);
+	len += mac_len;
+	pad = AES_BLOCK_SIZE - len % AES_BLOCK_SIZE;
+	memset(buf + len, pad - 1, pad);
+	len += pad;
+
+	EVP_CIPHER_CTX_init(&ctx);
+	if (!EVP_EncryptInit_ex(&ctx, c->cbc(), NULL, r->key, r->iv) ||
+	    !EVP_CIPHER_CTX_set_padding(&ctx, 0) ||
+	    !EVP_EncryptUpdate(&ctx, out, &out_len, buf, len) ||
+	    (size_t)out_len != len)
+		errx(1, "AES-CBC failed");
+	EVP_CIPHER_CTX_cleanup(&ctx);
+
+	return len;
+}
+
+static int
+cbc_hmac_init(EVP_CIPHER_CTX *ctx, const struct cbc_hmac_cipher *c,
+    const struct record *r, int enc)
+{
+	EVP_CIPHER_CTX_init(ctx);
+	if (!EVP_CipherInit_ex(ctx, c->cipher(), NULL, r->key, r->iv, enc))
+		return 0;
+	if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_MAC_KEY,
+	    sizeof(r->mac_key), (void *)r->mac_key) <= 0)
+		return 0;
+	return 1;
+}
+
+static size_t
+record_encrypt(const struct cbc_hmac_cipher *c, const struct record *r,
+    unsigned char *out)
+{
+	unsigned char aad[13];
+	EVP_CIPHER_CTX ctx;
+	size_t eiv, len;
+	int pad;
+
+	eiv = r->version >= 0x0302 ? AES_BLOCK_SIZE : 0;
+
+	memset(out, 0, eiv);
+	memcpy(out + eiv, r->payload, r->payload_len);
+	len = eiv + r->payload_len;
+
+	if (!cbc_hmac_init(&ctx, c, r, 1))
+		errx(1, "%s encrypt init failed", c->name);
+	record_aad(r, len, aad);
+	if ((pad = EVP_CIPHER_CTX_ctrl(&ctx, EVP_CTRL_AEAD_TLS1_AAD,
+	    sizeof(aad), aad)) <= 0)
+		errx(1, "%s encrypt AAD failed", c->name);
+	len += pad;
+	if (EVP_Cipher(&ctx, out, out, len) <= 0)
+		errx(1, "%s encrypt failed", c->name);
+	EVP_CIPHER_CTX_cleanup(&ctx);
+
+	return len;
+}
+
+/* Decrypt a record, returning the payload length or -1 if it is bad. */
+static int
+record_decrypt(const struct cbc_hmac_cipher *c, const struct record *r,
+    const unsigned char *in, size_t len, unsigned char *out)
+{
+	unsigned char aad[13];
+	EVP_CIPHER_CTX ctx;
+	size_t eiv, mac_len;
+	int ret;
+
+	eiv = r->version >= 0x0302 ? AES_BLOCK_SIZE : 0;
+	mac_len = EVP_MD_size(c->md());
+
+	if (!cbc_hmac_init(&ctx, c, r, 0))
+		errx(1, "%s decrypt init failed", c->name);
+	record_aad(r, len, aad);
+	if (EVP_CIPHER_CTX_ctrl(&ctx, EVP_CTRL_AEAD_TLS1_AAD,
+	    sizeof(aad), aad) != (int)mac_len)
+		errx(1, "%s decrypt AAD failed", c->name);
+	ret = EVP_Cipher(&ctx, out, in, len);
+	EVP_CIPHER_CTX_cleanup(&ctx);
+
+	if (ret <= 0)
+		return -1;
+
+	return len - eiv - mac_len - (out[len - 1] + 1);
+}
+
+static int
+cbc_hmac_test(const struct cbc_hmac_cipher *c, uint16_t version)
+{
+	unsigned char want[MAX_RECORD], got[MAX_RECORD];
+	unsigned char plain[MAX_RECORD], bad[MAX_RECORD];
+	struct record r;
+	size_t eiv, len, want_len, i, tamper[3];
+
+	eiv = version >= 0x0302 ? AES_BLOCK_SIZE : 0;
+
+	memset(&r, 0, sizeof(r));
+	r.version = version;
+	arc4random_buf(r.payload, sizeof(r.payload));
+
+	for (r.payload_len = 0; r.payload_len < MAX_PAYLOAD;
+	    r.payload_len++) {
+		arc4random_buf(r.key, sizeof(r.key));
+		arc4random_buf(r.mac_key, sizeof(r.mac_key));
+		arc4random_buf(r.iv, sizeof(r.iv));
+		arc4random_buf(r.seq, sizeof(r.seq));
+
+		want_len = record_encrypt_ref(c, &r, want);
+		len = record_encrypt(c, &r, got);
+		if (len != want_len || memcmp(got, want, len) != 0) {
+			fprintf(stderr, "FAIL: %s version %04x payload %zu: "
+			    "record differs\n", c->name, version,
+			    r.payload_len);
+			return 1;
+		}
+
+		if (record_decrypt(c, &r, got, len, plain) !=
+		    (int)r.payload_len ||
+		    memcmp(plain + eiv, r.payload, r.payload_len) != 0) {
+			fprintf(stderr, "FAIL: %s version %04x payload %zu: "
+			    "decryption failed\n", c->name, version,
+			    r.payload_len);
+			return 1;
+		}
+
+		/* Flip a bit in the payload or MAC, and in the padding. */
+		tamper[0] = (r.payload_len * 7) % len;
+		tamper[1] = len - AES_BLOCK_SIZE - 1;
+		tamper[2] = len - 1;
+		for (i = 0; i < 3; i++) {
+			memcpy(bad, got, len);
+			bad[tamper[i]] ^= 0x01 << (r.payload_len % 8);
+			if (record_decrypt(c, &r, bad, len, plain) != -1) {
+				fprintf(stderr, "FAIL: %s version %04x "
+				    "payload %zu: tampered byte %zu "
+				    "accepted\n", c->name, version,
+				    r.payload_len, tamper[i]);
+				return 1;
+			}
+		}
+
+		/* A record replayed under another sequence number. */
+		r.seq[7] ^= 1;
+		if (record_decrypt(c, &r, got, len, plain) != -1) {
+			fprintf(stderr, "FAIL: %s version %04x payload %zu: "
+			    "wrong sequence number accepted\n", c->name,
+			    version, r.payload_len);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int
+cbc_hmac_tests(const char *path)
+{
+	size_t i, j;
+	int failed = 0;
+
+	for (i = 0; i < N_CBC_HMAC_CIPHERS; i++) {
+		if (cbc_hmac_ciphers[i].cipher() == NULL) {
+			fprintf(stdout, "Skipping %s, not supported.\n",
+			    cbc_hmac_ciphers[i].name);
+			continue;
+		}
+		for (j = 0; j < sizeof(tls_versions) / sizeof(tls_versions[0]);
+		    j++)
+			failed |= cbc_hmac_test(&cbc_hmac_ciphers[i],
+			    tls_versions[j]);
+		if (!failed)
+			fprintf(stdout, "%s with %s: passed.\n",
+			    cbc_hmac_ciphers[i].name, path);
+	}
+
+	return failed;
+}
+
+#if defined(__x86_64__) && !defined(OPENSSL_NO_ASM)
+#include "x86_arch.h"
+
+extern uint32_t OPENSSL_ia32cap_ext_P;
+void OPENSSL_cpuid_setup(void);
+
+int
+main(int argc, char **argv)
+{
+	uint32_t caps;
+	int failed;
+
+	OPENSSL_cpuid_setup();
+	caps = OPENSSL_ia32cap_ext_P;
+
+	OPENSSL_ia32cap_ext_P = caps & ~IA32CAP_EXT_MASK_SHA;
+	failed = cbc_hmac_tests("integer SHA");
+
+	OPENSSL_ia32cap_ext_P = caps;
+	if ((caps & IA32CAP_EXT_MASK_SHA) != 0)
+		failed |= cbc_hmac_tests("SHA extensions");
+	else
+		fprintf(stdout, "Skipping SHA extensions, not supported.\n");
+
+	return failed;
+}
+#else
+int
+main(int argc, char **argv)
+{
+	return cbc_hmac_tests("generic");
+}
+#endif
@@ -15,6 +15,7 @@
  */
 
 #include <err.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -291,6 +292,85 @@ struct chacha_test_function chacha_test_functions[] = {
 
 #define N_FUNCS (sizeof(chacha_test_functions) / sizeof(*chacha_test_functions))
 
+/*
+ * Compare bulk output, which may be produced by the multi-block code paths,
+ * against output generated one byte at a time, including a block counter
+ * that wraps from the low into the high word.
+ */
+static int
+chacha_multiblock_test(void)
+{
+	static const unsigned char counters[][8] = {
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+		{ 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+		{ 0xf9, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00 },
+		{ 0xfe, 0xff, 0xff, 0xff, 0x01, 0x00, 0x00, 0x00 },
+	};
+	unsigned char key[32], iv[8];
+	unsigned char *in, *out, *want;
+	uint64_t counter;
+	ChaCha_ctx ctx;
+	size_t len, i, j, k;
+	int failed = 0;
+
+	len = 64 * 23 + 37;
+
+	if ((in = malloc(len)) == NULL)
+		errx(1, "malloc in");
+	if ((out = malloc(len)) == NULL)
+		errx(1, "malloc out");
+	if ((want = malloc(len)) == NULL)
+		errx(1, "malloc want");
+
+	for (i = 0; i < sizeof(key); i++)
+		key[i] = i;
+	for (i = 0; i < sizeof(iv); i++)
+		iv[i] = 0xa0 + i;
+	for (i = 0; i < len; i++)
+		in[i] = i * 7;
+
+	for (i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+		ChaCha_set_key(&ctx, key, 256);
+		ChaCha_set_iv(&ctx, iv, counters[i]);
+		for (j = 0; j < len; j++)
+			ChaCha(&ctx, want + j, in + j, 1);
+
+		counter = 0;
+		for (j = 0; j < 8; j++)
+			counter |= (uint64_t)counters[i][j] << (8 * j);
+
+		for (j = 1; j < len; j += j) {
+			memset(out, 0, len);
+			CRYPTO_chacha_20(out, in, j, key, iv, counter);
+			if (memcmp(out, want, j) != 0) {
+				printf("ChaCha multi-block CRYPTO_chacha_20 "
+				    "failed for counter %zu, length %zu\n",
+				    i, j);
+				failed = 1;
+			}
+
+			/* Feed the data in chunks of j bytes. */
+			memset(out, 0, len);
+			ChaCha_set_key(&ctx, key, 256);
+			ChaCha_set_iv(&ctx, iv, counters[i]);
+			for (k = 0; k < len; k += j)
+				ChaCha(&ctx, out + k, in + k,
+				    len - k < j ? len - k : j);
+			if (memcmp(out, want, len) != 0) {
+				printf("ChaCha multi-block ChaCha failed for "
+				    "counter %zu, chunk size %zu\n", i, j);
+				failed = 1;
+			}
+		}
+	}
+
+	free(in);
+	free(out);
+	free(want);
+
+	return failed;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -334,5 +414,8 @@ main(int argc, char **argv)
 		}
 	}
 
+	if (chacha_multiblock_test() != 0)
+		failed = 1;
+
 	return failed;
 }
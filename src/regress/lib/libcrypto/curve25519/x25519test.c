@@ -14,10 +14,13 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <err.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include <openssl/bn.h>
 #include <openssl/curve25519.h>
 
 static int
@@ -127,11 +130,261 @@ x25519_small_order_test(void)
 	return 1;
 }
 
+/*
+ * A straightforward RFC 7748 Montgomery ladder using BIGNUM, as an
+ * independent reference for the field arithmetic in curve25519.c.
+ */
+static void
+x25519_bn(uint8_t out[32], const uint8_t scalar[32], const uint8_t point[32])
+{
+	BIGNUM *p, *x1, *x2, *z2, *x3, *z3, *a, *aa, *b, *bb, *e, *c, *d;
+	BIGNUM *da, *cb, *t;
+	BN_CTX *ctx;
+	uint8_t k[32], buf[32];
+	int i, bit, swap = 0, len;
+
+	if ((ctx = BN_CTX_new()) == NULL)
+		errx(1, "BN_CTX_new failed");
+	BN_CTX_start(ctx);
+	p = BN_CTX_get(ctx);
+	x1 = BN_CTX_get(ctx);
+	x2 = BN_CTX_get(ctx);
+	z2 = BN_CTX_get(ctx);
+	x3 = BN_CTX_get(ctx);
+	z3 = BN_CTX_get(ctx);
+	a = BN_CTX_get(ctx);
+	aa = BN_CTX_get(ctx);
+	b = BN_CTX_get(ctx);
+	bb = BN_CTX_get(ctx);
+	e = BN_CTX_get(ctx);
+	c = BN_CTX_get(ctx);
+	d = BN_CTX_get(ctx);
+	da = BN_CTX_get(ctx);
+	cb = BN_CTX_get(ctx);
+	if ((t = BN_CTX_get(ctx)) == NULL)
+		errx(1, "BN_CTX_get failed");
+
+	/* p = 2^255 - 19 */
+	if (!BN_set_bit(p, 255) || !BN_sub_word(p, 19))
+		errx(1, "BN_sub_word failed");
+
+	memcpy(k, scalar, sizeof(k));
+	k[0] &= 248;
+	k[31] &= 127;
+	k[31] |= 64;
+
+	/* The u-coordinate is little endian with the top bit masked. */
+	for (i = 0; i < 32; i++)
+		buf[i] = point[31 - i];
+	buf[0] &= 0x7f;
+	if (BN_bin2bn(buf, sizeof(buf), x1) == NULL ||
+	    !BN_nnmod(x1, x1, p, ctx))
+		errx(1, "BN_nnmod failed");
+
+	if (!BN_one(x2) || !BN_zero(z2) || BN_copy(x3, x1) == NULL ||
+	    !BN_one(z3))
+		errx(1, "BN_one failed");
+
+	for (i = 254; i >= 0; i--) {
+		bit = (k[i / 8] >> (i & 7)) & 1;
+		if (swap ^ bit) {
+			BN_swap(x2, x3);
+			BN_swap(z2, z3);
+		}
+		swap = bit;
+
+		if (!BN_mod_add(a, x2, z2, p, ctx) ||
+		    !BN_mod_sqr(aa, a, p, ctx) ||
+		    !BN_mod_sub(b, x2, z2, p, ctx) ||
+		    !BN_mod_sqr(bb, b, p, ctx) ||
+		    !BN_mod_sub(e, aa, bb, p, ctx) ||
+		    !BN_mod_add(c, x3, z3, p, ctx) ||
+		    !BN_mod_sub(d, x3, z3, p, ctx) ||
+		    !BN_mod_mul(da, d, a, p, ctx) ||
+		    !BN_mod_mul(cb, c, b, p, ctx) ||
+		    !BN_mod_add(t, da, cb, p, ctx) ||
+		    !BN_mod_sqr(x3, t, p, ctx) ||
+		    !BN_mod_sub(t, da, cb, p, ctx) ||
+		    !BN_mod_sqr(t, t, p, ctx) ||
+		    !BN_mod_mul(z3, x1, t, p, ctx) ||
+		    !BN_mod_mul(x2, aa, bb, p, ctx) ||
+		    BN_copy(t, e) == NULL ||
+		    !BN_mul_word(t, 121665) ||
+		    !BN_mod_add(t, aa, t, p, ctx) ||
+		    !BN_mod_mul(z2, e, t, p, ctx))
+			errx(1, "ladder step failed");
+	}
+	if (swap) {
+		BN_swap(x2, x3);
+		BN_swap(z2, z3);
+	}
+
+	/* x2 / z2, where z2 = 0 gives 0. */
+	if (BN_copy(t, p) == NULL || !BN_sub_word(t, 2) ||
+	    !BN_mod_exp_mont_consttime(z2, z2, t, p, ctx, NULL) ||
+	    !BN_mod_mul(x2, x2, z2, p, ctx))
+		errx(1, "inversion failed");
+
+	len = BN_num_bytes(x2);
+	memset(buf, 0, sizeof(buf));
+	BN_bn2bin(x2, buf + sizeof(buf) - len);
+	for (i = 0; i < 32; i++)
+		out[i] = buf[31 - i];
+
+	BN_CTX_end(ctx);
+	BN_CTX_free(ctx);
+}
+
+static void
+set_u(uint8_t u[32], int bits, int sub)
+{
+	BIGNUM *bn;
+	uint8_t buf[32];
+	int i;
+
+	/* u = 2^bits - sub, little endian. */
+	if ((bn = BN_new()) == NULL)
+		errx(1, "BN_new failed");
+	if (!BN_set_bit(bn, bits) || (sub > 0 && !BN_sub_word(bn, sub)) ||
+	    (sub < 0 && !BN_add_word(bn, -sub)))
+		errx(1, "BN_set_bit failed");
+	memset(buf, 0, sizeof(buf));
+	BN_bn2bin(bn, buf + sizeof(buf) - BN_num_bytes(bn));
+	for (i = 0; i < 32; i++)
+		u[i] = buf[31 - i];
+	BN_free(bn);
+}
+
+static int
+x25519_compare(const char *name, const uint8_t scalar[32],
+    const uint8_t point[32])
+{
+	uint8_t out[32], want[32];
+	int i;
+
+	X25519(out, scalar, point);
+	x25519_bn(want, scalar, point);
+	if (memcmp(out, want, sizeof(out)) != 0) {
+		fprintf(stderr, "X25519 %s differs from reference:\n", name);
+		fprintf(stderr, "    got  ");
+		for (i = 0; i < 32; i++)
+			fprintf(stderr, "%02x", out[i]);
+		fprintf(stderr, "\n    want ");
+		for (i = 0; i < 32; i++)
+			fprintf(stderr, "%02x", want[i]);
+		fprintf(stderr, "\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Compare against the reference for u-coordinates at and around the limb
+ * boundaries of both the radix 2^51 and radix 2^25.5 representations, for
+ * non-canonical encodings (p and above, top bit set) and for limbs that
+ * are all ones, which exercise the carry and reduction paths.
+ */
+static int
+x25519_field_test(void)
+{
+	static const int bits[] = {
+		25, 26, 51, 77, 102, 128, 153, 179, 204, 230, 254,
+	};
+	static const int subs[] = { -1, 0, 1, 19, 20 };
+	uint8_t scalar[32], point[32];
+	char name[64];
+	size_t i, j;
+	int n, failed = 0;
+
+	arc4random_buf(scalar, sizeof(scalar));
+
+	for (i = 0; i < sizeof(bits) / sizeof(bits[0]); i++) {
+		for (j = 0; j < sizeof(subs) / sizeof(subs[0]); j++) {
+			set_u(point, bits[i], subs[j]);
+			snprintf(name, sizeof(name), "u = 2^%d - %d",
+			    bits[i], subs[j]);
+			failed |= !x25519_compare(name, scalar, point);
+		}
+	}
+
+	/* p - 1, p, p + 1, 2^255 - 1 and the same with the top bit set. */
+	for (j = 0; j < 2; j++) {
+		for (n = 20; n >= 0; n--) {
+			set_u(point, 255, n);
+			point[31] |= j << 7;
+			snprintf(name, sizeof(name), "u = 2^255 - %d%s", n,
+			    j ? " with top bit" : "");
+			failed |= !x25519_compare(name, scalar, point);
+		}
+	}
+
+	/* Every byte set, in both the scalar and the u-coordinate. */
+	memset(scalar, 0xff, sizeof(scalar));
+	memset(point, 0xff, sizeof(point));
+	failed |= !x25519_compare("all ones", scalar, point);
+
+	/* Random u-coordinates, with runs of ones and zeroes. */
+	for (n = 0; n < 256; n++) {
+		arc4random_buf(scalar, sizeof(scalar));
+		arc4random_buf(point, sizeof(point));
+		for (i = 0; i < sizeof(point); i++) {
+			if ((n & 1) && (arc4random() & 1))
+				point[i] = 0xff;
+			if ((n & 2) && (arc4random() & 1))
+				point[i] = 0x00;
+		}
+		snprintf(name, sizeof(name), "random %d", n);
+		failed |= !x25519_compare(name, scalar, point);
+	}
+
+	return !failed;
+}
+
+/*
+ * The public value must be the reference scalar multiple of the base point
+ * and both sides must agree on the shared key.
+ */
+static int
+x25519_keypair_test(void)
+{
+	static const uint8_t kBasePoint[32] = { 9 };
+	uint8_t pub1[32], priv1[32], pub2[32], priv2[32];
+	uint8_t want[32], shared1[32], shared2[32];
+	int i;
+
+	for (i = 0; i < 64; i++) {
+		X25519_keypair(pub1, priv1);
+		X25519_keypair(pub2, priv2);
+
+		x25519_bn(want, priv1, kBasePoint);
+		if (memcmp(pub1, want, sizeof(want)) != 0) {
+			fprintf(stderr, "X25519 public value differs from "
+			    "reference.\n");
+			return 0;
+		}
+
+		if (!X25519(shared1, priv1, pub2) ||
+		    !X25519(shared2, priv2, pub1)) {
+			fprintf(stderr, "X25519 failed.\n");
+			return 0;
+		}
+		if (memcmp(shared1, shared2, sizeof(shared1)) != 0) {
+			fprintf(stderr, "X25519 shared keys differ.\n");
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
 int
 main(int argc, char **argv) {
 	if (!x25519_test() ||
 	    !x25519_iterated_test() ||
-	    !x25519_small_order_test())
+	    !x25519_small_order_test() ||
+	    !x25519_field_test() ||
+	    !x25519_keypair_test())
 		return 1;
 
 	printf("PASS\n");
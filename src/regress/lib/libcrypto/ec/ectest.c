@@ -1362,6 +1362,231 @@ internal_curve_test(void)
 	return;
 }
 
+/*
+ * Compare P-256 as returned by EC_GROUP_new_by_curve_name(), which may use
+ * an optimised method, with the same curve on top of EC_GFp_mont_method().
+ */
+static void
+p256_point_check(const EC_GROUP *group, const EC_POINT *point,
+    const EC_GROUP *ref_group, const EC_POINT *ref_point, BN_CTX *ctx)
+{
+	BIGNUM *x, *y, *ref_x, *ref_y;
+
+	if (EC_POINT_is_at_infinity(group, point) !=
+	    EC_POINT_is_at_infinity(ref_group, ref_point))
+		ABORT;
+	if (EC_POINT_is_at_infinity(group, point))
+		return;
+
+	x = BN_new();
+	y = BN_new();
+	ref_x = BN_new();
+	ref_y = BN_new();
+	if (x == NULL || y == NULL || ref_x == NULL || ref_y == NULL)
+		ABORT;
+	if (!EC_POINT_get_affine_coordinates_GFp(group, point, x, y, ctx))
+		ABORT;
+	if (!EC_POINT_get_affine_coordinates_GFp(ref_group, ref_point, ref_x,
+	    ref_y, ctx))
+		ABORT;
+	if (BN_cmp(x, ref_x) != 0 || BN_cmp(y, ref_y) != 0)
+		ABORT;
+	BN_free(x);
+	BN_free(y);
+	BN_free(ref_x);
+	BN_free(ref_y);
+}
+
+static void
+p256_named_curve_test(void)
+{
+	BN_CTX *ctx;
+	BIGNUM *p, *a, *b, *x, *y, *order, *k, *l, *m;
+	EC_GROUP *group, *ref_group;
+	EC_POINT *G, *P, *Q, *R, *ref_G, *ref_P, *ref_Q, *ref_R;
+	const EC_POINT *points[2];
+	const BIGNUM *scalars[2];
+	int i, precomp;
+
+	fprintf(stdout, "\nNIST curve P-256 (named curve against generic "
+	    "implementation) ... ");
+	fflush(stdout);
+
+	if ((ctx = BN_CTX_new()) == NULL)
+		ABORT;
+	p = BN_new();
+	a = BN_new();
+	b = BN_new();
+	x = BN_new();
+	y = BN_new();
+	order = BN_new();
+	k = BN_new();
+	l = BN_new();
+	m = BN_new();
+	if (p == NULL || a == NULL || b == NULL || x == NULL || y == NULL ||
+	    order == NULL || k == NULL || l == NULL || m == NULL)
+		ABORT;
+
+	if ((group = EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1)) == NULL)
+		ABORT;
+	if (!EC_GROUP_get_curve_GFp(group, p, a, b, ctx))
+		ABORT;
+	if (!EC_GROUP_get_order(group, order, ctx))
+		ABORT;
+	if ((ref_group = EC_GROUP_new(EC_GFp_mont_method())) == NULL)
+		ABORT;
+	if (!EC_GROUP_set_curve_GFp(ref_group, p, a, b, ctx))
+		ABORT;
+	if (!EC_POINT_get_affine_coordinates_GFp(group,
+	    EC_GROUP_get0_generator(group), x, y, ctx))
+		ABORT;
+	if ((ref_G = EC_POINT_new(ref_group)) == NULL)
+		ABORT;
+	if (!EC_POINT_set_affine_coordinates_GFp(ref_group, ref_G, x, y, ctx))
+		ABORT;
+	if (!EC_GROUP_set_generator(ref_group, ref_G, order, BN_value_one()))
+		ABORT;
+
+	if ((G = EC_POINT_new(group)) == NULL ||
+	    (P = EC_POINT_new(group)) == NULL ||
+	    (Q = EC_POINT_new(group)) == NULL ||
+	    (R = EC_POINT_new(group)) == NULL ||
+	    (ref_P = EC_POINT_new(ref_group)) == NULL ||
+	    (ref_Q = EC_POINT_new(ref_group)) == NULL ||
+	    (ref_R = EC_POINT_new(ref_group)) == NULL)
+		ABORT;
+	if (!EC_POINT_copy(G, EC_GROUP_get0_generator(group)))
+		ABORT;
+
+	for (precomp = 0; precomp < 2; precomp++) {
+		for (i = 0; i < 64; i++) {
+			/* Include small, all-ones and order-adjacent scalars. */
+			switch (i) {
+			case 0:
+				BN_zero(k);
+				break;
+			case 1:
+				BN_one(k);
+				break;
+			case 2:
+				if (!BN_sub(k, order, BN_value_one()))
+					ABORT;
+				break;
+			case 3:
+				if (!BN_set_bit(k, 256) || !BN_sub_word(k, 1))
+					ABORT;
+				break;
+			default:
+				if (!BN_rand(k, 256 - (i % 5), 0, 0))
+					ABORT;
+				break;
+			}
+			if (!BN_rand(l, 256, 0, 0))
+				ABORT;
+			if (!BN_rand(m, 255, 0, 0))
+				ABORT;
+
+			/* k * G */
+			if (!EC_POINT_mul(group, Q, k, NULL, NULL, ctx))
+				ABORT;
+			if (!EC_POINT_mul(ref_group, ref_Q, k, NULL, NULL, ctx))
+				ABORT;
+			p256_point_check(group, Q, ref_group, ref_Q, ctx);
+
+			/* P = l * G, via both the generator and a plain point */
+			if (!EC_POINT_mul(group, P, NULL, G, l, ctx))
+				ABORT;
+			if (!EC_POINT_mul(ref_group, ref_P, l, NULL, NULL, ctx))
+				ABORT;
+			p256_point_check(group, P, ref_group, ref_P, ctx);
+
+			/* k * P */
+			if (!EC_POINT_mul(group, Q, NULL, P, k, ctx))
+				ABORT;
+			if (!EC_POINT_mul(ref_group, ref_Q, NULL, ref_P, k, ctx))
+				ABORT;
+			p256_point_check(group, Q, ref_group, ref_Q, ctx);
+
+			/* m * G + k * P */
+			if (!EC_POINT_mul(group, R, m, P, k, ctx))
+				ABORT;
+			if (!EC_POINT_mul(ref_group, ref_R, m, ref_P, k, ctx))
+				ABORT;
+			p256_point_check(group, R, ref_group, ref_R, ctx);
+
+			/*
+			 * m * G + k * P + l * Q, where Q is at infinity for
+			 * k = 0. ec_wNAF_mul() does not handle points at
+			 * infinity, so these are left out of the reference.
+			 */
+			points[0] = P;
+			points[1] = Q;
+			scalars[0] = k;
+			scalars[1] = l;
+			if (!EC_POINTs_mul(group, R, m, 2, points, scalars, ctx))
+				ABORT;
+			points[0] = ref_P;
+			points[1] = ref_Q;
+			if (!EC_POINTs_mul(ref_group, ref_R, m,
+			    EC_POINT_is_at_infinity(ref_group, ref_Q) ? 1 : 2,
+			    points, scalars, ctx))
+				ABORT;
+			p256_point_check(group, R, ref_group, ref_R, ctx);
+
+			/* P + P must be handled as a doubling */
+			if (!EC_POINT_add(group, Q, P, P, ctx))
+				ABORT;
+			if (!EC_POINT_dbl(ref_group, ref_Q, ref_P, ctx))
+				ABORT;
+			p256_point_check(group, Q, ref_group, ref_Q, ctx);
+		}
+		if (!EC_GROUP_precompute_mult(group, ctx))
+			ABORT;
+		if (!EC_GROUP_precompute_mult(ref_group, ctx))
+			ABORT;
+	}
+
+	/* A point at infinity which still carries X and Y coordinates. */
+	if (!EC_POINT_copy(Q, G) || !EC_POINT_set_to_infinity(group, Q))
+		ABORT;
+	if (!BN_rand(k, 256, 0, 0))
+		ABORT;
+	if (!EC_POINT_mul(group, R, NULL, Q, k, ctx))
+		ABORT;
+	if (!EC_POINT_is_at_infinity(group, R))
+		ABORT;
+	if (!EC_POINT_mul(group, R, m, Q, k, ctx))
+		ABORT;
+	if (!EC_POINT_mul(ref_group, ref_R, m, NULL, NULL, ctx))
+		ABORT;
+	p256_point_check(group, R, ref_group, ref_R, ctx);
+
+	fprintf(stdout, "ok\n");
+
+	group_order_tests(group);
+
+	EC_POINT_free(G);
+	EC_POINT_free(P);
+	EC_POINT_free(Q);
+	EC_POINT_free(R);
+	EC_POINT_free(ref_G);
+	EC_POINT_free(ref_P);
+	EC_POINT_free(ref_Q);
+	EC_POINT_free(ref_R);
+	EC_GROUP_free(group);
+	EC_GROUP_free(ref_group);
+	BN_free(p);
+	BN_free(a);
+	BN_free(b);
+	BN_free(x);
+	BN_free(y);
+	BN_free(order);
+	BN_free(k);
+	BN_free(l);
+	BN_free(m);
+	BN_CTX_free(ctx);
+}
+
 #ifndef OPENSSL_NO_EC_NISTP_64_GCC_128
 /* nistp_test_params contains magic numbers for testing our optimized
  * implementations of several NIST curves with characteristic > 3. */
@@ -1574,6 +1799,7 @@ main(int argc, char *argv[])
 #ifndef OPENSSL_NO_EC_NISTP_64_GCC_128
 	nistp_tests();
 #endif
+	p256_named_curve_test();
 	/* test the internal curves */
 	internal_curve_test();
 
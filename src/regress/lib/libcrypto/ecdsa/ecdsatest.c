@@ -296,6 +296,25 @@ int test_builtin(BIO *out)
 			}
 		BIO_printf(out, ".");
 		(void)BIO_flush(out);
+		/* verify with precomputed multiples of the public keys */
+		if (!EC_KEY_precompute_pub_mult(eckey, NULL) ||
+		    !EC_KEY_precompute_pub_mult(wrong_eckey, NULL))
+			{
+			BIO_printf(out, " failed\n");
+			goto builtin_err;
+			}
+		if (ECDSA_verify(0, digest, 20, signature, sig_len,
+			eckey) != 1 ||
+		    ECDSA_verify(0, wrong_digest, 20, signature, sig_len,
+			eckey) == 1 ||
+		    ECDSA_verify(0, digest, 20, signature, sig_len,
+			wrong_eckey) == 1)
+			{
+			BIO_printf(out, " failed\n");
+			goto builtin_err;
+			}
+		BIO_printf(out, ".");
+		(void)BIO_flush(out);
 
 		/* Modify a single byte of the signature: to ensure we don't
 		 * garble the ASN1 structure, we read the raw signature and
@@ -0,0 +1,585 @@
+/* $OpenBSD$ */
+/*
+ * Copyright (c) 2026 The LibreSSL project.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/bn.h>
+#include <openssl/curve25519.h>
+#include <openssl/sha.h>
+
+#include "curve25519_internal.h"
+
+struct ed25519_test {
+	const uint8_t private_key[ED25519_PRIVATE_KEY_LENGTH];
+	const uint8_t public_key[ED25519_PUBLIC_KEY_LENGTH];
+	const uint8_t message[2];
+	size_t message_len;
+	const uint8_t signature[ED25519_SIGNATURE_LENGTH];
+};
+
+/* Taken from https://tools.ietf.org/html/rfc8032#section-7.1 */
+static const struct ed25519_test ed25519_tests[] = {
+	{
+		.private_key = {
+			0x9d, 0x61, 0xb1, 0x9d, 0xef, 0xfd, 0x5a, 0x60,
+			0xba, 0x84, 0x4a, 0xf4, 0x92, 0xec, 0x2c, 0xc4,
+			0x44, 0x49, 0xc5, 0x69, 0x7b, 0x32, 0x69, 0x19,
+			0x70, 0x3b, 0xac, 0x03, 0x1c, 0xae, 0x7f, 0x60,
+			0xd7, 0x5a, 0x98, 0x01, 0x82, 0xb1, 0x0a, 0xb7,
+			0xd5, 0x4b, 0xfe, 0xd3, 0xc9, 0x64, 0x07, 0x3a,
+			0x0e, 0xe1, 0x72, 0xf3, 0xda, 0xa6, 0x23, 0x25,
+			0xaf, 0x02, 0x1a, 0x68, 0xf7, 0x07, 0x51, 0x1a,
+		},
+		.public_key = {
+			0xd7, 0x5a, 0x98, 0x01, 0x82, 0xb1, 0x0a, 0xb7,
+			0xd5, 0x4b, 0xfe, 0xd3, 0xc9, 0x64, 0x07, 0x3a,
+			0x0e, 0xe1, 0x72, 0xf3, 0xda, 0xa6, 0x23, 0x25,
+			0xaf, 0x02, 0x1a, 0x68, 0xf7, 0x07, 0x51, 0x1a,
+		},
+		.message_len = 0,
+		.signature = {
+			0xe5, 0x56, 0x43, 0x00, 0xc3, 0x60, 0xac, 0x72,
+			0x90, 0x86, 0xe2, 0xcc, 0x80, 0x6e, 0x82, 0x8a,
+			0x84, 0x87, 0x7f, 0x1e, 0xb8, 0xe5, 0xd9, 0x74,
+			0xd8, 0x73, 0xe0, 0x65, 0x22, 0x49, 0x01, 0x55,
+			0x5f, 0xb8, 0x82, 0x15, 0x90, 0xa3, 0x3b, 0xac,
+			0xc6, 0x1e, 0x39, 0x70, 0x1c, 0xf9, 0xb4, 0x6b,
+			0xd2, 0x5b, 0xf5, 0xf0, 0x59, 0x5b, 0xbe, 0x24,
+			0x65, 0x51, 0x41, 0x43, 0x8e, 0x7a, 0x10, 0x0b,
+		},
+	},
+	{
+		.private_key = {
+			0x4c, 0xcd, 0x08, 0x9b, 0x28, 0xff, 0x96, 0xda,
+			0x9d, 0xb6, 0xc3, 0x46, 0xec, 0x11, 0x4e, 0x0f,
+			0x5b, 0x8a, 0x31, 0x9f, 0x35, 0xab, 0xa6, 0x24,
+			0xda, 0x8c, 0xf6, 0xed, 0x4f, 0xb8, 0xa6, 0xfb,
+			0x3d, 0x40, 0x17, 0xc3, 0xe8, 0x43, 0x89, 0x5a,
+			0x92, 0xb7, 0x0a, 0xa7, 0x4d, 0x1b, 0x7e, 0xbc,
+			0x9c, 0x98, 0x2c, 0xcf, 0x2e, 0xc4, 0x96, 0x8c,
+			0xc0, 0xcd, 0x55, 0xf1, 0x2a, 0xf4, 0x66, 0x0c,
+		},
+		.public_key = {
+			0x3d, 0x40, 0x17, 0xc3, 0xe8, 0x43, 0x89, 0x5a,
+			0x92, 0xb7, 0x0a, 0xa7, 0x4d, 0x1b, 0x7e, 0xbc,
+			0x9c, 0x98, 0x2c, 0xcf, 0x2e, 0xc4, 0x96, 0x8c,
+			0xc0, 0xcd, 0x55, 0xf1, 0x2a, 0xf4, 0x66, 0x0c,
+		},
+		.message = { 0x72 },
+		.message_len = 1,
+		.signature = {
+			0x92, 0xa0, 0x09, 0xa9, 0xf0, 0xd4, 0xca, 0xb8,
+			0x72, 0x0e, 0x82, 0x0b, 0x5f, 0x64, 0x25, 0x40,
+			0xa2, 0xb2, 0x7b, 0x54, 0x16, 0x50, 0x3f, 0x8f,
+			0xb3, 0x76, 0x22, 0x23, 0xeb, 0xdb, 0x69, 0xda,
+			0x08, 0x5a, 0xc1, 0xe4, 0x3e, 0x15, 0x99, 0x6e,
+			0x45, 0x8f, 0x36, 0x13, 0xd0, 0xf1, 0x1d, 0x8c,
+			0x38, 0x7b, 0x2e, 0xae, 0xb4, 0x30, 0x2a, 0xee,
+			0xb0, 0x0d, 0x29, 0x16, 0x12, 0xbb, 0x0c, 0x00,
+		},
+	},
+	{
+		.private_key = {
+			0xc5, 0xaa, 0x8d, 0xf4, 0x3f, 0x9f, 0x83, 0x7b,
+			0xed, 0xb7, 0x44, 0x2f, 0x31, 0xdc, 0xb7, 0xb1,
+			0x66, 0xd3, 0x85, 0x35, 0x07, 0x6f, 0x09, 0x4b,
+			0x85, 0xce, 0x3a, 0x2e, 0x0b, 0x44, 0x58, 0xf7,
+			0xfc, 0x51, 0xcd, 0x8e, 0x62, 0x18, 0xa1, 0xa3,
+			0x8d, 0xa4, 0x7e, 0xd0, 0x02, 0x30, 0xf0, 0x58,
+			0x08, 0x16, 0xed, 0x13, 0xba, 0x33, 0x03, 0xac,
+			0x5d, 0xeb, 0x91, 0x15, 0x48, 0x90, 0x80, 0x25,
+		},
+		.public_key = {
+			0xfc, 0x51, 0xcd, 0x8e, 0x62, 0x18, 0xa1, 0xa3,
+			0x8d, 0xa4, 0x7e, 0xd0, 0x02, 0x30, 0xf0, 0x58,
+			0x08, 0x16, 0xed, 0x13, 0xba, 0x33, 0x03, 0xac,
+			0x5d, 0xeb, 0x91, 0x15, 0x48, 0x90, 0x80, 0x25,
+		},
+		.message = { 0xaf, 0x82 },
+		.message_len = 2,
+		.signature = {
+			0x62, 0x91, 0xd6, 0x57, 0xde, 0xec, 0x24, 0x02,
+			0x48, 0x27, 0xe6, 0x9c, 0x3a, 0xbe, 0x01, 0xa3,
+			0x0c, 0xe5, 0x48, 0xa2, 0x84, 0x74, 0x3a, 0x44,
+			0x5e, 0x36, 0x80, 0xd7, 0xdb, 0x5a, 0xc3, 0xac,
+			0x18, 0xff, 0x9b, 0x53, 0x8d, 0x16, 0xf2, 0x90,
+			0xae, 0x67, 0xf7, 0x60, 0x98, 0x4d, 0xc6, 0x59,
+			0x4a, 0x7c, 0x15, 0xe9, 0x71, 0x6e, 0xd2, 0x8d,
+			0xc0, 0x27, 0xbe, 0xce, 0xea, 0x1e, 0xc4, 0x0a,
+		},
+	},
+};
+
+#define N_ED25519_TESTS (sizeof(ed25519_tests) / sizeof(ed25519_tests[0]))
+
+static int
+ed25519_test(void)
+{
+	const struct ed25519_test *et;
+	uint8_t sig[ED25519_SIGNATURE_LENGTH];
+	size_t i;
+
+	for (i = 0; i < N_ED25519_TESTS; i++) {
+		et = &ed25519_tests[i];
+
+		if (!ED25519_sign(sig, et->message, et->message_len,
+		    et->private_key)) {
+			fprintf(stderr, "FAIL: test %zu: ED25519_sign failed\n",
+			    i);
+			return 0;
+		}
+		if (memcmp(sig, et->signature, sizeof(sig)) != 0) {
+			fprintf(stderr, "FAIL: test %zu: signature mismatch\n",
+			    i);
+			return 0;
+		}
+		if (!ED25519_verify(et->message, et->message_len,
+		    et->signature, et->public_key)) {
+			fprintf(stderr, "FAIL: test %zu: signature failed to "
+			    "verify\n", i);
+			return 0;
+		}
+		memcpy(sig, et->signature, sizeof(sig));
+		sig[0] ^= 1;
+		if (ED25519_verify(et->message, et->message_len, sig,
+		    et->public_key)) {
+			fprintf(stderr, "FAIL: test %zu: bad signature "
+			    "verified\n", i);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int
+ed25519_keypair_test(void)
+{
+	uint8_t public_key[ED25519_PUBLIC_KEY_LENGTH];
+	uint8_t private_key[ED25519_PRIVATE_KEY_LENGTH];
+	uint8_t sig[ED25519_SIGNATURE_LENGTH];
+	uint8_t message[64];
+
+	ED25519_keypair(public_key, private_key);
+	arc4random_buf(message, sizeof(message));
+
+	if (memcmp(private_key + 32, public_key, sizeof(public_key)) != 0) {
+		fprintf(stderr, "FAIL: public key not in private key\n");
+		return 0;
+	}
+	if (!ED25519_sign(sig, message, sizeof(message), private_key) ||
+	    !ED25519_verify(message, sizeof(message), sig, public_key)) {
+		fprintf(stderr, "FAIL: ED25519_keypair signature failed to "
+		    "verify\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+#define BATCH_MAX	150
+#define BATCH_KEYS	5
+
+struct batch {
+	uint8_t public_keys[BATCH_MAX][ED25519_PUBLIC_KEY_LENGTH];
+	uint8_t signatures[BATCH_MAX][ED25519_SIGNATURE_LENGTH];
+	uint8_t messages[BATCH_MAX][48];
+	size_t message_lens[BATCH_MAX];
+
+	const uint8_t *public_key_ptrs[BATCH_MAX];
+	const uint8_t *signature_ptrs[BATCH_MAX];
+	const uint8_t *message_ptrs[BATCH_MAX];
+};
+
+/*
+ * Fill a batch with valid signatures. With shared keys set, the
+ * signatures are made with a handful of keys, otherwise each has its own.
+ */
+static void
+batch_fill(struct batch *b, size_t count, int shared_keys)
+{
+	uint8_t public_keys[BATCH_KEYS][ED25519_PUBLIC_KEY_LENGTH];
+	uint8_t private_keys[BATCH_KEYS][ED25519_PRIVATE_KEY_LENGTH];
+	uint8_t private_key[ED25519_PRIVATE_KEY_LENGTH];
+	size_t i, k;
+
+	for (k = 0; k < BATCH_KEYS; k++)
+		ED25519_keypair(public_keys[k], private_keys[k]);
+
+	for (i = 0; i < count; i++) {
+		if (shared_keys) {
+			k = i % BATCH_KEYS;
+			memcpy(b->public_keys[i], public_keys[k],
+			    sizeof(b->public_keys[i]));
+			memcpy(private_key, private_keys[k],
+			    sizeof(private_key));
+		} else
+			ED25519_keypair(b->public_keys[i], private_key);
+
+		b->message_lens[i] = i % sizeof(b->messages[i]);
+		arc4random_buf(b->messages[i], b->message_lens[i]);
+		if (!ED25519_sign(b->signatures[i], b->messages[i],
+		    b->message_lens[i], private_key))
+			errx(1, "ED25519_sign failed");
+
+		b->public_key_ptrs[i] = b->public_keys[i];
+		b->signature_ptrs[i] = b->signatures[i];
+		b->message_ptrs[i] = b->messages[i];
+	}
+}
+
+static int
+batch_verify(struct batch *b, size_t count, size_t bad, const char *desc)
+{
+	int valid[BATCH_MAX];
+	size_t i;
+	int ret, want;
+
+	for (i = 0; i < count; i++)
+		valid[i] = -1;
+
+	ret = ED25519_verify_batch(b->message_ptrs, b->message_lens,
+	    b->signature_ptrs, b->public_key_ptrs, count, valid);
+	if (ret != (bad >= count)) {
+		fprintf(stderr, "FAIL: batch of %zu, %s at %zu: got %d\n",
+		    count, desc, bad, ret);
+		return 0;
+	}
+	if (ED25519_verify_batch(b->message_ptrs, b->message_lens,
+	    b->signature_ptrs, b->public_key_ptrs, count, NULL) != ret) {
+		fprintf(stderr, "FAIL: batch of %zu, %s at %zu: result "
+		    "differs without valid\n", count, desc, bad);
+		return 0;
+	}
+
+	for (i = 0; i < count; i++) {
+		want = ED25519_verify(b->message_ptrs[i], b->message_lens[i],
+		    b->signature_ptrs[i], b->public_key_ptrs[i]);
+		if (want != (i != bad) || valid[i] != want) {
+			fprintf(stderr, "FAIL: batch of %zu, %s at %zu: "
+			    "signature %zu is %d, want %d\n", count, desc,
+			    bad, i, valid[i], want);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Check that a batch of valid signatures passes and that a single bad
+ * signature anywhere in a batch is found, whichever part of it is bad.
+ */
+static int
+ed25519_verify_batch_test(void)
+{
+	static const size_t counts[] = { 0, 1, 2, 3, 63, 64, 65, 129, 150 };
+	uint8_t save_sig[ED25519_SIGNATURE_LENGTH];
+	uint8_t save_pub[ED25519_PUBLIC_KEY_LENGTH];
+	size_t positions[4];
+	struct batch *b;
+	size_t count, bad, i, j;
+	int shared_keys, failed = 0;
+
+	if ((b = calloc(1, sizeof(*b))) == NULL)
+		err(1, NULL);
+
+	for (shared_keys = 0; shared_keys < 2; shared_keys++) {
+		for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+			count = counts[i];
+			batch_fill(b, count, shared_keys);
+
+			failed |= !batch_verify(b, count, count, "none bad");
+			if (count == 0)
+				continue;
+
+			positions[0] = 0;
+			positions[1] = count / 2;
+			positions[2] = count - 1;
+			positions[3] = arc4random_uniform(count);
+
+			for (j = 0; j < 4; j++) {
+				bad = positions[j];
+				memcpy(save_sig, b->signatures[bad],
+				    sizeof(save_sig));
+				memcpy(save_pub, b->public_keys[bad],
+				    sizeof(save_pub));
+
+				/* A bit flipped in R. */
+				b->signatures[bad][j] ^= 0x10;
+				failed |= !batch_verify(b, count, bad, "bad R");
+				memcpy(b->signatures[bad], save_sig,
+				    sizeof(save_sig));
+
+				/* A bit flipped in S. */
+				b->signatures[bad][32 + j] ^= 0x01;
+				failed |= !batch_verify(b, count, bad, "bad S");
+				memcpy(b->signatures[bad], save_sig,
+				    sizeof(save_sig));
+
+				/* S with its top bits set. */
+				b->signatures[bad][63] |= 0xe0;
+				failed |= !batch_verify(b, count, bad,
+				    "large S");
+				memcpy(b->signatures[bad], save_sig,
+				    sizeof(save_sig));
+
+				/* The wrong message. */
+				if (b->message_lens[bad] > 0) {
+					b->messages[bad][0] ^= 0x80;
+					failed |= !batch_verify(b, count, bad,
+					    "bad message");
+					b->messages[bad][0] ^= 0x80;
+				}
+
+				/* The wrong public key. */
+				b->public_keys[bad][j] ^= 0x04;
+				if (ED25519_verify(b->message_ptrs[bad],
+				    b->message_lens[bad], b->signature_ptrs[bad],
+				    b->public_key_ptrs[bad]) == 0)
+					failed |= !batch_verify(b, count, bad,
+					    "bad public key");
+				memcpy(b->public_keys[bad], save_pub,
+				    sizeof(save_pub));
+			}
+
+			failed |= !batch_verify(b, count, count, "restored");
+		}
+	}
+
+	free(b);
+
+	return !failed;
+}
+
+/* Scalars and field elements are little-endian, BIGNUMs big-endian. */
+static BIGNUM *
+le_to_bn(const uint8_t *in, size_t len, BIGNUM *bn)
+{
+	uint8_t buf[SHA512_DIGEST_LENGTH];
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = in[len - 1 - i];
+
+	return BN_bin2bn(buf, len, bn);
+}
+
+static void
+bn_to_le(const BIGNUM *bn, uint8_t out[32])
+{
+	uint8_t buf[32];
+	int i, len;
+
+	memset(buf, 0, sizeof(buf));
+	len = BN_num_bytes(bn);
+	BN_bn2bin(bn, buf + sizeof(buf) - len);
+	for (i = 0; i < 32; i++)
+		out[i] = buf[31 - i];
+}
+
+/*
+ * Add the point of order two, (0, -1), to the encoded point p. The sum of
+ * (x, y) and (0, -1) is (-x, -y).
+ */
+static void
+add_order_two(uint8_t p[32], const BIGNUM *prime, BN_CTX *ctx)
+{
+	BIGNUM *y;
+	uint8_t sign;
+
+	sign = p[31] & 0x80;
+	p[31] &= 0x7f;
+
+	BN_CTX_start(ctx);
+	if ((y = BN_CTX_get(ctx)) == NULL ||
+	    le_to_bn(p, 32, y) == NULL ||
+	    !BN_sub(y, prime, y))
+		errx(1, "negating y failed");
+	bn_to_le(y, p);
+	p[31] |= sign ^ 0x80;
+	BN_CTX_end(ctx);
+}
+
+/*
+ * Sign like ED25519_sign does, then add the point of order two to R or,
+ * with torsion_key set, to the public key, and recompute S to match. The
+ * result only satisfies the cofactored verification equation.
+ */
+static void
+sign_small_order(uint8_t sig[ED25519_SIGNATURE_LENGTH],
+    uint8_t public_key[ED25519_PUBLIC_KEY_LENGTH], const uint8_t *message,
+    size_t message_len, const uint8_t private_key[ED25519_PRIVATE_KEY_LENGTH],
+    int torsion_key)
+{
+	uint8_t az[SHA512_DIGEST_LENGTH], h[SHA512_DIGEST_LENGTH];
+	SHA512_CTX hash_ctx;
+	BIGNUM *order, *prime, *r, *a, *k, *s;
+	BN_CTX *ctx;
+
+	if ((ctx = BN_CTX_new()) == NULL)
+		errx(1, "BN_CTX_new failed");
+	BN_CTX_start(ctx);
+	if ((order = BN_CTX_get(ctx)) == NULL ||
+	    (prime = BN_CTX_get(ctx)) == NULL ||
+	    (r = BN_CTX_get(ctx)) == NULL ||
+	    (a = BN_CTX_get(ctx)) == NULL ||
+	    (k = BN_CTX_get(ctx)) == NULL ||
+	    (s = BN_CTX_get(ctx)) == NULL)
+		errx(1, "BN_CTX_get failed");
+	if (!BN_hex2bn(&order, "1000000000000000000000000000000014def9dea2f7"
+	    "9cd65812631a5cf5d3ed") ||
+	    !BN_hex2bn(&prime, "7fffffffffffffffffffffffffffffffffffffffffff"
+	    "ffffffffffffffffffed"))
+		errx(1, "BN_hex2bn failed");
+
+	if (!ED25519_sign(sig, message, message_len, private_key))
+		errx(1, "ED25519_sign failed");
+	memcpy(public_key, private_key + 32, ED25519_PUBLIC_KEY_LENGTH);
+
+	SHA512(private_key, 32, az);
+	az[0] &= 248;
+	az[31] &= 63;
+	az[31] |= 64;
+
+	/* The nonce r, with R = [r]B already in the signature. */
+	SHA512_Init(&hash_ctx);
+	SHA512_Update(&hash_ctx, az + 32, 32);
+	SHA512_Update(&hash_ctx, message, message_len);
+	SHA512_Final(h, &hash_ctx);
+	if (le_to_bn(h, sizeof(h), r) == NULL || le_to_bn(az, 32, a) == NULL)
+		errx(1, "le_to_bn failed");
+
+	if (torsion_key)
+		add_order_two(public_key, prime, ctx);
+	else
+		add_order_two(sig, prime, ctx);
+
+	SHA512_Init(&hash_ctx);
+	SHA512_Update(&hash_ctx, sig, 32);
+	SHA512_Update(&hash_ctx, public_key, ED25519_PUBLIC_KEY_LENGTH);
+	SHA512_Update(&hash_ctx, message, message_len);
+	SHA512_Final(h, &hash_ctx);
+	if (le_to_bn(h, sizeof(h), k) == NULL)
+		errx(1, "le_to_bn failed");
+
+	/* S = r + k * a mod l */
+	if (!BN_mod_mul(s, k, a, order, ctx) ||
+	    !BN_mod_add(s, s, r, order, ctx))
+		errx(1, "computing S failed");
+	bn_to_le(s, sig + 32);
+
+	BN_CTX_end(ctx);
+	BN_CTX_free(ctx);
+}
+
+/*
+ * A point of order two added to R or to the public key leaves the error
+ * term in the small-order subgroup. The batch must agree with
+ * ED25519_verify on such signatures whatever random coefficients it draws,
+ * so check many batches.
+ */
+static int
+ed25519_small_order_test(void)
+{
+	uint8_t private_key[ED25519_PRIVATE_KEY_LENGTH];
+	uint8_t public_key[ED25519_PUBLIC_KEY_LENGTH];
+	int valid[BATCH_MAX];
+	struct batch *b;
+	size_t count = 64, i, bad, torsion_r, torsion_key;
+	int round, pass, want, ret, failed = 0;
+
+	if ((b = calloc(1, sizeof(*b))) == NULL)
+		err(1, NULL);
+
+	for (round = 0; round < 32; round++) {
+		batch_fill(b, count, 0);
+
+		torsion_r = arc4random_uniform(count);
+		torsion_key = (torsion_r + 1 + arc4random_uniform(count - 1)) %
+		    count;
+		for (i = 0; i < count; i++) {
+			if (i != torsion_r && i != torsion_key)
+				continue;
+			ED25519_keypair(public_key, private_key);
+			sign_small_order(b->signatures[i], b->public_keys[i],
+			    b->messages[i], b->message_lens[i], private_key,
+			    i == torsion_key);
+			if (ED25519_verify(b->message_ptrs[i],
+			    b->message_lens[i], b->signature_ptrs[i],
+			    b->public_key_ptrs[i]) != 1) {
+				fprintf(stderr, "FAIL: round %d: small-order "
+				    "%s rejected\n", round,
+				    i == torsion_key ? "public key" : "R");
+				failed = 1;
+			}
+		}
+
+		/* All valid, then one other signature with a bad S as well. */
+		for (pass = 0; pass < 2; pass++) {
+			bad = count;
+			if (pass == 1) {
+				for (bad = 0; bad == torsion_r ||
+				    bad == torsion_key; bad++)
+					;
+				b->signatures[bad][40] ^= 0x01;
+			}
+
+			ret = ED25519_verify_batch(b->message_ptrs,
+			    b->message_lens, b->signature_ptrs,
+			    b->public_key_ptrs, count, valid);
+			if (ret != (bad >= count)) {
+				fprintf(stderr, "FAIL: round %d: batch with bad "
+				    "signature at %zu returned %d\n", round,
+				    bad, ret);
+				failed = 1;
+			}
+			for (i = 0; i < count; i++) {
+				want = ED25519_verify(b->message_ptrs[i],
+				    b->message_lens[i], b->signature_ptrs[i],
+				    b->public_key_ptrs[i]);
+				if (valid[i] != want || want != (i != bad)) {
+					fprintf(stderr, "FAIL: round %d: "
+					    "signature %zu is %d, want %d\n",
+					    round, i, valid[i], want);
+					failed = 1;
+				}
+			}
+		}
+	}
+
+	free(b);
+
+	return !failed;
+}
+
+int
+main(int argc, char **argv)
+{
+	if (!ed25519_test() ||
+	    !ed25519_keypair_test() ||
+	    !ed25519_verify_batch_test() ||
+	    !ed25519_small_order_test())
+		return 1;
+
+	printf("PASS\n");
+	return 0;
+}
@@ -54,6 +54,7 @@
 #include <string.h>
 
 #include <openssl/aes.h>
+#include <openssl/evp.h>
 #include <openssl/modes.h>
 
 /* XXX - something like this should be in the public headers. */
@@ -912,6 +913,118 @@ fail:
 	return (ret);
 }
 
+/*
+ * Compare the EVP ciphers, which may use the bulk AES-NI implementations,
+ * against CRYPTO_gcm128_encrypt with AES_encrypt, for long inputs that are
+ * passed in chunks of various sizes.
+ */
+static int
+do_gcm128_long_test(int key_bits, const EVP_CIPHER *cipher)
+{
+	static const size_t chunks[] = { 1, 15, 16, 17, 95, 96, 97, 200, 4096 };
+	EVP_CIPHER_CTX *cctx;
+	GCM128_CONTEXT ctx;
+	AES_KEY key;
+	uint8_t k[32], iv[12], aad[20], tag[16], evp_tag[16];
+	uint8_t *in, *ref, *out;
+	size_t i, j, len, n;
+	int outl;
+	int ret = 1;
+
+	len = 3 * 4096 + 13;
+	if ((in = malloc(len)) == NULL || (ref = malloc(len)) == NULL ||
+	    (out = malloc(len)) == NULL)
+		err(1, "malloc");
+	if ((cctx = EVP_CIPHER_CTX_new()) == NULL)
+		err(1, "EVP_CIPHER_CTX_new");
+
+	for (j = 0; j < sizeof(k); j++)
+		k[j] = j * 13 + key_bits;
+	for (j = 0; j < sizeof(iv); j++)
+		iv[j] = 0xf0 ^ j;
+	for (j = 0; j < sizeof(aad); j++)
+		aad[j] = j;
+	for (j = 0; j < len; j++)
+		in[j] = j * j + (j >> 8);
+
+	AES_set_encrypt_key(k, key_bits, &key);
+	CRYPTO_gcm128_init(&ctx, &key, (block128_f)AES_encrypt);
+	CRYPTO_gcm128_setiv(&ctx, iv, sizeof(iv));
+	CRYPTO_gcm128_aad(&ctx, aad, sizeof(aad));
+	CRYPTO_gcm128_encrypt(&ctx, in, ref, len);
+	CRYPTO_gcm128_tag(&ctx, tag, sizeof(tag));
+
+	for (i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+		memset(out, 0, len);
+		if (!EVP_EncryptInit_ex(cctx, cipher, NULL, k, iv) ||
+		    !EVP_EncryptUpdate(cctx, NULL, &outl, aad, sizeof(aad))) {
+			fprintf(stderr, "AES-%d: encrypt init failed\n",
+			    key_bits);
+			goto fail;
+		}
+		for (j = 0; j < len; j += n) {
+			n = len - j < chunks[i] ? len - j : chunks[i];
+			if (!EVP_EncryptUpdate(cctx, out + j, &outl, in + j,
+			    n)) {
+				fprintf(stderr, "AES-%d: encrypt failed\n",
+				    key_bits);
+				goto fail;
+			}
+		}
+		if (!EVP_EncryptFinal_ex(cctx, out, &outl) ||
+		    !EVP_CIPHER_CTX_ctrl(cctx, EVP_CTRL_GCM_GET_TAG,
+		    sizeof(evp_tag), evp_tag)) {
+			fprintf(stderr, "AES-%d: encrypt final failed\n",
+			    key_bits);
+			goto fail;
+		}
+		if (memcmp(out, ref, len) != 0 ||
+		    memcmp(evp_tag, tag, sizeof(tag)) != 0) {
+			fprintf(stderr, "AES-%d: encrypt mismatch with chunk "
+			    "size %zu\n", key_bits, chunks[i]);
+			goto fail;
+		}
+
+		/* Decrypt in place. */
+		if (!EVP_DecryptInit_ex(cctx, cipher, NULL, k, iv) ||
+		    !EVP_DecryptUpdate(cctx, NULL, &outl, aad, sizeof(aad))) {
+			fprintf(stderr, "AES-%d: decrypt init failed\n",
+			    key_bits);
+			goto fail;
+		}
+		for (j = 0; j < len; j += n) {
+			n = len - j < chunks[i] ? len - j : chunks[i];
+			if (!EVP_DecryptUpdate(cctx, out + j, &outl, out + j,
+			    n)) {
+				fprintf(stderr, "AES-%d: decrypt failed\n",
+				    key_bits);
+				goto fail;
+			}
+		}
+		if (!EVP_CIPHER_CTX_ctrl(cctx, EVP_CTRL_GCM_SET_TAG,
+		    sizeof(tag), tag) ||
+		    EVP_DecryptFinal_ex(cctx, out, &outl) <= 0) {
+			fprintf(stderr, "AES-%d: tag mismatch with chunk "
+			    "size %zu\n", key_bits, chunks[i]);
+			goto fail;
+		}
+		if (memcmp(out, in, len) != 0) {
+			fprintf(stderr, "AES-%d: decrypt mismatch with chunk "
+			    "size %zu\n", key_bits, chunks[i]);
+			goto fail;
+		}
+	}
+
+	ret = 0;
+
+fail:
+	EVP_CIPHER_CTX_free(cctx);
+	free(in);
+	free(ref);
+	free(out);
+	return (ret);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -921,5 +1034,9 @@ main(int argc, char **argv)
 	for (i = 0; i < N_TESTS; i++)
 		ret |= do_gcm128_test(i + 1, &gcm128_tests[i]);
 
+	ret |= do_gcm128_long_test(128, EVP_aes_128_gcm());
+	ret |= do_gcm128_long_test(192, EVP_aes_192_gcm());
+	ret |= do_gcm128_long_test(256, EVP_aes_256_gcm());
+
 	return ret;
 }
@@ -4,7 +4,9 @@
  *   https://github.com/floodyberry/poly1305-donna
  */
 
+#include <err.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <openssl/poly1305.h>
 
@@ -13,6 +15,7 @@ void poly1305_auth(unsigned char mac[16], const unsigned char *m, size_t bytes,
 
 int poly1305_verify(const unsigned char mac1[16], const unsigned char mac2[16]);
 int poly1305_power_on_self_test(void);
+int poly1305_long_test(void);
 
 void
 poly1305_auth(unsigned char mac[16], const unsigned char *m, size_t bytes,
@@ -156,6 +159,89 @@ poly1305_power_on_self_test(void)
 	return result;
 }
 
+/*
+ * Long inputs, which exercise the multi-block implementations, including
+ * all the possible lengths of the trailing partial chunk.
+ */
+int
+poly1305_long_test(void)
+{
+	/*
+		mac of the macs of messages of length 0 to 2047, where key byte
+		j is (i + j) and message byte j is (i * j) for message i
+	*/
+	static const unsigned char total_mac[16] = {
+		0x4d, 0xb5, 0x0b, 0xc4, 0x41, 0xbe, 0x28, 0xfa,
+		0xb6, 0x89, 0xa8, 0x28, 0x41, 0x1f, 0x36, 0xe5
+	};
+
+	/*
+		mac of a 65549 byte message, where key byte j is (0x80 + 5 * j)
+		and message byte j is (j * j + (j >> 8))
+	*/
+	static const unsigned char long_mac[16] = {
+		0x22, 0xb8, 0xd5, 0x92, 0xe9, 0x87, 0xcd, 0x7e,
+		0x1d, 0xeb, 0x03, 0x52, 0x0d, 0xbd, 0xe7, 0x9b
+	};
+
+	static const size_t chunks[] = { 1, 15, 16, 17, 63, 64, 255, 256, 257,
+	    1000, 4096, 16384 };
+
+	poly1305_context ctx;
+	poly1305_context total_ctx;
+	unsigned char total_key[32];
+	unsigned char key[32];
+	unsigned char *msg;
+	unsigned char mac[16];
+	size_t i, j, len, n;
+	int result = 1;
+
+	len = 65536 + 13;
+	if ((msg = malloc(len)) == NULL)
+		err(1, "malloc");
+
+	for (j = 0; j < sizeof(total_key); j++)
+		total_key[j] = 0xa5 ^ (j * 3);
+
+	CRYPTO_poly1305_init(&total_ctx, total_key);
+	for (i = 0; i < 2048; i++) {
+		for (j = 0; j < sizeof(key); j++)
+			key[j] = i + j;
+		for (j = 0; j < i; j++)
+			msg[j] = i * j;
+		poly1305_auth(mac, msg, i, key);
+		CRYPTO_poly1305_update(&total_ctx, mac, 16);
+	}
+	CRYPTO_poly1305_finish(&total_ctx, mac);
+	result &= poly1305_verify(total_mac, mac);
+
+	for (j = 0; j < sizeof(key); j++)
+		key[j] = 0x80 + 5 * j;
+	for (j = 0; j < len; j++)
+		msg[j] = j * j + (j >> 8);
+
+	for (i = 0; i < sizeof(mac); i++)
+		mac[i] = 0;
+	poly1305_auth(mac, msg, len, key);
+	result &= poly1305_verify(long_mac, mac);
+
+	for (i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+		for (j = 0; j < sizeof(mac); j++)
+			mac[j] = 0;
+		CRYPTO_poly1305_init(&ctx, key);
+		for (j = 0; j < len; j += n) {
+			n = len - j < chunks[i] ? len - j : chunks[i];
+			CRYPTO_poly1305_update(&ctx, msg + j, n);
+		}
+		CRYPTO_poly1305_finish(&ctx, mac);
+		result &= poly1305_verify(long_mac, mac);
+	}
+
+	free(msg);
+
+	return result;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -164,5 +250,10 @@ main(int argc, char **argv)
 		return 1;
 	}
 
+	if (!poly1305_long_test()) {
+		fprintf(stderr, "One or more long input tests failed!\n");
+		return 1;
+	}
+
 	return 0;
 }
@@ -0,0 +1,365 @@
+/* $OpenBSD$ */
+/*
+ * Copyright (c) 2026 The LibreSSL project.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Test the per-thread RSA blinding table: every thread other than the
+ * owner of rsa->blinding borrows a BN_BLINDING from the table for each
+ * operation. Only when every slot is busy do threads share
+ * rsa->mt_blinding, and threads that come and go must not use up the table.
+ */
+
+#include <err.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/bn.h>
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+#include <openssl/rsa.h>
+
+#include "rsa_locl.h"
+
+#define THREAD_OPS	4
+#define CHURN_THREADS	512
+#define CHURN_WAVE	16
+
+static pthread_mutex_t *crypto_locks;
+static pthread_mutex_t threadid_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t threadid_key;
+static unsigned long threadid_next;
+static pthread_barrier_t barrier;
+static RSA *rsa;
+
+static void
+crypto_lock_cb(int mode, int type, const char *file, int line)
+{
+	if (mode & CRYPTO_LOCK)
+		pthread_mutex_lock(&crypto_locks[type]);
+	else
+		pthread_mutex_unlock(&crypto_locks[type]);
+}
+
+/*
+ * Give every thread an id of its own. The default id is the address of
+ * errno, which a new thread may inherit from one that exited.
+ */
+static void
+threadid_cb(CRYPTO_THREADID *id)
+{
+	unsigned long tid;
+
+	if ((tid = (unsigned long)pthread_getspecific(threadid_key)) == 0) {
+		pthread_mutex_lock(&threadid_lock);
+		tid = ++threadid_next;
+		pthread_mutex_unlock(&threadid_lock);
+		if (pthread_setspecific(threadid_key, (void *)tid) != 0)
+			errx(1, "pthread_setspecific failed");
+	}
+	CRYPTO_THREADID_set_numeric(id, tid);
+}
+
+/* Sign with the private key and check the result with the public key. */
+static int
+rsa_private_op(void)
+{
+	unsigned char msg[32], sig[256], out[256];
+	int len;
+
+	arc4random_buf(msg, sizeof(msg));
+	if ((len = RSA_private_encrypt(sizeof(msg), msg, sig, rsa,
+	    RSA_PKCS1_PADDING)) != RSA_size(rsa)) {
+		ERR_print_errors_fp(stderr);
+		return 0;
+	}
+	if (RSA_public_decrypt(len, sig, out, rsa, RSA_PKCS1_PADDING) !=
+	    sizeof(msg) || memcmp(msg, out, sizeof(msg)) != 0)
+		return 0;
+
+	return 1;
+}
+
+static void *
+blinding_thread(void *arg)
+{
+	int *failed = arg;
+	int i;
+
+	/* Start together, so that the threads compete for the slots. */
+	pthread_barrier_wait(&barrier);
+	for (i = 0; i < THREAD_OPS; i++)
+		*failed |= !rsa_private_op();
+
+	return NULL;
+}
+
+static void *
+churn_thread(void *arg)
+{
+	int *failed = arg;
+
+	*failed |= !rsa_private_op();
+
+	return NULL;
+}
+
+/*
+ * Count the slots that have a blinding set up. No slot may still be held
+ * once the operations are done.
+ */
+static int
+count_thread_blindings(void)
+{
+	int i, n = 0;
+
+	if (rsa->thread_blinding == NULL)
+		return 0;
+
+	for (i = 0; i < RSA_THREAD_BLINDING_SLOTS; i++) {
+		if (rsa->thread_blinding[i].busy) {
+			fprintf(stderr, "FAIL: slot %d is still busy\n", i);
+			return -1;
+		}
+		if (rsa->thread_blinding[i].blinding != NULL)
+			n++;
+	}
+
+	return n;
+}
+
+static int
+run_threads(int nthreads, void *(*fn)(void *))
+{
+	pthread_t *threads;
+	int *failed;
+	int i, ret = 1;
+
+	if ((threads = calloc(nthreads, sizeof(*threads))) == NULL ||
+	    (failed = calloc(nthreads, sizeof(*failed))) == NULL)
+		err(1, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, fn, &failed[i]) != 0)
+			errx(1, "pthread_create failed");
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		if (failed[i]) {
+			fprintf(stderr, "FAIL: %d threads: private key "
+			    "operation failed in thread %d\n", nthreads, i);
+			ret = 0;
+		}
+	}
+
+	free(threads);
+	free(failed);
+
+	return ret;
+}
+
+static int
+blinding_test(int nthreads)
+{
+	int n, want;
+
+	/* The main thread makes the first operation and owns rsa->blinding. */
+	if (!rsa_private_op()) {
+		fprintf(stderr, "FAIL: private key operation failed\n");
+		return 0;
+	}
+	if (rsa->blinding == NULL || rsa->thread_blinding != NULL ||
+	    rsa->mt_blinding != NULL) {
+		fprintf(stderr, "FAIL: only rsa->blinding should be set up\n");
+		return 0;
+	}
+
+	if (pthread_barrier_init(&barrier, NULL, nthreads) != 0)
+		errx(1, "pthread_barrier_init failed");
+	if (!run_threads(nthreads, blinding_thread))
+		return 0;
+	pthread_barrier_destroy(&barrier);
+
+	/* The owner still uses rsa->blinding. */
+	if (!rsa_private_op()) {
+		fprintf(stderr, "FAIL: private key operation failed\n");
+		return 0;
+	}
+
+	want = nthreads;
+	if (want > RSA_THREAD_BLINDING_SLOTS)
+		want = RSA_THREAD_BLINDING_SLOTS;
+	if ((n = count_thread_blindings()) < 1 || n > want) {
+		fprintf(stderr, "FAIL: %d threads: got %d thread blindings, "
+		    "want 1 to %d\n", nthreads, n, want);
+		return 0;
+	}
+	if (nthreads <= RSA_THREAD_BLINDING_SLOTS &&
+	    rsa->mt_blinding != NULL) {
+		fprintf(stderr, "FAIL: %d threads: mt_blinding is set\n",
+		    nthreads);
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Many more threads than slots come and go, a few at a time. As no more
+ * than a wave of them run at once, none of them should need mt_blinding.
+ */
+static int
+churn_test(void)
+{
+	int i, n;
+
+	if (!rsa_private_op()) {
+		fprintf(stderr, "FAIL: private key operation failed\n");
+		return 0;
+	}
+	for (i = 0; i < CHURN_THREADS; i += CHURN_WAVE) {
+		if (!run_threads(CHURN_WAVE, churn_thread))
+			return 0;
+	}
+
+	if ((n = count_thread_blindings()) < 1 ||
+	    n > RSA_THREAD_BLINDING_SLOTS) {
+		fprintf(stderr, "FAIL: churn: got %d thread blindings\n", n);
+		return 0;
+	}
+	if (rsa->mt_blinding != NULL) {
+		fprintf(stderr, "FAIL: churn: mt_blinding is set\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+/* With every slot held, a thread falls back to rsa->mt_blinding. */
+static int
+full_table_test(void)
+{
+	int i, ret = 1;
+
+	if (!rsa_private_op() || !run_threads(1, churn_thread)) {
+		fprintf(stderr, "FAIL: private key operation failed\n");
+		return 0;
+	}
+	if (rsa->thread_blinding == NULL || rsa->mt_blinding != NULL) {
+		fprintf(stderr, "FAIL: full table: wrong initial state\n");
+		return 0;
+	}
+
+	for (i = 0; i < RSA_THREAD_BLINDING_SLOTS; i++)
+		rsa->thread_blinding[i].busy = 1;
+	if (!run_threads(1, churn_thread))
+		ret = 0;
+	if (rsa->mt_blinding == NULL) {
+		fprintf(stderr, "FAIL: full table: mt_blinding is not set\n");
+		ret = 0;
+	}
+	for (i = 0; i < RSA_THREAD_BLINDING_SLOTS; i++)
+		rsa->thread_blinding[i].busy = 0;
+
+	return ret;
+}
+
+/* Turning blinding off frees the table. */
+static int
+blinding_off_test(void)
+{
+	RSA_blinding_off(rsa);
+	if (rsa->blinding != NULL || rsa->thread_blinding != NULL) {
+		fprintf(stderr, "FAIL: RSA_blinding_off left blinding set up\n");
+		return 0;
+	}
+	if (!rsa_private_op()) {
+		fprintf(stderr, "FAIL: private key operation failed without "
+		    "blinding\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+static RSA *
+rsa_new_key(void)
+{
+	RSA *key;
+	BIGNUM *e;
+
+	if ((e = BN_new()) == NULL || !BN_set_word(e, RSA_F4))
+		errx(1, "BN_set_word failed");
+	if ((key = RSA_new()) == NULL ||
+	    !RSA_generate_key_ex(key, 1024, e, NULL))
+		errx(1, "RSA_generate_key_ex failed");
+	BN_free(e);
+
+	return key;
+}
+
+int
+main(int argc, char **argv)
+{
+	static const int nthreads[] = {
+		1, 8, RSA_THREAD_BLINDING_SLOTS, RSA_THREAD_BLINDING_SLOTS + 8,
+	};
+	size_t i;
+	int failed = 0;
+
+	/* libcrypto only locks with the callbacks set. */
+	if ((crypto_locks = calloc(CRYPTO_num_locks(),
+	    sizeof(*crypto_locks))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < (size_t)CRYPTO_num_locks(); i++)
+		pthread_mutex_init(&crypto_locks[i], NULL);
+	CRYPTO_set_locking_callback(crypto_lock_cb);
+
+	if (pthread_key_create(&threadid_key, NULL) != 0)
+		errx(1, "pthread_key_create failed");
+	if (!CRYPTO_THREADID_set_callback(threadid_cb))
+		errx(1, "CRYPTO_THREADID_set_callback failed");
+
+	for (i = 0; i < sizeof(nthreads) / sizeof(nthreads[0]); i++) {
+		rsa = rsa_new_key();
+		failed |= !blinding_test(nthreads[i]);
+		failed |= !blinding_off_test();
+		RSA_free(rsa);
+	}
+
+	rsa = rsa_new_key();
+	failed |= !churn_test();
+	failed |= !blinding_off_test();
+	RSA_free(rsa);
+
+	rsa = rsa_new_key();
+	failed |= !full_table_test();
+	failed |= !blinding_off_test();
+	RSA_free(rsa);
+
+	CRYPTO_set_locking_callback(NULL);
+	for (i = 0; i < (size_t)CRYPTO_num_locks(); i++)
+		pthread_mutex_destroy(&crypto_locks[i]);
+	free(crypto_locks);
+
+	if (!failed)
+		printf("PASS\n");
+
+	return failed;
+}
@@ -0,0 +1,184 @@
+/* $OpenBSD$ */
+/*
+ * Copyright (c) 2026 The LibreSSL project.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Test that the Montgomery context for n built when an RSA key is decoded
+ * is used without CRYPTO_LOCK_RSA, while keys that were not decoded still
+ * build theirs on first use under the lock.
+ */
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/bn.h>
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+#include <openssl/rsa.h>
+
+#include "rsa_locl.h"
+
+#define PUBLIC_OPS	16
+
+static int rsa_locks;
+
+static void
+crypto_lock_cb(int mode, int type, const char *file, int line)
+{
+	if ((mode & CRYPTO_LOCK) != 0 && type == CRYPTO_LOCK_RSA)
+		rsa_locks++;
+}
+
+static RSA *
+rsa_new_key(unsigned long e_word)
+{
+	RSA *key;
+	BIGNUM *e;
+
+	if ((e = BN_new()) == NULL || !BN_set_word(e, e_word))
+		errx(1, "BN_set_word failed");
+	if ((key = RSA_new()) == NULL ||
+	    !RSA_generate_key_ex(key, 1024, e, NULL))
+		errx(1, "RSA_generate_key_ex failed");
+	BN_free(e);
+
+	return key;
+}
+
+/* Decode the public half of key into *pub, which may already be a key. */
+static RSA *
+rsa_decode_public(RSA **pub, RSA *key)
+{
+	unsigned char *der = NULL;
+	const unsigned char *p;
+	int len;
+
+	if ((len = i2d_RSAPublicKey(key, &der)) <= 0)
+		errx(1, "i2d_RSAPublicKey failed");
+	p = der;
+	if (d2i_RSAPublicKey(pub, &p, len) == NULL)
+		errx(1, "d2i_RSAPublicKey failed");
+	free(der);
+
+	return *pub;
+}
+
+/*
+ * Encrypt with pub and decrypt with key, and return how often the public
+ * operations took CRYPTO_LOCK_RSA, or -1 on failure.
+ */
+static int
+rsa_public_ops(RSA *pub, RSA *key)
+{
+	unsigned char msg[32], enc[128], dec[128];
+	int i, locks = 0;
+
+	for (i = 0; i < PUBLIC_OPS; i++) {
+		arc4random_buf(msg, sizeof(msg));
+		rsa_locks = 0;
+		if (RSA_public_encrypt(sizeof(msg), msg, enc, pub,
+		    RSA_PKCS1_PADDING) != RSA_size(pub)) {
+			ERR_print_errors_fp(stderr);
+			return -1;
+		}
+		locks += rsa_locks;
+		if (RSA_private_decrypt(RSA_size(key), enc, dec, key,
+		    RSA_PKCS1_PADDING) != sizeof(msg) ||
+		    memcmp(msg, dec, sizeof(msg)) != 0) {
+			ERR_print_errors_fp(stderr);
+			return -1;
+		}
+	}
+
+	return locks;
+}
+
+static int
+rsa_mont_test(unsigned long e_word)
+{
+	RSA *key, *other, *pub = NULL;
+	int locks, failed = 0;
+
+	key = rsa_new_key(e_word);
+	other = rsa_new_key(e_word);
+
+	/* A generated key builds its context on first use, under the lock. */
+	if ((key->flags & RSA_FLAG_MONT_N_DECODED) != 0) {
+		fprintf(stderr, "FAIL: e=%lu: generated key is flagged\n",
+		    e_word);
+		failed = 1;
+	}
+	if ((locks = rsa_public_ops(key, key)) <= 0) {
+		fprintf(stderr, "FAIL: e=%lu: generated key: %d locks\n",
+		    e_word, locks);
+		failed = 1;
+	}
+
+	/* A decoded key has its context and reads it without the lock. */
+	rsa_decode_public(&pub, key);
+	if ((pub->flags & RSA_FLAG_MONT_N_DECODED) == 0 ||
+	    pub->_method_mod_n == NULL) {
+		fprintf(stderr, "FAIL: e=%lu: decoded key has no context\n",
+		    e_word);
+		failed = 1;
+	}
+	if ((locks = rsa_public_ops(pub, key)) != 0) {
+		fprintf(stderr, "FAIL: e=%lu: decoded key: %d locks\n",
+		    e_word, locks);
+		failed = 1;
+	}
+
+	/* Decoding another key into the same structure replaces it. */
+	rsa_decode_public(&pub, other);
+	if ((pub->flags & RSA_FLAG_MONT_N_DECODED) == 0 ||
+	    BN_cmp(&pub->_method_mod_n->N, other->n) != 0) {
+		fprintf(stderr, "FAIL: e=%lu: redecoded key has a stale "
+		    "context\n", e_word);
+		failed = 1;
+	}
+	if ((locks = rsa_public_ops(pub, other)) != 0) {
+		fprintf(stderr, "FAIL: e=%lu: redecoded key: %d locks\n",
+		    e_word, locks);
+		failed = 1;
+	}
+
+	RSA_free(pub);
+	RSA_free(other);
+	RSA_free(key);
+
+	return !failed;
+}
+
+int
+main(int argc, char **argv)
+{
+	int failed = 0;
+
+	CRYPTO_set_locking_callback(crypto_lock_cb);
+
+	/* e=65537 takes the fast path, e=3 the method's bn_mod_exp. */
+	failed |= !rsa_mont_test(RSA_F4);
+	failed |= !rsa_mont_test(RSA_3);
+
+	CRYPTO_set_locking_callback(NULL);
+
+	if (!failed)
+		printf("PASS\n");
+
+	return failed;
+}
@@ -3,6 +3,7 @@
  * Copyright (c) 2004 The OpenSSL Project.  All rights reserved.
  * ====================================================================
  */
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -61,8 +62,9 @@ unsigned char addenum_3[SHA224_DIGEST_LENGTH] = {
 	0x4e, 0xe7, 0xad, 0x67,
 };
 
-int
-main(int argc, char **argv) {
+static int
+sha256_test(void)
+{
 	unsigned char md[SHA256_DIGEST_LENGTH];
 	int		i;
 	EVP_MD_CTX	evp;
@@ -159,4 +161,209 @@ main(int argc, char **argv) {
 
 	return 0;
 }
+
+#define MAX_MSG_LEN	(100 * 1024 + 3)
+
+static unsigned char msg[MAX_MSG_LEN + 1];
+
+/* Message lengths around the block size and a few multi-block ones. */
+static size_t
+msg_len(int i)
+{
+	static const size_t long_lens[] = {
+		4096, 8191, 8192, 8193, 65536 + 55, MAX_MSG_LEN,
+	};
+
+	if (i < 1000)
+		return i;
+	i -= 1000;
+	if (i < (int)(sizeof(long_lens) / sizeof(long_lens[0])))
+		return long_lens[i];
+	return 0;
+}
+
+#define NUM_MSG_LENS	1006
+
+static unsigned char ref_md[NUM_MSG_LENS][SHA256_DIGEST_LENGTH];
+
+/*
+ * Hash messages of many lengths, fed in pieces and from an unaligned
+ * buffer, and compare the digests with those of the first code path.
+ */
+static int
+sha256_paths_test(const char *path, int ref)
+{
+	unsigned char md[SHA256_DIGEST_LENGTH];
+	const unsigned char *p;
+	SHA256_CTX ctx;
+	size_t len, n;
+	int i;
+
+	for (i = 0; i < NUM_MSG_LENS; i++) {
+		len = msg_len(i);
+		p = msg + (i & 1);
+
+		SHA256_Init(&ctx);
+		for (n = 0; n < len; n += 1 + n % 193)
+			SHA256_Update(&ctx, p + n,
+			    len - n < 1 + n % 193 ? len - n : 1 + n % 193);
+		SHA256_Final(md, &ctx);
+
+		if (ref) {
+			memcpy(ref_md[i], md, sizeof(md));
+			continue;
+		}
+		if (memcmp(md, ref_md[i], sizeof(md)) != 0) {
+			fprintf(stderr, "SHA-256 %s path differs for length "
+			    "%zu.\n", path, len);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+#define MULTI_MAX_COUNT	64
+#define MULTI_MAX_LEN	(21 * 1024)
+
+/*
+ * Hash groups of 0 to MULTI_MAX_COUNT messages with SHA256_multi(), with
+ * lengths around the block size mixed with lengths up to MULTI_MAX_LEN,
+ * and check each digest against SHA256().
+ */
+static int
+sha256_multi_test(const char *path)
+{
+	static const size_t short_lens[] = {
+		0, 1, 55, 56, 63, 64, 65, 119, 120, 127, 128, 129,
+	};
+	unsigned char mds[MULTI_MAX_COUNT][SHA256_DIGEST_LENGTH];
+	unsigned char md[SHA256_DIGEST_LENGTH];
+	const unsigned char *d[MULTI_MAX_COUNT];
+	unsigned char *mdp[MULTI_MAX_COUNT];
+	size_t n[MULTI_MAX_COUNT];
+	size_t count, i;
+
+	for (count = 0; count <= MULTI_MAX_COUNT; count++) {
+		for (i = 0; i < count; i++) {
+			if (i & 1)
+				n[i] = short_lens[(count + i) %
+				    (sizeof(short_lens) / sizeof(short_lens[0]))];
+			else
+				n[i] = (count * 331 + i * 2053) %
+				    (MULTI_MAX_LEN + 1);
+			d[i] = msg + i % 3;
+			mdp[i] = mds[i];
+		}
+		memset(mds, 0, sizeof(mds));
+
+		SHA256_multi(d, n, mdp, count);
+
+		for (i = 0; i < count; i++) {
+			SHA256(d[i], n[i], md);
+			if (memcmp(md, mds[i], sizeof(md)) != 0) {
+				fprintf(stderr, "SHA256_multi %s path differs "
+				    "for message %zu of %zu, length %zu.\n",
+				    path, i, count, n[i]);
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+#if defined(__x86_64__) && !defined(OPENSSL_NO_ASM)
+#include "x86_arch.h"
+
+extern uint64_t OPENSSL_ia32cap_P;
+extern uint32_t OPENSSL_ia32cap_ext_P;
+void OPENSSL_cpuid_setup(void);
+
+/*
+ * The code paths of sha256_block_data_order and SHA256_multi(), selected
+ * by clearing capability bits. A path is only run if the CPU has the bits
+ * it needs. The SSSE3 path only differs for SHA256_multi().
+ */
+static const struct {
+	const char *name;
+	uint64_t need;
+	uint32_t need_ext;
+	uint64_t clear;
+	uint32_t clear_ext;
+} paths[] = {
+	{
+		.name = "integer",
+		.clear = CPUCAP_MASK_SSSE3,
+		.clear_ext = IA32CAP_EXT_MASK_SHA | IA32CAP_EXT_MASK_AVX2,
+	},
+	{
+		.name = "SSSE3",
+		.need = CPUCAP_MASK_SSSE3,
+		.clear_ext = IA32CAP_EXT_MASK_SHA | IA32CAP_EXT_MASK_AVX2,
+	},
+	{
+		.name = "AVX2",
+		.need_ext = IA32CAP_EXT_MASK_AVX2 | IA32CAP_EXT_MASK_BMI1 |
+		    IA32CAP_EXT_MASK_BMI2,
+		.clear_ext = IA32CAP_EXT_MASK_SHA,
+	},
+	{
+		.name = "SHA extensions",
+		.need_ext = IA32CAP_EXT_MASK_SHA,
+	},
+};
+
+static int
+cpu_paths_test(void)
+{
+	uint64_t caps;
+	uint32_t caps_ext;
+	size_t i;
+	int failed = 0;
+
+	OPENSSL_cpuid_setup();
+	caps = OPENSSL_ia32cap_P;
+	caps_ext = OPENSSL_ia32cap_ext_P;
+
+	for (i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+		if ((caps & paths[i].need) != paths[i].need ||
+		    (caps_ext & paths[i].need_ext) != paths[i].need_ext) {
+			fprintf(stdout, "Skipping SHA-256 %s path.\n",
+			    paths[i].name);
+			continue;
+		}
+		fprintf(stdout, "Using SHA-256 %s path.\n", paths[i].name);
+		OPENSSL_ia32cap_P = caps & ~paths[i].clear;
+		OPENSSL_ia32cap_ext_P = caps_ext & ~paths[i].clear_ext;
+		failed |= sha256_test();
+		failed |= sha256_paths_test(paths[i].name, i == 0);
+		failed |= sha256_multi_test(paths[i].name);
+	}
+	OPENSSL_ia32cap_P = caps;
+	OPENSSL_ia32cap_ext_P = caps_ext;
+
+	return failed;
+}
+#else
+static int
+cpu_paths_test(void)
+{
+	int failed;
+
+	failed = sha256_test();
+	failed |= sha256_paths_test("generic", 1);
+	failed |= sha256_multi_test("generic");
+
+	return failed;
+}
+#endif
+
+int
+main(int argc, char **argv)
+{
+	arc4random_buf(msg, sizeof(msg));
+
+	return cpu_paths_test();
+}
 #endif
@@ -3,6 +3,7 @@
  * Copyright (c) 2004 The OpenSSL Project.  All rights reserved.
  * ====================================================================
  */
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -80,8 +81,9 @@ unsigned char app_d3[SHA384_DIGEST_LENGTH] = {
 	0xae, 0x97, 0xdd, 0xd8, 0x7f, 0x3d, 0x89, 0x85,
 };
 
-int
-main(int argc, char **argv) {
+static int
+sha512_test(void)
+{
 	unsigned char md[SHA512_DIGEST_LENGTH];
 	int		i;
 	EVP_MD_CTX	evp;
@@ -198,4 +200,140 @@ main(int argc, char **argv) {
 
 	return 0;
 }
+
+#define MAX_MSG_LEN	(100 * 1024 + 3)
+
+static unsigned char msg[MAX_MSG_LEN + 1];
+
+/* Message lengths around the block size and a few multi-block ones. */
+static size_t
+msg_len(int i)
+{
+	static const size_t long_lens[] = {
+		4096, 8191, 8192, 8193, 65536 + 111, MAX_MSG_LEN,
+	};
+
+	if (i < 1000)
+		return i;
+	i -= 1000;
+	if (i < (int)(sizeof(long_lens) / sizeof(long_lens[0])))
+		return long_lens[i];
+	return 0;
+}
+
+#define NUM_MSG_LENS	1006
+
+static unsigned char ref_md[NUM_MSG_LENS][SHA512_DIGEST_LENGTH];
+
+/*
+ * Hash messages of many lengths, fed in pieces and from an unaligned
+ * buffer, and compare the digests with those of the first code path.
+ */
+static int
+sha512_paths_test(const char *path, int ref)
+{
+	unsigned char md[SHA512_DIGEST_LENGTH];
+	const unsigned char *p;
+	SHA512_CTX ctx;
+	size_t len, n;
+	int i;
+
+	for (i = 0; i < NUM_MSG_LENS; i++) {
+		len = msg_len(i);
+		p = msg + (i & 1);
+
+		SHA512_Init(&ctx);
+		for (n = 0; n < len; n += 1 + n % 389)
+			SHA512_Update(&ctx, p + n,
+			    len - n < 1 + n % 389 ? len - n : 1 + n % 389);
+		SHA512_Final(md, &ctx);
+
+		if (ref) {
+			memcpy(ref_md[i], md, sizeof(md));
+			continue;
+		}
+		if (memcmp(md, ref_md[i], sizeof(md)) != 0) {
+			fprintf(stderr, "SHA-512 %s path differs for length "
+			    "%zu.\n", path, len);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+#if defined(__x86_64__) && !defined(OPENSSL_NO_ASM)
+#include "x86_arch.h"
+
+extern uint32_t OPENSSL_ia32cap_ext_P;
+void OPENSSL_cpuid_setup(void);
+
+/*
+ * The code paths of sha512_block_data_order, selected by clearing bits
+ * of the extended capability word. A path is only run if the CPU has the
+ * bits it needs.
+ */
+static const struct {
+	const char *name;
+	uint32_t need;
+	uint32_t clear;
+} paths[] = {
+	{
+		.name = "integer",
+		.need = 0,
+		.clear = IA32CAP_EXT_MASK_AVX2,
+	},
+	{
+		.name = "AVX2",
+		.need = IA32CAP_EXT_MASK_AVX2 | IA32CAP_EXT_MASK_BMI1 |
+		    IA32CAP_EXT_MASK_BMI2,
+		.clear = 0,
+	},
+};
+
+static int
+cpu_paths_test(void)
+{
+	uint32_t caps;
+	size_t i;
+	int failed = 0;
+
+	OPENSSL_cpuid_setup();
+	caps = OPENSSL_ia32cap_ext_P;
+
+	for (i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+		if ((caps & paths[i].need) != paths[i].need) {
+			fprintf(stdout, "Skipping SHA-512 %s path.\n",
+			    paths[i].name);
+			continue;
+		}
+		fprintf(stdout, "Using SHA-512 %s path.\n", paths[i].name);
+		OPENSSL_ia32cap_ext_P = caps & ~paths[i].clear;
+		failed |= sha512_test();
+		failed |= sha512_paths_test(paths[i].name, i == 0);
+	}
+	OPENSSL_ia32cap_ext_P = caps;
+
+	return failed;
+}
+#else
+static int
+cpu_paths_test(void)
+{
+	int failed;
+
+	failed = sha512_test();
+	failed |= sha512_paths_test("generic", 1);
+
+	return failed;
+}
+#endif
+
+int
+main(int argc, char **argv)
+{
+	arc4random_buf(msg, sizeof(msg));
+
+	return cpu_paths_test();
+}
 #endif
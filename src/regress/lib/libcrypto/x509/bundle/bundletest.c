@@ -0,0 +1,614 @@
+/* $OpenBSD$ */
+/*
+ * Copyright (c) 2026 The LibreSSL project.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Tests for certificate bundles: the format written by
+ * X509_bundle_write_bio(), loading through the file and memory lookups,
+ * lazy decoding on lookup, and rejection of malformed bundles.
+ */
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <openssl/bio.h>
+#include <openssl/ec.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/objects.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#define DAY	(24 * 60 * 60)
+
+#define HEADER_LEN	16
+#define ENTRY_LEN	12
+
+#define N_FILLERS	30
+
+static EVP_PKEY *
+key_new(void)
+{
+	EVP_PKEY *pkey;
+	EC_KEY *ec;
+
+	if ((ec = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1)) == NULL ||
+	    !EC_KEY_generate_key(ec))
+		errx(1, "EC_KEY_generate_key failed");
+	if ((pkey = EVP_PKEY_new()) == NULL || !EVP_PKEY_assign_EC_KEY(pkey, ec))
+		errx(1, "EVP_PKEY_assign_EC_KEY failed");
+
+	return pkey;
+}
+
+static X509_NAME *
+name_new(const char *cn)
+{
+	X509_NAME *name;
+
+	if ((name = X509_NAME_new()) == NULL ||
+	    !X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+	    (const unsigned char *)cn, -1, -1, 0))
+		errx(1, "X509_NAME_add_entry_by_txt failed");
+
+	return name;
+}
+
+/*
+ * Make a certificate for cn and key, issued by issuer, or self-signed if
+ * issuer is NULL. It is valid from the given day until the given day,
+ * relative to now.
+ */
+static X509 *
+cert_new(const char *cn, EVP_PKEY *key, X509 *issuer, EVP_PKEY *issuer_key,
+    int ca, long serial, long from, long until)
+{
+	BASIC_CONSTRAINTS *bc;
+	unsigned char *der = NULL;
+	const unsigned char *p;
+	X509_NAME *name;
+	X509 *x, *ret;
+	int len;
+
+	if ((x = X509_new()) == NULL)
+		errx(1, "X509_new failed");
+	name = name_new(cn);
+	if (!X509_set_version(x, 2) ||
+	    !ASN1_INTEGER_set(X509_get_serialNumber(x), serial) ||
+	    !X509_set_subject_name(x, name) ||
+	    !X509_set_issuer_name(x, issuer != NULL ?
+	    X509_get_subject_name(issuer) : name) ||
+	    X509_gmtime_adj(X509_get_notBefore(x), from * DAY) == NULL ||
+	    X509_gmtime_adj(X509_get_notAfter(x), until * DAY) == NULL ||
+	    !X509_set_pubkey(x, key))
+		errx(1, "failed to set up certificate");
+	X509_NAME_free(name);
+
+	if ((bc = BASIC_CONSTRAINTS_new()) == NULL)
+		errx(1, "BASIC_CONSTRAINTS_new failed");
+	bc->ca = ca ? 0xff : 0;
+	if (!X509_add1_ext_i2d(x, NID_basic_constraints, bc, 1, 0))
+		errx(1, "X509_add1_ext_i2d failed");
+	BASIC_CONSTRAINTS_free(bc);
+
+	if (!X509_sign(x, issuer_key != NULL ? issuer_key : key,
+	    EVP_sha256()))
+		errx(1, "X509_sign failed");
+
+	/* Round trip through DER, so that the encoding and hash are cached. */
+	if ((len = i2d_X509(x, &der)) <= 0)
+		errx(1, "i2d_X509 failed");
+	p = der;
+	if ((ret = d2i_X509(NULL, &p, len)) == NULL)
+		errx(1, "d2i_X509 failed");
+	free(der);
+	X509_free(x);
+
+	return ret;
+}
+
+struct certs {
+	EVP_PKEY *root_key, *key;
+	X509 *root, *old_root, *leaf, *dup[2], *fillers[N_FILLERS];
+	STACK_OF(X509) *sk;
+};
+
+static void
+certs_new(struct certs *c)
+{
+	char cn[32];
+	int i;
+
+	c->root_key = key_new();
+	c->key = key_new();
+
+	c->root = cert_new("Bundle Root", c->root_key, NULL, NULL, 1, 1,
+	    -1, 3650);
+	c->old_root = cert_new("Bundle Root", c->root_key, NULL, NULL, 1, 2,
+	    -10, -1);
+	c->leaf = cert_new("Bundle Leaf", c->key, c->root, c->root_key, 0, 3,
+	    -1, 30);
+	c->dup[0] = cert_new("Dup", c->key, NULL, NULL, 1, 4, -1, 30);
+	c->dup[1] = cert_new("Dup", c->root_key, NULL, NULL, 1, 5, -1, 30);
+	for (i = 0; i < N_FILLERS; i++) {
+		snprintf(cn, sizeof(cn), "Filler %d", i);
+		c->fillers[i] = cert_new(cn, c->key, NULL, NULL, 1, 10 + i,
+		    -1, 30);
+	}
+
+	/* The bundle is written from a stack with duplicates. */
+	if ((c->sk = sk_X509_new_null()) == NULL)
+		errx(1, "sk_X509_new_null failed");
+	for (i = 0; i < N_FILLERS; i++) {
+		if (!sk_X509_push(c->sk, c->fillers[i]))
+			errx(1, "sk_X509_push failed");
+		if (i == N_FILLERS / 2 &&
+		    (!sk_X509_push(c->sk, c->root) ||
+		    !sk_X509_push(c->sk, c->dup[0]) ||
+		    !sk_X509_push(c->sk, c->dup[1])))
+			errx(1, "sk_X509_push failed");
+	}
+	if (!sk_X509_push(c->sk, c->root) || !sk_X509_push(c->sk, c->dup[0]))
+		errx(1, "sk_X509_push failed");
+}
+
+static void
+certs_free(struct certs *c)
+{
+	int i;
+
+	sk_X509_free(c->sk);
+	X509_free(c->root);
+	X509_free(c->old_root);
+	X509_free(c->leaf);
+	X509_free(c->dup[0]);
+	X509_free(c->dup[1]);
+	for (i = 0; i < N_FILLERS; i++)
+		X509_free(c->fillers[i]);
+	EVP_PKEY_free(c->root_key);
+	EVP_PKEY_free(c->key);
+}
+
+static uint32_t
+get32(const unsigned char *p)
+{
+	return ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+	    (uint32_t)p[2] << 8 | (uint32_t)p[3]);
+}
+
+static void
+put32(unsigned char *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static unsigned char *
+bundle_new(struct certs *c, size_t *len)
+{
+	unsigned char *data, *p;
+	BIO *bio;
+	long n;
+
+	if ((bio = BIO_new(BIO_s_mem())) == NULL)
+		errx(1, "BIO_new failed");
+	if (!X509_bundle_write_bio(bio, c->sk))
+		errx(1, "X509_bundle_write_bio failed");
+	if ((n = BIO_get_mem_data(bio, &p)) <= 0)
+		errx(1, "empty bundle");
+	if ((data = malloc(n)) == NULL)
+		err(1, NULL);
+	memcpy(data, p, n);
+	*len = n;
+	BIO_free(bio);
+
+	return data;
+}
+
+/* Number of objects the store has decoded and added. */
+static int
+store_num(X509_STORE *store)
+{
+	return sk_X509_OBJECT_num(store->objs);
+}
+
+static int
+verify(X509_STORE *store, X509 *leaf)
+{
+	X509_STORE_CTX *ctx;
+	int error;
+
+	if ((ctx = X509_STORE_CTX_new()) == NULL ||
+	    !X509_STORE_CTX_init(ctx, store, leaf, NULL))
+		errx(1, "X509_STORE_CTX_init failed");
+	if (X509_verify_cert(ctx) == 1)
+		error = X509_V_OK;
+	else if ((error = X509_STORE_CTX_get_error(ctx)) == X509_V_OK)
+		error = -1;
+	X509_STORE_CTX_free(ctx);
+
+	return error;
+}
+
+static int
+get1_certs(X509_STORE *store, const char *cn)
+{
+	X509_STORE_CTX *ctx;
+	STACK_OF(X509) *sk;
+	X509_NAME *name;
+	int n;
+
+	if ((ctx = X509_STORE_CTX_new()) == NULL ||
+	    !X509_STORE_CTX_init(ctx, store, NULL, NULL))
+		errx(1, "X509_STORE_CTX_init failed");
+	name = name_new(cn);
+	sk = X509_STORE_get1_certs(ctx, name);
+	n = sk == NULL ? 0 : sk_X509_num(sk);
+	sk_X509_pop_free(sk, X509_free);
+	X509_NAME_free(name);
+	X509_STORE_CTX_free(ctx);
+
+	return n;
+}
+
+static int
+check_int(const char *desc, int got, int want)
+{
+	if (got == want)
+		return 1;
+	fprintf(stderr, "FAIL: %s: got %d, want %d\n", desc, got, want);
+	return 0;
+}
+
+/*
+ * Check the layout of a written bundle: a sorted index with the subject
+ * hash of each certificate, and every distinct input certificate once.
+ */
+static int
+bundle_write_test(struct certs *c)
+{
+	unsigned char *data;
+	const unsigned char *p;
+	uint32_t i, count, hash, offset, length, last = 0;
+	int found[N_FILLERS + 3] = { 0 };
+	X509 *want[N_FILLERS + 3];
+	size_t len;
+	X509 *x;
+	int j, failed = 0;
+
+	for (j = 0; j < N_FILLERS; j++)
+		want[j] = c->fillers[j];
+	want[N_FILLERS] = c->root;
+	want[N_FILLERS + 1] = c->dup[0];
+	want[N_FILLERS + 2] = c->dup[1];
+
+	data = bundle_new(c, &len);
+
+	if (len < HEADER_LEN || memcmp(data, "\0X509BND", 8) != 0 ||
+	    get32(data + 8) != 1)
+		errx(1, "FAIL: bad bundle header");
+	count = get32(data + 12);
+	failed |= !check_int("index entries", count, N_FILLERS + 3);
+	if (HEADER_LEN + (size_t)count * ENTRY_LEN > len)
+		errx(1, "FAIL: index extends past the end of the bundle");
+
+	for (i = 0; i < count; i++) {
+		p = data + HEADER_LEN + i * ENTRY_LEN;
+		hash = get32(p);
+		offset = get32(p + 4);
+		length = get32(p + 8);
+		if (hash < last) {
+			fprintf(stderr, "FAIL: index entry %u out of order\n", i);
+			failed = 1;
+		}
+		last = hash;
+		if (offset < HEADER_LEN + count * ENTRY_LEN || offset > len ||
+		    length > len - offset) {
+			fprintf(stderr, "FAIL: index entry %u out of bounds\n",
+			    i);
+			failed = 1;
+			continue;
+		}
+		p = data + offset;
+		if ((x = d2i_X509(NULL, &p, length)) == NULL ||
+		    p != data + offset + length) {
+			fprintf(stderr, "FAIL: certificate %u does not "
+			    "decode\n", i);
+			failed = 1;
+			X509_free(x);
+			continue;
+		}
+		if (X509_subject_name_hash(x) != hash) {
+			fprintf(stderr, "FAIL: certificate %u has the wrong "
+			    "hash\n", i);
+			failed = 1;
+		}
+		for (j = 0; j < N_FILLERS + 3; j++) {
+			if (X509_cmp(x, want[j]) == 0)
+				found[j]++;
+		}
+		X509_free(x);
+	}
+	for (j = 0; j < N_FILLERS + 3; j++) {
+		if (found[j] != 1) {
+			fprintf(stderr, "FAIL: certificate %d found %d times\n",
+			    j, found[j]);
+			failed = 1;
+		}
+	}
+
+	free(data);
+
+	return !failed;
+}
+
+/*
+ * Nothing is decoded when a bundle is loaded. Each lookup decodes only
+ * the certificates with the subject it asks for.
+ */
+static int
+bundle_lookup_test(const char *desc, struct certs *c, X509_STORE *store)
+{
+	int failed = 0;
+
+	if (!check_int(desc, store_num(store), 0))
+		return 0;
+
+	failed |= !check_int(desc, verify(store, c->leaf), X509_V_OK);
+	failed |= !check_int(desc, store_num(store), 1);
+	failed |= !check_int(desc, verify(store, c->leaf), X509_V_OK);
+	failed |= !check_int(desc, store_num(store), 1);
+
+	/* Both certificates with the same subject are found. */
+	failed |= !check_int(desc, get1_certs(store, "Dup"), 2);
+	failed |= !check_int(desc, store_num(store), 3);
+	failed |= !check_int(desc, get1_certs(store, "Filler 7"), 1);
+	failed |= !check_int(desc, store_num(store), 4);
+	failed |= !check_int(desc, get1_certs(store, "Nobody"), 0);
+	failed |= !check_int(desc, store_num(store), 4);
+
+	return !failed;
+}
+
+static int
+bundle_mem_test(struct certs *c)
+{
+	X509_STORE *store;
+	unsigned char *data;
+	size_t len;
+	int failed = 0;
+
+	data = bundle_new(c, &len);
+	if ((store = X509_STORE_new()) == NULL ||
+	    !X509_STORE_load_mem(store, data, len))
+		errx(1, "X509_STORE_load_mem failed");
+	/* The store keeps its own copy. */
+	memset(data, 0, len);
+	free(data);
+
+	failed |= !bundle_lookup_test("by_mem", c, store);
+	X509_STORE_free(store);
+
+	return !failed;
+}
+
+static int
+bundle_file_test(struct certs *c)
+{
+	char path[] = "/tmp/bundletest.XXXXXXXXXX";
+	char tmp[] = "/tmp/bundletest.XXXXXXXXXX";
+	X509_LOOKUP *lu;
+	X509_STORE *store[2];
+	unsigned char *data;
+	size_t len;
+	int fd, failed = 0;
+
+	data = bundle_new(c, &len);
+	if ((fd = mkstemp(path)) == -1)
+		err(1, "mkstemp");
+	if (write(fd, data, len) != (ssize_t)len)
+		err(1, "write");
+	free(data);
+
+	/* A bundle given as a CA file goes to the bundle lookup. */
+	if ((store[0] = X509_STORE_new()) == NULL ||
+	    !X509_STORE_load_locations(store[0], path, NULL))
+		errx(1, "X509_STORE_load_locations failed");
+	if ((store[1] = X509_STORE_new()) == NULL ||
+	    (lu = X509_STORE_add_lookup(store[1],
+	    X509_LOOKUP_bundle())) == NULL ||
+	    X509_LOOKUP_load_bundle(lu, path) != 1)
+		errx(1, "X509_LOOKUP_load_bundle failed");
+
+	close(fd);
+
+	/*
+	 * Replace the bundle the way certhash does, by renaming a new file
+	 * over it. The stores keep using the file they mapped.
+	 */
+	if ((fd = mkstemp(tmp)) == -1)
+		err(1, "mkstemp");
+	if (write(fd, "replaced", 8) != 8)
+		err(1, "write");
+	close(fd);
+	if (rename(tmp, path) == -1)
+		err(1, "rename");
+	unlink(path);
+
+	failed |= !bundle_lookup_test("by_file", c, store[0]);
+	failed |= !bundle_lookup_test("by_bundle", c, store[1]);
+	X509_STORE_free(store[0]);
+	X509_STORE_free(store[1]);
+
+	return !failed;
+}
+
+/*
+ * The store only asks its lookups for a subject it has no certificate
+ * for. A certificate added directly shadows the bundle's certificates
+ * with the same subject, even if it is expired.
+ */
+static int
+bundle_shadow_test(struct certs *c)
+{
+	X509_STORE *store;
+	unsigned char *data;
+	size_t len;
+	int failed = 0;
+
+	data = bundle_new(c, &len);
+	if ((store = X509_STORE_new()) == NULL ||
+	    !X509_STORE_add_cert(store, c->old_root) ||
+	    !X509_STORE_load_mem(store, data, len))
+		errx(1, "failed to set up store");
+	free(data);
+
+	failed |= !check_int("shadowed", verify(store, c->leaf),
+	    X509_V_ERR_CERT_HAS_EXPIRED);
+	failed |= !check_int("shadowed", store_num(store), 1);
+	failed |= !check_int("shadowed", get1_certs(store, "Dup"), 2);
+	X509_STORE_free(store);
+
+	return !failed;
+}
+
+/* Malformed bundles are rejected when they are loaded. */
+static int
+bundle_bad_test(struct certs *c)
+{
+	unsigned char *data, *bad, tmp[ENTRY_LEN];
+	X509_STORE *store;
+	uint32_t count, offset;
+	size_t len;
+	int i, ok, failed = 0;
+	const char *desc[] = {
+		"truncated header",
+		"bad version",
+		"too many entries",
+		"index out of order",
+		"offset in the index",
+		"offset past the end",
+		"zero length",
+		"length past the end",
+	};
+
+	data = bundle_new(c, &len);
+	count = get32(data + 12);
+	if ((bad = malloc(len)) == NULL)
+		err(1, NULL);
+
+	for (i = 0; i < (int)(sizeof(desc) / sizeof(desc[0])); i++) {
+		memcpy(bad, data, len);
+		switch (i) {
+		case 0:
+			/* Only checked after the magic is matched. */
+			break;
+		case 1:
+			put32(bad + 8, 2);
+			break;
+		case 2:
+			put32(bad + 12, len / ENTRY_LEN);
+			break;
+		case 3:
+			memcpy(tmp, bad + HEADER_LEN, ENTRY_LEN);
+			memcpy(bad + HEADER_LEN, bad + HEADER_LEN +
+			    (count - 1) * ENTRY_LEN, ENTRY_LEN);
+			memcpy(bad + HEADER_LEN + (count - 1) * ENTRY_LEN, tmp,
+			    ENTRY_LEN);
+			break;
+		case 4:
+			put32(bad + HEADER_LEN + 4, HEADER_LEN);
+			break;
+		case 5:
+			put32(bad + HEADER_LEN + 4, len + 1);
+			break;
+		case 6:
+			put32(bad + HEADER_LEN + 8, 0);
+			break;
+		case 7:
+			offset = get32(bad + HEADER_LEN + 4);
+			put32(bad + HEADER_LEN + 8, len - offset + 1);
+			break;
+		}
+
+		if ((store = X509_STORE_new()) == NULL)
+			errx(1, "X509_STORE_new failed");
+		ERR_clear_error();
+		ok = X509_STORE_load_mem(store, bad, i == 0 ? 12 : len);
+		ERR_clear_error();
+		if (ok) {
+			fprintf(stderr, "FAIL: %s: bundle accepted\n", desc[i]);
+			failed = 1;
+		}
+		X509_STORE_free(store);
+	}
+
+	/*
+	 * A certificate that does not decode is only noticed on lookup, and
+	 * does not affect the others.
+	 */
+	memcpy(bad, data, len);
+	for (i = 0; i < (int)count; i++) {
+		offset = get32(bad + HEADER_LEN + i * ENTRY_LEN + 4);
+		if (get32(bad + HEADER_LEN + i * ENTRY_LEN) ==
+		    X509_subject_name_hash(c->fillers[7]))
+			bad[offset] = 0xff;
+	}
+	if ((store = X509_STORE_new()) == NULL ||
+	    !X509_STORE_load_mem(store, bad, len))
+		errx(1, "X509_STORE_load_mem failed");
+	failed |= !check_int("bad certificate", get1_certs(store, "Filler 7"),
+	    0);
+	failed |= !check_int("bad certificate", verify(store, c->leaf),
+	    X509_V_OK);
+	X509_STORE_free(store);
+
+	free(bad);
+	free(data);
+
+	return !failed;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct certs c;
+	int failed = 0;
+
+	OpenSSL_add_all_digests();
+	ERR_load_crypto_strings();
+
+	certs_new(&c);
+
+	failed |= !bundle_write_test(&c);
+	failed |= !bundle_mem_test(&c);
+	failed |= !bundle_file_test(&c);
+	failed |= !bundle_shadow_test(&c);
+	failed |= !bundle_bad_test(&c);
+
+	certs_free(&c);
+
+	if (!failed)
+		printf("PASS\n");
+
+	return failed;
+}
@@ -0,0 +1,712 @@
+/* $OpenBSD$ */
+/*
+ * Copyright (c) 2026 The LibreSSL project.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Tests for X509_CRL_read_compact_bio(): lookups and signature checks must
+ * agree with d2i_X509_CRL(), and malformed or unsupported CRLs must be
+ * rejected.
+ */
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/bio.h>
+#include <openssl/crypto.h>
+#include <openssl/ec.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/objects.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#define N_ENTRIES	2000
+#define N_SMALL		10
+
+#define CRL_INDIRECT	0x01
+#define CRL_LONG_SERIAL	0x02
+
+/* The serial of an entry whose bytes are easy to find in the encoding. */
+static const unsigned char marker[] = {
+	0x5a, 0x5a, 0x5a, 0x5a, 0x5a, 0x5a, 0x5a, 0x5a,
+};
+
+struct crl {
+	unsigned char *der;
+	size_t len;
+	ASN1_INTEGER **serials;
+	int count;
+};
+
+static int crl_write_locks;
+
+static void
+crypto_lock_cb(int mode, int type, const char *file, int line)
+{
+	if ((mode & (CRYPTO_LOCK | CRYPTO_WRITE)) ==
+	    (CRYPTO_LOCK | CRYPTO_WRITE) && type == CRYPTO_LOCK_X509_CRL)
+		crl_write_locks++;
+}
+
+static EVP_PKEY *
+key_new(void)
+{
+	EVP_PKEY *pkey;
+	EC_KEY *ec;
+
+	if ((ec = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1)) == NULL ||
+	    !EC_KEY_generate_key(ec))
+		errx(1, "EC_KEY_generate_key failed");
+	if ((pkey = EVP_PKEY_new()) == NULL || !EVP_PKEY_assign_EC_KEY(pkey, ec))
+		errx(1, "EVP_PKEY_assign_EC_KEY failed");
+
+	return pkey;
+}
+
+static X509_NAME *
+name_new(const char *cn)
+{
+	X509_NAME *name;
+
+	if ((name = X509_NAME_new()) == NULL ||
+	    !X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+	    (const unsigned char *)cn, -1, -1, 0))
+		errx(1, "X509_NAME_add_entry_by_txt failed");
+
+	return name;
+}
+
+static ASN1_INTEGER *
+serial_new(const unsigned char *data, int len, int neg)
+{
+	ASN1_INTEGER *serial;
+
+	if ((serial = ASN1_INTEGER_new()) == NULL ||
+	    !ASN1_STRING_set(serial, data, len))
+		errx(1, "ASN1_STRING_set failed");
+	if (neg)
+		serial->type = V_ASN1_NEG_INTEGER;
+
+	return serial;
+}
+
+/*
+ * Make the serial of entry i. Besides a few fixed ones there are random
+ * serials of 2 to 20 octets, positive and negative, half of them with the
+ * high bit set so that positive ones are encoded with a leading zero. The
+ * last two octets hold i, which keeps the serials distinct.
+ */
+static ASN1_INTEGER *
+entry_serial(int i)
+{
+	static const unsigned char zero[] = { 0x00 };
+	static const unsigned char one[] = { 0x01 };
+	static const unsigned char high[] = { 0x80 };
+	unsigned char data[20];
+	uint32_t r;
+	int len;
+
+	switch (i) {
+	case 0:
+		return serial_new(zero, sizeof(zero), 0);
+	case 1:
+		return serial_new(one, sizeof(one), 0);
+	case 2:
+		return serial_new(one, sizeof(one), 1);
+	case 3:
+		return serial_new(high, sizeof(high), 0);
+	case 4:
+		return serial_new(high, sizeof(high), 1);
+	case 5:
+		return serial_new(marker, sizeof(marker), 0);
+	}
+
+	r = arc4random();
+	len = 2 + r % (sizeof(data) - 1);
+	arc4random_buf(data, sizeof(data));
+	data[0] = (r >> 8) % 2 ? data[0] | 0x80 : (data[0] & 0x7f) | 0x01;
+	data[len - 2] = i >> 8;
+	data[len - 1] = i;
+
+	return serial_new(data, len, (r >> 16) % 4 == 0);
+}
+
+static X509_REVOKED *
+revoked_new(ASN1_INTEGER *serial, long age, int reason, X509_NAME *issuer)
+{
+	ASN1_ENUMERATED *e;
+	GENERAL_NAMES *gens;
+	GENERAL_NAME *gen;
+	X509_REVOKED *rev;
+	ASN1_TIME *date;
+
+	if ((date = X509_gmtime_adj(NULL, -age)) == NULL ||
+	    (rev = X509_REVOKED_new()) == NULL ||
+	    !X509_REVOKED_set_serialNumber(rev, serial) ||
+	    !X509_REVOKED_set_revocationDate(rev, date))
+		errx(1, "failed to set up revoked entry");
+	ASN1_TIME_free(date);
+
+	if (reason != CRL_REASON_NONE) {
+		if ((e = ASN1_ENUMERATED_new()) == NULL ||
+		    !ASN1_ENUMERATED_set(e, reason) ||
+		    !X509_REVOKED_add1_ext_i2d(rev, NID_crl_reason, e, 0, 0))
+			errx(1, "failed to add reason code");
+		ASN1_ENUMERATED_free(e);
+	}
+	if (issuer != NULL) {
+		if ((gens = GENERAL_NAMES_new()) == NULL ||
+		    (gen = GENERAL_NAME_new()) == NULL)
+			errx(1, "GENERAL_NAME_new failed");
+		gen->type = GEN_DIRNAME;
+		if ((gen->d.directoryName = X509_NAME_dup(issuer)) == NULL ||
+		    !sk_GENERAL_NAME_push(gens, gen))
+			errx(1, "sk_GENERAL_NAME_push failed");
+		if (!X509_REVOKED_add1_ext_i2d(rev, NID_certificate_issuer,
+		    gens, 1, 0))
+			errx(1, "X509_REVOKED_add1_ext_i2d failed");
+		GENERAL_NAMES_free(gens);
+	}
+
+	return rev;
+}
+
+/*
+ * Make a signed CRL with count entries, nextUpdate and a CRL number. With
+ * CRL_INDIRECT the last entry names another certificate issuer, with
+ * CRL_LONG_SERIAL its serial has 21 octets.
+ */
+static void
+crl_new(struct crl *c, EVP_PKEY *key, int count, int flags)
+{
+	static const int reasons[] = {
+		CRL_REASON_NONE, CRL_REASON_KEY_COMPROMISE,
+		CRL_REASON_SUPERSEDED, CRL_REASON_REMOVE_FROM_CRL,
+	};
+	unsigned char long_serial[21];
+	X509_NAME *issuer, *other;
+	ASN1_INTEGER *number;
+	X509_CRL *crl;
+	ASN1_TIME *t;
+	unsigned char *der = NULL;
+	int i, len;
+
+	issuer = name_new("Compact CRL Issuer");
+	other = name_new("Other Issuer");
+	if ((crl = X509_CRL_new()) == NULL ||
+	    !X509_CRL_set_version(crl, 1) ||
+	    !X509_CRL_set_issuer_name(crl, issuer))
+		errx(1, "failed to set up CRL");
+	if ((t = X509_gmtime_adj(NULL, -3600)) == NULL ||
+	    !X509_CRL_set_lastUpdate(crl, t))
+		errx(1, "X509_CRL_set_lastUpdate failed");
+	ASN1_TIME_free(t);
+	if ((t = X509_gmtime_adj(NULL, 7 * 24 * 3600)) == NULL ||
+	    !X509_CRL_set_nextUpdate(crl, t))
+		errx(1, "X509_CRL_set_nextUpdate failed");
+	ASN1_TIME_free(t);
+	if ((number = ASN1_INTEGER_new()) == NULL ||
+	    !ASN1_INTEGER_set(number, 42) ||
+	    !X509_CRL_add1_ext_i2d(crl, NID_crl_number, number, 0, 0))
+		errx(1, "failed to add CRL number");
+	ASN1_INTEGER_free(number);
+
+	if ((c->serials = calloc(count, sizeof(*c->serials))) == NULL)
+		err(1, NULL);
+	c->count = count;
+	memset(long_serial, 0x33, sizeof(long_serial));
+	for (i = 0; i < count; i++) {
+		if ((flags & CRL_LONG_SERIAL) != 0 && i == count - 1)
+			c->serials[i] = serial_new(long_serial,
+			    sizeof(long_serial), 0);
+		else
+			c->serials[i] = entry_serial(i);
+		if (!X509_CRL_add0_revoked(crl, revoked_new(c->serials[i],
+		    60 * i, reasons[i % 4],
+		    (flags & CRL_INDIRECT) != 0 && i == count - 1 ?
+		    other : NULL)))
+			errx(1, "X509_CRL_add0_revoked failed");
+	}
+
+	if (!X509_CRL_sign(crl, key, EVP_sha256()))
+		errx(1, "X509_CRL_sign failed");
+	if ((len = i2d_X509_CRL(crl, &der)) <= 0)
+		errx(1, "i2d_X509_CRL failed");
+	c->der = der;
+	c->len = len;
+
+	X509_CRL_free(crl);
+	X509_NAME_free(issuer);
+	X509_NAME_free(other);
+}
+
+static void
+crl_free(struct crl *c)
+{
+	int i;
+
+	for (i = 0; i < c->count; i++)
+		ASN1_INTEGER_free(c->serials[i]);
+	free(c->serials);
+	free(c->der);
+}
+
+static X509_CRL *
+read_compact(const unsigned char *der, size_t len)
+{
+	X509_CRL *crl;
+	BIO *bio;
+
+	if ((bio = BIO_new_mem_buf((void *)der, len)) == NULL)
+		errx(1, "BIO_new_mem_buf failed");
+	crl = X509_CRL_read_compact_bio(bio);
+	BIO_free(bio);
+
+	return crl;
+}
+
+static X509_CRL *
+read_d2i(const unsigned char *der, size_t len)
+{
+	const unsigned char *p = der;
+
+	return d2i_X509_CRL(NULL, &p, len);
+}
+
+/* Find the marker entry's serial in the encoding. */
+static size_t
+marker_offset(const struct crl *c)
+{
+	size_t i;
+
+	for (i = 2; i + sizeof(marker) <= c->len; i++) {
+		if (c->der[i - 2] == 0x02 && c->der[i - 1] == sizeof(marker) &&
+		    memcmp(c->der + i, marker, sizeof(marker)) == 0)
+			return i - 2;
+	}
+	errx(1, "marker serial not found");
+}
+
+static int
+revoked_cmp(X509_REVOKED *a, X509_REVOKED *b)
+{
+	if (ASN1_INTEGER_cmp(a->serialNumber, b->serialNumber) != 0)
+		return 1;
+	if (ASN1_STRING_cmp(a->revocationDate, b->revocationDate) != 0)
+		return 1;
+	return a->reason != b->reason;
+}
+
+static int
+lookup_cmp(X509_CRL *compact, X509_CRL *full, ASN1_INTEGER *serial,
+    X509 *x, const char *desc, int i)
+{
+	X509_REVOKED *ra = NULL, *rb = NULL;
+	int a, b;
+
+	a = X509_CRL_get0_by_serial(compact, &ra, serial);
+	b = X509_CRL_get0_by_serial(full, &rb, serial);
+	if (a != b || (a != 0 && revoked_cmp(ra, rb) != 0)) {
+		fprintf(stderr, "FAIL: %s %d: got %d from the compact CRL, "
+		    "%d from d2i_X509_CRL\n", desc, i, a, b);
+		return 0;
+	}
+
+	if (!X509_set_serialNumber(x, serial))
+		errx(1, "X509_set_serialNumber failed");
+	ra = rb = NULL;
+	a = X509_CRL_get0_by_cert(compact, &ra, x);
+	b = X509_CRL_get0_by_cert(full, &rb, x);
+	if (a != b || (a != 0 && revoked_cmp(ra, rb) != 0)) {
+		fprintf(stderr, "FAIL: %s %d by certificate: got %d from the "
+		    "compact CRL, %d from d2i_X509_CRL\n", desc, i, a, b);
+		return 0;
+	}
+
+	return 1;
+}
+
+static int
+crl_compact_lookup_test(const struct crl *c)
+{
+	unsigned char data[21];
+	X509_CRL *compact, *full;
+	X509_NAME *issuer, *other;
+	ASN1_INTEGER *serial;
+	X509 *x[2];
+	int i, j, failed = 0;
+
+	if ((compact = read_compact(c->der, c->len)) == NULL)
+		errx(1, "FAIL: X509_CRL_read_compact_bio failed");
+	if ((full = read_d2i(c->der, c->len)) == NULL)
+		errx(1, "d2i_X509_CRL failed");
+
+	if (X509_CRL_compact_count(compact) != (size_t)c->count) {
+		fprintf(stderr, "FAIL: %zu compact entries, want %d\n",
+		    X509_CRL_compact_count(compact), c->count);
+		failed = 1;
+	}
+	if (X509_CRL_compact_count(full) != 0) {
+		fprintf(stderr, "FAIL: decoded CRL has compact entries\n");
+		failed = 1;
+	}
+	if (X509_NAME_cmp(X509_CRL_get_issuer(compact),
+	    X509_CRL_get_issuer(full)) != 0 ||
+	    ASN1_STRING_cmp(X509_CRL_get_nextUpdate(compact),
+	    X509_CRL_get_nextUpdate(full)) != 0) {
+		fprintf(stderr, "FAIL: CRL fields differ\n");
+		failed = 1;
+	}
+
+	/* Certificates from the CRL issuer and from another issuer. */
+	issuer = name_new("Compact CRL Issuer");
+	other = name_new("Other Issuer");
+	if ((x[0] = X509_new()) == NULL || (x[1] = X509_new()) == NULL ||
+	    !X509_set_issuer_name(x[0], issuer) ||
+	    !X509_set_issuer_name(x[1], other))
+		errx(1, "failed to set up certificates");
+
+	for (i = 0; i < c->count; i++) {
+		for (j = 0; j < 2; j++)
+			failed |= !lookup_cmp(compact, full, c->serials[i],
+			    x[j], "entry", i);
+
+		/* The same serial with the other sign. */
+		serial = ASN1_INTEGER_dup(c->serials[i]);
+		serial->type = serial->type == V_ASN1_NEG_INTEGER ?
+		    V_ASN1_INTEGER : V_ASN1_NEG_INTEGER;
+		failed |= !lookup_cmp(compact, full, serial, x[0], "sign", i);
+		ASN1_INTEGER_free(serial);
+
+		/* A serial one octet longer. */
+		memset(data, 0x11, sizeof(data));
+		if (c->serials[i]->length < (int)sizeof(data)) {
+			memcpy(data, c->serials[i]->data,
+			    c->serials[i]->length);
+			serial = serial_new(data, c->serials[i]->length + 1,
+			    0);
+			failed |= !lookup_cmp(compact, full, serial, x[0],
+			    "longer", i);
+			ASN1_INTEGER_free(serial);
+		}
+	}
+
+	/* Serials longer than a compact CRL can hold. */
+	serial = serial_new(data, sizeof(data), 0);
+	failed |= !lookup_cmp(compact, full, serial, x[0], "too long", 0);
+	ASN1_INTEGER_free(serial);
+
+	X509_free(x[0]);
+	X509_free(x[1]);
+	X509_NAME_free(issuer);
+	X509_NAME_free(other);
+	X509_CRL_free(compact);
+	X509_CRL_free(full);
+
+	return !failed;
+}
+
+static int
+crl_compact_verify_test(const struct crl *c, EVP_PKEY *key)
+{
+	X509_CRL *compact, *full;
+	unsigned char *der;
+	EVP_PKEY *other;
+	size_t off;
+	int a, b, failed = 0;
+
+	other = key_new();
+
+	if ((compact = read_compact(c->der, c->len)) == NULL ||
+	    (full = read_d2i(c->der, c->len)) == NULL)
+		errx(1, "failed to read CRL");
+	a = X509_CRL_verify(compact, key);
+	b = X509_CRL_verify(full, key);
+	if (a != 1 || b != 1) {
+		fprintf(stderr, "FAIL: verify returned %d for the compact "
+		    "CRL and %d for d2i_X509_CRL\n", a, b);
+		failed = 1;
+	}
+	a = X509_CRL_verify(compact, other);
+	b = X509_CRL_verify(full, other);
+	if (a == 1 || b == 1) {
+		fprintf(stderr, "FAIL: verified with the wrong key\n");
+		failed = 1;
+	}
+	X509_CRL_free(compact);
+	X509_CRL_free(full);
+
+	/* Change one octet of a serial in the TBSCertList. */
+	if ((der = malloc(c->len)) == NULL)
+		err(1, NULL);
+	memcpy(der, c->der, c->len);
+	off = marker_offset(c);
+	der[off + 2 + sizeof(marker) - 1] ^= 0x01;
+	if ((compact = read_compact(der, c->len)) == NULL ||
+	    (full = read_d2i(der, c->len)) == NULL)
+		errx(1, "failed to read modified CRL");
+	a = X509_CRL_verify(compact, key);
+	b = X509_CRL_verify(full, key);
+	if (a == 1 || b == 1) {
+		fprintf(stderr, "FAIL: modified CRL verified: %d for the "
+		    "compact CRL, %d for d2i_X509_CRL\n", a, b);
+		failed = 1;
+	}
+	X509_CRL_free(compact);
+	X509_CRL_free(full);
+	free(der);
+
+	EVP_PKEY_free(other);
+	ERR_clear_error();
+
+	return !failed;
+}
+
+static int
+expect_reject(const char *desc, const unsigned char *der, size_t len)
+{
+	X509_CRL *crl;
+
+	if ((crl = read_compact(der, len)) != NULL) {
+		fprintf(stderr, "FAIL: %s: CRL accepted\n", desc);
+		X509_CRL_free(crl);
+		return 0;
+	}
+	ERR_clear_error();
+
+	return 1;
+}
+
+/* Return the length of the outer header, which has a long form length. */
+static size_t
+outer_header(const struct crl *c, size_t *len)
+{
+	size_t i, n;
+
+	if (c->der[0] != 0x30 || (c->der[1] & 0x80) == 0)
+		errx(1, "unexpected CRL header");
+	n = c->der[1] & 0x7f;
+	for (*len = 0, i = 0; i < n; i++)
+		*len = *len << 8 | c->der[2 + i];
+
+	return 2 + n;
+}
+
+/* Write a SEQUENCE header for len content octets and return its length. */
+static size_t
+sequence_header(unsigned char *der, size_t len)
+{
+	size_t i, n = 0;
+
+	der[0] = 0x30;
+	if (len < 0x80) {
+		der[1] = len;
+		return 2;
+	}
+	while (n < sizeof(len) && (len >> (8 * n)) != 0)
+		n++;
+	der[1] = 0x80 | n;
+	for (i = 0; i < n; i++)
+		der[2 + i] = len >> (8 * (n - 1 - i));
+
+	return 2 + n;
+}
+
+static int
+crl_compact_malformed_test(const struct crl *c)
+{
+	unsigned char *der;
+	size_t len, hdr_len, content_len, off;
+	int failed = 0;
+
+	/* Truncated anywhere. */
+	for (len = 0; len < c->len; len++) {
+		if (!expect_reject("truncated", c->der, len)) {
+			fprintf(stderr, "     at %zu of %zu octets\n", len,
+			    c->len);
+			failed = 1;
+		}
+	}
+
+	if ((der = malloc(c->len + 16)) == NULL)
+		err(1, NULL);
+	hdr_len = outer_header(c, &content_len);
+	if (content_len != c->len - hdr_len)
+		errx(1, "unexpected CRL length");
+
+	/* Overlong: the outer length covers an extra octet. */
+	len = sequence_header(der, content_len + 1);
+	memcpy(der + len, c->der + hdr_len, content_len);
+	der[len + content_len] = 0;
+	failed |= !expect_reject("trailing octet in outer sequence", der,
+	    len + content_len + 1);
+
+	/* Overlong: a length in five octets. */
+	der[0] = 0x30;
+	der[1] = 0x85;
+	der[2] = 0;
+	der[3] = content_len >> 24;
+	der[4] = content_len >> 16;
+	der[5] = content_len >> 8;
+	der[6] = content_len;
+	memcpy(der + 7, c->der + hdr_len, content_len);
+	failed |= !expect_reject("five octet length", der,
+	    7 + content_len);
+
+	/* Overlong: an entry that claims more than its sequence holds. */
+	memcpy(der, c->der, c->len);
+	off = marker_offset(c);
+	der[off - 1] += 0x10;
+	failed |= !expect_reject("overlong entry", der, c->len);
+
+	/* Indefinite length. */
+	der[0] = 0x30;
+	der[1] = 0x80;
+	memcpy(der + 2, c->der + hdr_len, content_len);
+	der[2 + content_len] = 0;
+	der[3 + content_len] = 0;
+	failed |= !expect_reject("indefinite length", der,
+	    4 + content_len);
+
+	/* Wrong tags. */
+	memcpy(der, c->der, c->len);
+	der[0] = 0x31;
+	failed |= !expect_reject("outer tag", der, c->len);
+	memcpy(der, c->der, c->len);
+	der[hdr_len] = 0x31;
+	failed |= !expect_reject("TBSCertList tag", der, c->len);
+	memcpy(der, c->der, c->len);
+	der[off - 2] = 0x31;
+	failed |= !expect_reject("entry tag", der, c->len);
+	memcpy(der, c->der, c->len);
+	der[off] = 0x04;
+	failed |= !expect_reject("serial tag", der, c->len);
+	memcpy(der, c->der, c->len);
+	der[off + 2 + sizeof(marker)] = 0x04;
+	failed |= !expect_reject("revocation date tag", der, c->len);
+
+	free(der);
+
+	return !failed;
+}
+
+/*
+ * A hit returns the same X509_REVOKED every time, and only the first hit
+ * on an entry may take the CRL write lock. Serials that do not survive
+ * the encoding are not found by d2i_X509_CRL() either and are skipped.
+ */
+static int
+crl_compact_cache_test(const struct crl *c)
+{
+	X509_CRL *compact;
+	X509_REVOKED *first, *rev;
+	int i, hits = 0, failed = 0;
+
+	if ((compact = read_compact(c->der, c->len)) == NULL)
+		errx(1, "FAIL: X509_CRL_read_compact_bio failed");
+
+	CRYPTO_set_locking_callback(crypto_lock_cb);
+	for (i = 0; i < c->count; i++) {
+		first = rev = NULL;
+		if (X509_CRL_get0_by_serial(compact, &first,
+		    c->serials[i]) == 0)
+			continue;
+		hits++;
+		crl_write_locks = 0;
+		if (X509_CRL_get0_by_serial(compact, &rev,
+		    c->serials[i]) == 0 || crl_write_locks != 0) {
+			fprintf(stderr, "FAIL: entry %d: second lookup took "
+			    "%d write locks\n", i, crl_write_locks);
+			failed = 1;
+		}
+		if (rev != first) {
+			fprintf(stderr, "FAIL: entry %d: lookups returned "
+			    "different entries\n", i);
+			failed = 1;
+		}
+	}
+	CRYPTO_set_locking_callback(NULL);
+
+	if (hits < c->count / 2) {
+		fprintf(stderr, "FAIL: only %d of %d entries found\n", hits,
+		    c->count);
+		failed = 1;
+	}
+
+	X509_CRL_free(compact);
+
+	return !failed;
+}
+
+static int
+crl_compact_unsupported_test(EVP_PKEY *key)
+{
+	struct crl c;
+	X509_CRL *crl;
+	int failed = 0;
+
+	/* Indirect CRLs need the certificate issuer of each entry. */
+	crl_new(&c, key, N_SMALL, CRL_INDIRECT);
+	if ((crl = read_d2i(c.der, c.len)) == NULL)
+		errx(1, "d2i_X509_CRL failed on an indirect CRL");
+	X509_CRL_free(crl);
+	failed |= !expect_reject("certificate issuer", c.der, c.len);
+	crl_free(&c);
+
+	/* Serials of more than 20 octets. */
+	crl_new(&c, key, N_SMALL, CRL_LONG_SERIAL);
+	if ((crl = read_d2i(c.der, c.len)) == NULL)
+		errx(1, "d2i_X509_CRL failed on a long serial");
+	X509_CRL_free(crl);
+	failed |= !expect_reject("21 octet serial", c.der, c.len);
+	crl_free(&c);
+
+	return !failed;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct crl big, small;
+	EVP_PKEY *key;
+	int failed = 0;
+
+	OpenSSL_add_all_digests();
+	ERR_load_crypto_strings();
+
+	key = key_new();
+	crl_new(&big, key, N_ENTRIES, 0);
+	crl_new(&small, key, N_SMALL, 0);
+
+	failed |= !crl_compact_lookup_test(&big);
+	failed |= !crl_compact_lookup_test(&small);
+	failed |= !crl_compact_cache_test(&big);
+	failed |= !crl_compact_verify_test(&big, key);
+	failed |= !crl_compact_malformed_test(&small);
+	failed |= !crl_compact_unsupported_test(key);
+
+	crl_free(&big);
+	crl_free(&small);
+	EVP_PKEY_free(key);
+
+	if (!failed)
+		printf("PASS\n");
+
+	return failed;
+}
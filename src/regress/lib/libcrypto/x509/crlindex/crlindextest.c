@@ -0,0 +1,523 @@
+/* $OpenBSD$ */
+/*
+ * Copyright (c) 2026 The LibreSSL project.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Tests for the serial number index of decoded CRLs: lookups must give
+ * the same results with and without the index, also for duplicate serials
+ * and entries with a certificate issuer, and must not follow entries that
+ * were replaced on the revoked stack.
+ */
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/asn1.h>
+#include <openssl/objects.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#define N_ENTRIES	1500
+#define N_QUERIES	500
+
+static X509_NAME *
+name_new(const char *cn)
+{
+	X509_NAME *name;
+
+	if ((name = X509_NAME_new()) == NULL ||
+	    !X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+	    (const unsigned char *)cn, -1, -1, 0))
+		errx(1, "X509_NAME_add_entry_by_txt failed");
+
+	return name;
+}
+
+/*
+ * Make a random serial. Most share one of a few prefixes longer than the
+ * index keys, so that keys tie and the serials themselves are compared.
+ */
+static ASN1_INTEGER *
+serial_new(void)
+{
+	static const unsigned char prefix[3][8] = {
+		{ 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 },
+		{ 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x09 },
+		{ 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },
+	};
+	unsigned char data[20];
+	ASN1_INTEGER *serial;
+	uint32_t r;
+	int len;
+
+	r = arc4random();
+	len = 1 + r % sizeof(data);
+	arc4random_buf(data, sizeof(data));
+	if (len > 8 && (r >> 8) % 4 != 3)
+		memcpy(data, prefix[(r >> 8) % 4], 8);
+	if (data[0] == 0)
+		data[0] = 1;
+
+	if ((serial = ASN1_INTEGER_new()) == NULL ||
+	    !ASN1_STRING_set(serial, data, len))
+		errx(1, "ASN1_STRING_set failed");
+	if ((r >> 16) % 8 == 0)
+		serial->type = V_ASN1_NEG_INTEGER;
+
+	return serial;
+}
+
+/* Make a revoked entry, with a certificate issuer extension if issuer. */
+static X509_REVOKED *
+revoked_new(ASN1_INTEGER *serial, X509_NAME *issuer, ASN1_TIME *date)
+{
+	GENERAL_NAMES *gens;
+	GENERAL_NAME *gen;
+	X509_REVOKED *rev;
+
+	if ((rev = X509_REVOKED_new()) == NULL ||
+	    !X509_REVOKED_set_serialNumber(rev, serial) ||
+	    !X509_REVOKED_set_revocationDate(rev, date))
+		errx(1, "failed to set up revoked entry");
+	if (issuer != NULL) {
+		if ((gens = GENERAL_NAMES_new()) == NULL ||
+		    (gen = GENERAL_NAME_new()) == NULL)
+			errx(1, "GENERAL_NAME_new failed");
+		gen->type = GEN_DIRNAME;
+		if ((gen->d.directoryName = X509_NAME_dup(issuer)) == NULL ||
+		    !sk_GENERAL_NAME_push(gens, gen))
+			errx(1, "sk_GENERAL_NAME_push failed");
+		if (!X509_REVOKED_add1_ext_i2d(rev, NID_certificate_issuer,
+		    gens, 1, 0))
+			errx(1, "X509_REVOKED_add1_ext_i2d failed");
+		GENERAL_NAMES_free(gens);
+	}
+
+	return rev;
+}
+
+/* Return a decoded copy of crl. */
+static X509_CRL *
+crl_decode(X509_CRL *crl)
+{
+	unsigned char *der = NULL;
+	const unsigned char *p;
+	X509_CRL *ret;
+	int len;
+
+	/* Lookups do not need a signature, only a well formed CRL. */
+	if (!X509_ALGOR_set0(crl->crl->sig_alg,
+	    OBJ_nid2obj(NID_ecdsa_with_SHA256), V_ASN1_UNDEF, NULL) ||
+	    !X509_ALGOR_set0(crl->sig_alg, OBJ_nid2obj(NID_ecdsa_with_SHA256),
+	    V_ASN1_UNDEF, NULL))
+		errx(1, "X509_ALGOR_set0 failed");
+	crl->crl->enc.modified = 1;
+
+	if ((len = i2d_X509_CRL(crl, &der)) <= 0)
+		errx(1, "i2d_X509_CRL failed");
+	p = der;
+	if ((ret = d2i_X509_CRL(NULL, &p, len)) == NULL)
+		errx(1, "d2i_X509_CRL failed");
+	free(der);
+
+	return ret;
+}
+
+/*
+ * Build a CRL by issuer with random entries. Some serials appear twice,
+ * either as identical entries or for different certificate issuers, and
+ * the entries after one with a certificate issuer inherit it.
+ */
+static X509_CRL *
+crl_new(X509_NAME *issuer, X509_NAME *other, ASN1_INTEGER **serials)
+{
+	X509_REVOKED *rev;
+	ASN1_TIME *date;
+	X509_CRL *crl;
+	uint32_t r;
+	int i, dup;
+
+	if ((crl = X509_CRL_new()) == NULL ||
+	    !X509_CRL_set_version(crl, 1) ||
+	    !X509_CRL_set_issuer_name(crl, issuer))
+		errx(1, "failed to set up CRL");
+	if ((date = X509_gmtime_adj(NULL, 0)) == NULL ||
+	    !X509_CRL_set_lastUpdate(crl, date))
+		errx(1, "X509_CRL_set_lastUpdate failed");
+
+	for (i = 0; i < N_ENTRIES; i++) {
+		r = arc4random();
+		dup = i > 0 && r % 16 == 0;
+		serials[i] = dup ? ASN1_INTEGER_dup(serials[r % i]) :
+		    serial_new();
+		if (serials[i] == NULL)
+			errx(1, "ASN1_INTEGER_dup failed");
+
+		/* Switch between the CRL issuer and the other issuer. */
+		if ((r >> 8) % 32 == 0)
+			rev = revoked_new(serials[i], other, date);
+		else if ((r >> 8) % 32 == 1)
+			rev = revoked_new(serials[i], issuer, date);
+		else
+			rev = revoked_new(serials[i], NULL, date);
+		if (!X509_CRL_add0_revoked(crl, rev))
+			errx(1, "X509_CRL_add0_revoked failed");
+	}
+	ASN1_TIME_free(date);
+
+	return crl;
+}
+
+static int
+revoked_cmp(X509_REVOKED *a, X509_REVOKED *b)
+{
+	unsigned char *da = NULL, *db = NULL;
+	int la, lb, ret;
+
+	if (a == NULL || b == NULL)
+		return a != b;
+	la = i2d_X509_REVOKED(a, &da);
+	lb = i2d_X509_REVOKED(b, &db);
+	ret = la != lb || la <= 0 || memcmp(da, db, la) != 0;
+	free(da);
+	free(db);
+
+	return ret;
+}
+
+/*
+ * Look up serial for each issuer in both CRLs. The entries found must be
+ * encoded the same, since the CRLs may order identical entries differently.
+ * Increment found if any lookup succeeded.
+ */
+static int
+lookup_cmp(X509_CRL *indexed, X509_CRL *plain, ASN1_INTEGER *serial,
+    X509_NAME **issuers, int n_issuers, int *found)
+{
+	X509_REVOKED *ra, *rb;
+	X509 *x;
+	int i, a, b, n, failed = 0;
+
+	ra = rb = NULL;
+	a = X509_CRL_get0_by_serial(indexed, &ra, serial);
+	b = X509_CRL_get0_by_serial(plain, &rb, serial);
+	if (a != b || (a != 0 && revoked_cmp(ra, rb) != 0)) {
+		fprintf(stderr, "FAIL: by serial: got %d with the index, "
+		    "%d without\n", a, b);
+		failed = 1;
+	}
+	n = a != 0;
+
+	if ((x = X509_new()) == NULL || !X509_set_serialNumber(x, serial))
+		errx(1, "X509_set_serialNumber failed");
+	for (i = 0; i < n_issuers; i++) {
+		if (!X509_set_issuer_name(x, issuers[i]))
+			errx(1, "X509_set_issuer_name failed");
+		ra = rb = NULL;
+		a = X509_CRL_get0_by_cert(indexed, &ra, x);
+		b = X509_CRL_get0_by_cert(plain, &rb, x);
+		if (a != b || (a != 0 && revoked_cmp(ra, rb) != 0)) {
+			fprintf(stderr, "FAIL: by certificate from issuer %d: "
+			    "got %d with the index, %d without\n", i, a, b);
+			failed = 1;
+		}
+		n |= a != 0;
+	}
+	X509_free(x);
+	*found += n;
+
+	return !failed;
+}
+
+static int
+crl_index_lookup_test(void)
+{
+	ASN1_INTEGER *serials[N_ENTRIES], *serial;
+	X509_NAME *issuers[3];
+	X509_CRL *crl, *indexed, *plain;
+	void *index;
+	int i, found = 0, failed = 0;
+
+	issuers[0] = name_new("CRL Issuer");
+	issuers[1] = name_new("Other Issuer");
+	issuers[2] = name_new("Unknown Issuer");
+
+	crl = crl_new(issuers[0], issuers[1], serials);
+
+	/* A CRL that was built rather than decoded has no index. */
+	if (X509_CRL_revoked_index_size(crl) != 0) {
+		fprintf(stderr, "FAIL: built CRL has an index\n");
+		failed = 1;
+	}
+
+	indexed = crl_decode(crl);
+	plain = crl_decode(crl);
+	if (X509_CRL_revoked_index_size(indexed) <
+	    N_ENTRIES * (sizeof(uint64_t) + sizeof(void *))) {
+		fprintf(stderr, "FAIL: index of %zu bytes for %d entries\n",
+		    X509_CRL_revoked_index_size(indexed), N_ENTRIES);
+		failed = 1;
+	}
+
+	/* Take the index away from one copy, to compare against. */
+	index = plain->revoked_index;
+	plain->revoked_index = NULL;
+	if (X509_CRL_revoked_index_size(plain) != 0)
+		errx(1, "failed to remove the index");
+
+	for (i = 0; i < N_ENTRIES; i++)
+		failed |= !lookup_cmp(indexed, plain, serials[i], issuers, 3,
+		    &found);
+	if (found != N_ENTRIES) {
+		fprintf(stderr, "FAIL: found %d of %d entries\n", found,
+		    N_ENTRIES);
+		failed = 1;
+	}
+	for (i = 0; i < N_QUERIES; i++) {
+		serial = serial_new();
+		failed |= !lookup_cmp(indexed, plain, serial, issuers, 3,
+		    &found);
+		ASN1_INTEGER_free(serial);
+	}
+
+	/* The index is still in use after all of this. */
+	if (X509_CRL_revoked_index_size(indexed) == 0) {
+		fprintf(stderr, "FAIL: index dropped by lookups\n");
+		failed = 1;
+	}
+
+	plain->revoked_index = index;
+	X509_CRL_free(plain);
+	X509_CRL_free(indexed);
+	X509_CRL_free(crl);
+	for (i = 0; i < N_ENTRIES; i++)
+		ASN1_INTEGER_free(serials[i]);
+	for (i = 0; i < 3; i++)
+		X509_NAME_free(issuers[i]);
+
+	return !failed;
+}
+
+static int
+found(X509_CRL *crl, ASN1_INTEGER *serial)
+{
+	X509_REVOKED *rev;
+
+	return X509_CRL_get0_by_serial(crl, &rev, serial) != 0;
+}
+
+/* Whether the revoked stack of crl holds serial, by linear search. */
+static int
+listed(X509_CRL *crl, ASN1_INTEGER *serial)
+{
+	STACK_OF(X509_REVOKED) *revoked = X509_CRL_get_REVOKED(crl);
+	X509_REVOKED *rev;
+	int i;
+
+	for (i = 0; i < sk_X509_REVOKED_num(revoked); i++) {
+		rev = sk_X509_REVOKED_value(revoked, i);
+		if (ASN1_STRING_cmp(rev->serialNumber, serial) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * After the revoked stack of crl was changed directly, the original
+ * entries that are left must still be found, and the ones that were freed
+ * must not be, unless another entry has the same serial. Entries put on
+ * the stack directly may or may not be found.
+ */
+static int
+check_originals(const char *desc, X509_CRL *crl, ASN1_INTEGER **serials,
+    const int *gone)
+{
+	int i, failed = 0;
+
+	for (i = 0; i < N_ENTRIES; i++) {
+		if (!gone[i] && !found(crl, serials[i])) {
+			fprintf(stderr, "FAIL: %s: entry %d not found\n", desc,
+			    i);
+			failed = 1;
+		}
+		if (gone[i] && found(crl, serials[i]) &&
+		    !listed(crl, serials[i])) {
+			fprintf(stderr, "FAIL: %s: freed entry %d found\n",
+			    desc, i);
+			failed = 1;
+		}
+	}
+
+	return !failed;
+}
+
+/*
+ * Change the revoked stack of a decoded CRL in ways the index is not told
+ * about. Lookups must never follow the entries that were freed.
+ */
+static int
+crl_index_mutate_test(void)
+{
+	ASN1_INTEGER *serials[N_ENTRIES], *serial;
+	X509_REVOKED *orig[N_ENTRIES], *rev;
+	STACK_OF(X509_REVOKED) *revoked;
+	X509_NAME *issuer;
+	X509_CRL *built, *crl;
+	ASN1_TIME *date;
+	int gone[N_ENTRIES];
+	int i, j, failed = 0;
+
+	issuer = name_new("CRL Issuer");
+	if ((date = X509_gmtime_adj(NULL, 0)) == NULL)
+		errx(1, "X509_gmtime_adj failed");
+	built = crl_new(issuer, issuer, serials);
+
+	/* Replace every other entry in place. */
+	crl = crl_decode(built);
+	revoked = X509_CRL_get_REVOKED(crl);
+	for (i = 0; i < N_ENTRIES; i++) {
+		gone[i] = i % 2 == 0;
+		if (!gone[i])
+			continue;
+		X509_REVOKED_free(sk_X509_REVOKED_value(revoked, i));
+		rev = revoked_new(serial = serial_new(), NULL, date);
+		ASN1_INTEGER_free(serial);
+		sk_X509_REVOKED_set(revoked, i, rev);
+	}
+	if (X509_CRL_revoked_index_size(crl) == 0) {
+		fprintf(stderr, "FAIL: index dropped\n");
+		failed = 1;
+	}
+	failed |= !check_originals("replaced", crl, serials, gone);
+	X509_CRL_free(crl);
+
+	/* Delete entries and push new ones, keeping the count. */
+	crl = crl_decode(built);
+	revoked = X509_CRL_get_REVOKED(crl);
+	for (i = 0; i < N_ENTRIES; i++) {
+		orig[i] = sk_X509_REVOKED_value(revoked, i);
+		gone[i] = 0;
+	}
+	for (i = 0; i < 100; i++) {
+		rev = sk_X509_REVOKED_delete(revoked,
+		    arc4random_uniform(sk_X509_REVOKED_num(revoked)));
+		for (j = 0; j < N_ENTRIES; j++) {
+			if (orig[j] == rev)
+				gone[j] = 1;
+		}
+		X509_REVOKED_free(rev);
+
+		rev = revoked_new(serial = serial_new(), NULL, date);
+		ASN1_INTEGER_free(serial);
+		if (!sk_X509_REVOKED_push(revoked, rev))
+			errx(1, "sk_X509_REVOKED_push failed");
+	}
+	failed |= !check_originals("deleted", crl, serials, gone);
+	X509_CRL_free(crl);
+
+	/* Sorting moves the entries, but the index must still agree. */
+	crl = crl_decode(built);
+	if (!X509_CRL_sort(crl))
+		errx(1, "X509_CRL_sort failed");
+	for (i = 0; i < N_ENTRIES; i++) {
+		if (!found(crl, serials[i])) {
+			fprintf(stderr, "FAIL: entry %d not found after "
+			    "sorting\n", i);
+			failed = 1;
+		}
+	}
+	X509_CRL_free(crl);
+
+	/* Adding an entry drops the index. */
+	crl = crl_decode(built);
+	serial = serial_new();
+	if (!X509_CRL_add0_revoked(crl, revoked_new(serial, NULL, date)))
+		errx(1, "X509_CRL_add0_revoked failed");
+	if (X509_CRL_revoked_index_size(crl) != 0) {
+		fprintf(stderr, "FAIL: index kept by X509_CRL_add0_revoked\n");
+		failed = 1;
+	}
+	if (!found(crl, serial)) {
+		fprintf(stderr, "FAIL: added entry not found\n");
+		failed = 1;
+	}
+	ASN1_INTEGER_free(serial);
+	X509_CRL_free(crl);
+
+	X509_CRL_free(built);
+	for (i = 0; i < N_ENTRIES; i++)
+		ASN1_INTEGER_free(serials[i]);
+	ASN1_TIME_free(date);
+	X509_NAME_free(issuer);
+
+	return !failed;
+}
+
+static int
+crl_index_empty_test(void)
+{
+	X509_NAME *issuer;
+	X509_CRL *crl, *decoded;
+	ASN1_INTEGER *serial;
+	ASN1_TIME *date;
+	int failed = 0;
+
+	issuer = name_new("CRL Issuer");
+	if ((crl = X509_CRL_new()) == NULL ||
+	    !X509_CRL_set_version(crl, 1) ||
+	    !X509_CRL_set_issuer_name(crl, issuer))
+		errx(1, "failed to set up CRL");
+	if ((date = X509_gmtime_adj(NULL, 0)) == NULL ||
+	    !X509_CRL_set_lastUpdate(crl, date))
+		errx(1, "X509_CRL_set_lastUpdate failed");
+	ASN1_TIME_free(date);
+	decoded = crl_decode(crl);
+
+	if (X509_CRL_revoked_index_size(decoded) != 0) {
+		fprintf(stderr, "FAIL: empty CRL has an index\n");
+		failed = 1;
+	}
+	serial = serial_new();
+	if (found(decoded, serial)) {
+		fprintf(stderr, "FAIL: found a serial in an empty CRL\n");
+		failed = 1;
+	}
+
+	ASN1_INTEGER_free(serial);
+	X509_CRL_free(decoded);
+	X509_CRL_free(crl);
+	X509_NAME_free(issuer);
+
+	return !failed;
+}
+
+int
+main(int argc, char **argv)
+{
+	int failed = 0;
+
+	failed |= !crl_index_lookup_test();
+	failed |= !crl_index_mutate_test();
+	failed |= !crl_index_empty_test();
+
+	if (!failed)
+		printf("PASS\n");
+
+	return failed;
+}
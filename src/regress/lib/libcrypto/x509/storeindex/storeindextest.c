@@ -0,0 +1,514 @@
+/* $OpenBSD$ */
+/*
+ * Copyright (c) 2026 The LibreSSL project.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Tests for the X509_STORE name hash and key identifier index: adding
+ * objects, rejecting duplicates, releasing objects, lookups by name while
+ * the index grows, and issuer lookups by subject key identifier.
+ */
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/ec.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/objects.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#define DAY	(24 * 60 * 60)
+
+/* Number of distinct names, and of certificates with each name. */
+#define N_NAMES		100
+#define N_PER_NAME	3
+
+static EVP_PKEY *
+key_new(void)
+{
+	EVP_PKEY *pkey;
+	EC_KEY *ec;
+
+	if ((ec = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1)) == NULL ||
+	    !EC_KEY_generate_key(ec))
+		errx(1, "EC_KEY_generate_key failed");
+	if ((pkey = EVP_PKEY_new()) == NULL || !EVP_PKEY_assign_EC_KEY(pkey, ec))
+		errx(1, "EVP_PKEY_assign_EC_KEY failed");
+
+	return pkey;
+}
+
+static X509_NAME *
+name_new(const char *cn)
+{
+	X509_NAME *name;
+
+	if ((name = X509_NAME_new()) == NULL ||
+	    !X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+	    (const unsigned char *)cn, -1, -1, 0))
+		errx(1, "X509_NAME_add_entry_by_txt failed");
+
+	return name;
+}
+
+static ASN1_OCTET_STRING *
+keyid_new(unsigned char id)
+{
+	ASN1_OCTET_STRING *keyid;
+	unsigned char data[20];
+
+	memset(data, id, sizeof(data));
+	if ((keyid = ASN1_OCTET_STRING_new()) == NULL ||
+	    !ASN1_OCTET_STRING_set(keyid, data, sizeof(data)))
+		errx(1, "ASN1_OCTET_STRING_set failed");
+
+	return keyid;
+}
+
+/*
+ * Make a CA certificate for cn and key, issued by the CA certificate for
+ * issuer_cn and issuer_key. A non-zero skid or akid adds a subject or
+ * authority key identifier made of that byte. The certificate is valid
+ * from the given day until the given day, relative to now.
+ */
+static X509 *
+cert_new(const char *cn, EVP_PKEY *key, const char *issuer_cn,
+    EVP_PKEY *issuer_key, long serial, unsigned char skid,
+    unsigned char akid, long from, long until)
+{
+	AUTHORITY_KEYID *ak;
+	BASIC_CONSTRAINTS *bc;
+	ASN1_OCTET_STRING *keyid;
+	X509_NAME *name, *issuer;
+	unsigned char *der = NULL;
+	const unsigned char *p;
+	X509 *x, *ret;
+	int len;
+
+	if ((x = X509_new()) == NULL)
+		errx(1, "X509_new failed");
+	name = name_new(cn);
+	issuer = name_new(issuer_cn);
+	if (!X509_set_version(x, 2) ||
+	    !ASN1_INTEGER_set(X509_get_serialNumber(x), serial) ||
+	    !X509_set_subject_name(x, name) ||
+	    !X509_set_issuer_name(x, issuer) ||
+	    X509_gmtime_adj(X509_get_notBefore(x), from * DAY) == NULL ||
+	    X509_gmtime_adj(X509_get_notAfter(x), until * DAY) == NULL ||
+	    !X509_set_pubkey(x, key))
+		errx(1, "failed to set up certificate");
+	X509_NAME_free(name);
+	X509_NAME_free(issuer);
+
+	if ((bc = BASIC_CONSTRAINTS_new()) == NULL)
+		errx(1, "BASIC_CONSTRAINTS_new failed");
+	bc->ca = 0xff;
+	if (!X509_add1_ext_i2d(x, NID_basic_constraints, bc, 1, 0))
+		errx(1, "X509_add1_ext_i2d failed");
+	BASIC_CONSTRAINTS_free(bc);
+
+	if (skid != 0) {
+		keyid = keyid_new(skid);
+		if (!X509_add1_ext_i2d(x, NID_subject_key_identifier, keyid,
+		    0, 0))
+			errx(1, "X509_add1_ext_i2d failed");
+		ASN1_OCTET_STRING_free(keyid);
+	}
+	if (akid != 0) {
+		if ((ak = AUTHORITY_KEYID_new()) == NULL)
+			errx(1, "AUTHORITY_KEYID_new failed");
+		ak->keyid = keyid_new(akid);
+		if (!X509_add1_ext_i2d(x, NID_authority_key_identifier, ak,
+		    0, 0))
+			errx(1, "X509_add1_ext_i2d failed");
+		AUTHORITY_KEYID_free(ak);
+	}
+
+	if (!X509_sign(x, issuer_key, EVP_sha256()))
+		errx(1, "X509_sign failed");
+
+	/* Round trip through DER, so that the encoding and hash are cached. */
+	if ((len = i2d_X509(x, &der)) <= 0)
+		errx(1, "i2d_X509 failed");
+	p = der;
+	if ((ret = d2i_X509(NULL, &p, len)) == NULL)
+		errx(1, "d2i_X509 failed");
+	free(der);
+	X509_free(x);
+
+	return ret;
+}
+
+static X509_CRL *
+crl_new(const char *issuer_cn, EVP_PKEY *issuer_key)
+{
+	X509_NAME *issuer;
+	unsigned char *der = NULL;
+	const unsigned char *p;
+	X509_CRL *crl, *ret;
+	ASN1_TIME *t;
+	int len;
+
+	issuer = name_new(issuer_cn);
+	if ((crl = X509_CRL_new()) == NULL ||
+	    !X509_CRL_set_version(crl, 1) ||
+	    !X509_CRL_set_issuer_name(crl, issuer))
+		errx(1, "failed to set up CRL");
+	X509_NAME_free(issuer);
+	if ((t = X509_gmtime_adj(NULL, -DAY)) == NULL ||
+	    !X509_CRL_set_lastUpdate(crl, t))
+		errx(1, "X509_CRL_set_lastUpdate failed");
+	ASN1_TIME_free(t);
+	if (!X509_CRL_sign(crl, issuer_key, EVP_sha256()))
+		errx(1, "X509_CRL_sign failed");
+
+	if ((len = i2d_X509_CRL(crl, &der)) <= 0)
+		errx(1, "i2d_X509_CRL failed");
+	p = der;
+	if ((ret = d2i_X509_CRL(NULL, &p, len)) == NULL)
+		errx(1, "d2i_X509_CRL failed");
+	free(der);
+	X509_CRL_free(crl);
+
+	return ret;
+}
+
+static int
+add_duplicate(X509_STORE *store, X509 *x)
+{
+	unsigned long error;
+
+	ERR_clear_error();
+	if (X509_STORE_add_cert(store, x))
+		return 0;
+	error = ERR_peek_last_error();
+	ERR_clear_error();
+
+	return ERR_GET_REASON(error) == X509_R_CERT_ALREADY_IN_HASH_TABLE;
+}
+
+/*
+ * Add N_PER_NAME certificates for each of N_NAMES names, enough for the
+ * index to grow several times, and check that every lookup by name finds
+ * exactly the certificates with that name, in the order they were added.
+ */
+static int
+store_index_name_test(void)
+{
+	X509 *certs[N_NAMES][N_PER_NAME];
+	STACK_OF(X509) *sk;
+	STACK_OF(X509_CRL) *crls;
+	X509_STORE_CTX *ctx;
+	X509_STORE *store;
+	X509_OBJECT obj;
+	X509_NAME *name;
+	X509_CRL *crl;
+	EVP_PKEY *key;
+	char cn[32];
+	int i, j, failed = 0;
+
+	key = key_new();
+	if ((store = X509_STORE_new()) == NULL)
+		errx(1, "X509_STORE_new failed");
+
+	for (j = 0; j < N_PER_NAME; j++) {
+		for (i = 0; i < N_NAMES; i++) {
+			snprintf(cn, sizeof(cn), "Cert %d", i);
+			certs[i][j] = cert_new(cn, key, cn, key,
+			    j * N_NAMES + i + 1, 0, 0, -1, 30);
+			if (!X509_STORE_add_cert(store, certs[i][j]))
+				errx(1, "X509_STORE_add_cert failed");
+		}
+	}
+	/* Every other name also has a CRL. */
+	for (i = 0; i < N_NAMES; i += 2) {
+		snprintf(cn, sizeof(cn), "Cert %d", i);
+		crl = crl_new(cn, key);
+		if (!X509_STORE_add_crl(store, crl))
+			errx(1, "X509_STORE_add_crl failed");
+		X509_CRL_free(crl);
+	}
+
+	for (i = 0; i < N_NAMES; i++) {
+		for (j = 0; j < N_PER_NAME; j++) {
+			if (!add_duplicate(store, certs[i][j])) {
+				fprintf(stderr, "FAIL: duplicate of Cert %d "
+				    "(%d) not rejected\n", i, j);
+				failed = 1;
+			}
+		}
+	}
+
+	if ((ctx = X509_STORE_CTX_new()) == NULL ||
+	    !X509_STORE_CTX_init(ctx, store, NULL, NULL))
+		errx(1, "X509_STORE_CTX_init failed");
+
+	for (i = 0; i < N_NAMES; i++) {
+		/* Look up by an upper case copy, which has the same hash. */
+		snprintf(cn, sizeof(cn), "CERT %d", i);
+		name = name_new(cn);
+
+		if ((sk = X509_STORE_get1_certs(ctx, name)) == NULL ||
+		    sk_X509_num(sk) != N_PER_NAME) {
+			fprintf(stderr, "FAIL: Cert %d: got %d certificates, "
+			    "want %d\n", i, sk == NULL ? -1 : sk_X509_num(sk),
+			    N_PER_NAME);
+			failed = 1;
+		} else {
+			for (j = 0; j < N_PER_NAME; j++) {
+				if (sk_X509_value(sk, j) != certs[i][j]) {
+					fprintf(stderr, "FAIL: Cert %d: "
+					    "certificate %d out of order\n",
+					    i, j);
+					failed = 1;
+				}
+			}
+		}
+		sk_X509_pop_free(sk, X509_free);
+
+		if (X509_STORE_get_by_subject(ctx, X509_LU_X509, name,
+		    &obj) != X509_LU_X509 || obj.data.x509 != certs[i][0]) {
+			fprintf(stderr, "FAIL: Cert %d: X509_STORE_get_by_subject "
+			    "did not return the first certificate\n", i);
+			failed = 1;
+		} else
+			X509_OBJECT_free_contents(&obj);
+
+		crls = X509_STORE_get1_crls(ctx, name);
+		if ((crls == NULL ? 0 : sk_X509_CRL_num(crls)) !=
+		    (i % 2 == 0 ? 1 : 0)) {
+			fprintf(stderr, "FAIL: Cert %d: got %d CRLs\n", i,
+			    crls == NULL ? 0 : sk_X509_CRL_num(crls));
+			failed = 1;
+		}
+		sk_X509_CRL_pop_free(crls, X509_CRL_free);
+
+		X509_NAME_free(name);
+	}
+
+	name = name_new("Cert 100");
+	if ((sk = X509_STORE_get1_certs(ctx, name)) != NULL) {
+		fprintf(stderr, "FAIL: found certificates for a name that "
+		    "is not in the store\n");
+		failed = 1;
+	}
+	sk_X509_pop_free(sk, X509_free);
+	X509_NAME_free(name);
+
+	X509_STORE_CTX_free(ctx);
+	X509_STORE_free(store);
+	for (i = 0; i < N_NAMES; i++) {
+		for (j = 0; j < N_PER_NAME; j++)
+			X509_free(certs[i][j]);
+	}
+	EVP_PKEY_free(key);
+
+	return !failed;
+}
+
+/*
+ * Objects are only removed from a store when it is freed. Check that the
+ * store holds one reference per object, that a rejected duplicate does not
+ * keep one, and that all are released with the store.
+ */
+static int
+store_index_release_test(void)
+{
+	X509_STORE_CTX *ctx;
+	X509_STORE *store;
+	X509_NAME *name;
+	STACK_OF(X509) *sk;
+	EVP_PKEY *key;
+	X509 *x, *dup;
+	int failed = 0;
+
+	key = key_new();
+	x = cert_new("Release", key, "Release", key, 1, 1, 0, -1, 30);
+	dup = X509_dup(x);
+
+	if ((store = X509_STORE_new()) == NULL ||
+	    !X509_STORE_add_cert(store, x))
+		errx(1, "X509_STORE_add_cert failed");
+	if (x->references != 2) {
+		fprintf(stderr, "FAIL: store holds %d references, want 1\n",
+		    x->references - 1);
+		failed = 1;
+	}
+	if (!add_duplicate(store, dup) || dup->references != 1) {
+		fprintf(stderr, "FAIL: rejected duplicate is referenced\n");
+		failed = 1;
+	}
+
+	/* The store keeps the certificate when the caller drops it. */
+	X509_free(x);
+	if ((ctx = X509_STORE_CTX_new()) == NULL ||
+	    !X509_STORE_CTX_init(ctx, store, NULL, NULL))
+		errx(1, "X509_STORE_CTX_init failed");
+	name = name_new("Release");
+	if ((sk = X509_STORE_get1_certs(ctx, name)) == NULL ||
+	    sk_X509_num(sk) != 1 || X509_cmp(sk_X509_value(sk, 0), dup) != 0) {
+		fprintf(stderr, "FAIL: certificate lost after X509_free\n");
+		failed = 1;
+	}
+	X509_NAME_free(name);
+	X509_STORE_CTX_free(ctx);
+
+	if (sk != NULL && sk_X509_num(sk) == 1) {
+		x = sk_X509_value(sk, 0);
+		X509_STORE_free(store);
+		if (x->references != 1) {
+			fprintf(stderr, "FAIL: %d references left after "
+			    "X509_STORE_free, want 1\n", x->references);
+			failed = 1;
+		}
+	} else
+		X509_STORE_free(store);
+	sk_X509_pop_free(sk, X509_free);
+
+	X509_free(dup);
+	EVP_PKEY_free(key);
+
+	return !failed;
+}
+
+struct issuer_test {
+	const char *desc;
+	unsigned char akid;
+	int want;
+};
+
+/*
+ * Three CA certificates share a name, as after a key rollover: one for
+ * the old key, and an expired and a current one for the new key. Issuer
+ * lookups go by the authority key identifier of the certificate, and
+ * must return the valid certificate for the right key.
+ */
+static int
+store_index_skid_test(void)
+{
+	const struct issuer_test tests[] = {
+		{ "old key", 0x01, 0 },
+		{ "new key", 0x02, 2 },
+		{ "unknown key", 0x03, -1 },
+	};
+	EVP_PKEY *key[2], *filler_key;
+	X509 *ca[3], *filler, *leaf, *issuer;
+	X509_STORE_CTX *ctx;
+	X509_STORE *store;
+	char cn[32];
+	size_t i;
+	int n, ret, failed = 0;
+
+	key[0] = key_new();
+	key[1] = key_new();
+	filler_key = key_new();
+
+	ca[0] = cert_new("Shared CA", key[0], "Shared CA", key[0], 1, 0x01, 0,
+	    -1, 3650);
+	ca[1] = cert_new("Shared CA", key[1], "Shared CA", key[1], 2, 0x02, 0,
+	    -10, -1);
+	ca[2] = cert_new("Shared CA", key[1], "Shared CA", key[1], 3, 0x02, 0,
+	    -1, 3650);
+
+	if ((store = X509_STORE_new()) == NULL)
+		errx(1, "X509_STORE_new failed");
+
+	/* Surround the CAs with enough certificates to grow the index. */
+	for (n = 0; n < 200; n++) {
+		if (n == 100) {
+			for (i = 0; i < 3; i++) {
+				if (!X509_STORE_add_cert(store, ca[i]))
+					errx(1, "X509_STORE_add_cert failed");
+			}
+		}
+		snprintf(cn, sizeof(cn), "Filler %d", n);
+		filler = cert_new(cn, filler_key, cn, filler_key, n + 10,
+		    0x10 + n, 0, -1, 30);
+		if (!X509_STORE_add_cert(store, filler))
+			errx(1, "X509_STORE_add_cert failed");
+		X509_free(filler);
+	}
+
+	for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		leaf = cert_new("Leaf", filler_key, "Shared CA",
+		    tests[i].want == 0 ? key[0] : key[1], 100 + i, 0,
+		    tests[i].akid, -1, 30);
+
+		if ((ctx = X509_STORE_CTX_new()) == NULL ||
+		    !X509_STORE_CTX_init(ctx, store, leaf, NULL))
+			errx(1, "X509_STORE_CTX_init failed");
+		ret = X509_STORE_CTX_get1_issuer(&issuer, ctx, leaf);
+		if (tests[i].want < 0) {
+			if (ret != 0) {
+				fprintf(stderr, "FAIL: %s: found an issuer\n",
+				    tests[i].desc);
+				failed = 1;
+			}
+		} else if (ret != 1 || issuer != ca[tests[i].want]) {
+			fprintf(stderr, "FAIL: %s: got the wrong issuer\n",
+			    tests[i].desc);
+			failed = 1;
+		}
+		if (ret == 1)
+			X509_free(issuer);
+		X509_STORE_CTX_free(ctx);
+
+		/* The whole chain verifies through the same lookup. */
+		if ((ctx = X509_STORE_CTX_new()) == NULL ||
+		    !X509_STORE_CTX_init(ctx, store, leaf, NULL))
+			errx(1, "X509_STORE_CTX_init failed");
+		ret = X509_verify_cert(ctx);
+		if ((ret == 1) != (tests[i].want >= 0)) {
+			fprintf(stderr, "FAIL: %s: verify returned %d (%s)\n",
+			    tests[i].desc, ret, X509_verify_cert_error_string(
+			    X509_STORE_CTX_get_error(ctx)));
+			failed = 1;
+		}
+		X509_STORE_CTX_free(ctx);
+
+		X509_free(leaf);
+	}
+
+	X509_STORE_free(store);
+	for (i = 0; i < 3; i++)
+		X509_free(ca[i]);
+	EVP_PKEY_free(key[0]);
+	EVP_PKEY_free(key[1]);
+	EVP_PKEY_free(filler_key);
+
+	return !failed;
+}
+
+int
+main(int argc, char **argv)
+{
+	int failed = 0;
+
+	OpenSSL_add_all_digests();
+	ERR_load_crypto_strings();
+
+	failed |= !store_index_name_test();
+	failed |= !store_index_release_test();
+	failed |= !store_index_skid_test();
+
+	if (!failed)
+		printf("PASS\n");
+
+	return failed;
+}
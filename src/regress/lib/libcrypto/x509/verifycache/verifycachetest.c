@@ -0,0 +1,478 @@
+/* $OpenBSD$ */
+/*
+ * Copyright (c) 2026 The LibreSSL project.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Tests for the X509_STORE verify cache: hits and misses, the checks that
+ * still run on a hit, and invalidation when certificates or CRLs are added.
+ */
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/objects.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#define DAY	(24 * 60 * 60)
+
+/*
+ * Round trip through DER, so that the result is like a certificate or CRL
+ * that was read in, with its encoding and digests cached.
+ */
+static X509 *
+cert_reparse(X509 *x)
+{
+	unsigned char *der = NULL;
+	const unsigned char *p;
+	X509 *ret;
+	int len;
+
+	if ((len = i2d_X509(x, &der)) <= 0)
+		errx(1, "i2d_X509 failed");
+	p = der;
+	if ((ret = d2i_X509(NULL, &p, len)) == NULL)
+		errx(1, "d2i_X509 failed");
+	free(der);
+	X509_free(x);
+
+	return ret;
+}
+
+static X509_CRL *
+crl_reparse(X509_CRL *crl)
+{
+	unsigned char *der = NULL;
+	const unsigned char *p;
+	X509_CRL *ret;
+	int len;
+
+	if ((len = i2d_X509_CRL(crl, &der)) <= 0)
+		errx(1, "i2d_X509_CRL failed");
+	p = der;
+	if ((ret = d2i_X509_CRL(NULL, &p, len)) == NULL)
+		errx(1, "d2i_X509_CRL failed");
+	free(der);
+	X509_CRL_free(crl);
+
+	return ret;
+}
+
+static EVP_PKEY *
+key_new(void)
+{
+	EVP_PKEY *pkey;
+	EC_KEY *ec;
+
+	if ((ec = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1)) == NULL ||
+	    !EC_KEY_generate_key(ec))
+		errx(1, "EC_KEY_generate_key failed");
+	if ((pkey = EVP_PKEY_new()) == NULL || !EVP_PKEY_assign_EC_KEY(pkey, ec))
+		errx(1, "EVP_PKEY_assign_EC_KEY failed");
+
+	return pkey;
+}
+
+static X509_NAME *
+name_new(const char *cn)
+{
+	X509_NAME *name;
+
+	if ((name = X509_NAME_new()) == NULL ||
+	    !X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+	    (const unsigned char *)cn, -1, -1, 0))
+		errx(1, "X509_NAME_add_entry_by_txt failed");
+
+	return name;
+}
+
+/*
+ * Make a certificate for cn and key, issued by issuer, or self-signed if
+ * issuer is NULL. It is valid from 1 day ago for the given days.
+ */
+static X509 *
+cert_new(const char *cn, EVP_PKEY *key, X509 *issuer, EVP_PKEY *issuer_key,
+    int ca, long serial, long days)
+{
+	BASIC_CONSTRAINTS *bc;
+	X509_NAME *name;
+	X509 *x;
+
+	if ((x = X509_new()) == NULL)
+		errx(1, "X509_new failed");
+	name = name_new(cn);
+	if (!X509_set_version(x, 2) ||
+	    !ASN1_INTEGER_set(X509_get_serialNumber(x), serial) ||
+	    !X509_set_subject_name(x, name) ||
+	    !X509_set_issuer_name(x, issuer != NULL ?
+	    X509_get_subject_name(issuer) : name) ||
+	    X509_gmtime_adj(X509_get_notBefore(x), -DAY) == NULL ||
+	    X509_gmtime_adj(X509_get_notAfter(x), days * DAY) == NULL ||
+	    !X509_set_pubkey(x, key))
+		errx(1, "failed to set up certificate");
+	X509_NAME_free(name);
+
+	if ((bc = BASIC_CONSTRAINTS_new()) == NULL)
+		errx(1, "BASIC_CONSTRAINTS_new failed");
+	bc->ca = ca ? 0xff : 0;
+	if (!X509_add1_ext_i2d(x, NID_basic_constraints, bc, 1, 0))
+		errx(1, "X509_add1_ext_i2d failed");
+	BASIC_CONSTRAINTS_free(bc);
+
+	if (!X509_sign(x, issuer_key != NULL ? issuer_key : key,
+	    EVP_sha256()))
+		errx(1, "X509_sign failed");
+
+	return cert_reparse(x);
+}
+
+/* Make a CRL by issuer that revokes the given serial, or nothing if 0. */
+static X509_CRL *
+crl_new(X509 *issuer, EVP_PKEY *issuer_key, long serial)
+{
+	X509_REVOKED *rev;
+	ASN1_INTEGER *aint;
+	ASN1_TIME *t;
+	X509_CRL *crl;
+
+	if ((crl = X509_CRL_new()) == NULL ||
+	    !X509_CRL_set_version(crl, 1) ||
+	    !X509_CRL_set_issuer_name(crl, X509_get_subject_name(issuer)))
+		errx(1, "failed to set up CRL");
+	if ((t = X509_gmtime_adj(NULL, -DAY)) == NULL ||
+	    !X509_CRL_set_lastUpdate(crl, t))
+		errx(1, "X509_CRL_set_lastUpdate failed");
+	ASN1_TIME_free(t);
+	if ((t = X509_gmtime_adj(NULL, 30 * DAY)) == NULL ||
+	    !X509_CRL_set_nextUpdate(crl, t))
+		errx(1, "X509_CRL_set_nextUpdate failed");
+
+	if (serial != 0) {
+		if ((rev = X509_REVOKED_new()) == NULL ||
+		    (aint = ASN1_INTEGER_new()) == NULL ||
+		    !ASN1_INTEGER_set(aint, serial) ||
+		    !X509_REVOKED_set_serialNumber(rev, aint) ||
+		    !X509_REVOKED_set_revocationDate(rev, t) ||
+		    !X509_CRL_add0_revoked(crl, rev))
+			errx(1, "failed to revoke serial");
+		ASN1_INTEGER_free(aint);
+	}
+	ASN1_TIME_free(t);
+
+	if (!X509_CRL_sort(crl) || !X509_CRL_sign(crl, issuer_key,
+	    EVP_sha256()))
+		errx(1, "X509_CRL_sign failed");
+
+	return crl_reparse(crl);
+}
+
+struct pki {
+	EVP_PKEY *root_key, *ca_key, *leaf_key;
+	X509 *root, *ca, *leaf, *leaf2;
+	STACK_OF(X509) *untrusted;
+};
+
+static void
+pki_new(struct pki *pki)
+{
+	pki->root_key = key_new();
+	pki->ca_key = key_new();
+	pki->leaf_key = key_new();
+
+	pki->root = cert_new("Root", pki->root_key, NULL, NULL, 1, 1, 3650);
+	pki->ca = cert_new("Intermediate", pki->ca_key, pki->root,
+	    pki->root_key, 1, 2, 3650);
+	pki->leaf = cert_new("Leaf", pki->leaf_key, pki->ca, pki->ca_key, 0,
+	    100, 30);
+	pki->leaf2 = cert_new("Leaf 2", pki->leaf_key, pki->ca, pki->ca_key,
+	    0, 101, 30);
+
+	if ((pki->untrusted = sk_X509_new_null()) == NULL ||
+	    !sk_X509_push(pki->untrusted, pki->ca))
+		errx(1, "sk_X509_push failed");
+}
+
+static void
+pki_free(struct pki *pki)
+{
+	sk_X509_free(pki->untrusted);
+	X509_free(pki->root);
+	X509_free(pki->ca);
+	X509_free(pki->leaf);
+	X509_free(pki->leaf2);
+	EVP_PKEY_free(pki->root_key);
+	EVP_PKEY_free(pki->ca_key);
+	EVP_PKEY_free(pki->leaf_key);
+}
+
+static int
+verify_cb(int ok, X509_STORE_CTX *ctx)
+{
+	return ok;
+}
+
+struct verify_opts {
+	int purpose;
+	time_t check_time;
+	int with_cb;
+};
+
+/* Verify leaf, returning the verify error or -1 on other failure. */
+static int
+verify(X509_STORE *store, X509 *leaf, STACK_OF(X509) *untrusted,
+    const struct verify_opts *opts)
+{
+	X509_STORE_CTX *ctx;
+	int error, ret;
+
+	if ((ctx = X509_STORE_CTX_new()) == NULL ||
+	    !X509_STORE_CTX_init(ctx, store, leaf, untrusted))
+		errx(1, "X509_STORE_CTX_init failed");
+	if (opts != NULL) {
+		if (opts->purpose != 0)
+			X509_STORE_CTX_set_purpose(ctx, opts->purpose);
+		if (opts->check_time != 0)
+			X509_STORE_CTX_set_time(ctx, 0, opts->check_time);
+		if (opts->with_cb)
+			X509_STORE_CTX_set_verify_cb(ctx, verify_cb);
+	}
+
+	ret = X509_verify_cert(ctx);
+	error = X509_STORE_CTX_get_error(ctx);
+	X509_STORE_CTX_free(ctx);
+
+	if (ret == 1 && error != X509_V_OK)
+		return -1;
+	if (ret != 1 && error == X509_V_OK)
+		return -1;
+
+	return error;
+}
+
+struct counters {
+	unsigned long hits, misses;
+};
+
+static int
+check(X509_STORE *store, struct counters *c, const char *desc, int error,
+    int want_error, unsigned long hits, unsigned long misses)
+{
+	unsigned long h, m;
+	int ret = 1;
+
+	h = X509_STORE_verify_cache_hits(store);
+	m = X509_STORE_verify_cache_misses(store);
+
+	if (error != want_error) {
+		fprintf(stderr, "FAIL: %s: got verify error %d (%s), want %d "
+		    "(%s)\n", desc, error, X509_verify_cert_error_string(error),
+		    want_error, X509_verify_cert_error_string(want_error));
+		ret = 0;
+	}
+	if (h - c->hits != hits || m - c->misses != misses) {
+		fprintf(stderr, "FAIL: %s: got %lu hits and %lu misses, "
+		    "want %lu and %lu\n", desc, h - c->hits, m - c->misses,
+		    hits, misses);
+		ret = 0;
+	}
+
+	c->hits = h;
+	c->misses = m;
+
+	return ret;
+}
+
+static int
+verify_cache_test(void)
+{
+	struct verify_opts opts;
+	struct counters c = { 0, 0 };
+	X509_STORE *store;
+	X509 *bad_leaf, *other;
+	EVP_PKEY *other_key;
+	struct pki pki;
+	int error, failed = 0;
+
+	pki_new(&pki);
+
+	if ((store = X509_STORE_new()) == NULL ||
+	    !X509_STORE_add_cert(store, pki.root))
+		errx(1, "X509_STORE_add_cert failed");
+
+	/* Without a cache nothing is counted. */
+	error = verify(store, pki.leaf, pki.untrusted, NULL);
+	failed |= !check(store, &c, "no cache", error, X509_V_OK, 0, 0);
+
+	if (!X509_STORE_set_verify_cache_size(store, 16))
+		errx(1, "X509_STORE_set_verify_cache_size failed");
+
+	error = verify(store, pki.leaf, pki.untrusted, NULL);
+	failed |= !check(store, &c, "first verify", error, X509_V_OK, 0, 1);
+	error = verify(store, pki.leaf, pki.untrusted, NULL);
+	failed |= !check(store, &c, "second verify", error, X509_V_OK, 1, 0);
+	error = verify(store, pki.leaf2, pki.untrusted, NULL);
+	failed |= !check(store, &c, "other leaf", error, X509_V_OK, 0, 1);
+	error = verify(store, pki.leaf2, pki.untrusted, NULL);
+	failed |= !check(store, &c, "other leaf again", error, X509_V_OK,
+	    1, 0);
+
+	/* Different parameters are a different entry. */
+	memset(&opts, 0, sizeof(opts));
+	opts.purpose = X509_PURPOSE_SSL_CLIENT;
+	error = verify(store, pki.leaf, pki.untrusted, &opts);
+	failed |= !check(store, &c, "other purpose", error, X509_V_OK, 0, 1);
+	error = verify(store, pki.leaf, pki.untrusted, &opts);
+	failed |= !check(store, &c, "other purpose again", error, X509_V_OK,
+	    1, 0);
+
+	/* The validity times are still checked on a hit. */
+	memset(&opts, 0, sizeof(opts));
+	opts.check_time = time(NULL) + 60 * DAY;
+	error = verify(store, pki.leaf, pki.untrusted, &opts);
+	failed |= !check(store, &c, "expired on a hit", error,
+	    X509_V_ERR_CERT_HAS_EXPIRED, 1, 0);
+
+	/* A verify callback could see the skipped checks, so no cache. */
+	memset(&opts, 0, sizeof(opts));
+	opts.with_cb = 1;
+	error = verify(store, pki.leaf, pki.untrusted, &opts);
+	failed |= !check(store, &c, "verify callback", error, X509_V_OK, 0, 0);
+
+	/* A chain that fails to verify is never cached. */
+	other_key = key_new();
+	bad_leaf = cert_new("Leaf", pki.leaf_key, pki.ca, other_key, 0, 102,
+	    30);
+	error = verify(store, bad_leaf, pki.untrusted, NULL);
+	failed |= !check(store, &c, "bad signature", error,
+	    X509_V_ERR_CERT_SIGNATURE_FAILURE, 0, 1);
+	error = verify(store, bad_leaf, pki.untrusted, NULL);
+	failed |= !check(store, &c, "bad signature again", error,
+	    X509_V_ERR_CERT_SIGNATURE_FAILURE, 0, 1);
+
+	/* Adding a certificate empties the cache. */
+	other = cert_new("Other root", other_key, NULL, NULL, 1, 3, 3650);
+	if (!X509_STORE_add_cert(store, other))
+		errx(1, "X509_STORE_add_cert failed");
+	error = verify(store, pki.leaf, pki.untrusted, NULL);
+	failed |= !check(store, &c, "after adding a certificate", error,
+	    X509_V_OK, 0, 1);
+	error = verify(store, pki.leaf, pki.untrusted, NULL);
+	failed |= !check(store, &c, "after adding a certificate again",
+	    error, X509_V_OK, 1, 0);
+
+	/* Turning the cache off and on again empties it too. */
+	if (!X509_STORE_set_verify_cache_size(store, 0) ||
+	    !X509_STORE_set_verify_cache_size(store, 1))
+		errx(1, "X509_STORE_set_verify_cache_size failed");
+	c.hits = c.misses = 0;
+	error = verify(store, pki.leaf, pki.untrusted, NULL);
+	failed |= !check(store, &c, "resized", error, X509_V_OK, 0, 1);
+	/* With one slot, another chain replaces it. */
+	error = verify(store, pki.leaf2, pki.untrusted, NULL);
+	failed |= !check(store, &c, "one slot", error, X509_V_OK, 0, 1);
+	error = verify(store, pki.leaf, pki.untrusted, NULL);
+	failed |= !check(store, &c, "one slot, replaced", error, X509_V_OK,
+	    0, 1);
+
+	X509_STORE_free(store);
+	X509_free(other);
+	X509_free(bad_leaf);
+	EVP_PKEY_free(other_key);
+	pki_free(&pki);
+
+	return !failed;
+}
+
+static int
+verify_cache_crl_test(void)
+{
+	struct counters c = { 0, 0 };
+	X509_STORE *store;
+	X509_CRL *crl;
+	struct pki pki;
+	int error, failed = 0;
+
+	pki_new(&pki);
+
+	if ((store = X509_STORE_new()) == NULL ||
+	    !X509_STORE_add_cert(store, pki.root) ||
+	    !X509_STORE_set_flags(store, X509_V_FLAG_CRL_CHECK) ||
+	    !X509_STORE_set_verify_cache_size(store, 16))
+		errx(1, "failed to set up store");
+
+	/* Without a CRL the chain does not verify, and is not cached. */
+	error = verify(store, pki.leaf, pki.untrusted, NULL);
+	failed |= !check(store, &c, "no CRL", error,
+	    X509_V_ERR_UNABLE_TO_GET_CRL, 0, 1);
+
+	/* Adding a CRL that revokes the second leaf empties the cache. */
+	crl = crl_new(pki.ca, pki.ca_key, 101);
+	if (!X509_STORE_add_crl(store, crl))
+		errx(1, "X509_STORE_add_crl failed");
+	X509_CRL_free(crl);
+
+	error = verify(store, pki.leaf, pki.untrusted, NULL);
+	failed |= !check(store, &c, "CRL", error, X509_V_OK, 0, 1);
+	error = verify(store, pki.leaf, pki.untrusted, NULL);
+	failed |= !check(store, &c, "CRL again", error, X509_V_OK, 1, 0);
+
+	/* A revoked certificate is not cached. */
+	error = verify(store, pki.leaf2, pki.untrusted, NULL);
+	failed |= !check(store, &c, "revoked", error,
+	    X509_V_ERR_CERT_REVOKED, 0, 1);
+	error = verify(store, pki.leaf2, pki.untrusted, NULL);
+	failed |= !check(store, &c, "revoked again", error,
+	    X509_V_ERR_CERT_REVOKED, 0, 1);
+
+	/* Any CRL added to the store empties the cache. */
+	crl = crl_new(pki.root, pki.root_key, 0);
+	if (!X509_STORE_add_crl(store, crl))
+		errx(1, "X509_STORE_add_crl failed");
+	X509_CRL_free(crl);
+
+	error = verify(store, pki.leaf, pki.untrusted, NULL);
+	failed |= !check(store, &c, "after adding a CRL", error, X509_V_OK,
+	    0, 1);
+	error = verify(store, pki.leaf, pki.untrusted, NULL);
+	failed |= !check(store, &c, "after adding a CRL again", error,
+	    X509_V_OK, 1, 0);
+
+	X509_STORE_free(store);
+	pki_free(&pki);
+
+	return !failed;
+}
+
+int
+main(int argc, char **argv)
+{
+	int failed = 0;
+
+	OpenSSL_add_all_digests();
+
+	failed |= !verify_cache_test();
+	failed |= !verify_cache_crl_test();
+
+	if (!failed)
+		printf("PASS\n");
+
+	return failed;
+}
@@ -0,0 +1,395 @@
+/* $OpenBSD$ */
+/*
+ * Copyright (c) 2026 The LibreSSL project.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Tests for the application data record layer: coalescing of records into
+ * a single write with SSL_CTX_set_max_send_records(), and decryption into
+ * the caller's buffer with SSL_MODE_ZERO_COPY_READ. The client and the
+ * server talk over a BIO pair, and every write the client makes is counted
+ * and split into its records.
+ */
+
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ssl_locl.h"
+
+#define BIO_PAIR_SIZE	(64 * 1024)
+
+char *server_file;
+
+/* Writes and application data records seen on the client's BIO. */
+static int writes;
+static int records;
+
+static long
+write_cb(BIO *bio, int oper, const char *argp, int argi, long argl, long ret)
+{
+	const unsigned char *p = (const unsigned char *)argp;
+	long off = 0;
+
+	if (oper != (BIO_CB_WRITE | BIO_CB_RETURN) || ret <= 0)
+		return ret;
+
+	writes++;
+	while (off + SSL3_RT_HEADER_LENGTH <= ret) {
+		if (p[off] == SSL3_RT_APPLICATION_DATA)
+			records++;
+		off += SSL3_RT_HEADER_LENGTH + (p[off + 3] << 8 | p[off + 4]);
+	}
+	if (off != ret)
+		errx(1, "write of %ld bytes ends within a record", ret);
+
+	return ret;
+}
+
+struct conn {
+	SSL_CTX *c_ctx;
+	SSL_CTX *s_ctx;
+	SSL *client;
+	SSL *server;
+};
+
+static void
+conn_free(struct conn *conn)
+{
+	SSL_free(conn->client);
+	SSL_free(conn->server);
+	SSL_CTX_free(conn->c_ctx);
+	SSL_CTX_free(conn->s_ctx);
+}
+
+static int
+handshake_step(SSL *ssl, int *done)
+{
+	int ret;
+
+	if (*done)
+		return 1;
+	if ((ret = SSL_do_handshake(ssl)) == 1) {
+		*done = 1;
+		return 1;
+	}
+	switch (SSL_get_error(ssl, ret)) {
+	case SSL_ERROR_WANT_READ:
+	case SSL_ERROR_WANT_WRITE:
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Connect a client and a server with an AEAD cipher suite, the client
+ * sending records of at most max_send_fragment bytes and coalescing up to
+ * max_send_records of them.
+ */
+static int
+conn_new(struct conn *conn, long max_send_fragment, long max_send_records)
+{
+	BIO *c_bio, *s_bio;
+	int c_done = 0, s_done = 0;
+	int i;
+
+	memset(conn, 0, sizeof(*conn));
+
+	if ((conn->c_ctx = SSL_CTX_new(TLS_client_method())) == NULL ||
+	    (conn->s_ctx = SSL_CTX_new(TLS_server_method())) == NULL)
+		errx(1, "SSL_CTX_new failed");
+	if (SSL_CTX_use_certificate_file(conn->s_ctx, server_file,
+	    SSL_FILETYPE_PEM) != 1 ||
+	    SSL_CTX_use_PrivateKey_file(conn->s_ctx, server_file,
+	    SSL_FILETYPE_PEM) != 1)
+		errx(1, "failed to load server certificate and key");
+	SSL_CTX_set_ecdh_auto(conn->s_ctx, 1);
+	if (!SSL_CTX_set_cipher_list(conn->c_ctx,
+	    "ECDHE-RSA-AES128-GCM-SHA256"))
+		errx(1, "SSL_CTX_set_cipher_list failed");
+	if (!SSL_CTX_set_max_send_fragment(conn->c_ctx, max_send_fragment) ||
+	    !SSL_CTX_set_max_send_records(conn->c_ctx, max_send_records)) {
+		fprintf(stderr, "FAIL: cannot coalesce %ld records of %ld "
+		    "bytes\n", max_send_records, max_send_fragment);
+		return 0;
+	}
+
+	if ((conn->client = SSL_new(conn->c_ctx)) == NULL ||
+	    (conn->server = SSL_new(conn->s_ctx)) == NULL)
+		errx(1, "SSL_new failed");
+	if (!BIO_new_bio_pair(&c_bio, BIO_PAIR_SIZE, &s_bio, BIO_PAIR_SIZE))
+		errx(1, "BIO_new_bio_pair failed");
+	BIO_set_callback(c_bio, write_cb);
+	SSL_set_bio(conn->client, c_bio, c_bio);
+	SSL_set_bio(conn->server, s_bio, s_bio);
+	SSL_set_connect_state(conn->client);
+	SSL_set_accept_state(conn->server);
+
+	for (i = 0; i < 100 && !(c_done && s_done); i++) {
+		if (!handshake_step(conn->client, &c_done) ||
+		    !handshake_step(conn->server, &s_done)) {
+			fprintf(stderr, "FAIL: handshake failed\n");
+			ERR_print_errors_fp(stderr);
+			return 0;
+		}
+	}
+	if (!c_done || !s_done) {
+		fprintf(stderr, "FAIL: handshake did not complete\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Read len bytes on the server and compare them with what was sent. */
+static int
+read_all(SSL *ssl, const unsigned char *sent, int len, int chunk)
+{
+	unsigned char *buf;
+	int n, off = 0;
+
+	if ((buf = malloc(len)) == NULL)
+		err(1, NULL);
+	while (off < len) {
+		n = len - off < chunk ? len - off : chunk;
+		if ((n = SSL_read(ssl, buf + off, n)) <= 0) {
+			fprintf(stderr, "FAIL: SSL_read returned %d after %d "
+			    "of %d bytes\n", n, off, len);
+			free(buf);
+			return 0;
+		}
+		off += n;
+	}
+	n = memcmp(buf, sent, len) == 0;
+	if (!n)
+		fprintf(stderr, "FAIL: received data differs\n");
+	free(buf);
+
+	return n;
+}
+
+struct coalesce_test {
+	long max_send_fragment;
+	long max_send_records;
+	int len;
+	int want_writes;
+	int want_records;
+};
+
+static const struct coalesce_test coalesce_tests[] = {
+	{ 512, 1, 4096, 8, 8 },
+	{ 512, 3, 4096, 3, 8 },
+	{ 512, 4, 4096, 2, 8 },
+	{ 512, 8, 4096, 1, 8 },
+	{ 512, 8, 4000, 1, 8 },
+	{ 512, 8, 10000, 3, 20 },
+	{ 4096, 4, 16384, 1, 4 },
+	{ 16384, 2, 49152, 2, 3 },
+};
+
+#define N_COALESCE_TESTS \
+    (sizeof(coalesce_tests) / sizeof(*coalesce_tests))
+
+static int
+coalesce_test(const struct coalesce_test *ct)
+{
+	struct conn conn;
+	unsigned char *data;
+	int ret, failed = 0;
+
+	if (!conn_new(&conn, ct->max_send_fragment, ct->max_send_records)) {
+		conn_free(&conn);
+		return 0;
+	}
+	if ((data = malloc(ct->len)) == NULL)
+		err(1, NULL);
+	arc4random_buf(data, ct->len);
+
+	writes = records = 0;
+	if ((ret = SSL_write(conn.client, data, ct->len)) != ct->len) {
+		fprintf(stderr, "FAIL: SSL_write returned %d\n", ret);
+		failed = 1;
+	}
+	if (writes != ct->want_writes || records != ct->want_records) {
+		fprintf(stderr, "FAIL: %d bytes in %ld byte records, %ld per "
+		    "write: %d records in %d writes, want %d in %d\n",
+		    ct->len, ct->max_send_fragment, ct->max_send_records,
+		    records, writes, ct->want_records, ct->want_writes);
+		failed = 1;
+	}
+	if (!failed && !read_all(conn.server, data, ct->len, 16384))
+		failed = 1;
+
+	free(data);
+	conn_free(&conn);
+
+	return !failed;
+}
+
+struct zero_copy_test {
+	const char *desc;
+	int zero_copy;
+	int len;
+	int buf_len;
+	int want_zero_copy;
+};
+
+static const struct zero_copy_test zero_copy_tests[] = {
+	{ "full record", 1, 16384, 16384, 1 },
+	{ "short record", 1, 1000, 16384, 1 },
+	{ "exact buffer", 1, 1000, 1000, 1 },
+	{ "short buffer", 1, 4000, 1000, 0 },
+	{ "mode off", 0, 16384, 16384, 0 },
+};
+
+#define N_ZERO_COPY_TESTS \
+    (sizeof(zero_copy_tests) / sizeof(*zero_copy_tests))
+
+/*
+ * Send one record and read it on the server, checking whether it was
+ * decrypted straight into the caller's buffer, in which case the record
+ * layer is left pointing at that buffer.
+ */
+static int
+zero_copy_test(const struct zero_copy_test *zt)
+{
+	struct conn conn;
+	unsigned char *data, *buf;
+	int n, off, used, failed = 0;
+
+	if (!conn_new(&conn, 16384, 1)) {
+		conn_free(&conn);
+		return 0;
+	}
+	if (zt->zero_copy)
+		SSL_set_mode(conn.server, SSL_MODE_ZERO_COPY_READ);
+	if ((data = malloc(zt->len)) == NULL ||
+	    (buf = malloc(zt->len + zt->buf_len)) == NULL)
+		err(1, NULL);
+	arc4random_buf(data, zt->len);
+
+	if (SSL_write(conn.client, data, zt->len) != zt->len)
+		errx(1, "SSL_write failed");
+
+	if ((n = SSL_read(conn.server, buf, zt->buf_len)) <= 0) {
+		fprintf(stderr, "FAIL: %s: SSL_read returned %d\n", zt->desc,
+		    n);
+		failed = 1;
+		goto done;
+	}
+	used = S3I(conn.server)->rrec.data == buf;
+	if (used != zt->want_zero_copy) {
+		fprintf(stderr, "FAIL: %s: record was %sdecrypted into the "
+		    "caller's buffer\n", zt->desc, used ? "" : "not ");
+		failed = 1;
+	}
+	for (off = n; off < zt->len; off += n) {
+		if ((n = SSL_read(conn.server, buf + off, zt->buf_len)) <= 0) {
+			fprintf(stderr, "FAIL: %s: SSL_read returned %d\n",
+			    zt->desc, n);
+			failed = 1;
+			goto done;
+		}
+	}
+	if (off != zt->len || memcmp(buf, data, zt->len) != 0) {
+		fprintf(stderr, "FAIL: %s: received data differs\n", zt->desc);
+		failed = 1;
+	}
+
+ done:
+	free(data);
+	free(buf);
+	conn_free(&conn);
+
+	return !failed;
+}
+
+/*
+ * SSL_read() with a length of zero or less must not decrypt into the
+ * buffer, and must leave the record to be read later.
+ */
+static int
+zero_copy_len_test(int len)
+{
+	unsigned char data[1000], buf[sizeof(data)], guard[sizeof(data)];
+	struct conn conn;
+	int n, failed = 0;
+
+	if (!conn_new(&conn, 16384, 1)) {
+		conn_free(&conn);
+		return 0;
+	}
+	SSL_set_mode(conn.server, SSL_MODE_ZERO_COPY_READ);
+	arc4random_buf(data, sizeof(data));
+	memset(guard, 0xa5, sizeof(guard));
+	memcpy(buf, guard, sizeof(buf));
+
+	if (SSL_write(conn.client, data, sizeof(data)) != sizeof(data))
+		errx(1, "SSL_write failed");
+
+	if ((n = SSL_read(conn.server, buf, len)) > 0) {
+		fprintf(stderr, "FAIL: SSL_read of %d bytes returned %d\n",
+		    len, n);
+		failed = 1;
+	}
+	if (memcmp(buf, guard, sizeof(buf)) != 0) {
+		fprintf(stderr, "FAIL: SSL_read of %d bytes wrote to the "
+		    "buffer\n", len);
+		failed = 1;
+	}
+	if ((n = SSL_read(conn.server, buf, sizeof(buf))) != sizeof(buf) ||
+	    memcmp(buf, data, sizeof(data)) != 0) {
+		fprintf(stderr, "FAIL: record lost after SSL_read of %d "
+		    "bytes\n", len);
+		failed = 1;
+	}
+
+	conn_free(&conn);
+
+	return !failed;
+}
+
+int
+main(int argc, char **argv)
+{
+	int failed = 0;
+	size_t i;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s server.pem\n", argv[0]);
+		exit(1);
+	}
+	server_file = argv[1];
+
+	SSL_library_init();
+	SSL_load_error_strings();
+
+	for (i = 0; i < N_COALESCE_TESTS; i++)
+		failed |= !coalesce_test(&coalesce_tests[i]);
+	for (i = 0; i < N_ZERO_COPY_TESTS; i++)
+		failed |= !zero_copy_test(&zero_copy_tests[i]);
+	failed |= !zero_copy_len_test(0);
+	failed |= !zero_copy_len_test(-1);
+
+	if (!failed)
+		printf("PASS\n");
+
+	return failed;
+}
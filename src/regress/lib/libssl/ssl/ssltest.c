@@ -345,6 +345,10 @@ sv_usage(void)
 	fprintf(stderr, " -reuse        - use session-id reuse\n");
 	fprintf(stderr, " -num <val>    - number of connections to perform\n");
 	fprintf(stderr, " -bytes <val>  - number of bytes to swap between client/server\n");
+	fprintf(stderr, " -max_send_fragment <val> - maximum plaintext bytes per record\n");
+	fprintf(stderr, " -max_send_records <val> - maximum records coalesced per write\n");
+	fprintf(stderr, " -zero_copy_read - decrypt directly into the read buffer\n");
+	fprintf(stderr, " -buffer_pool <val> - release buffers into a pool of this size\n");
 	fprintf(stderr, " -dhe1024dsa   - use 1024 bit key (with 160-bit subprime) for DHE\n");
 	fprintf(stderr, " -no_dhe       - disable DHE\n");
 	fprintf(stderr, " -no_ecdhe     - disable ECDHE\n");
@@ -480,6 +484,9 @@ main(int argc, char *argv[])
 	SSL *c_ssl, *s_ssl;
 	int number = 1, reuse = 0;
 	long bytes = 256L;
+	long max_send_fragment = 0, max_send_records = 0;
+	int zero_copy_read = 0;
+	long buffer_pool = 0;
 	DH *dh;
 	int dhe1024dsa = 0;
 	EC_KEY *ecdh = NULL;
@@ -551,6 +558,20 @@ main(int argc, char *argv[])
 				bytes*=1024L;
 			if (argv[0][i - 1] == 'm')
 				bytes*=1024L*1024L;
+		} else if (strcmp(*argv, "-max_send_fragment") == 0) {
+			if (--argc < 1)
+				goto bad;
+			max_send_fragment = atol(*(++argv));
+		} else if (strcmp(*argv, "-max_send_records") == 0) {
+			if (--argc < 1)
+				goto bad;
+			max_send_records = atol(*(++argv));
+		} else if (strcmp(*argv, "-zero_copy_read") == 0) {
+			zero_copy_read = 1;
+		} else if (strcmp(*argv, "-buffer_pool") == 0) {
+			if (--argc < 1)
+				goto bad;
+			buffer_pool = atol(*(++argv));
 		} else if (strcmp(*argv, "-cert") == 0) {
 			if (--argc < 1)
 				goto bad;
@@ -680,6 +701,31 @@ bad:
 		SSL_CTX_set_cipher_list(s_ctx, cipher);
 	}
 
+	if (max_send_fragment != 0) {
+		if (!SSL_CTX_set_max_send_fragment(c_ctx, max_send_fragment) ||
+		    !SSL_CTX_set_max_send_fragment(s_ctx, max_send_fragment)) {
+			fprintf(stderr, "invalid max_send_fragment\n");
+			goto end;
+		}
+	}
+	if (max_send_records != 0) {
+		if (!SSL_CTX_set_max_send_records(c_ctx, max_send_records) ||
+		    !SSL_CTX_set_max_send_records(s_ctx, max_send_records)) {
+			fprintf(stderr, "invalid max_send_records\n");
+			goto end;
+		}
+	}
+	if (zero_copy_read) {
+		SSL_CTX_set_mode(c_ctx, SSL_MODE_ZERO_COPY_READ);
+		SSL_CTX_set_mode(s_ctx, SSL_MODE_ZERO_COPY_READ);
+	}
+	if (buffer_pool != 0) {
+		SSL_CTX_set_buffer_pool_max(c_ctx, buffer_pool);
+		SSL_CTX_set_buffer_pool_max(s_ctx, buffer_pool);
+		SSL_CTX_set_mode(c_ctx, SSL_MODE_RELEASE_BUFFERS);
+		SSL_CTX_set_mode(s_ctx, SSL_MODE_RELEASE_BUFFERS);
+	}
+
 	if (!no_dhe) {
 		if (dhe1024dsa) {
 			/* use SSL_OP_SINGLE_DH_USE to avoid small subgroup attacks */
@@ -792,6 +838,25 @@ bad:
 			ret = doit(s_ssl, c_ssl, bytes);
 	}
 
+	if (buffer_pool != 0) {
+		if (verbose)
+			BIO_printf(bio_stdout, "buffer pool: %ld hits, "
+			    "%ld misses, peak %ld\n",
+			    SSL_CTX_buffer_pool_hits(s_ctx),
+			    SSL_CTX_buffer_pool_misses(s_ctx),
+			    SSL_CTX_buffer_pool_peak(s_ctx));
+		/*
+		 * Each server connection sets up a read and a write buffer.
+		 * Buffers reused from the thread's cache count as neither
+		 * hits nor misses, so reuse shows as fewer misses.
+		 */
+		if (SSL_CTX_buffer_pool_misses(s_ctx) >= 2 * number ||
+		    SSL_CTX_buffer_pool_peak(s_ctx) > 2 * buffer_pool) {
+			fprintf(stderr, "buffer pool not used as expected\n");
+			ret = 1;
+		}
+	}
+
 	if (!verbose) {
 		print_details(c_ssl, "");
 	}
@@ -0,0 +1,513 @@
+/* $OpenBSD$ */
+/*
+ * Copyright (c) 2026 The LibreSSL project.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/ssl.h>
+
+#include "ssl_locl.h"
+
+#define NUM_SESSIONS	1000
+#define NUM_THREADS	8
+#define BASE_TIME	1000000
+
+static int removed;
+
+static void
+remove_cb(SSL_CTX *ctx, SSL_SESSION *s)
+{
+	removed++;
+}
+
+static SSL_SESSION *
+new_session(int i, long time, long timeout)
+{
+	SSL_SESSION *s;
+
+	if ((s = SSL_SESSION_new()) == NULL)
+		return NULL;
+
+	s->ssl_version = TLS1_2_VERSION;
+	s->session_id_length = SSL3_SSL_SESSION_ID_LENGTH;
+	arc4random_buf(s->session_id, s->session_id_length);
+	memcpy(s->session_id, &i, sizeof(i));
+	SSL_SESSION_set_time(s, time);
+	SSL_SESSION_set_timeout(s, timeout);
+
+	return s;
+}
+
+static int
+cached(SSL_CTX *ctx, SSL_SESSION *s)
+{
+	SSL_SESSION_CACHE_SHARD *sc;
+
+	sc = ssl_session_cache_shard(ctx, s->session_id, s->session_id_length);
+	return lh_SSL_SESSION_retrieve(sc->sessions, s) == s;
+}
+
+/*
+ * Check that each shard's heap holds the sessions in its hash, ordered
+ * by expiry time with the one that expires first on top, and that the
+ * shards add up to the cache's session count and to SSL_CTX_sessions().
+ */
+static int
+check_heaps(SSL_CTX *ctx)
+{
+	struct lhash_st_SSL_SESSION *all;
+	SSL_SESSION_CACHE_SHARD *sc;
+	SSL_SESSION *s, *parent;
+	unsigned long total = 0;
+	size_t j;
+	int i;
+
+	for (i = 0; i < SSL_SESSION_CACHE_SHARDS; i++) {
+		sc = &ctx->internal->session_cache[i];
+		for (j = 0; j < sc->heap_len; j++) {
+			s = sc->heap[j];
+			if (s->internal->cache_shard != sc ||
+			    s->internal->cache_index != j) {
+				fprintf(stderr, "FAIL: shard %d session %zu "
+				    "has a wrong position\n", i, j);
+				return 1;
+			}
+			if (j > 0) {
+				parent = sc->heap[(j - 1) / 2];
+				if (s->time + s->timeout <
+				    parent->time + parent->timeout) {
+					fprintf(stderr, "FAIL: shard %d out "
+					    "of order\n", i);
+					return 1;
+				}
+			}
+			if (!cached(ctx, s)) {
+				fprintf(stderr, "FAIL: shard %d session not "
+				    "in hash\n", i);
+				return 1;
+			}
+		}
+		if (sc->heap_len != lh_SSL_SESSION_num_items(sc->sessions)) {
+			fprintf(stderr, "FAIL: shard %d has %zu sessions in "
+			    "heap, %lu in hash\n", i, sc->heap_len,
+			    lh_SSL_SESSION_num_items(sc->sessions));
+			return 1;
+		}
+		if (SSL_CTX_sessions_shard(ctx, i) != sc->sessions) {
+			fprintf(stderr, "FAIL: SSL_CTX_sessions_shard(%d)\n",
+			    i);
+			return 1;
+		}
+		total += lh_SSL_SESSION_num_items(
+		    SSL_CTX_sessions_shard(ctx, i));
+	}
+	if (SSL_CTX_sessions_shard(ctx, -1) != NULL ||
+	    SSL_CTX_sessions_shard(ctx, i) != NULL) {
+		fprintf(stderr, "FAIL: SSL_CTX_sessions_shard out of range\n");
+		return 1;
+	}
+	if ((all = SSL_CTX_sessions(ctx)) == NULL ||
+	    lh_SSL_SESSION_num_items(all) != total) {
+		fprintf(stderr, "FAIL: SSL_CTX_sessions\n");
+		return 1;
+	}
+	for (i = 0; i < SSL_SESSION_CACHE_SHARDS; i++) {
+		sc = &ctx->internal->session_cache[i];
+		for (j = 0; j < sc->heap_len; j++) {
+			if (lh_SSL_SESSION_retrieve(all, sc->heap[j]) !=
+			    sc->heap[j]) {
+				fprintf(stderr, "FAIL: shard %d session not "
+				    "in SSL_CTX_sessions\n", i);
+				return 1;
+			}
+		}
+	}
+	if (total != (unsigned long)SSL_CTX_sess_number(ctx)) {
+		fprintf(stderr, "FAIL: %lu sessions in shards, %ld counted\n",
+		    total, SSL_CTX_sess_number(ctx));
+		return 1;
+	}
+
+	return 0;
+}
+
+static int
+test_session_cache_flush(void)
+{
+	SSL_SESSION *sessions[NUM_SESSIONS];
+	SSL_CTX *ctx;
+	long expiry, flush_time;
+	int expired, i;
+	int failed = 1;
+
+	memset(sessions, 0, sizeof(sessions));
+
+	if ((ctx = SSL_CTX_new(TLS_method())) == NULL) {
+		fprintf(stderr, "FAIL: SSL_CTX_new\n");
+		goto failure;
+	}
+	SSL_CTX_sess_set_cache_size(ctx, 0);
+	SSL_CTX_sess_set_remove_cb(ctx, remove_cb);
+
+	/* Add sessions with unordered expiry times. */
+	for (i = 0; i < NUM_SESSIONS; i++) {
+		if ((sessions[i] = new_session(i, BASE_TIME + (i * 7) % 501,
+		    100 + (i * 13) % 307)) == NULL) {
+			fprintf(stderr, "FAIL: SSL_SESSION_new\n");
+			goto failure;
+		}
+		if (SSL_CTX_add_session(ctx, sessions[i]) != 1) {
+			fprintf(stderr, "FAIL: SSL_CTX_add_session\n");
+			goto failure;
+		}
+	}
+	if (SSL_CTX_sess_number(ctx) != NUM_SESSIONS) {
+		fprintf(stderr, "FAIL: %ld sessions cached, want %d\n",
+		    SSL_CTX_sess_number(ctx), NUM_SESSIONS);
+		goto failure;
+	}
+	if (check_heaps(ctx))
+		goto failure;
+
+	/*
+	 * Changing the time or timeout of cached sessions must move them,
+	 * so that the flush below still finds them.
+	 */
+	for (i = 0; i < NUM_SESSIONS; i += 10) {
+		if (i % 20 == 0)
+			SSL_SESSION_set_time(sessions[i], BASE_TIME - 1000);
+		else
+			SSL_SESSION_set_timeout(sessions[i], 1000);
+	}
+	if (check_heaps(ctx))
+		goto failure;
+
+	/* Adding a session again must not change the cache. */
+	if (SSL_CTX_add_session(ctx, sessions[17]) != 0) {
+		fprintf(stderr, "FAIL: SSL_CTX_add_session of cached session\n");
+		goto failure;
+	}
+
+	flush_time = BASE_TIME + 450;
+	expired = 0;
+	for (i = 0; i < NUM_SESSIONS; i++) {
+		expiry = sessions[i]->time + sessions[i]->timeout;
+		if (flush_time > expiry)
+			expired++;
+	}
+
+	removed = 0;
+	SSL_CTX_flush_sessions(ctx, flush_time);
+	if (removed != expired) {
+		fprintf(stderr, "FAIL: flush removed %d sessions, want %d\n",
+		    removed, expired);
+		goto failure;
+	}
+	for (i = 0; i < NUM_SESSIONS; i++) {
+		expiry = sessions[i]->time + sessions[i]->timeout;
+		if (cached(ctx, sessions[i]) != (flush_time <= expiry)) {
+			fprintf(stderr, "FAIL: session %d %s\n", i,
+			    cached(ctx, sessions[i]) ? "not flushed" :
+			    "flushed");
+			goto failure;
+		}
+	}
+	if (check_heaps(ctx))
+		goto failure;
+
+	for (i = 0; i < NUM_SESSIONS; i++) {
+		if (!cached(ctx, sessions[i]))
+			continue;
+		if (SSL_CTX_remove_session(ctx, sessions[i]) != 1 ||
+		    cached(ctx, sessions[i])) {
+			fprintf(stderr, "FAIL: SSL_CTX_remove_session\n");
+			goto failure;
+		}
+		break;
+	}
+	if (check_heaps(ctx))
+		goto failure;
+
+	SSL_CTX_flush_sessions(ctx, 0);
+	if (SSL_CTX_sess_number(ctx) != 0) {
+		fprintf(stderr, "FAIL: %ld sessions left after flush\n",
+		    SSL_CTX_sess_number(ctx));
+		goto failure;
+	}
+
+	failed = 0;
+
+ failure:
+	for (i = 0; i < NUM_SESSIONS; i++)
+		SSL_SESSION_free(sessions[i]);
+	SSL_CTX_free(ctx);
+
+	return failed;
+}
+
+static SSL_SESSION **reentrant_sessions;
+static SSL_SESSION *reentrant_victim;
+
+/*
+ * A remove callback that uses the cache, which must not deadlock: it
+ * changes the timeout of the session being removed and, the first time,
+ * removes a session that has not expired from the same shard.
+ */
+static void
+reentrant_remove_cb(SSL_CTX *ctx, SSL_SESSION *s)
+{
+	SSL_SESSION_CACHE_SHARD *sc;
+	int i;
+
+	removed++;
+	SSL_SESSION_set_timeout(s, 1);
+	if (reentrant_victim != NULL)
+		return;
+
+	sc = ssl_session_cache_shard(ctx, s->session_id, s->session_id_length);
+	for (i = 1; i < NUM_SESSIONS; i += 2) {
+		if (ssl_session_cache_shard(ctx,
+		    reentrant_sessions[i]->session_id,
+		    reentrant_sessions[i]->session_id_length) == sc) {
+			reentrant_victim = reentrant_sessions[i];
+			SSL_CTX_remove_session(ctx, reentrant_victim);
+			return;
+		}
+	}
+}
+
+static int
+test_session_cache_flush_reentrant(void)
+{
+	SSL_SESSION *sessions[NUM_SESSIONS];
+	SSL_CTX *ctx;
+	int i;
+	int failed = 1;
+
+	memset(sessions, 0, sizeof(sessions));
+
+	if ((ctx = SSL_CTX_new(TLS_method())) == NULL) {
+		fprintf(stderr, "FAIL: SSL_CTX_new\n");
+		goto failure;
+	}
+	SSL_CTX_sess_set_cache_size(ctx, 0);
+	SSL_CTX_sess_set_remove_cb(ctx, reentrant_remove_cb);
+
+	/* Even sessions expire before BASE_TIME + 200, odd ones after. */
+	for (i = 0; i < NUM_SESSIONS; i++) {
+		if ((sessions[i] = new_session(i, BASE_TIME,
+		    i % 2 == 0 ? 100 : 300)) == NULL) {
+			fprintf(stderr, "FAIL: SSL_SESSION_new\n");
+			goto failure;
+		}
+		if (SSL_CTX_add_session(ctx, sessions[i]) != 1) {
+			fprintf(stderr, "FAIL: SSL_CTX_add_session\n");
+			goto failure;
+		}
+	}
+
+	removed = 0;
+	reentrant_sessions = sessions;
+	reentrant_victim = NULL;
+	SSL_CTX_flush_sessions(ctx, BASE_TIME + 200);
+	if (removed != NUM_SESSIONS / 2 + 1 || reentrant_victim == NULL ||
+	    SSL_CTX_sess_number(ctx) != NUM_SESSIONS / 2 - 1) {
+		fprintf(stderr, "FAIL: flush with a reentrant callback removed "
+		    "%d sessions, %ld left\n", removed,
+		    SSL_CTX_sess_number(ctx));
+		goto failure;
+	}
+	for (i = 0; i < NUM_SESSIONS; i++) {
+		if (cached(ctx, sessions[i]) !=
+		    (i % 2 == 1 && sessions[i] != reentrant_victim)) {
+			fprintf(stderr, "FAIL: session %d %s\n", i,
+			    cached(ctx, sessions[i]) ? "not removed" :
+			    "removed");
+			goto failure;
+		}
+	}
+	if (check_heaps(ctx))
+		goto failure;
+
+	failed = 0;
+
+ failure:
+	for (i = 0; i < NUM_SESSIONS; i++)
+		SSL_SESSION_free(sessions[i]);
+	SSL_CTX_free(ctx);
+
+	return failed;
+}
+
+static int
+test_session_cache_size(long size)
+{
+	SSL_SESSION *s;
+	SSL_CTX *ctx;
+	int i;
+	int failed = 1;
+
+	if ((ctx = SSL_CTX_new(TLS_method())) == NULL) {
+		fprintf(stderr, "FAIL: SSL_CTX_new\n");
+		goto failure;
+	}
+	SSL_CTX_sess_set_cache_size(ctx, size);
+
+	for (i = 0; i < NUM_SESSIONS; i++) {
+		if ((s = new_session(i, BASE_TIME + i, 300)) == NULL) {
+			fprintf(stderr, "FAIL: SSL_SESSION_new\n");
+			goto failure;
+		}
+		SSL_CTX_add_session(ctx, s);
+
+		/* The session that expires last is never the one evicted. */
+		if (!cached(ctx, s)) {
+			fprintf(stderr, "FAIL: newest session evicted\n");
+			SSL_SESSION_free(s);
+			goto failure;
+		}
+		SSL_SESSION_free(s);
+
+		if (SSL_CTX_sess_number(ctx) > size) {
+			fprintf(stderr, "FAIL: %ld sessions cached, "
+			    "limit is %ld\n", SSL_CTX_sess_number(ctx), size);
+			goto failure;
+		}
+	}
+	if (SSL_CTX_sess_number(ctx) != size) {
+		fprintf(stderr, "FAIL: %ld sessions cached, want %ld\n",
+		    SSL_CTX_sess_number(ctx), size);
+		goto failure;
+	}
+	if (SSL_CTX_sess_cache_full(ctx) != NUM_SESSIONS - size) {
+		fprintf(stderr, "FAIL: %ld sessions evicted, want %ld\n",
+		    SSL_CTX_sess_cache_full(ctx), NUM_SESSIONS - size);
+		goto failure;
+	}
+	if (check_heaps(ctx))
+		goto failure;
+
+	failed = 0;
+
+ failure:
+	SSL_CTX_free(ctx);
+
+	return failed;
+}
+
+struct thread_arg {
+	SSL_CTX *ctx;
+	int id;
+	int failed;
+};
+
+static void *
+session_cache_thread(void *arg)
+{
+	struct thread_arg *ta = arg;
+	SSL_SESSION *s;
+	int i;
+
+	for (i = 0; i < NUM_SESSIONS; i++) {
+		if ((s = new_session(ta->id * NUM_SESSIONS + i,
+		    BASE_TIME + i, 300)) == NULL) {
+			ta->failed = 1;
+			return NULL;
+		}
+		SSL_CTX_add_session(ta->ctx, s);
+		if (i % 3 == 0)
+			SSL_SESSION_set_timeout(s, 100 + i % 50);
+		if (i % 5 == 0)
+			SSL_CTX_remove_session(ta->ctx, s);
+		if (i % 100 == 0)
+			SSL_CTX_flush_sessions(ta->ctx, BASE_TIME + i / 2);
+		SSL_SESSION_free(s);
+	}
+
+	return NULL;
+}
+
+static int
+test_session_cache_threads(void)
+{
+	struct thread_arg ta[NUM_THREADS];
+	pthread_t threads[NUM_THREADS];
+	SSL_CTX *ctx;
+	int i;
+	int failed = 1;
+
+	if ((ctx = SSL_CTX_new(TLS_method())) == NULL) {
+		fprintf(stderr, "FAIL: SSL_CTX_new\n");
+		goto failure;
+	}
+	SSL_CTX_sess_set_cache_size(ctx, 500);
+
+	for (i = 0; i < NUM_THREADS; i++) {
+		ta[i].ctx = ctx;
+		ta[i].id = i;
+		ta[i].failed = 0;
+		if (pthread_create(&threads[i], NULL, session_cache_thread,
+		    &ta[i]) != 0) {
+			fprintf(stderr, "FAIL: pthread_create\n");
+			goto failure;
+		}
+	}
+	for (i = 0; i < NUM_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+		if (ta[i].failed) {
+			fprintf(stderr, "FAIL: thread %d\n", i);
+			goto failure;
+		}
+	}
+
+	if (SSL_CTX_sess_number(ctx) > 500) {
+		fprintf(stderr, "FAIL: %ld sessions cached, limit is 500\n",
+		    SSL_CTX_sess_number(ctx));
+		goto failure;
+	}
+	if (check_heaps(ctx))
+		goto failure;
+
+	failed = 0;
+
+ failure:
+	SSL_CTX_free(ctx);
+
+	return failed;
+}
+
+int
+main(int argc, char **argv)
+{
+	int failed = 0;
+
+	SSL_library_init();
+
+	failed |= test_session_cache_flush();
+	failed |= test_session_cache_flush_reentrant();
+	failed |= test_session_cache_size(1);
+	failed |= test_session_cache_size(16);
+	failed |= test_session_cache_size(64);
+	failed |= test_session_cache_threads();
+
+	if (failed == 0)
+		printf("PASS %s\n", __FILE__);
+
+	return (failed);
+}
@@ -19,10 +19,14 @@
 
 #include <err.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include <openssl/crypto.h>
+
 #include <tls.h>
 
 #define CIRCULAR_BUFFER_SIZE 512
@@ -428,6 +432,258 @@ do_tls_ordering_tests(void)
 	return (failure);
 }
 
+static int
+do_session_resumption_test(char *desc, struct tls_config *client_cfg,
+    struct tls *server, int *resumed)
+{
+	struct tls *client, *server_cctx;
+	int failure;
+
+	circular_init();
+
+	if ((client = tls_client()) == NULL)
+		errx(1, "failed to create tls client");
+	if (tls_configure(client, client_cfg) == -1)
+		errx(1, "failed to configure client: %s", tls_error(client));
+
+	if (tls_accept_cbs(server, &server_cctx, server_read, server_write,
+	    NULL) == -1)
+		errx(1, "failed to accept: %s", tls_error(server));
+	if (tls_connect_cbs(client, client_read, client_write, NULL,
+	    "test") == -1)
+		errx(1, "failed to connect: %s", tls_error(client));
+
+	failure = do_client_server_test(desc, client, server_cctx);
+
+	*resumed = tls_conn_session_resumed(client);
+	if (tls_conn_session_resumed(server_cctx) != *resumed) {
+		printf("FAIL: %s client and server disagree on resumption\n",
+		    desc);
+		failure = 1;
+	}
+
+	tls_free(server_cctx);
+	tls_free(client);
+
+	return (failure);
+}
+
+static int
+do_tls_session_tests(void)
+{
+	struct tls_config *client_cfg, *server_cfg;
+	char session_file[] = "/tmp/tlstest.XXXXXXXXXX";
+	struct tls *server;
+	int i, resumed, session_fd;
+	int failure = 0;
+
+	if ((server = tls_server()) == NULL)
+		errx(1, "failed to create tls server");
+	if ((server_cfg = tls_config_new()) == NULL)
+		errx(1, "failed to create tls server config");
+	if (tls_config_set_keypair_file(server_cfg, certfile, keyfile) == -1)
+		errx(1, "failed to set keypair: %s",
+		    tls_config_error(server_cfg));
+	if (tls_config_set_session_lifetime(server_cfg, 300) == -1)
+		errx(1, "failed to set session lifetime: %s",
+		    tls_config_error(server_cfg));
+	if (tls_configure(server, server_cfg) == -1)
+		errx(1, "failed to configure server: %s", tls_error(server));
+	tls_config_free(server_cfg);
+
+	/* Sessions cached in memory. */
+	if ((client_cfg = tls_config_new()) == NULL)
+		errx(1, "failed to create tls client config");
+	tls_config_insecure_noverifyname(client_cfg);
+	if (tls_config_set_ca_file(client_cfg, cafile) == -1)
+		errx(1, "failed to set ca: %s", tls_config_error(client_cfg));
+	if (tls_config_set_session_cache_size(client_cfg, 4) == -1)
+		errx(1, "failed to set session cache size: %s",
+		    tls_config_error(client_cfg));
+
+	for (i = 0; i < 3; i++) {
+		failure |= do_session_resumption_test("session cache",
+		    client_cfg, server, &resumed);
+		if (resumed != (i > 0)) {
+			printf("FAIL: session cache connection %d %s\n", i,
+			    resumed ? "resumed" : "not resumed");
+			failure = 1;
+		}
+	}
+	tls_config_free(client_cfg);
+
+	/* Sessions stored in a file. */
+	if ((session_fd = mkstemp(session_file)) == -1)
+		err(1, "failed to create session file");
+	unlink(session_file);
+
+	for (i = 0; i < 3; i++) {
+		if ((client_cfg = tls_config_new()) == NULL)
+			errx(1, "failed to create tls client config");
+		tls_config_insecure_noverifyname(client_cfg);
+		if (tls_config_set_ca_file(client_cfg, cafile) == -1)
+			errx(1, "failed to set ca: %s",
+			    tls_config_error(client_cfg));
+		if (tls_config_set_session_fd(client_cfg, session_fd) == -1)
+			errx(1, "failed to set session fd: %s",
+			    tls_config_error(client_cfg));
+
+		failure |= do_session_resumption_test("session file",
+		    client_cfg, server, &resumed);
+		if (resumed != (i > 0)) {
+			printf("FAIL: session file connection %d %s\n", i,
+			    resumed ? "resumed" : "not resumed");
+			failure = 1;
+		}
+		tls_config_free(client_cfg);
+	}
+	close(session_fd);
+
+	tls_free(server);
+
+	return (failure);
+}
+
+#define SESSION_THREADS		8
+#define SESSION_THREAD_CONNS	16
+
+static pthread_mutex_t *crypto_locks;
+
+static void
+crypto_lock_cb(int mode, int type, const char *file, int line)
+{
+	if (mode & CRYPTO_LOCK)
+		pthread_mutex_lock(&crypto_locks[type]);
+	else
+		pthread_mutex_unlock(&crypto_locks[type]);
+}
+
+struct session_thread {
+	pthread_t thread;
+	struct tls_config *client_cfg;
+	struct tls *server;
+	int resumed;
+	int failure;
+};
+
+static void *
+session_thread(void *arg)
+{
+	struct session_thread *st = arg;
+	struct tls *client, *server_cctx;
+	int i, sv[2];
+
+	for (i = 0; i < SESSION_THREAD_CONNS; i++) {
+		if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, PF_UNSPEC,
+		    sv) == -1)
+			err(1, "failed to create socketpair");
+
+		if ((client = tls_client()) == NULL)
+			errx(1, "failed to create tls client");
+		if (tls_configure(client, st->client_cfg) == -1)
+			errx(1, "failed to configure client: %s",
+			    tls_error(client));
+		if (tls_accept_socket(st->server, &server_cctx, sv[0]) == -1)
+			errx(1, "failed to accept: %s", tls_error(st->server));
+		if (tls_connect_socket(client, sv[1], "test") == -1)
+			errx(1, "failed to connect: %s", tls_error(client));
+
+		if (do_client_server_handshake("session thread", client,
+		    server_cctx) != 0 ||
+		    do_client_server_close("session thread", client,
+		    server_cctx) != 0)
+			st->failure = 1;
+		if (tls_conn_session_resumed(client))
+			st->resumed++;
+
+		tls_free(server_cctx);
+		tls_free(client);
+		close(sv[0]);
+		close(sv[1]);
+	}
+
+	return (NULL);
+}
+
+/*
+ * Connect from several threads through one client config, so that they
+ * all share its session cache.
+ */
+static int
+do_tls_session_thread_tests(void)
+{
+	struct session_thread st[SESSION_THREADS];
+	struct tls_config *client_cfg, *server_cfg;
+	struct tls *server;
+	int i, resumed;
+	int failure = 0;
+
+	/* libssl and libcrypto only lock with the callbacks set. */
+	if ((crypto_locks = calloc(CRYPTO_num_locks(),
+	    sizeof(*crypto_locks))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < CRYPTO_num_locks(); i++)
+		pthread_mutex_init(&crypto_locks[i], NULL);
+	CRYPTO_set_locking_callback(crypto_lock_cb);
+
+	if ((server = tls_server()) == NULL)
+		errx(1, "failed to create tls server");
+	if ((server_cfg = tls_config_new()) == NULL)
+		errx(1, "failed to create tls server config");
+	if (tls_config_set_keypair_file(server_cfg, certfile, keyfile) == -1)
+		errx(1, "failed to set keypair: %s",
+		    tls_config_error(server_cfg));
+	if (tls_config_set_session_lifetime(server_cfg, 300) == -1)
+		errx(1, "failed to set session lifetime: %s",
+		    tls_config_error(server_cfg));
+	if (tls_configure(server, server_cfg) == -1)
+		errx(1, "failed to configure server: %s", tls_error(server));
+	tls_config_free(server_cfg);
+
+	if ((client_cfg = tls_config_new()) == NULL)
+		errx(1, "failed to create tls client config");
+	tls_config_insecure_noverifyname(client_cfg);
+	if (tls_config_set_ca_file(client_cfg, cafile) == -1)
+		errx(1, "failed to set ca: %s", tls_config_error(client_cfg));
+	if (tls_config_set_session_cache_size(client_cfg, 4) == -1)
+		errx(1, "failed to set session cache size: %s",
+		    tls_config_error(client_cfg));
+
+	/* Fill the cache, so that every threaded connection can resume. */
+	failure |= do_session_resumption_test("session thread", client_cfg,
+	    server, &resumed);
+
+	for (i = 0; i < SESSION_THREADS; i++) {
+		st[i].client_cfg = client_cfg;
+		st[i].server = server;
+		st[i].resumed = 0;
+		st[i].failure = 0;
+		if (pthread_create(&st[i].thread, NULL, session_thread,
+		    &st[i]) != 0)
+			errx(1, "failed to create thread");
+	}
+	for (i = 0; i < SESSION_THREADS; i++) {
+		pthread_join(st[i].thread, NULL);
+		failure |= st[i].failure;
+		if (st[i].resumed != SESSION_THREAD_CONNS) {
+			printf("FAIL: session thread %d resumed %d of %d "
+			    "connections\n", i, st[i].resumed,
+			    SESSION_THREAD_CONNS);
+			failure = 1;
+		}
+	}
+
+	tls_config_free(client_cfg);
+	tls_free(server);
+
+	CRYPTO_set_locking_callback(NULL);
+	for (i = 0; i < CRYPTO_num_locks(); i++)
+		pthread_mutex_destroy(&crypto_locks[i]);
+	free(crypto_locks);
+
+	return (failure);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -448,6 +704,8 @@ main(int argc, char **argv)
 
 	failure |= do_tls_tests();
 	failure |= do_tls_ordering_tests();
+	failure |= do_tls_session_tests();
+	failure |= do_tls_session_thread_tests();
 
 	return (failure);
 }
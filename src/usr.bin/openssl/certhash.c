@@ -28,16 +28,26 @@
 #include <openssl/bio.h>
 #include <openssl/evp.h>
 #include <openssl/pem.h>
+#include <openssl/sha.h>
 #include <openssl/x509.h>
 
 #include "apps.h"
 
 static struct {
+	char *bundle;
 	int dryrun;
 	int verbose;
 } certhash_config;
 
 struct option certhash_options[] = {
+	{
+		.name = "b",
+		.argname = "bundle",
+		.desc = "Write the certificates to a bundle instead of "
+		    "creating links",
+		.type = OPTION_ARG,
+		.opt.arg = &certhash_config.bundle,
+	},
 	{
 		.name = "n",
 		.desc = "Perform a dry-run - do not make any changes",
@@ -59,6 +69,8 @@ struct hashinfo {
 	unsigned long hash;
 	unsigned int index;
 	unsigned char fingerprint[EVP_MAX_MD_SIZE];
+	unsigned char *der;
+	size_t der_len;
 	int is_crl;
 	int is_dup;
 	int exists;
@@ -95,6 +107,7 @@ hashinfo_free(struct hashinfo *hi)
 
 	free(hi->filename);
 	free(hi->target);
+	free(hi->der);
 	free(hi);
 }
 
@@ -168,6 +181,54 @@ hashinfo_chain_length(struct hashinfo *hi)
 	return (len);
 }
 
+/*
+ * Compute the SHA-256 fingerprints of a chain of certificates or CRLs from
+ * their DER encodings, hashing several of them at once.
+ */
+static int
+hashinfo_chain_fingerprint(struct hashinfo *head)
+{
+	const unsigned char **der = NULL;
+	unsigned char **md = NULL;
+	struct hashinfo *entry;
+	size_t *der_len = NULL;
+	size_t i, len;
+	int ret = -1;
+
+	if (head == NULL)
+		return (0);
+
+	len = hashinfo_chain_length(head);
+	if ((der = reallocarray(NULL, len, sizeof(*der))) == NULL)
+		goto err;
+	if ((der_len = reallocarray(NULL, len, sizeof(*der_len))) == NULL)
+		goto err;
+	if ((md = reallocarray(NULL, len, sizeof(*md))) == NULL)
+		goto err;
+
+	for (entry = head, i = 0; entry != NULL; entry = entry->next, i++) {
+		der[i] = entry->der;
+		der_len[i] = entry->der_len;
+		md[i] = entry->fingerprint;
+	}
+	SHA256_multi(der, der_len, md, len);
+
+	for (entry = head; entry != NULL; entry = entry->next) {
+		free(entry->der);
+		entry->der = NULL;
+		entry->der_len = 0;
+	}
+
+	ret = 0;
+
+err:
+	free(der);
+	free(der_len);
+	free(md);
+
+	return (ret);
+}
+
 static int
 hashinfo_chain_sort(struct hashinfo **head)
 {
@@ -295,30 +356,37 @@ done:
 	return (hi);
 }
 
+/*
+ * The fingerprint is computed later by hashinfo_chain_fingerprint(), from
+ * the DER encoding kept in the hashinfo.
+ */
 static struct hashinfo *
 certhash_cert(BIO *bio, const char *filename)
 {
-	unsigned char fingerprint[EVP_MAX_MD_SIZE];
 	struct hashinfo *hi = NULL;
-	const EVP_MD *digest;
+	unsigned char *der = NULL;
 	X509 *cert = NULL;
 	unsigned long hash;
-	unsigned int len;
+	int len;
 
 	if ((cert = PEM_read_bio_X509(bio, NULL, NULL, NULL)) == NULL)
 		goto err;
 
 	hash = X509_subject_name_hash(cert);
 
-	digest = EVP_sha256();
-	if (X509_digest(cert, digest, fingerprint, &len) != 1) {
+	if ((len = i2d_X509(cert, &der)) <= 0) {
 		fprintf(stderr, "out of memory\n");
 		goto err;
 	}
 
-	hi = hashinfo(filename, hash, fingerprint);
+	if ((hi = hashinfo(filename, hash, NULL)) == NULL)
+		goto err;
+	hi->der = der;
+	hi->der_len = len;
+	der = NULL;
 
 err:
+	free(der);
 	X509_free(cert);
 
 	return (hi);
@@ -327,27 +395,30 @@ err:
 static struct hashinfo *
 certhash_crl(BIO *bio, const char *filename)
 {
-	unsigned char fingerprint[EVP_MAX_MD_SIZE];
 	struct hashinfo *hi = NULL;
-	const EVP_MD *digest;
+	unsigned char *der = NULL;
 	X509_CRL *crl = NULL;
 	unsigned long hash;
-	unsigned int len;
+	int len;
 
 	if ((crl = PEM_read_bio_X509_CRL(bio, NULL, NULL, NULL)) == NULL)
 		return (NULL);
 
 	hash = X509_NAME_hash(X509_CRL_get_issuer(crl));
 
-	digest = EVP_sha256();
-	if (X509_CRL_digest(crl, digest, fingerprint, &len) != 1) {
+	if ((len = i2d_X509_CRL(crl, &der)) <= 0) {
 		fprintf(stderr, "out of memory\n");
 		goto err;
 	}
 
-	hi = hashinfo(filename, hash, fingerprint);
+	if ((hi = hashinfo(filename, hash, NULL)) == NULL)
+		goto err;
+	hi->der = der;
+	hi->der_len = len;
+	der = NULL;
 
 err:
+	free(der);
 	X509_CRL_free(crl);
 
 	return (hi);
@@ -432,7 +503,11 @@ certhash_merge(struct hashinfo **links, struct hashinfo **certs,
 {
 	struct hashinfo *cert, *crl;
 
-	/* Pass 1 - sort and index entries. */
+	/* Pass 1 - fingerprint, sort and index entries. */
+	if (hashinfo_chain_fingerprint(*certs) == -1)
+		return (-1);
+	if (hashinfo_chain_fingerprint(*crls) == -1)
+		return (-1);
 	if (hashinfo_chain_sort(certs) == -1)
 		return (-1);
 	if (hashinfo_chain_sort(crls) == -1)
@@ -635,10 +710,170 @@ done:
 	return (ret);
 }
 
+static int
+certhash_bundle_read(const char *filename, STACK_OF(X509) *certs)
+{
+	STACK_OF(X509_INFO) *inf = NULL;
+	X509_INFO *xi;
+	BIO *bio = NULL;
+	int i, count = -1;
+
+	if ((bio = BIO_new_file(filename, "r")) == NULL) {
+		fprintf(stderr, "failed to open %s\n", filename);
+		goto err;
+	}
+	if ((inf = PEM_X509_INFO_read_bio(bio, NULL, NULL, NULL)) == NULL) {
+		fprintf(stderr, "failed to read %s\n", filename);
+		goto err;
+	}
+	count = 0;
+	for (i = 0; i < sk_X509_INFO_num(inf); i++) {
+		xi = sk_X509_INFO_value(inf, i);
+		if (xi->x509 == NULL)
+			continue;
+		if (sk_X509_push(certs, xi->x509) == 0) {
+			fprintf(stderr, "out of memory\n");
+			count = -1;
+			goto err;
+		}
+		xi->x509 = NULL;
+		count++;
+	}
+	if (count == 0)
+		fprintf(stderr, "PEM file %s does not contain a certificate, "
+		    "ignoring...\n", filename);
+
+ err:
+	sk_X509_INFO_pop_free(inf, X509_INFO_free);
+	BIO_free(bio);
+
+	return (count);
+}
+
+static int
+certhash_bundle_directory(const char *path, STACK_OF(X509) *certs)
+{
+	struct dirent *dep;
+	DIR *dip;
+	char *filename;
+	int ret = 0;
+
+	if ((dip = opendir(path)) == NULL) {
+		fprintf(stderr, "failed to open directory %s\n", path);
+		return (-1);
+	}
+
+	if (certhash_config.verbose)
+		fprintf(stdout, "scanning directory %s\n", path);
+
+	while ((dep = readdir(dip)) != NULL) {
+		if (!filename_is_pem(dep->d_name))
+			continue;
+		if (asprintf(&filename, "%s/%s", path, dep->d_name) == -1) {
+			fprintf(stderr, "out of memory\n");
+			ret = -1;
+			break;
+		}
+		if (certhash_bundle_read(filename, certs) == -1)
+			ret = -1;
+		free(filename);
+		if (ret == -1)
+			break;
+	}
+	closedir(dip);
+
+	return (ret);
+}
+
+/*
+ * Write the certificates from the given PEM files and directories to a
+ * bundle. The bundle is written next to the old one and renamed over it,
+ * since processes may have the old one mapped.
+ */
+static int
+certhash_bundle(int argc, char **argv)
+{
+	STACK_OF(X509) *certs = NULL;
+	char *tmp = NULL;
+	struct stat sb;
+	BIO *bio = NULL;
+	int i, fd = -1, ret = 1;
+
+	if ((certs = sk_X509_new_null()) == NULL) {
+		fprintf(stderr, "out of memory\n");
+		goto err;
+	}
+
+	for (i = 0; i < argc; i++) {
+		if (stat(argv[i], &sb) == -1) {
+			fprintf(stderr, "failed to stat %s: %s\n", argv[i],
+			    strerror(errno));
+			goto err;
+		}
+		if (S_ISDIR(sb.st_mode)) {
+			if (certhash_bundle_directory(argv[i], certs) == -1)
+				goto err;
+		} else if (certhash_bundle_read(argv[i], certs) == -1)
+			goto err;
+	}
+
+	if (certhash_config.verbose || certhash_config.dryrun)
+		fprintf(stdout, "%s %d certificates to %s\n",
+		    (certhash_config.dryrun ? "would write" : "writing"),
+		    sk_X509_num(certs), certhash_config.bundle);
+	if (certhash_config.dryrun) {
+		ret = 0;
+		goto err;
+	}
+
+	if (asprintf(&tmp, "%s.XXXXXXXXXX", certhash_config.bundle) == -1) {
+		tmp = NULL;
+		fprintf(stderr, "out of memory\n");
+		goto err;
+	}
+	if ((fd = mkstemp(tmp)) == -1) {
+		fprintf(stderr, "failed to create %s: %s\n", tmp,
+		    strerror(errno));
+		goto err;
+	}
+	if (fchmod(fd, 0644) == -1 ||
+	    (bio = BIO_new_fd(fd, BIO_NOCLOSE)) == NULL ||
+	    !X509_bundle_write_bio(bio, certs) || BIO_flush(bio) != 1) {
+		fprintf(stderr, "failed to write %s\n", tmp);
+		unlink(tmp);
+		goto err;
+	}
+	if (close(fd) == -1) {
+		fd = -1;
+		fprintf(stderr, "failed to write %s\n", tmp);
+		unlink(tmp);
+		goto err;
+	}
+	fd = -1;
+	if (rename(tmp, certhash_config.bundle) == -1) {
+		fprintf(stderr, "failed to rename %s to %s: %s\n", tmp,
+		    certhash_config.bundle, strerror(errno));
+		unlink(tmp);
+		goto err;
+	}
+
+	ret = 0;
+
+ err:
+	BIO_free(bio);
+	if (fd != -1)
+		close(fd);
+	free(tmp);
+	sk_X509_pop_free(certs, X509_free);
+
+	return (ret);
+}
+
 static void
 certhash_usage(void)
 {
-	fprintf(stderr, "usage: certhash [-nv] dir ...\n");
+	fprintf(stderr, "usage: certhash [-nv] dir ...\n"
+	    "       certhash [-nv] -b bundle dir | file ...\n");
 	options_usage(certhash_options);
 }
 
@@ -662,6 +897,9 @@ certhash_main(int argc, char **argv)
                 return (1);
         }
 
+	if (certhash_config.bundle != NULL)
+		return (certhash_bundle(argc - argsused, argv + argsused));
+
 	if ((cwdfd = open(".", O_RDONLY)) == -1) {
 		perror("failed to open current directory");
 		return (1);
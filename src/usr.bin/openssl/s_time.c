@@ -111,6 +111,7 @@ struct {
 	int verify;
 	int verify_depth;
 	char *www_path;
+	int zerocopy;
 } s_time_config;
 
 struct option s_time_options[] = {
@@ -210,6 +211,12 @@ struct option s_time_options[] = {
 		.type = OPTION_ARG,
 		.opt.arg = &s_time_config.www_path,
 	},
+	{
+		.name = "zerocopy",
+		.desc = "Decrypt application data directly into the read buffer",
+		.type = OPTION_FLAG,
+		.opt.flag = &s_time_config.zerocopy,
+	},
 	{ NULL },
 };
 
@@ -221,7 +228,7 @@ s_time_usage(void)
 	    "[-bugs] [-CAfile file] [-CApath directory] [-cert file]\n"
 	    "    [-cipher cipherlist] [-connect host:port] [-key keyfile]\n"
 	    "    [-nbio] [-new] [-no_shutdown] [-reuse] [-time seconds]\n"
-	    "    [-verify depth] [-www page]\n\n");
+	    "    [-verify depth] [-www page] [-zerocopy]\n\n");
 	options_usage(s_time_options);
 }
 
@@ -249,7 +256,7 @@ s_time_main(int argc, char **argv)
 	SSL *scon = NULL;
 	time_t finishtime;
 	int ret = 1;
-	char buf[1024 * 8];
+	char buf[SSL3_RT_MAX_PLAIN_LENGTH];
 	int ver;
 
 	if (single_execution) {
@@ -296,6 +303,9 @@ s_time_main(int argc, char **argv)
 	if (s_time_config.bugs)
 		SSL_CTX_set_options(tm_ctx, SSL_OP_ALL);
 
+	if (s_time_config.zerocopy)
+		SSL_CTX_set_mode(tm_ctx, SSL_MODE_ZERO_COPY_READ);
+
 	if (s_time_config.cipher != NULL) {
 		if (!SSL_CTX_set_cipher_list(tm_ctx, s_time_config.cipher)) {
 			BIO_printf(bio_err, "error setting cipher list\n");
@@ -384,6 +394,7 @@ s_time_main(int argc, char **argv)
 	    nConn,
 	    (long long)(time(NULL) - finishtime + s_time_config.maxtime),
 	    bytes_read / nConn);
+	printf("%.2f bytes read/user sec\n", (double)bytes_read / totalTime);
 
 	/*
 	 * Now loop and time connections using the same session id over and
@@ -476,6 +487,7 @@ next:
 	    nConn,
 	    (long long)(time(NULL) - finishtime + s_time_config.maxtime),
 	    bytes_read / nConn);
+	printf("%.2f bytes read/user sec\n", (double)bytes_read / totalTime);
 
 	ret = 0;
 end: